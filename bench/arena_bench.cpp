@@ -0,0 +1,118 @@
+// False sharing between per-thread counters: packed 8-byte counters, the
+// usual alignas(64) slots, and PaddedCounters spaced by the padding
+// detected at run time (128 bytes on Intel, where the L2 prefetcher pairs
+// lines). Each thread is pinned and bumps only its own counter. Ends with
+// an SpscQueue round trip between two threads.
+//   arena_bench [THREADS [MILLIONS]]   THREADS 0: every allowed CPU
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "arena.hpp"
+#include "percpu.hpp"
+
+struct alignas(64) Aligned64 {
+  std::atomic<uint64_t> value{0};
+};
+
+// ns per increment with `threads` threads each calling bump(t) `iters`
+// times
+template <typename Bump>
+static double run(size_t threads, uint64_t iters, Bump bump) {
+  const std::vector<int> cpus = allowed_cpus();
+  std::barrier start(std::ptrdiff_t(threads + 1));
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      if (!cpus.empty()) pin_thread_to_cpu(cpus[t % cpus.size()]);
+      start.arrive_and_wait();
+      for (uint64_t i = 0; i < iters; ++i) bump(t);
+    });
+  }
+  start.arrive_and_wait();
+  auto begin = std::chrono::steady_clock::now();
+  for (std::thread &th : pool) th.join();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - begin;
+  return d.count() / double(iters);
+}
+
+static void report(std::string_view name, size_t stride, double ns,
+                   uint64_t total, uint64_t expected) {
+  std::cout << std::format("{:<16} stride {:4}: {:7.2f} ns/increment{}\n",
+                           name, stride, ns,
+                           total == expected ? "" : " (WRONG TOTAL)");
+}
+
+int main(int argc, char **argv) {
+  size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 0;
+  uint64_t iters =
+      (argc > 2 ? std::strtoull(argv[2], nullptr, 0) : 20) * 1'000'000;
+  if (threads == 0) threads = std::max<size_t>(allowed_cpus().size(), 2);
+
+  const LineGeometry &geo = host_line_geometry();
+  std::cout << std::format(
+      "line {} B, padding {} B, L1d {} KiB, L2 {} KiB per CPU; compile-time "
+      "guess {} B\n",
+      geo.lineSize, geo.padding, geo.l1Bytes / 1024, geo.l2Bytes / 1024,
+      std::hardware_destructive_interference_size);
+  std::cout << std::format("{} threads, {} M increments each\n", threads,
+                           iters / 1'000'000);
+  const uint64_t expected = threads * iters;
+
+  auto bump = [](std::atomic<uint64_t> &c) {
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  };
+
+  std::vector<std::atomic<uint64_t>> packed(threads);
+  double ns = run(threads, iters, [&](size_t t) { bump(packed[t]); });
+  uint64_t total = 0;
+  for (const auto &c : packed) total += c.load();
+  report("packed", sizeof(packed[0]), ns, total, expected);
+
+  std::vector<Aligned64> aligned(threads);
+  ns = run(threads, iters, [&](size_t t) { bump(aligned[t].value); });
+  total = 0;
+  for (const auto &c : aligned) total += c.value.load();
+  report("alignas(64)", sizeof(Aligned64), ns, total, expected);
+
+  PaddedCounters padded(threads);
+  ns = run(threads, iters, [&](size_t t) { padded.add(t); });
+  report("PaddedCounters", padded.stride(), ns, padded.total(), expected);
+
+  constexpr uint64_t kMessages = 10'000'000;
+  SpscQueue<uint64_t> queue(1024);
+  uint64_t received = 0;
+  auto begin = std::chrono::steady_clock::now();
+  std::thread consumer([&] {
+    for (uint64_t n = 0; n < kMessages;) {
+      if (auto v = queue.pop()) {
+        received += *v;
+        ++n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (uint64_t i = 0; i < kMessages; ++i) {
+    while (!queue.push(i)) std::this_thread::yield();
+  }
+  consumer.join();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - begin;
+  std::cout << std::format("SpscQueue<uint64_t>({}): {:7.2f} ns/message{}\n",
+                           queue.capacity(), d.count() / kMessages,
+                           received == kMessages * (kMessages - 1) / 2
+                               ? ""
+                               : " (WRONG SUM)");
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Field<>/regs_to_chars() against the helpers they replaced: the
+// bitfield32 macros, and num_to_str() building a std::string through a
+// heap std::vector per register.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace legacy {
+
+#define legacy_bit32(n) (1U << (n))
+#define legacy_bitmask32(h, l) \
+  ((legacy_bit32(h) | (legacy_bit32(h) - 1)) & ~(legacy_bit32(l) - 1))
+#define legacy_extract_bits(x, start, end) \
+  (((x & legacy_bitmask32(end, start)) >> start))
+
+static std::vector<unsigned char> getBytesLE(const unsigned char *bytes,
+                                             const size_t n) {
+  std::vector<unsigned char> ret(n);
+  std::copy_n(bytes, n, ret.begin());
+  return ret;
+}
+
+static std::string num_to_str(int num) {
+  auto vec = getBytesLE(reinterpret_cast<const unsigned char *>(&num),
+                        sizeof(num));
+  return std::string(vec.begin(), vec.end());
+}
+
+}  // namespace legacy
+
+template <typename F>
+static double ns_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f(uint32_t(i));
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main() {
+  constexpr int kIters = 20'000'000;
+  volatile uint32_t sink = 0;
+  uint32_t eax = 0x000806F8;
+
+  std::cout << std::format(
+      "extract (macro):          {:.2f} ns\n",
+      ns_per_call(
+          [&](uint32_t i) {
+            uint32_t x = eax ^ i;
+            sink = (legacy_extract_bits(x, 16, 19) << 4) |
+                   legacy_extract_bits(x, 4, 7);
+          },
+          kIters));
+  std::cout << std::format(
+      "extract (Field):          {:.2f} ns\n",
+      ns_per_call(
+          [&](uint32_t i) {
+            uint32_t x = eax ^ i;
+            sink = (leaf1::ExtendedModel::get(x) << 4) | leaf1::Model::get(x);
+          },
+          kIters));
+
+  // Vendor string from three registers
+  std::cout << std::format(
+      "vendor (num_to_str):      {:.2f} ns\n",
+      ns_per_call(
+          [&](uint32_t i) {
+            std::string s = legacy::num_to_str(0x756E6547 ^ (i & 1));
+            s += legacy::num_to_str(0x49656E69);
+            s += legacy::num_to_str(0x6C65746E);
+            sink = s[0] + s[11];
+          },
+          kIters / 10));
+  std::cout << std::format(
+      "vendor (regs_to_chars):   {:.2f} ns\n",
+      ns_per_call(
+          [&](uint32_t i) {
+            auto s = regs_to_chars(0x756E6547U ^ (i & 1), 0x49656E69U,
+                                   0x6C65746EU);
+            sink = s.chars[0] + s.chars[11];
+          },
+          kIters / 10));
+  return 0;
+}
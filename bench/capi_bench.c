@@ -0,0 +1,86 @@
+/* In-process detection through the C API of the shared library, against
+ * spawning the CLI and reading its report as services used to.
+ *   capi_bench [CPUID_EXE]   also times `CPUID_EXE --report json` */
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpuid_api.h"
+
+extern char **environ;
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int spawn_report(const char *exe) {
+  char *argv[] = {(char *)exe, "--report", "json", NULL};
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  pid_t pid;
+  int rc = posix_spawn(&pid, exe, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (rc != 0) return 0;
+  int status;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+  enum { kIters = 200, kQueries = 10000000 };
+
+  double start = now_us();
+  const cpuid_snapshot *host = cpuid_snapshot_host();
+  double first = now_us() - start;
+
+  start = now_us();
+  for (int i = 0; i < kIters; ++i) cpuid_snapshot_free(cpuid_snapshot_create());
+  double create = (now_us() - start) / kIters;
+
+  char brand[64];
+  cpuid_brand(host, brand, sizeof(brand));
+  printf("API version %u, %zu leaves, %s\n", cpuid_api_version(),
+         cpuid_snapshot_leaf_count(host), brand);
+  printf("first cpuid_snapshot_host(): %9.1f us\n", first);
+  printf("cpuid_snapshot_create():     %9.1f us\n", create);
+
+  int avx2 = cpuid_feature_lookup("AVX2");
+  volatile int sink = 0;
+  start = now_us();
+  for (int i = 0; i < kQueries; ++i) sink = cpuid_feature_usable(host, avx2);
+  printf("cpuid_feature_usable():      %9.1f ns\n",
+         (now_us() - start) * 1e3 / kQueries);
+
+  cpuid_cache caches[8];
+  size_t n = cpuid_cache_info(host, caches, 8);
+  for (size_t i = 0; i < n && i < 8; ++i) {
+    printf("  L%u %s %u KiB, %u-way, line %u\n", caches[i].level,
+           caches[i].type == CPUID_CACHE_INSTRUCTION ? "i"
+           : caches[i].type == CPUID_CACHE_DATA      ? "d"
+                                                     : "u",
+           caches[i].size_bytes / 1024, caches[i].ways, caches[i].line_size);
+  }
+
+  if (argc > 1) {
+    enum { kSpawns = 10 };
+    start = now_us();
+    for (int i = 0; i < kSpawns; ++i) {
+      if (!spawn_report(argv[1])) {
+        fprintf(stderr, "%s --report json failed\n", argv[1]);
+        return 1;
+      }
+    }
+    printf("spawn %s --report json: %9.1f us\n", argv[1],
+           (now_us() - start) / kSpawns);
+  }
+  (void)sink;
+  return 0;
+}
@@ -0,0 +1,61 @@
+// Compares a dispatched kernel call against a direct call to the same
+// implementation. Small buffers keep the kernel cheap so call overhead shows.
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "cpuinfo.hpp"
+#include "kernels.hpp"
+
+template <typename F>
+static double ns_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main() {
+  constexpr int kIters = 20'000'000;
+  std::vector<uint8_t> bytes(64, 0xA5);
+  std::vector<uint32_t> words(16, 7);
+  volatile uint64_t sink = 0;
+
+  std::cout << std::format("popcount -> {}, sum -> {}\n",
+                           kernels::popcount_dispatch.selected().name,
+                           kernels::sum_dispatch.selected().name);
+
+  // Check every variant that can run here agrees with the scalar baseline
+  const FeatureSet &features = CPUInfo::host().usableFeatures();
+  for (const auto &impl : kernels::popcount_dispatch.impls()) {
+    if (!features.hasAll(impl.needs)) continue;
+    if (impl.fn(bytes.data(), bytes.size()) !=
+        kernels::popcount_scalar(bytes.data(), bytes.size())) {
+      std::cout << std::format("popcount {} mismatch\n", impl.name);
+      return 1;
+    }
+  }
+
+  // The direct call goes through a volatile pointer so it cannot be inlined
+  // either; both sides pay exactly one indirect call.
+  kernels::PopcountFn *volatile direct = kernels::popcount_dispatch.get();
+  double d = ns_per_call(
+      [&] { sink = sink + direct(bytes.data(), bytes.size()); }, kIters);
+  double p = ns_per_call(
+      [&] { sink = sink + kernels::popcount(bytes.data(), bytes.size()); },
+      kIters);
+  std::cout << std::format(
+      "popcount(64B): direct {:.2f} ns, dispatched {:.2f} ns\n", d, p);
+
+  kernels::SumFn *volatile directSum = kernels::sum_dispatch.get();
+  d = ns_per_call(
+      [&] { sink = sink + directSum(words.data(), words.size()); }, kIters);
+  p = ns_per_call(
+      [&] { sink = sink + kernels::sum(words.data(), words.size()); }, kIters);
+  std::cout << std::format(
+      "sum(16 x u32): direct {:.2f} ns, dispatched {:.2f} ns\n", d, p);
+  return 0;
+}
@@ -0,0 +1,160 @@
+// Fleet dump ingestion throughput on a synthetic dump: hosts of 1 to 8
+// CPUs cloned from this machine with varied models and APIC IDs, a third
+// each in the `cpuid -r`, plain hex and InstLatX64 layouts. Compares the
+// per-host parse_cpuid_dump() + PerCpuSnapshot path (on a prefix) with
+// ingest_fleet_dump() inline, on the pool, and from a mapped file.
+//   fleet_bench [MIB [THREADS]]   MIB: dump size (default 64)
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "backend.hpp"
+#include "fleet.hpp"
+
+// One host's records for `cpus` CPUs; model and APIC IDs are patched in
+static void append_host(std::string &out, size_t host, unsigned cpus,
+                        const CpuidSnapshot &base) {
+  std::format_to(std::back_inserter(out), "HOST node{:06}.rack{}\n", host,
+                 host % 97);
+  for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+    std::format_to(std::back_inserter(out), "CPU {}:\n", cpu);
+    for (CpuidLeaf l : base.leaves()) {
+      if (l.leaf == 0x1) {
+        l.regs[0] = (l.regs[0] & ~0xF0U) | uint32_t(host % 16) << 4;
+        l.regs[1] = (l.regs[1] & 0x00FFFFFF) | cpu << 24;
+      } else if (l.leaf == 0xB || l.leaf == 0x1F) {
+        l.regs[3] = cpu;
+      }
+      switch (host % 3) {
+        case 0:
+          std::format_to(std::back_inserter(out),
+                         "   {:#010x} {:#04x}: eax={:#010x} ebx={:#010x} "
+                         "ecx={:#010x} edx={:#010x}\n",
+                         l.leaf, l.subleaf, l.EAX(), l.EBX(), l.ECX(),
+                         l.EDX());
+          break;
+        case 1:
+          std::format_to(std::back_inserter(out),
+                         "{:x} {:x} {:08x} {:08x} {:08x} {:08x}\n", l.leaf,
+                         l.subleaf, l.EAX(), l.EBX(), l.ECX(), l.EDX());
+          break;
+        default:
+          std::format_to(std::back_inserter(out),
+                         "CPUID {:08X}: {:08X}-{:08X}-{:08X}-{:08X} "
+                         "[SL {:02X}]\n",
+                         l.leaf, l.EAX(), l.EBX(), l.ECX(), l.EDX(),
+                         l.subleaf);
+          break;
+      }
+    }
+  }
+}
+
+// What re-decoding a fleet took before: one parse_cpuid_dump() per host
+static FleetTable decode_per_host(std::string_view text) {
+  FleetTable table;
+  while (!text.empty()) {
+    size_t next = text.find("\nHOST", 1);
+    std::string_view host = text.substr(0, next);
+    text.remove_prefix(next == text.npos ? text.size() : next + 1);
+    std::string_view name = host.substr(5, host.find('\n') - 5);
+    if (std::optional<CpuidDump> dump = parse_cpuid_dump(host)) {
+      table.addHost(name, PerCpuSnapshot(*dump));
+    }
+  }
+  return table;
+}
+
+static bool same_rows(const FleetTable &a, const FleetTable &b) {
+  return a.names == b.names && a.vendor == b.vendor && a.family == b.family &&
+         a.model == b.model && a.stepping == b.stepping &&
+         a.features == b.features && a.l1dBytes == b.l1dBytes &&
+         a.l2Bytes == b.l2Bytes && a.l3Bytes == b.l3Bytes &&
+         a.logicalCpus == b.logicalCpus && a.cores == b.cores &&
+         a.packages == b.packages;
+}
+
+template <typename F>
+static double best_seconds(F &&f, int runs) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  const size_t target = size_t(argc > 1 ? std::atoi(argv[1]) : 64) << 20;
+  const unsigned threads = argc > 2 ? unsigned(std::atoi(argv[2])) : 0;
+  constexpr int kRuns = 3;
+
+  const CpuidSnapshot &base = CpuidSnapshot::host();
+  std::string text;
+  text.reserve(target + (size_t(1) << 20));
+  size_t hosts = 0;
+  while (text.size() < target) {
+    append_host(text, hosts, 1U << (hosts % 4), base);
+    ++hosts;
+  }
+  std::cout << std::format("{} hosts, {:.1f} MiB of text\n", hosts,
+                           double(text.size()) / double(1 << 20));
+
+  auto report = [&](std::string_view what, size_t bytes, double s) {
+    std::cout << std::format(
+        "{:<22} {:8.3f} s  {:6.3f} GB/s  {:9.0f} hosts/s\n", what, s,
+        double(bytes) / s * 1e-9,
+        double(hosts) * double(bytes) / double(text.size()) / s);
+  };
+
+  // The old path is slow enough that a prefix shows its rate
+  std::string_view prefix(text.data(),
+                          std::min(text.size(), size_t(8) << 20));
+  prefix = prefix.substr(0, prefix.rfind("\nHOST") + 1);
+  FleetTable slow;
+  report("parse_cpuid_dump", prefix.size(),
+         best_seconds([&] { slow = decode_per_host(prefix); }, 1));
+  const bool match =
+      same_rows(slow, ingest_fleet_dump(prefix, {.threads = 1}));
+
+  FleetTable table;
+  report("ingest, 1 thread", text.size(), best_seconds([&] {
+           table = ingest_fleet_dump(text, {.threads = 1});
+         }, kRuns));
+  report(std::format("ingest, pool ({})",
+                     threads ? std::to_string(threads) : "cores"),
+         text.size(), best_seconds([&] {
+           table = ingest_fleet_dump(text, {.threads = threads});
+         }, kRuns));
+
+  std::filesystem::path file = std::filesystem::temp_directory_path() /
+                               std::format("fleet_bench.{}", getpid());
+  std::ofstream(file, std::ios::binary) << text;
+  report("load_fleet_dump", text.size(), best_seconds([&] {
+           table = *load_fleet_dump(file.string(), {.threads = threads});
+         }, kRuns));
+  std::filesystem::remove(file);
+
+  std::cout << std::format(
+      "{} rows; per-host path agrees on {} hosts: {}\n", table.size(),
+      slow.size(), match ? "yes" : "NO");
+  std::cout << std::format(
+      "row 1: {} family {:#x} model {:#x}, L3 {} KiB, {} cpus, {} cores, "
+      "{} packages\n",
+      table.host(1), table.family[1], table.model[1], table.l3Bytes[1] >> 10,
+      table.logicalCpus[1], table.cores[1], table.packages[1]);
+  return match && table.size() == hosts ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+// What one `cpuid` costs on this (virtual) machine, per leaf, against a
+// lookup in a CpuidSnapshot taken once. Under a hypervisor every `cpuid`
+// is a trap round trip; on bare metal it is still a serializing
+// instruction of a hundred cycles or more.
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#include "hypervisor.hpp"
+#include "snapshot.hpp"
+#include "tsc.hpp"
+
+int main() {
+  const CpuidSnapshot snap;
+  const HypervisorInfo hv = decode_hypervisor(snap);
+  const TscClock &clock = TscClock::host();
+  const VirtHints hints = virt_hints(hv, decode_tsc(snap));
+  std::cout << std::format("hypervisor {}, cache cpuid {}, TSC {} Hz\n",
+                           hypervisor_name(hv.vendor), hints.cacheCpuid,
+                           clock.tscHz());
+
+  struct Probe {
+    uint32_t leaf;
+    uint32_t subleaf;
+  };
+  static constexpr Probe kProbes[] = {
+      {0x0, 0},  {0x1, 0},        {0x4, 1},        {0x7, 0},
+      {0xB, 0},  {0xD, 1},        {0x40000000, 0}, {0x40000001, 0},
+      {0x80000000, 0}, {0x80000002, 0},
+  };
+  for (const Probe &p : kProbes) {
+    double ns = measure_cpuid_ns(p.leaf, p.subleaf, 20000);
+    std::cout << std::format("cpuid {:#010x}.{}: {:8.1f} ns {:8.0f} cycles\n",
+                             p.leaf, p.subleaf, ns,
+                             ns * double(clock.tscHz()) / 1e9);
+  }
+
+  constexpr int kIters = 10'000'000;
+  volatile uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIters; ++i) sink = sink + snap.get(0x7).EBX();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::format("snapshot get(0x7):   {:8.1f} ns\n",
+                           d.count() / kIters);
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Full-machine CPUID scan: pinned worker threads (affinity migration)
+// against unpinned workers reading /dev/cpu/N/cpuid, at 1 and N threads.
+//   percpu_bench [ROOT]     device directory, default /dev/cpu
+//   percpu_bench --fake N   writes N fake devices (sparse files holding this
+//                           CPU's leaves) to a temporary directory first
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "backend.hpp"
+#include "percpu.hpp"
+
+// At the offsets DevCpuBackend reads regular files from
+static bool write_fake_devices(const std::string &root, int cpus) {
+  const CpuidSnapshot snap;
+  for (int cpu = 0; cpu < cpus; ++cpu) {
+    std::string dir = std::format("{}/{}", root, cpu);
+    std::filesystem::create_directories(dir);
+    int fd = open((dir + "/cpuid").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return false;
+    for (const CpuidLeaf &l : snap.leaves()) {
+      off_t offset = off_t(DevCpuBackend::fileOffset(l.leaf, l.subleaf));
+      if (pwrite(fd, l.regs, sizeof(l.regs), offset) != sizeof(l.regs)) {
+        close(fd);
+        return false;
+      }
+    }
+    close(fd);
+  }
+  return true;
+}
+
+template <typename F>
+static double us_per_scan(F &&scan, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) scan();
+  std::chrono::duration<double, std::micro> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main(int argc, char **argv) {
+  constexpr int kIters = 20;
+  std::string root = "/dev/cpu";
+  // Only a directory this process created is removed at the end
+  const bool fake = argc > 2 && std::string_view(argv[1]) == "--fake";
+  if (fake) {
+    root = std::filesystem::temp_directory_path() /
+           std::format("cpuid-fake-{}", getpid());
+    if (!write_fake_devices(root, std::atoi(argv[2]))) {
+      std::cerr << std::format("cannot write fake devices to {}\n", root);
+      std::filesystem::remove_all(root);
+      return 1;
+    }
+  } else if (argc > 1) {
+    root = argv[1];
+  }
+
+  unsigned n = std::max(1U, std::thread::hardware_concurrency());
+  std::optional<PerCpuSnapshot> probe = PerCpuSnapshot::fromDevices(root);
+  if (!probe) {
+    std::cerr << std::format("{}: no readable cpuid devices\n", root);
+    if (fake) std::filesystem::remove_all(root);
+    return 1;
+  }
+  std::cout << std::format("{} CPUs by affinity, {} devices under {}\n",
+                           allowed_cpus().size(), probe->size(), root);
+
+  volatile size_t sink = 0;
+  for (unsigned threads : {1U, n}) {
+    std::cout << std::format(
+        "affinity, {:3} threads: {:9.1f} us/scan\n", threads,
+        us_per_scan([&] { sink = PerCpuSnapshot(threads).size(); }, kIters));
+    std::cout << std::format(
+        "device,   {:3} threads: {:9.1f} us/scan\n", threads,
+        us_per_scan(
+            [&] { sink = PerCpuSnapshot::fromDevices(root, threads)->size(); },
+            kIters));
+  }
+
+  if (fake) std::filesystem::remove_all(root);
+  return 0;
+}
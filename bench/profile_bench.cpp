@@ -0,0 +1,89 @@
+// ProfileScope overhead (an empty region, timed with the TSC) and a
+// profile of three regions run on several threads: a compute loop, a
+// sequential scan and a random walk that misses the LLC.
+//   profile_bench [THREADS]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "pmu.hpp"
+#include "profiler.hpp"
+#include "snapshot.hpp"
+
+static uint64_t compute(uint64_t n) {
+  uint64_t x = 1;
+  for (uint64_t i = 0; i < n; ++i) x = x * 6364136223846793005ull + i;
+  return x;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 0)) : 4;
+
+  const PmuInfo pmu = decode_pmu(CpuidSnapshot::host());
+  Profiler &profiler = Profiler::host();
+  std::cout << std::format(
+      "PMU v{}: {} general, {} fixed counters; profiling with {} events, "
+      "rdpmc {}\n",
+      pmu.version, pmu.gpCounters, pmu.fixedCounters,
+      profile_source_name(profiler.source()), profiler.userRead());
+
+  const ProfileRegion empty = profiler.region("empty");
+  constexpr int kIters = 1'000'000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIters; ++i) {
+    ProfileScope scope(empty);
+  }
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::format("empty ProfileScope: {:.1f} ns\n",
+                           d.count() / kIters);
+
+  // 64 MiB of a random cyclic permutation: every step is a dependent miss
+  std::vector<uint32_t> next(uint32_t(1) << 24);
+  {
+    std::vector<uint32_t> order(next.size());
+    std::iota(order.begin(), order.end(), 0U);
+    std::shuffle(order.begin() + 1, order.end(), std::mt19937(42));
+    for (size_t i = 0; i < order.size(); ++i) {
+      next[order[i]] = order[(i + 1) % order.size()];
+    }
+  }
+
+  const ProfileRegion computeRegion = profiler.region("compute");
+  const ProfileRegion scanRegion = profiler.region("scan");
+  const ProfileRegion walkRegion = profiler.region("random-walk");
+  std::vector<std::thread> pool;
+  std::vector<uint64_t> sinks(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      uint64_t sink = 0;
+      for (int round = 0; round < 4; ++round) {
+        {
+          ProfileScope scope(computeRegion);
+          sink += compute(10'000'000);
+        }
+        {
+          ProfileScope scope(scanRegion);
+          sink += std::accumulate(next.begin(), next.end(), uint64_t(0));
+        }
+        {
+          ProfileScope scope(walkRegion);
+          uint32_t i = t;
+          for (int step = 0; step < 1'000'000; ++step) i = next[i];
+          sink += i;
+        }
+      }
+      sinks[t] = sink;
+    });
+  }
+  for (std::thread &th : pool) th.join();
+  std::cout << format_profile(profiler);
+  return int(std::accumulate(sinks.begin(), sinks.end(), uint64_t(0)) == 1);
+}
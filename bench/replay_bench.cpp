@@ -0,0 +1,73 @@
+// Decoder throughput against a recorded machine: parse a raw dump, rebuild
+// every CPU's snapshot through ReplayBackend, then run the feature, cache,
+// topology and core-type decoders over it.
+//   replay_bench [DUMP]   (default: a dump of this host, made in memory)
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include "backend.hpp"
+#include "cache.hpp"
+#include "features.hpp"
+#include "hybrid.hpp"
+#include "percpu.hpp"
+#include "topology.hpp"
+
+template <typename F>
+static double ns_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main(int argc, char **argv) {
+  constexpr int kIters = 2'000;
+  std::string text;
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    std::ostringstream s;
+    s << in.rdbuf();
+    text = s.str();
+  } else {
+    text = format_cpuid_dump(PerCpuSnapshot());
+  }
+
+  std::optional<CpuidDump> dump = parse_cpuid_dump(text);
+  if (!dump) {
+    std::cerr << "no CPUID records in dump\n";
+    return 1;
+  }
+  PerCpuSnapshot all(*dump);
+  volatile size_t sink = 0;
+
+  std::cout << std::format("{} CPUs, {} leaves on cpu {}, {} bytes of text\n",
+                           all.size(), all[0].size(), all.cpu(0), text.size());
+
+  double parse = ns_per_call(
+      [&] { sink = parse_cpuid_dump(text)->cpus.size(); }, kIters);
+  std::cout << std::format("parse:      {:9.0f} ns/dump  ({:.0f} MB/s)\n",
+                           parse, text.size() / parse * 1e3);
+  std::cout << std::format(
+      "snapshots:  {:9.0f} ns/dump\n",
+      ns_per_call([&] { sink = PerCpuSnapshot(*dump).size(); }, kIters));
+  std::cout << std::format(
+      "features:   {:9.0f} ns/cpu\n",
+      ns_per_call([&] { sink = FeatureSet(all[0]).count(); }, kIters));
+  std::cout << std::format(
+      "caches:     {:9.0f} ns/cpu\n",
+      ns_per_call([&] { sink = decode_caches(all[0]).lineSize(); }, kIters));
+  std::cout << std::format(
+      "topology:   {:9.0f} ns/dump\n",
+      ns_per_call([&] { sink = Topology(all).size(); }, kIters));
+  std::cout << std::format(
+      "core types: {:9.0f} ns/dump\n",
+      ns_per_call([&] { sink = CoreTypeMap(all).isHybrid(); }, kIters));
+  return 0;
+}
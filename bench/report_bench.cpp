@@ -0,0 +1,57 @@
+// Cost of building and emitting the standard report in each format, and
+// the number of heap allocations per report (expected: zero). Reports go
+// to /dev/null so only formatting and the write(2) are measured.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "report.hpp"
+
+static std::atomic<size_t> gAllocations{0};
+
+void *operator new(size_t n) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+int main() {
+  constexpr int kIters = 20'000;
+  static constexpr const char *kNames[] = {"human", "json", "csv", "binary"};
+  const CpuidSnapshot snap;
+  static ReportBuffer buffer;
+  int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  int status = 0;
+
+  // printf rather than std::format so the bench itself does not allocate
+  for (ReportFormat format : {ReportFormat::Human, ReportFormat::Json,
+                              ReportFormat::Csv, ReportFormat::Binary}) {
+    ReportWriter writer(buffer, format);
+    write_report(writer, snap);  // warm-up: first-use statics
+    size_t bytes = buffer.size();
+    buffer.flush(devnull);
+
+    size_t before = gAllocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIters; ++i) {
+      write_report(writer, snap);
+      buffer.flush(devnull);
+    }
+    std::chrono::duration<double, std::nano> d =
+        std::chrono::steady_clock::now() - start;
+    size_t allocs = gAllocations.load() - before;
+
+    printf("%-6s %6zu bytes  %8.0f ns/report  %zu allocations\n",
+           kNames[size_t(format)], bytes, d.count() / kIters, allocs);
+    if (allocs != 0) status = 1;
+  }
+  close(devnull);
+  return status;
+}
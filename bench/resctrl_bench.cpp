@@ -0,0 +1,126 @@
+// Reserving L3 ways for a group through resctrl and reading its
+// monitoring counters back, against a stand-in tree shaped like a
+// two-socket machine (so it runs anywhere, without root):
+//   resctrl_bench            stand-in tree in a temporary directory
+//   resctrl_bench ROOT       an existing tree; a real mount needs root. The
+//                            group "resctrl_bench" is removed again only
+//                            where rmdir can do it, i.e. on a real mount
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "cache.hpp"
+#include "rdt.hpp"
+#include "resctrl.hpp"
+#include "snapshot.hpp"
+
+static void write(const std::filesystem::path &path,
+                  const std::string &text) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << text;
+}
+
+// 11-way L3 per socket with the top two ways shared with I/O, as on
+// Skylake-SP
+static std::string make_stand_in() {
+  std::filesystem::path root = std::filesystem::temp_directory_path() /
+                               std::format("resctrl_bench.{}", getpid());
+  write(root / "schemata", "    L3:0=7ff;1=7ff\n    MB:0=100;1=100\n");
+  write(root / "tasks", "");
+  write(root / "info/L3/cbm_mask", "7ff\n");
+  write(root / "info/L3/min_cbm_bits", "1\n");
+  write(root / "info/L3/shareable_bits", "600\n");
+  write(root / "info/L3/num_closids", "16\n");
+  return root.string();
+}
+
+// What the kernel would expose once the group has run for a while
+static void fake_counters(const std::string &group) {
+  for (int domain = 0; domain < 2; ++domain) {
+    std::filesystem::path dir = std::filesystem::path(group) /
+                                std::format("mon_data/mon_L3_{:02}", domain);
+    write(dir / "llc_occupancy", std::format("{}\n", (domain + 1) << 22));
+    write(dir / "mbm_total_bytes",
+          std::format("{}\n", uint64_t(domain + 1) << 30));
+    write(dir / "mbm_local_bytes", "Unavailable\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  const bool standIn = argc < 2;
+  const std::string root = standIn ? make_stand_in() : argv[1];
+
+  const CpuidSnapshot &snap = CpuidSnapshot::host();
+  const RdtInfo rdt = decode_rdt(snap);
+  std::cout << std::format(
+      "CPUID: monitoring {}, L3 CAT {} bits x {} CLOS, MBA max {}\n",
+      rdt.monitoring.present(), rdt.l3.cbmLength, rdt.l3.closCount,
+      rdt.bandwidth.maxThrottle);
+
+  std::optional<Resctrl> resctrl = Resctrl::open(root);
+  if (!resctrl) {
+    std::cerr << std::format("{}: not a resctrl tree\n", root);
+    return 1;
+  }
+  // The stand-in's geometry is fixed; a real mount follows this CPU
+  CacheHierarchy caches = decode_caches(snap);
+  if (standIn) {
+    CacheLevel &l3 = caches.caches[0];
+    l3 = CacheLevel{};
+    l3.level = 3;
+    l3.type = CacheType::Unified;
+    l3.ways = 11;
+    l3.lineSize = 64;
+    l3.sets = 45056;
+    l3.sizeBytes = 11 * 64 * 45056;  // 30.25 MiB
+    caches.count = 1;
+  }
+  std::cout << std::format("{}: cbm_mask {:#x}, {} domains, {} CLOSIDs\n",
+                           root, resctrl->l3().cbmMask,
+                           resctrl->domains().size(),
+                           resctrl->l3().numClosids);
+
+  const std::string group = "resctrl_bench";
+  for (size_t mib : {1, 4, 8, 16}) {
+    std::optional<uint32_t> mask =
+        resctrl->reserve(group, mib << 20, caches);
+    std::cout << std::format(
+        "reserve {:2} MiB: {} ways, mask {:#x}, default now {:#x}\n", mib,
+        resctrl->waysFor(mib << 20, caches), mask.value_or(0),
+        resctrl->mask("").value_or(0));
+  }
+  if (!resctrl->assignTask(group)) {
+    std::cerr << "cannot assign this thread\n";
+    return 1;
+  }
+  if (standIn) fake_counters(root + "/" + group);
+  for (const ResctrlUsage &u : resctrl->usage(group)) {
+    std::cout << std::format(
+        "  L3 domain {}: occupancy {} KiB, total {} MiB, local {} MiB\n",
+        u.domain, u.llcOccupancyBytes >> 10, u.mbmTotalBytes >> 20,
+        u.mbmLocalBytes >> 20);
+  }
+
+  constexpr int kIters = 2000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIters; ++i) (void)resctrl->usage(group);
+  std::chrono::duration<double, std::micro> d =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::format("usage(): {:.1f} us\n", d.count() / kIters);
+
+  // Give the ways back before removing the group
+  resctrl->createGroup("", resctrl->l3().cbmMask);
+  // removeGroup() only rmdirs, so the stand-in tree is removed here
+  if (standIn) {
+    std::filesystem::remove_all(root);
+  } else if (!resctrl->removeGroup(group)) {
+    std::cerr << std::format("cannot remove {}/{}\n", root, group);
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Shared-memory snapshot against per-process decoding. Reports what each
+// process pays to build CPUInfo itself versus attaching to a published
+// segment, then the cost of a query with 1..N reader threads (each with
+// its own mapping, as separate processes would have) while a publisher
+// rewrites the segment every PERIOD microseconds.
+//   shm_bench [PERIOD]   (default 100; 0 publishes once)
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpuinfo.hpp"
+#include "shared_snapshot.hpp"
+#include "tsc.hpp"
+
+template <typename F>
+static double us_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  std::chrono::duration<double, std::micro> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main(int argc, char **argv) {
+  constexpr auto kWindow = std::chrono::milliseconds(200);
+  const unsigned period = argc > 1 ? unsigned(std::atoi(argv[1])) : 100;
+  const std::string name = std::format("/cpuid-bench-{}", getpid());
+
+  const CpuidSnapshot snap;
+  const XsaveInfo xsave = host_xsave(snap);
+  std::optional<SnapshotPublisher> publisher = SnapshotPublisher::create(name);
+  if (!publisher || !publisher->publish(snap, xsave, 0)) {
+    std::cerr << std::format("{}: cannot publish\n", name);
+    return 1;
+  }
+
+  volatile size_t sink = 0;
+  std::cout << std::format(
+      "per process: CPUInfo from cpuid {:8.1f} us, attach + copy {:8.1f} us\n",
+      us_per_call(
+          [&] {
+            CpuidSnapshot s;
+            sink = CPUInfo(s, host_xsave(s)).cores();
+          },
+          200),
+      us_per_call([&] { sink = SnapshotReader::open(name)->snapshot()->size(); },
+                  200));
+
+  unsigned n = std::max(1U, std::thread::hardware_concurrency());
+  for (unsigned threads = 1;; threads = std::min(threads * 2, n)) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    uint64_t publishes = 0;
+
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < threads; ++t) {
+      readers.emplace_back([&] {
+        SnapshotReader reader = std::move(*SnapshotReader::open(name));
+        uint64_t local = 0;
+        size_t acc = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          acc += reader.usable(Feature::AVX2).value_or(false);
+          acc += reader.get(0x7).value_or(CpuidLeaf{}).EBX();
+          local += 2;
+        }
+        sink = acc;
+        reads.fetch_add(local, std::memory_order_relaxed);
+      });
+    }
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < kWindow) {
+      if (period) {
+        publisher->publish(snap, xsave, 0);
+        ++publishes;
+        std::this_thread::sleep_for(std::chrono::microseconds(period));
+      } else {
+        std::this_thread::sleep_for(kWindow);
+      }
+    }
+    stop = true;
+    for (std::thread &t : readers) t.join();
+
+    std::chrono::duration<double, std::nano> d =
+        std::chrono::steady_clock::now() - start;
+    std::cout << std::format(
+        "{:3} readers: {:7.1f} ns/query per thread, {:6.1f} M queries/s, "
+        "{} publishes\n",
+        threads, d.count() * threads / double(reads), reads / d.count() * 1e3,
+        publishes);
+    if (threads == n) break;
+  }
+
+  SnapshotPublisher::unlink(name);
+  return 0;
+}
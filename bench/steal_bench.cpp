@@ -0,0 +1,107 @@
+// Fork/join on ThreadPool with locality-ordered stealing against the same
+// pool picking victims uniformly at random: recursive fib (scheduling
+// overhead) and a recursive blocked sum over an array too large for one
+// cache (where a task runs matters). Prints where the steals came from.
+//   steal_bench [WORKERS [FIB_N]]   WORKERS 0: one per core (default)
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+static constexpr std::string_view kLevelNames[kStealLevels] = {
+    "smt", "l2", "l3", "die", "package", "remote"};
+
+static uint64_t fib(ThreadPool &pool, unsigned n) {
+  if (n < 2) return n;
+  // Below the cutoff a task is cheaper to run than to fork
+  if (n < 18) return fib(pool, n - 1) + fib(pool, n - 2);
+  uint64_t a = 0;
+  TaskGroup group(pool);
+  group.run([&] { a = fib(pool, n - 1); });
+  uint64_t b = fib(pool, n - 2);
+  group.wait();
+  return a + b;
+}
+
+static uint64_t sum(ThreadPool &pool, const uint64_t *data, size_t n) {
+  if (n <= 16384) return std::accumulate(data, data + n, uint64_t(0));
+  uint64_t left = 0;
+  TaskGroup group(pool);
+  group.run([&] { left = sum(pool, data, n / 2); });
+  uint64_t right = sum(pool, data + n / 2, n - n / 2);
+  group.wait();
+  return left + right;
+}
+
+// Runs `body` on a worker and waits for it
+template <typename F>
+static double run_ms(ThreadPool &pool, F &&body) {
+  auto start = std::chrono::steady_clock::now();
+  TaskGroup group(pool);
+  group.run(std::forward<F>(body));
+  group.wait();
+  std::chrono::duration<double, std::milli> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+static void print_stats(const ThreadPool &pool) {
+  WorkerStats t = pool.totalStats();
+  std::string levels;
+  for (size_t l = 0; l < kStealLevels; ++l) {
+    if (!t.steals[l]) continue;
+    levels += std::format("{}{}={}", levels.empty() ? " (" : " ",
+                          kLevelNames[l], t.steals[l]);
+  }
+  if (!levels.empty()) levels += ")";
+  std::cout << std::format("    tasks {} local {} steals {}{} failed {}\n",
+                           t.executed, t.local, t.totalSteals(), levels,
+                           t.failedSteals);
+}
+
+int main(int argc, char **argv) {
+  unsigned workers = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 0)) : 0;
+  unsigned fibN = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 0)) : 32;
+
+  const Topology &topo = Topology::host();
+  std::cout << std::format("{} CPUs, {} cores, {} packages\n", topo.size(),
+                           topo.count(TopoLevel::Core),
+                           topo.count(TopoLevel::Package));
+
+  std::vector<uint64_t> data(uint64_t(1) << 25);  // 256 MiB
+  std::iota(data.begin(), data.end(), uint64_t(0));
+  const uint64_t expected = data.size() * (data.size() - 1) / 2;
+
+  for (StealOrder order : {StealOrder::Locality, StealOrder::Random}) {
+    ThreadPool pool(topo, {.workers = workers, .order = order});
+    std::cout << std::format(
+        "{} stealing, {} workers\n",
+        order == StealOrder::Locality ? "locality" : "random", pool.size());
+
+    uint64_t f = 0;
+    double ms = run_ms(pool, [&] { f = fib(pool, fibN); });
+    std::cout << std::format("  fib({}) = {}: {:8.1f} ms\n", fibN, f, ms);
+    print_stats(pool);
+
+    constexpr int kPasses = 5;
+    pool.resetStats();
+    uint64_t s = 0;
+    ms = 0;
+    for (int i = 0; i < kPasses; ++i) {
+      ms += run_ms(pool, [&] { s = sum(pool, data.data(), data.size()); });
+    }
+    std::cout << std::format("  sum {}: {:8.1f} ms/pass, {:5.2f} GB/s\n",
+                             s == expected ? "ok" : "WRONG", ms / kPasses,
+                             double(data.size() * sizeof(uint64_t)) * kPasses /
+                                 (ms * 1e6));
+    print_stats(pool);
+  }
+  return 0;
+}
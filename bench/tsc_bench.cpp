@@ -0,0 +1,67 @@
+// Cost per timestamp of TscClock::now_ns() against std::chrono::steady_clock
+// and clock_gettime(CLOCK_MONOTONIC_RAW), then drift of the TSC clock
+// against steady_clock over a few seconds.
+#include <time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <thread>
+
+#include "tsc.hpp"
+
+template <typename F>
+static double ns_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main() {
+  constexpr int kIters = 10'000'000;
+  const TscClock &clock = TscClock::host();
+  volatile uint64_t sink = 0;
+
+  std::cout << std::format("TSC {} Hz, source {}, invariant {}, RDTSCP {}\n",
+                           clock.tscHz(), int(clock.source()),
+                           clock.invariant(), clock.hasRdtscp());
+  std::cout << std::format(
+      "now_ns():          {:.2f} ns\n",
+      ns_per_call([&] { sink = clock.now_ns(); }, kIters));
+  std::cout << std::format(
+      "now_ns_ordered():  {:.2f} ns\n",
+      ns_per_call([&] { sink = clock.now_ns_ordered(); }, kIters));
+  std::cout << std::format(
+      "steady_clock:      {:.2f} ns\n",
+      ns_per_call(
+          [&] {
+            sink = std::chrono::steady_clock::now().time_since_epoch().count();
+          },
+          kIters));
+  std::cout << std::format("MONOTONIC_RAW:     {:.2f} ns\n",
+                           ns_per_call(
+                               [&] {
+                                 timespec ts;
+                                 clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+                                 sink = ts.tv_nsec;
+                               },
+                               kIters));
+
+  // Drift: both clocks advance over the same interval
+  auto s0 = std::chrono::steady_clock::now();
+  uint64_t t0 = clock.now_ns();
+  for (int second = 1; second <= 3; ++second) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    int64_t steady = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - s0)
+                         .count();
+    int64_t tsc = int64_t(clock.now_ns() - t0);
+    std::cout << std::format("after {} s: drift {} ns ({:.2f} ppm)\n", second,
+                             tsc - steady,
+                             double(tsc - steady) * 1e6 / double(steady));
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Incremental re-enumeration against a full rescan. A fake sysfs tree
+// (online cpulist, cpuN/microcode/version) lists the CPUs this process may
+// run on, which are read by pinned threads as the real watcher does; CPU 0
+// can be given a patched leaf 7 on top. Takes a CPU offline and back, bumps
+// CPU 0's microcode together with a leaf 7 bit, prints each diff, then
+// times a refresh with nothing changed, a one-CPU refresh and a full
+// PerCpuSnapshot + Topology rebuild.
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "backend.hpp"
+#include "watch.hpp"
+
+static void write_file(const std::string &path, const std::string &text) {
+  std::ofstream(path) << text << '\n';
+}
+
+static void write_microcode(const std::string &sys, int cpu, uint32_t rev) {
+  std::string dir = std::format("{}/cpu{}/microcode", sys, cpu);
+  std::filesystem::create_directories(dir);
+  write_file(dir + "/version", std::format("{:#x}", rev));
+}
+
+static std::string online_list(const std::vector<int> &cpus, int skip = -1) {
+  std::string list;
+  for (int cpu : cpus) {
+    if (cpu == skip) continue;
+    list += std::format("{}{}", list.empty() ? "" : ",", cpu);
+  }
+  return list;
+}
+
+template <typename F>
+static double us_per_call(F &&f, int iters) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  std::chrono::duration<double, std::micro> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / iters;
+}
+
+int main() {
+  constexpr int kIters = 50;
+  const std::vector<int> cpus = allowed_cpus();
+  const std::string sys = std::filesystem::temp_directory_path() /
+                          std::format("cpuid-watch-{}", getpid());
+
+  uint32_t rev = 0x100;
+  for (int cpu : cpus) write_microcode(sys, cpu, rev);
+  write_file(sys + "/online", online_list(cpus));
+
+  // What the "new microcode" changes on the first CPU
+  std::atomic<bool> patched{false};
+  auto read = [&](int cpu) -> std::optional<CpuidSnapshot> {
+    std::optional<CpuidSnapshot> snap = PerCpuSnapshot::readPinned(cpu);
+    if (!snap || cpu != cpus.front() || !patched) return snap;
+    std::vector<CpuidLeaf> leaves(snap->leaves().begin(), snap->leaves().end());
+    for (CpuidLeaf &l : leaves) {
+      if (l.leaf == 0x7 && l.subleaf == 0) l.regs[3] ^= 1;  // EDX bit 0
+    }
+    return CpuidSnapshot(ReplayBackend(std::move(leaves)));
+  };
+  CpuWatcher watcher({.sysRoot = sys, .read = read, .netlink = false});
+  std::cout << std::format("{} CPUs, {} enumerated, via {}\n", cpus.size(),
+                           watcher.cpus().size(), watcher.source());
+
+  auto step = [&](const char *what) {
+    auto start = std::chrono::steady_clock::now();
+    bool woke = watcher.wait(std::chrono::milliseconds(100));
+    std::vector<CpuChange> changes = watcher.refresh();
+    std::chrono::duration<double, std::micro> d =
+        std::chrono::steady_clock::now() - start;
+    std::cout << std::format("{} ({}, {:.1f} us):\n{}", what,
+                             woke ? "event" : "timeout", d.count(),
+                             format_changes(changes));
+  };
+
+  write_file(sys + "/online", online_list(cpus, cpus.back()));
+  step("offline");
+  write_file(sys + "/online", online_list(cpus));
+  step("online");
+
+  patched = true;
+  write_microcode(sys, cpus.front(), ++rev);
+  step("microcode + leaf 7");
+
+  volatile size_t sink = 0;
+  std::cout << std::format(
+      "refresh, no change:   {:9.1f} us\n",
+      us_per_call([&] { sink = watcher.refresh().size(); }, kIters));
+  // Only the refresh is timed, not the sysfs write that triggers it
+  std::chrono::duration<double, std::micro> oneCpu{};
+  for (int i = 0; i < kIters; ++i) {
+    write_microcode(sys, cpus.front(), ++rev);
+    auto start = std::chrono::steady_clock::now();
+    sink = watcher.refresh().size();
+    oneCpu += std::chrono::steady_clock::now() - start;
+  }
+  std::cout << std::format("refresh, one CPU:     {:9.1f} us\n",
+                           oneCpu.count() / kIters);
+  std::cout << std::format("full rescan:          {:9.1f} us\n",
+                           us_per_call(
+                               [&] {
+                                 PerCpuSnapshot all(cpus, 0, read);
+                                 sink = Topology(all).size();
+                               },
+                               kIters));
+
+  std::filesystem::remove_all(sys);
+  return 0;
+}
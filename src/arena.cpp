@@ -0,0 +1,153 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+
+#include "utils.hpp"
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+size_t align_up(size_t n, size_t align) {
+  return (n + align - 1) & ~(align - 1);
+}
+
+}  // namespace
+
+LineGeometry decode_line_geometry(const CpuidSnapshot &snap,
+                                  const CacheHierarchy &caches) {
+  LineGeometry geo;
+  unsigned clflush = leaf1::ClflushLineSize::get(snap.get(0x1)) * 8;
+  geo.lineSize = clflush ? clflush : caches.lineSize();
+  // Lines are powers of two everywhere; anything else is a broken
+  // hypervisor and would misalign every slot
+  if (!std::has_single_bit(geo.lineSize)) geo.lineSize = 64;
+  // Intel's L2 spatial prefetcher completes every line to its 128-byte
+  // aligned pair, so writers one line apart still contend
+  geo.padding = snap.vendor() == CpuVendor::Intel ? 2 * geo.lineSize
+                                                  : geo.lineSize;
+  if (size_t l1 = caches.perCpuBytes(1)) geo.l1Bytes = l1;
+  if (size_t l2 = caches.perCpuBytes(2)) geo.l2Bytes = l2;
+  return geo;
+}
+
+const LineGeometry &host_line_geometry() {
+  static const LineGeometry geo = [] {
+    const CpuidSnapshot &snap = CpuidSnapshot::host();
+    return decode_line_geometry(snap, decode_caches(snap));
+  }();
+  return geo;
+}
+
+// Chunks of half the L2 share leave the rest to whatever the memory is for
+Arena::Arena(const LineGeometry &geo)
+    : mGeo(geo),
+      mChunkSize(align_up(std::max<size_t>(geo.l2Bytes / 2, 16 * kPageSize),
+                          kPageSize)) {}
+
+Arena::Arena(Arena &&other) noexcept
+    : mGeo(other.mGeo),
+      mChunkSize(other.mChunkSize),
+      mChunks(std::move(other.mChunks)),
+      mCursor(std::exchange(other.mCursor, nullptr)),
+      mEnd(std::exchange(other.mEnd, nullptr)),
+      mUsed(std::exchange(other.mUsed, 0)) {
+  other.mChunks.clear();
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept {
+  if (this != &other) {
+    release();
+    mGeo = other.mGeo;
+    mChunkSize = other.mChunkSize;
+    mChunks = std::move(other.mChunks);
+    other.mChunks.clear();
+    mCursor = std::exchange(other.mCursor, nullptr);
+    mEnd = std::exchange(other.mEnd, nullptr);
+    mUsed = std::exchange(other.mUsed, 0);
+  }
+  return *this;
+}
+
+Arena::~Arena() { release(); }
+
+void Arena::release() {
+  for (const Chunk &c : mChunks) std::free(c.base);
+  mChunks.clear();
+  mCursor = mEnd = nullptr;
+  mUsed = 0;
+}
+
+std::byte *Arena::newChunk(size_t bytes) {
+  size_t align = std::max<size_t>(kPageSize, mGeo.padding);
+  bytes = align_up(bytes, align);
+  auto *base = static_cast<std::byte *>(std::aligned_alloc(align, bytes));
+  if (base) mChunks.push_back({base, bytes});
+  return base;
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+  if (align == 0) align = mGeo.lineSize;
+  if (!std::has_single_bit(align) || align > kPageSize) return nullptr;
+  bytes = std::max<size_t>(bytes, 1);
+
+  auto cursor = reinterpret_cast<uintptr_t>(mCursor);
+  uintptr_t start = align_up(cursor, align);
+  if (mCursor && start + bytes <= reinterpret_cast<uintptr_t>(mEnd)) {
+    mCursor = reinterpret_cast<std::byte *>(start + bytes);
+    mUsed += bytes;
+    return reinterpret_cast<void *>(start);
+  }
+
+  // Big requests get a chunk of their own and leave the current one open
+  if (bytes > mChunkSize / 2) {
+    std::byte *p = newChunk(bytes);
+    if (p) mUsed += bytes;
+    return p;
+  }
+  std::byte *p = newChunk(mChunkSize);
+  if (!p) return nullptr;
+  mCursor = p + bytes;
+  mEnd = p + mChunkSize;
+  mUsed += bytes;
+  return p;
+}
+
+void *Arena::allocateIsolated(size_t bytes) {
+  return allocate(align_up(std::max<size_t>(bytes, 1), mGeo.padding),
+                  mGeo.padding);
+}
+
+void Arena::reset() {
+  if (mChunks.empty()) return;
+  Chunk first = mChunks.front();
+  for (size_t i = 1; i < mChunks.size(); ++i) std::free(mChunks[i].base);
+  mChunks.assign(1, first);
+  mCursor = first.base;
+  mEnd = first.base + first.size;
+  mUsed = 0;
+}
+
+PaddedCounters::PaddedCounters(size_t slots, const LineGeometry &geo)
+    : mArena(geo),
+      mSlots(slots),
+      mStride(align_up(sizeof(std::atomic<uint64_t>), geo.padding)) {
+  mBase = static_cast<std::byte *>(
+      mArena.allocateIsolated(std::max<size_t>(slots, 1) * mStride));
+  if (!mBase) throw std::bad_alloc();
+  for (size_t i = 0; i < slots; ++i) {
+    new (mBase + i * mStride) std::atomic<uint64_t>(0);
+  }
+}
+
+uint64_t PaddedCounters::total() const {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < mSlots; ++i) sum += get(i);
+  return sum;
+}
+
+void PaddedCounters::reset() {
+  for (size_t i = 0; i < mSlots; ++i) {
+    at(i).store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,197 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "snapshot.hpp"
+
+// Memory layout parameters of this CPU, known only at run time, unlike
+// std::hardware_destructive_interference_size
+struct LineGeometry {
+  unsigned lineSize = 64;  // CLFLUSH line size, else the L1d line size
+  // Distance that keeps two writers from sharing a line: two lines where
+  // the L2 spatial prefetcher fetches lines in 128-byte pairs (Intel)
+  unsigned padding = 64;
+  size_t l1Bytes = 32 * 1024;  // per logical CPU
+  size_t l2Bytes = 256 * 1024;
+};
+
+// Line size from leaf 1 EBX[15:8] (CLFLUSH), cache capacities from
+// `caches`, defaults above for anything not reported
+LineGeometry decode_line_geometry(const CpuidSnapshot &snap,
+                                  const CacheHierarchy &caches);
+// Of CpuidSnapshot::host(), decoded once
+const LineGeometry &host_line_geometry();
+
+// Bump allocator over chunks of this CPU's per-core L2 share, so a thread's
+// arena stays resident in its own caches. Chunks are page-aligned; default
+// allocations are line-aligned, isolated ones own whole padding slots.
+// Memory is released all at once by reset() or the destructor; objects
+// are not destroyed. Not thread-safe: one arena per thread, or set up
+// before sharing.
+class Arena {
+ public:
+  explicit Arena(const LineGeometry &geo = host_line_geometry());
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&other) noexcept;
+  Arena &operator=(Arena &&other) noexcept;
+  ~Arena();
+
+  const LineGeometry &geometry() const { return mGeo; }
+  size_t chunkSize() const { return mChunkSize; }
+  // Bytes handed out since construction or reset()
+  size_t used() const { return mUsed; }
+  size_t chunks() const { return mChunks.size(); }
+
+  // `align` 0 means the line size; a power of two otherwise. nullptr when
+  // the system is out of memory.
+  void *allocate(size_t bytes, size_t align = 0);
+  // Starts on a padding boundary and is rounded up to whole padding slots,
+  // so nothing else allocated here shares (or prefetches with) its lines
+  void *allocateIsolated(size_t bytes);
+
+  template <typename T, typename... Args>
+  T *make(Args &&...args) {
+    void *p = allocate(sizeof(T), std::max<size_t>(alignof(T), mGeo.lineSize));
+    return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+  }
+  template <typename T, typename... Args>
+  T *makeIsolated(Args &&...args) {
+    static_assert(alignof(T) <= 4096);
+    void *p = allocateIsolated(sizeof(T));
+    return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+  }
+
+  // Keeps the first chunk for reuse, frees the rest
+  void reset();
+
+ private:
+  struct Chunk {
+    std::byte *base;
+    size_t size;
+  };
+
+  std::byte *newChunk(size_t bytes);
+  void release();
+
+  LineGeometry mGeo;
+  size_t mChunkSize;
+  std::vector<Chunk> mChunks;
+  std::byte *mCursor = nullptr;
+  std::byte *mEnd = nullptr;
+  size_t mUsed = 0;
+};
+
+// One counter per thread (slot), each alone in a padding-sized slot of an
+// arena, for statistics bumped on hot paths and summed rarely. Each slot
+// must have a single writer; reads from other threads are relaxed.
+class PaddedCounters {
+ public:
+  // Throws std::bad_alloc when the arena cannot hold `slots` counters
+  explicit PaddedCounters(size_t slots,
+                          const LineGeometry &geo = host_line_geometry());
+
+  size_t size() const { return mSlots; }
+  // Bytes between consecutive counters
+  size_t stride() const { return mStride; }
+
+  void add(size_t slot, uint64_t n = 1) {
+    std::atomic<uint64_t> &c = at(slot);
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  uint64_t get(size_t slot) const {
+    return at(slot).load(std::memory_order_relaxed);
+  }
+  uint64_t total() const;
+  void reset();
+
+ private:
+  std::atomic<uint64_t> &at(size_t slot) const {
+    return *reinterpret_cast<std::atomic<uint64_t> *>(mBase + slot * mStride);
+  }
+
+  Arena mArena;
+  size_t mSlots;
+  size_t mStride;
+  std::byte *mBase;
+};
+
+// Bounded single-producer single-consumer queue whose producer and
+// consumer indices live in separate padding slots, each next to a cached
+// copy of the other side's index, so the two threads only exchange lines
+// when the cached copy runs out. The ring itself starts on a slot of its
+// own.
+template <typename T>
+class SpscQueue {
+ public:
+  // Capacity is rounded up to a power of two. Throws std::bad_alloc when
+  // the arena cannot hold it.
+  explicit SpscQueue(size_t capacity,
+                     const LineGeometry &geo = host_line_geometry())
+      : mArena(geo) {
+    mMask = std::bit_ceil(std::max<size_t>(capacity, 2)) - 1;
+    mProducer = mArena.makeIsolated<Side>();
+    mConsumer = mArena.makeIsolated<Side>();
+    mRing = static_cast<T *>(mArena.allocateIsolated((mMask + 1) * sizeof(T)));
+    if (!mProducer || !mConsumer || !mRing) throw std::bad_alloc();
+  }
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+  ~SpscQueue() {
+    while (pop()) {
+    }
+  }
+
+  size_t capacity() const { return mMask + 1; }
+
+  // Producer only; false when full
+  template <typename... Args>
+  bool push(Args &&...args) {
+    size_t tail = mProducer->index.load(std::memory_order_relaxed);
+    if (tail - mProducer->cached > mMask) {
+      mProducer->cached = mConsumer->index.load(std::memory_order_acquire);
+      if (tail - mProducer->cached > mMask) return false;
+    }
+    new (&mRing[tail & mMask]) T(std::forward<Args>(args)...);
+    mProducer->index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only; nullopt when empty
+  std::optional<T> pop() {
+    size_t head = mConsumer->index.load(std::memory_order_relaxed);
+    if (head == mConsumer->cached) {
+      mConsumer->cached = mProducer->index.load(std::memory_order_acquire);
+      if (head == mConsumer->cached) return std::nullopt;
+    }
+    T &slot = mRing[head & mMask];
+    std::optional<T> out(std::move(slot));
+    slot.~T();
+    mConsumer->index.store(head + 1, std::memory_order_release);
+    return out;
+  }
+
+ private:
+  struct Side {
+    std::atomic<size_t> index{0};
+    size_t cached = 0;  // last seen index of the other side
+  };
+
+  Arena mArena;
+  size_t mMask;
+  Side *mProducer;
+  Side *mConsumer;
+  T *mRing;
+};
+
+#endif  // ARENA_HPP
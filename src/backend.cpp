@@ -0,0 +1,202 @@
+#include "backend.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "cpuid.hpp"
+#include "percpu.hpp"
+
+void CpuidBackend::queryBatch(std::span<CpuidLeaf> leaves) const {
+  for (CpuidLeaf &l : leaves) l = query(l.leaf, l.subleaf);
+}
+
+const NativeBackend &NativeBackend::instance() {
+  static const NativeBackend backend;
+  return backend;
+}
+
+CpuidLeaf NativeBackend::query(uint32_t leaf, uint32_t subleaf) const {
+  CPUID2 cpuid(leaf, subleaf);
+  return {leaf, subleaf, {cpuid.EAX(), cpuid.EBX(), cpuid.ECX(), cpuid.EDX()}};
+}
+
+DevCpuBackend::DevCpuBackend(int cpu, const std::string &root)
+    : mFd(open(std::format("{}/{}/cpuid", root, cpu).c_str(),
+               O_RDONLY | O_CLOEXEC)) {
+  struct stat st;
+  mFile = mFd >= 0 && fstat(mFd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+DevCpuBackend::~DevCpuBackend() {
+  if (mFd >= 0) close(mFd);
+}
+
+// The driver takes EAX from the low and ECX from the high half of the file
+// offset, and rejects reads that are not a multiple of 16 bytes
+static bool read_device(int fd, bool file, CpuidLeaf &l) {
+  uint64_t offset = file ? DevCpuBackend::fileOffset(l.leaf, l.subleaf)
+                         : (uint64_t(l.subleaf) << 32) | l.leaf;
+  return pread(fd, l.regs, sizeof(l.regs), off_t(offset)) == sizeof(l.regs);
+}
+
+CpuidLeaf DevCpuBackend::query(uint32_t leaf, uint32_t subleaf) const {
+  CpuidLeaf l{leaf, subleaf, {0, 0, 0, 0}};
+  if (!read_device(mFd, mFile, l)) l = {leaf, subleaf, {0, 0, 0, 0}};
+  return l;
+}
+
+void DevCpuBackend::queryBatch(std::span<CpuidLeaf> leaves) const {
+  for (CpuidLeaf &l : leaves) {
+    if (!read_device(mFd, mFile, l)) l = {l.leaf, l.subleaf, {0, 0, 0, 0}};
+  }
+}
+
+std::vector<int> device_cpus(const std::string &root) {
+  std::vector<int> cpus;
+  DIR *dir = opendir(root.c_str());
+  if (!dir) return cpus;
+  while (dirent *e = readdir(dir)) {
+    char *end;
+    long cpu = strtol(e->d_name, &end, 10);
+    if (end == e->d_name || *end != '\0') continue;
+    if (access(std::format("{}/{}/cpuid", root, cpu).c_str(), F_OK) == 0) {
+      cpus.push_back(int(cpu));
+    }
+  }
+  closedir(dir);
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+ReplayBackend::ReplayBackend(std::vector<CpuidLeaf> leaves)
+    : mLeaves(std::move(leaves)) {
+  auto byKey = [](const CpuidLeaf &a, const CpuidLeaf &b) {
+    return a.key() < b.key();
+  };
+  std::stable_sort(mLeaves.begin(), mLeaves.end(), byKey);
+  auto dup = std::unique(mLeaves.begin(), mLeaves.end(),
+                         [](const CpuidLeaf &a, const CpuidLeaf &b) {
+                           return a.key() == b.key();
+                         });
+  mLeaves.erase(dup, mLeaves.end());
+}
+
+CpuidLeaf ReplayBackend::query(uint32_t leaf, uint32_t subleaf) const {
+  uint64_t key = (uint64_t(leaf) << 32) | subleaf;
+  auto it = std::lower_bound(
+      mLeaves.begin(), mLeaves.end(), key,
+      [](const CpuidLeaf &l, uint64_t k) { return l.key() < k; });
+  if (it == mLeaves.end() || it->key() != key) {
+    return {leaf, subleaf, {0, 0, 0, 0}};
+  }
+  return *it;
+}
+
+// Parses one record line in any of the supported layouts. `prev` is the
+// previous record of the same CPU, for dumps that list subleaves as
+// repeated leaf lines without a subleaf column.
+static bool parse_record(const char *line, const CpuidLeaf *prev,
+                         CpuidLeaf &out) {
+  unsigned leaf, sub, a, b, c, d;
+  int end = 0;
+
+  // cpuid -r
+  if (sscanf(line, " 0x%x 0x%x: eax=0x%x ebx=0x%x ecx=0x%x edx=0x%x", &leaf,
+             &sub, &a, &b, &c, &d) == 6) {
+    out = {leaf, sub, {a, b, c, d}};
+    return true;
+  }
+
+  // InstLatX64 / AIDA64
+  if (sscanf(line, " CPUID %x: %x-%x-%x-%x", &leaf, &a, &b, &c, &d) == 5) {
+    if (const char *sl = strstr(line, "[SL ")) {
+      if (sscanf(sl, "[SL %x]", &sub) != 1) return false;
+    } else {
+      sub = prev && prev->leaf == leaf ? prev->subleaf + 1 : 0;
+    }
+    out = {leaf, sub, {a, b, c, d}};
+    return true;
+  }
+
+  // leaf subleaf eax ebx ecx edx, nothing else on the line
+  if (sscanf(line, " %x %x %x %x %x %x %n", &leaf, &sub, &a, &b, &c, &d,
+             &end) == 6 &&
+      line[end] == '\0') {
+    out = {leaf, sub, {a, b, c, d}};
+    return true;
+  }
+  return false;
+}
+
+std::optional<CpuidDump> parse_cpuid_dump(std::string_view text) {
+  std::vector<int> cpus;
+  std::vector<std::vector<CpuidLeaf>> records;
+  std::string line;
+
+  while (!text.empty()) {
+    size_t eol = text.find('\n');
+    line.assign(text.substr(0, eol));
+    text.remove_prefix(eol == text.npos ? text.size() : eol + 1);
+
+    int cpu;
+    if (sscanf(line.c_str(), " CPU %d:", &cpu) == 1 ||
+        sscanf(line.c_str(), " CPU#%d", &cpu) == 1) {
+      cpus.push_back(cpu);
+      records.emplace_back();
+      continue;
+    }
+
+    CpuidLeaf leaf;
+    const CpuidLeaf *prev =
+        records.empty() || records.back().empty() ? nullptr
+                                                  : &records.back().back();
+    if (!parse_record(line.c_str(), prev, leaf)) continue;
+    // Records before any CPU header belong to CPU 0
+    if (records.empty()) {
+      cpus.push_back(0);
+      records.emplace_back();
+    }
+    records.back().push_back(leaf);
+  }
+
+  CpuidDump dump;
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (records[i].empty()) continue;
+    dump.cpus.push_back(cpus[i]);
+    dump.backends.emplace_back(std::move(records[i]));
+  }
+  if (dump.backends.empty()) return std::nullopt;
+  return dump;
+}
+
+std::optional<CpuidDump> load_cpuid_dump(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) return std::nullopt;
+  std::ostringstream text;
+  text << in.rdbuf();
+  return parse_cpuid_dump(text.str());
+}
+
+std::string format_cpuid_dump(const PerCpuSnapshot &all) {
+  std::string out;
+  for (size_t i = 0; i < all.size(); ++i) {
+    std::format_to(std::back_inserter(out), "CPU {}:\n", all.cpu(i));
+    for (const CpuidLeaf &l : all[i].leaves()) {
+      std::format_to(std::back_inserter(out),
+                     "   {:#010x} {:#04x}: eax={:#010x} ebx={:#010x} "
+                     "ecx={:#010x} edx={:#010x}\n",
+                     l.leaf, l.subleaf, l.EAX(), l.EBX(), l.ECX(), l.EDX());
+    }
+  }
+  return out;
+}
@@ -0,0 +1,115 @@
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "snapshot.hpp"
+
+class PerCpuSnapshot;
+
+// Source of raw CPUID results. CpuidSnapshot enumerates leaves through one
+// of these, so every decoder built on a snapshot (features, caches,
+// topology, core types) runs unchanged against the live CPU or a recording.
+class CpuidBackend {
+ public:
+  virtual ~CpuidBackend() = default;
+
+  // Registers for (leaf, subleaf). Unknown leaves return all zeros, the
+  // answer hardware gives for an unsupported leaf.
+  virtual CpuidLeaf query(uint32_t leaf, uint32_t subleaf) const = 0;
+  // Fills the registers of every record from its (leaf, subleaf); backends
+  // with a per-call cost override this to amortise it
+  virtual void queryBatch(std::span<CpuidLeaf> leaves) const;
+  virtual const char *name() const = 0;
+};
+
+// Executes `cpuid` on whichever CPU the calling thread runs on. Stateless,
+// so one instance is shared by every thread.
+class NativeBackend final : public CpuidBackend {
+ public:
+  static const NativeBackend &instance();
+
+  CpuidLeaf query(uint32_t leaf, uint32_t subleaf) const override;
+  const char *name() const override { return "native"; }
+};
+
+// Reads one CPU through the Linux cpuid driver: a 16-byte pread of
+// /dev/cpu/N/cpuid at offset (subleaf << 32) | leaf runs `cpuid` on CPU N
+// and returns EAX..EDX, so no thread is migrated. Needs the cpuid module
+// and read access to the device (root by default).
+class DevCpuBackend final : public CpuidBackend {
+ public:
+  // Opens `root`/`cpu`/cpuid once. Any other directory with the same
+  // layout works as `root`, e.g. one of regular files written by a test,
+  // which hold each record at fileOffset()
+  explicit DevCpuBackend(int cpu, const std::string &root = "/dev/cpu");
+  ~DevCpuBackend() override;
+  DevCpuBackend(const DevCpuBackend &) = delete;
+  DevCpuBackend &operator=(const DevCpuBackend &) = delete;
+
+  // False when the device could not be opened
+  bool ok() const { return mFd >= 0; }
+
+  // A failed read (offline CPU, short file) yields an all-zero record
+  CpuidLeaf query(uint32_t leaf, uint32_t subleaf) const override;
+  // One pread per record on the already open descriptor; the driver has
+  // no vectored interface
+  void queryBatch(std::span<CpuidLeaf> leaves) const override;
+  const char *name() const override { return "devcpu"; }
+
+  // Where a regular file standing in for the device keeps a record: the
+  // driver's offset times 16, since records one byte apart would overlap
+  static uint64_t fileOffset(uint32_t leaf, uint32_t subleaf) {
+    return ((uint64_t(subleaf) << 32) | leaf) << 4;
+  }
+
+ private:
+  int mFd = -1;
+  bool mFile = false;  // a regular file rather than the driver
+};
+
+// Logical CPUs that have a `root`/N/cpuid entry, ascending
+std::vector<int> device_cpus(const std::string &root = "/dev/cpu");
+
+// Answers from the recorded leaves of one CPU
+class ReplayBackend final : public CpuidBackend {
+ public:
+  // Sorts `leaves` by key(); on duplicates the first record wins
+  explicit ReplayBackend(std::vector<CpuidLeaf> leaves);
+
+  CpuidLeaf query(uint32_t leaf, uint32_t subleaf) const override;
+  const char *name() const override { return "replay"; }
+
+  std::span<const CpuidLeaf> leaves() const { return mLeaves; }
+
+ private:
+  std::vector<CpuidLeaf> mLeaves;
+};
+
+// A recorded machine: one ReplayBackend per logical CPU, in dump order
+struct CpuidDump {
+  std::vector<int> cpus;
+  std::vector<ReplayBackend> backends;
+};
+
+// Parses a raw dump. Accepted line formats, mixed freely:
+//   `cpuid -r`:  "   0x00000004 0x01: eax=0x1c004122 ebx=... ecx=... edx=..."
+//   InstLatX64:  "CPUID 00000004: 1C004122-01C0003F-0000003F-00000000 [SL 01]"
+//   plain hex:   "4 1 1c004122 01c0003f 0000003f 00000000"
+//                (leaf subleaf eax ebx ecx edx, as read from
+//                /dev/cpu/N/cpuid)
+// "CPU N:" and "CPU#N" lines start the records of logical CPU N; a dump
+// without them is CPU 0. Other lines are ignored. Returns nullopt when no
+// record was found.
+std::optional<CpuidDump> parse_cpuid_dump(std::string_view text);
+std::optional<CpuidDump> load_cpuid_dump(const std::string &path);
+
+// Formats `all` in the `cpuid -r` layout, readable by parse_cpuid_dump()
+std::string format_cpuid_dump(const PerCpuSnapshot &all);
+
+#endif  // BACKEND_HPP
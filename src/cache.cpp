@@ -0,0 +1,287 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "features.hpp"
+
+namespace {
+
+struct Leaf2Descriptor {
+  uint8_t code;
+  uint8_t level;
+  CacheType type;
+  uint16_t sizeKB;
+  uint8_t ways;
+  uint8_t lineSize;
+};
+
+// Cache entries of Intel SDM Vol. 2A, Table 3-12; TLB and prefetch
+// descriptors are not listed.
+constexpr Leaf2Descriptor kLeaf2Caches[] = {
+    {0x06, 1, CacheType::Instruction, 8, 4, 32},
+    {0x08, 1, CacheType::Instruction, 16, 4, 32},
+    {0x09, 1, CacheType::Instruction, 32, 4, 64},
+    {0x0A, 1, CacheType::Data, 8, 2, 32},
+    {0x0C, 1, CacheType::Data, 16, 4, 32},
+    {0x0D, 1, CacheType::Data, 16, 4, 64},
+    {0x0E, 1, CacheType::Data, 24, 6, 64},
+    {0x1D, 2, CacheType::Unified, 128, 2, 64},
+    {0x21, 2, CacheType::Unified, 256, 8, 64},
+    {0x22, 3, CacheType::Unified, 512, 4, 64},
+    {0x23, 3, CacheType::Unified, 1024, 8, 64},
+    {0x24, 2, CacheType::Unified, 1024, 16, 64},
+    {0x25, 3, CacheType::Unified, 2048, 8, 64},
+    {0x29, 3, CacheType::Unified, 4096, 8, 64},
+    {0x2C, 1, CacheType::Data, 32, 8, 64},
+    {0x30, 1, CacheType::Instruction, 32, 8, 64},
+    {0x41, 2, CacheType::Unified, 128, 4, 32},
+    {0x42, 2, CacheType::Unified, 256, 4, 32},
+    {0x43, 2, CacheType::Unified, 512, 4, 32},
+    {0x44, 2, CacheType::Unified, 1024, 4, 32},
+    {0x45, 2, CacheType::Unified, 2048, 4, 32},
+    {0x46, 3, CacheType::Unified, 4096, 4, 64},
+    {0x47, 3, CacheType::Unified, 8192, 8, 64},
+    {0x48, 2, CacheType::Unified, 3072, 12, 64},
+    // L3 on family 0FH model 06H Xeon MP, L2 everywhere else
+    {0x49, 2, CacheType::Unified, 4096, 16, 64},
+    {0x4A, 3, CacheType::Unified, 6144, 12, 64},
+    {0x4B, 3, CacheType::Unified, 8192, 16, 64},
+    {0x4C, 3, CacheType::Unified, 12288, 12, 64},
+    {0x4D, 3, CacheType::Unified, 16384, 16, 64},
+    {0x4E, 2, CacheType::Unified, 6144, 24, 64},
+    {0x60, 1, CacheType::Data, 16, 8, 64},
+    {0x66, 1, CacheType::Data, 8, 4, 64},
+    {0x67, 1, CacheType::Data, 16, 4, 64},
+    {0x68, 1, CacheType::Data, 32, 4, 64},
+    {0x78, 2, CacheType::Unified, 1024, 4, 64},
+    {0x79, 2, CacheType::Unified, 128, 8, 64},
+    {0x7A, 2, CacheType::Unified, 256, 8, 64},
+    {0x7B, 2, CacheType::Unified, 512, 8, 64},
+    {0x7C, 2, CacheType::Unified, 1024, 8, 64},
+    {0x7D, 2, CacheType::Unified, 2048, 8, 64},
+    {0x7F, 2, CacheType::Unified, 512, 2, 64},
+    {0x80, 2, CacheType::Unified, 512, 8, 64},
+    {0x82, 2, CacheType::Unified, 256, 8, 32},
+    {0x83, 2, CacheType::Unified, 512, 8, 32},
+    {0x84, 2, CacheType::Unified, 1024, 8, 32},
+    {0x85, 2, CacheType::Unified, 2048, 8, 32},
+    {0x86, 2, CacheType::Unified, 512, 4, 64},
+    {0x87, 2, CacheType::Unified, 1024, 8, 64},
+    {0xD0, 3, CacheType::Unified, 512, 4, 64},
+    {0xD1, 3, CacheType::Unified, 1024, 4, 64},
+    {0xD2, 3, CacheType::Unified, 2048, 4, 64},
+    {0xD6, 3, CacheType::Unified, 1024, 8, 64},
+    {0xD7, 3, CacheType::Unified, 2048, 8, 64},
+    {0xD8, 3, CacheType::Unified, 4096, 8, 64},
+    {0xDC, 3, CacheType::Unified, 1536, 12, 64},
+    {0xDD, 3, CacheType::Unified, 3072, 12, 64},
+    {0xDE, 3, CacheType::Unified, 6144, 12, 64},
+    {0xE2, 3, CacheType::Unified, 2048, 16, 64},
+    {0xE3, 3, CacheType::Unified, 4096, 16, 64},
+    {0xE4, 3, CacheType::Unified, 8192, 16, 64},
+    {0xEA, 3, CacheType::Unified, 12288, 24, 64},
+    {0xEB, 3, CacheType::Unified, 18432, 24, 64},
+    {0xEC, 3, CacheType::Unified, 24576, 24, 64},
+};
+
+void add(CacheHierarchy &h, const CacheLevel &c) {
+  if (h.count < h.caches.size()) h.caches[h.count++] = c;
+}
+
+// Leaf 4 and AMD leaf 0x8000001D share one register layout
+bool decode_deterministic(const CpuidSnapshot &snap, uint32_t leaf,
+                          CacheHierarchy &h) {
+  for (uint32_t sub = 0;; ++sub) {
+    if (!snap.contains(leaf, sub)) break;
+    const CpuidLeaf &r = snap.get(leaf, sub);
+    auto type = CacheType(r.EAX() & 0x1F);
+    if (type == CacheType::Null) break;
+    CacheLevel c{};
+    c.type = type;
+    c.level = (r.EAX() >> 5) & 0x7;
+    c.fullyAssociative = (r.EAX() >> 9) & 1;
+    c.sharedBy = ((r.EAX() >> 14) & 0xFFF) + 1;
+    c.ways = ((r.EBX() >> 22) & 0x3FF) + 1;
+    uint32_t partitions = ((r.EBX() >> 12) & 0x3FF) + 1;
+    c.lineSize = (r.EBX() & 0xFFF) + 1;
+    c.sets = r.ECX() + 1;
+    c.inclusive = (r.EDX() >> 1) & 1;
+    c.sizeBytes = uint32_t(c.ways) * partitions * c.lineSize * c.sets;
+    add(h, c);
+  }
+  return h.count > 0;
+}
+
+// Ways value of the 0x80000005 fields for a fully associative cache
+constexpr uint16_t kAmdFullyAssociative = 0xFF;
+
+// 0x80000006 associativity field encoding (AMD APM Vol. 3, E.4.13). Code
+// 9 defers to Fn8000_001D and the reserved codes say nothing, so those
+// map to 0 (unknown); 0xF is fully associative.
+uint16_t amd_l2_ways(uint32_t code) {
+  static constexpr uint16_t kWays[16] = {
+      0,  1,  2,  3,  4,  6,   8,   0,
+      16, 0,  32, 48, 64, 96, 128, kAmdFullyAssociative};
+  return kWays[code & 0xF];
+}
+
+// A cache whose ways stay 0 has unknown associativity and no set count
+void add_amd_legacy(CacheLevel c, CacheHierarchy &h) {
+  if (c.sizeBytes == 0) return;
+  if (c.ways == kAmdFullyAssociative) {
+    c.fullyAssociative = true;
+    c.ways = c.lineSize ? uint16_t(c.sizeBytes / c.lineSize) : 0;
+  }
+  if (c.ways && c.lineSize) c.sets = c.sizeBytes / (c.ways * c.lineSize);
+  add(h, c);
+}
+
+bool decode_amd_legacy(const CpuidSnapshot &snap, CacheHierarchy &h) {
+  if (snap.maxExtendedLeaf() < 0x80000005) return false;
+  const CpuidLeaf &l1 = snap.get(0x80000005);
+  add_amd_legacy({.level = 1,
+                  .type = CacheType::Data,
+                  .ways = uint16_t((l1.ECX() >> 16) & 0xFF),
+                  .lineSize = uint16_t(l1.ECX() & 0xFF),
+                  .sizeBytes = (l1.ECX() >> 24) * 1024},
+                 h);
+  add_amd_legacy({.level = 1,
+                  .type = CacheType::Instruction,
+                  .ways = uint16_t((l1.EDX() >> 16) & 0xFF),
+                  .lineSize = uint16_t(l1.EDX() & 0xFF),
+                  .sizeBytes = (l1.EDX() >> 24) * 1024},
+                 h);
+  if (snap.maxExtendedLeaf() >= 0x80000006) {
+    const CpuidLeaf &l2 = snap.get(0x80000006);
+    uint32_t l2ways = (l2.ECX() >> 12) & 0xF;
+    uint32_t l3ways = (l2.EDX() >> 12) & 0xF;
+    add_amd_legacy({.level = 2,
+                    .type = CacheType::Unified,
+                    .ways = amd_l2_ways(l2ways),
+                    .lineSize = uint16_t(l2.ECX() & 0xFF),
+                    .sizeBytes = (l2.ECX() >> 16) * 1024},
+                   h);
+    add_amd_legacy({.level = 3,
+                    .type = CacheType::Unified,
+                    .ways = amd_l2_ways(l3ways),
+                    .lineSize = uint16_t(l2.EDX() & 0xFF),
+                    .sizeBytes = (l2.EDX() >> 18) * 512 * 1024},
+                   h);
+  }
+  return h.count > 0;
+}
+
+bool decode_leaf2(const CpuidSnapshot &snap, CacheHierarchy &h) {
+  if (snap.maxBasicLeaf() < 2) return false;
+  const CpuidLeaf &r = snap.get(0x2);
+  for (int reg = 0; reg < 4; ++reg) {
+    // Bit 31 set means the register holds no descriptors
+    if (r.regs[reg] & (1U << 31)) continue;
+    for (int byte = 0; byte < 4; ++byte) {
+      // AL is the iteration count, not a descriptor
+      if (reg == 0 && byte == 0) continue;
+      uint8_t code = (r.regs[reg] >> (8 * byte)) & 0xFF;
+      for (const auto &d : kLeaf2Caches) {
+        if (d.code != code) continue;
+        uint32_t size = uint32_t(d.sizeKB) * 1024;
+        add(h, {.level = d.level,
+                .type = d.type,
+                .ways = d.ways,
+                .lineSize = d.lineSize,
+                .sets = size / (d.ways * d.lineSize),
+                .sizeBytes = size});
+      }
+    }
+  }
+  std::sort(h.caches.begin(), h.caches.begin() + h.count,
+            [](const CacheLevel &a, const CacheLevel &b) {
+              return a.level != b.level ? a.level < b.level : a.type < b.type;
+            });
+  return h.count > 0;
+}
+
+}  // namespace
+
+CacheHierarchy decode_caches(const CpuidSnapshot &snap) {
+  CacheHierarchy h;
+  CpuVendor vendor = snap.vendor();
+  bool amd = vendor == CpuVendor::AMD || vendor == CpuVendor::Hygon;
+
+  if (amd && FeatureSet(snap).has(Feature::TOPOEXT) &&
+      decode_deterministic(snap, 0x8000001D, h)) {
+    h.source = CacheSource::AmdLeaf8000001D;
+  } else if (!amd && snap.maxBasicLeaf() >= 4 &&
+             decode_deterministic(snap, 0x4, h)) {
+    h.source = CacheSource::Leaf4;
+  } else if (amd && decode_amd_legacy(snap, h)) {
+    h.source = CacheSource::AmdLegacy;
+  } else if (decode_leaf2(snap, h)) {
+    h.source = CacheSource::Leaf2;
+  }
+  return h;
+}
+
+const CacheLevel *CacheHierarchy::data(unsigned level) const {
+  for (uint8_t i = 0; i < count; ++i) {
+    const CacheLevel &c = caches[i];
+    if (c.level == level &&
+        (c.type == CacheType::Data || c.type == CacheType::Unified)) {
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+const CacheLevel *CacheHierarchy::instruction(unsigned level) const {
+  for (uint8_t i = 0; i < count; ++i) {
+    const CacheLevel &c = caches[i];
+    if (c.level == level &&
+        (c.type == CacheType::Instruction || c.type == CacheType::Unified)) {
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+unsigned CacheHierarchy::lineSize() const {
+  const CacheLevel *l1 = data(1);
+  return l1 && l1->lineSize ? l1->lineSize : 64;
+}
+
+size_t CacheHierarchy::perCpuBytes(unsigned level) const {
+  const CacheLevel *c = data(level);
+  if (!c) return 0;
+  return c->sizeBytes / std::max<unsigned>(c->sharedBy, 1);
+}
+
+CacheBlocking recommend_blocking(const CacheHierarchy &caches,
+                                 size_t elementSize, unsigned operands) {
+  elementSize = std::max<size_t>(elementSize, 1);
+  operands = std::max(operands, 1U);
+
+  // Conservative defaults when a level is missing
+  size_t l1 = caches.perCpuBytes(1) ? caches.perCpuBytes(1) : 32 * 1024;
+  size_t l2 = caches.perCpuBytes(2) ? caches.perCpuBytes(2) : 256 * 1024;
+  size_t l3 = caches.perCpuBytes(3) ? caches.perCpuBytes(3) : l2;
+
+  // Tiles are rounded down to whole cache lines
+  size_t perLine = std::max<size_t>(caches.lineSize() / elementSize, 1);
+  auto tile = [&](size_t bytes) {
+    auto side = size_t(std::sqrt(double(bytes / 2) / operands / elementSize));
+    return std::max(side / perLine * perLine, perLine);
+  };
+
+  return {.l1Elements = l1 / 2 / elementSize,
+          .l2Elements = l2 / 2 / elementSize,
+          .l3Elements = l3 / 2 / elementSize,
+          .l1Tile = tile(l1),
+          .l2Tile = tile(l2)};
+}
+
+size_t recommend_partitions(const CacheHierarchy &caches, size_t totalBytes) {
+  size_t l2 = caches.perCpuBytes(2) ? caches.perCpuBytes(2) : 256 * 1024;
+  size_t budget = l2 / 2;
+  return std::bit_ceil(std::max<size_t>((totalBytes + budget - 1) / budget, 1));
+}
@@ -0,0 +1,72 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "snapshot.hpp"
+
+enum class CacheType : uint8_t { Null, Data, Instruction, Unified };
+
+struct CacheLevel {
+  uint8_t level = 0;
+  CacheType type = CacheType::Null;
+  bool fullyAssociative = false;
+  bool inclusive = false;
+  uint16_t ways = 0;  // 0 when the source does not say
+  uint16_t lineSize = 0;
+  uint32_t sets = 0;
+  uint32_t sizeBytes = 0;
+  // Logical CPUs sharing this cache; 0 when the source does not say
+  uint16_t sharedBy = 0;
+};
+
+// Where a CacheHierarchy was decoded from
+enum class CacheSource : uint8_t {
+  None,
+  Leaf4,
+  AmdLeaf8000001D,
+  AmdLegacy,
+  Leaf2
+};
+
+struct CacheHierarchy {
+  std::array<CacheLevel, 8> caches{};
+  uint8_t count = 0;
+  CacheSource source = CacheSource::None;
+
+  // Data or unified cache at `level`, or nullptr
+  const CacheLevel *data(unsigned level) const;
+  const CacheLevel *instruction(unsigned level) const;
+  // Line size of the closest data cache, 64 when nothing was reported
+  unsigned lineSize() const;
+  // Bytes of `level` available to one logical CPU. Leaf 4 reports the
+  // maximum number of sharing IDs, so this can err on the small side.
+  size_t perCpuBytes(unsigned level) const;
+};
+
+// Leaf 4 on Intel, 0x8000001D or 0x80000005/6 on AMD, leaf 2 descriptors as
+// the last resort.
+CacheHierarchy decode_caches(const CpuidSnapshot &snap);
+
+// Block sizes for cache-blocked kernels, in elements
+struct CacheBlocking {
+  size_t l1Elements;  // per-thread working set that stays in L1d
+  size_t l2Elements;
+  size_t l3Elements;  // this CPU's share of the last level
+  size_t l1Tile;      // side of a square tile, `operands` of which fit in L1d
+  size_t l2Tile;
+};
+
+// Recommends block sizes for elements of `elementSize` bytes when
+// `operands` blocks must be resident at once (e.g. 3 for C += A * B). Half
+// of each cache is budgeted so streams, stack and prefetch have room.
+CacheBlocking recommend_blocking(const CacheHierarchy &caches,
+                                 size_t elementSize, unsigned operands = 1);
+
+// Radix partitions needed so each partition of `totalBytes` fits in this
+// CPU's share of L2 (hash-join build side); always a power of two.
+size_t recommend_partitions(const CacheHierarchy &caches, size_t totalBytes);
+
+#endif  // CACHE_HPP
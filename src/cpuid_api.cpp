@@ -0,0 +1,183 @@
+#include "cpuid_api.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string_view>
+
+#include "cache.hpp"
+#include "features.hpp"
+#include "shared_snapshot.hpp"
+#include "simd.hpp"
+#include "snapshot.hpp"
+#include "snapshot_file.hpp"
+#include "uarch.hpp"
+#include "xsave.hpp"
+
+// Decoded at creation so every query after it is a lookup
+struct cpuid_snapshot {
+  explicit cpuid_snapshot(CpuidSnapshot s)
+      : snap(std::move(s)),
+        features(snap),
+        usable(usable_features(features, host_xsave(snap))),
+        caches(decode_caches(snap)),
+        vectorBits(decode_simd(snap, usable).maxBits) {}
+
+  CpuidSnapshot snap;
+  FeatureSet features;
+  FeatureSet usable;
+  CacheHierarchy caches;
+  uint16_t vectorBits;
+};
+
+// No C++ exception may cross into a C caller; allocation failure is the
+// only one the library can raise
+template <typename F>
+static cpuid_snapshot *make_snapshot(F &&enumerate) {
+  try {
+    std::optional<CpuidSnapshot> snap = enumerate();
+    return snap ? new cpuid_snapshot(std::move(*snap)) : nullptr;
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+static size_t copy_string(std::string_view s, char *buf, size_t size) {
+  if (buf && size) {
+    size_t n = std::min(s.size(), size - 1);
+    std::memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+  }
+  return s.size();
+}
+
+static bool valid_feature(int feature) {
+  return feature >= 0 && size_t(feature) < kFeatureCount;
+}
+
+extern "C" {
+
+uint32_t cpuid_api_version(void) { return CPUID_API_VERSION; }
+
+const cpuid_snapshot *cpuid_snapshot_host(void) {
+  static const cpuid_snapshot *host = make_snapshot(
+      [] { return std::optional<CpuidSnapshot>(CpuidSnapshot::host()); });
+  return host;
+}
+
+cpuid_snapshot *cpuid_snapshot_create(void) {
+  return make_snapshot(
+      [] { return std::optional<CpuidSnapshot>(std::in_place); });
+}
+
+cpuid_snapshot *cpuid_snapshot_load(const char *path) {
+  if (!path) return nullptr;
+  return make_snapshot(
+      [path] { return map_snapshot_file(path, host_fingerprint()); });
+}
+
+cpuid_snapshot *cpuid_snapshot_attach(const char *name) {
+  return make_snapshot([name]() -> std::optional<CpuidSnapshot> {
+    std::optional<SnapshotReader> reader =
+        SnapshotReader::open(name ? name : kSharedSnapshotName);
+    if (!reader) return std::nullopt;
+    return reader->snapshot();
+  });
+}
+
+void cpuid_snapshot_free(cpuid_snapshot *snap) {
+  if (snap != cpuid_snapshot_host()) delete snap;
+}
+
+int cpuid_snapshot_get(const cpuid_snapshot *snap, uint32_t leaf,
+                       uint32_t subleaf, cpuid_regs *out) {
+  const CpuidLeaf *l = nullptr;
+  if (snap && snap->snap.contains(leaf, subleaf)) {
+    l = &snap->snap.get(leaf, subleaf);
+  }
+  if (out) {
+    *out = l ? cpuid_regs{l->EAX(), l->EBX(), l->ECX(), l->EDX()}
+             : cpuid_regs{0, 0, 0, 0};
+  }
+  return l != nullptr;
+}
+
+size_t cpuid_snapshot_leaf_count(const cpuid_snapshot *snap) {
+  return snap ? snap->snap.size() : 0;
+}
+
+size_t cpuid_vendor(const cpuid_snapshot *snap, char *buf, size_t size) {
+  char vendor[12] = {};
+  if (snap) {
+    const CpuidLeaf &l0 = snap->snap.get(0x0);
+    std::memcpy(vendor, &l0.EBX(), 4);
+    std::memcpy(vendor + 4, &l0.EDX(), 4);
+    std::memcpy(vendor + 8, &l0.ECX(), 4);
+  }
+  std::string_view s(vendor, sizeof(vendor));
+  return copy_string(s.substr(0, s.find('\0')), buf, size);
+}
+
+size_t cpuid_brand(const cpuid_snapshot *snap, char *buf, size_t size) {
+  // 48 characters from 0x80000002..4, NUL-padded, often space-prefixed
+  char brand[48] = {};
+  if (snap) {
+    for (uint32_t i = 0; i < 3; ++i) {
+      std::memcpy(brand + 16 * i, snap->snap.get(0x80000002 + i).regs, 16);
+    }
+  }
+  std::string_view b(brand, sizeof(brand));
+  b = b.substr(0, b.find('\0'));
+  while (!b.empty() && b.front() == ' ') b.remove_prefix(1);
+  while (!b.empty() && b.back() == ' ') b.remove_suffix(1);
+  return copy_string(b, buf, size);
+}
+
+void cpuid_cpu_signature(const cpuid_snapshot *snap, cpuid_signature *out) {
+  if (!out) return;
+  *out = {0, 0, 0};
+  if (!snap) return;
+  CpuSignature sig = cpu_signature(snap->snap.vendor(), snap->snap.get(0x1));
+  *out = {sig.family, sig.model, sig.stepping};
+}
+
+int cpuid_feature_lookup(const char *name) {
+  if (!name) return -1;
+  std::optional<Feature> f = FeatureNames{}[name];
+  return f ? int(*f) : -1;
+}
+
+const char *cpuid_feature_name(int feature) {
+  // The names are string literals, so NUL-terminated
+  return valid_feature(feature) ? kFeatures[feature].name.data() : nullptr;
+}
+
+int cpuid_feature_count(void) { return int(kFeatureCount); }
+
+int cpuid_has_feature(const cpuid_snapshot *snap, int feature) {
+  return snap && valid_feature(feature) &&
+         snap->features.has(Feature(feature));
+}
+
+int cpuid_feature_usable(const cpuid_snapshot *snap, int feature) {
+  return snap && valid_feature(feature) && snap->usable.has(Feature(feature));
+}
+
+uint32_t cpuid_vector_bits(const cpuid_snapshot *snap) {
+  return snap ? snap->vectorBits : 0;
+}
+
+size_t cpuid_cache_info(const cpuid_snapshot *snap, cpuid_cache *out,
+                        size_t max) {
+  if (!snap) return 0;
+  const CacheHierarchy &caches = snap->caches;
+  for (size_t i = 0; out && i < std::min<size_t>(caches.count, max); ++i) {
+    const CacheLevel &c = caches.caches[i];
+    out[i] = {c.level,    uint32_t(c.type), c.sizeBytes, c.lineSize,
+              c.ways,     c.sets,           c.sharedBy,  c.inclusive};
+  }
+  return caches.count;
+}
+
+}  // extern "C"
@@ -0,0 +1,109 @@
+/* C interface of the cpuid library. Only this header and the functions in
+ * it are exported from the shared library; it depends on nothing but the
+ * C standard headers, so any language with a C FFI can link it.
+ *
+ * A snapshot holds every CPUID leaf of one CPU plus what was decoded from
+ * it (features, the XSAVE-backed usable set, caches). After creation every
+ * query is a memory read, and snapshots are safe to share between threads.
+ * Functions taking a snapshot accept NULL and then report nothing. */
+#ifndef CPUID_API_H
+#define CPUID_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPUID_API __attribute__((visibility("default")))
+
+/* Bumped on incompatible changes; structs only grow at the end */
+#define CPUID_API_VERSION 1
+
+typedef struct cpuid_snapshot cpuid_snapshot;
+
+typedef struct cpuid_regs {
+  uint32_t eax;
+  uint32_t ebx;
+  uint32_t ecx;
+  uint32_t edx;
+} cpuid_regs;
+
+typedef struct cpuid_signature {
+  uint32_t family; /* display family, extended family applied */
+  uint32_t model;  /* display model, extended model applied */
+  uint32_t stepping;
+} cpuid_signature;
+
+enum {
+  CPUID_CACHE_DATA = 1,
+  CPUID_CACHE_INSTRUCTION = 2,
+  CPUID_CACHE_UNIFIED = 3,
+};
+
+typedef struct cpuid_cache {
+  uint32_t level; /* 1..4 */
+  uint32_t type;  /* CPUID_CACHE_* */
+  uint32_t size_bytes;
+  uint32_t line_size;
+  uint32_t ways;
+  uint32_t sets;
+  uint32_t shared_by; /* logical CPUs sharing it, 0 when not reported */
+  uint32_t inclusive;
+} cpuid_cache;
+
+/* CPUID_API_VERSION of the loaded library */
+CPUID_API uint32_t cpuid_api_version(void);
+
+/* Snapshot of the first CPU that asks, built once per process. Owned by
+ * the library: never pass it to cpuid_snapshot_free(). */
+CPUID_API const cpuid_snapshot *cpuid_snapshot_host(void);
+/* Enumerates the calling CPU now */
+CPUID_API cpuid_snapshot *cpuid_snapshot_create(void);
+/* Maps a snapshot file written by `cpuid_exe --save`; NULL when it is
+ * missing or was recorded on another CPU model or microcode */
+CPUID_API cpuid_snapshot *cpuid_snapshot_load(const char *path);
+/* Copies the segment published by `cpuid_exe --publish`; NULL for the
+ * default name "/cpuid-snapshot". NULL when nothing is published, or
+ * when a publisher died mid-write and left the segment unreadable. */
+CPUID_API cpuid_snapshot *cpuid_snapshot_attach(const char *name);
+CPUID_API void cpuid_snapshot_free(cpuid_snapshot *snap);
+
+/* Registers of (leaf, subleaf). Returns 1 when the leaf was enumerated,
+ * else 0 with *out zeroed, the answer hardware gives for it. */
+CPUID_API int cpuid_snapshot_get(const cpuid_snapshot *snap, uint32_t leaf,
+                                 uint32_t subleaf, cpuid_regs *out);
+CPUID_API size_t cpuid_snapshot_leaf_count(const cpuid_snapshot *snap);
+
+/* Copy a NUL-terminated string into buf (truncated to size - 1) and return
+ * its full length, as snprintf does */
+CPUID_API size_t cpuid_vendor(const cpuid_snapshot *snap, char *buf,
+                              size_t size);
+CPUID_API size_t cpuid_brand(const cpuid_snapshot *snap, char *buf,
+                             size_t size);
+CPUID_API void cpuid_cpu_signature(const cpuid_snapshot *snap,
+                                   cpuid_signature *out);
+
+/* Features are named as in the report ("AVX2", "AVX512F", ...). Resolve a
+ * name once; the id is valid for the lifetime of the process. */
+CPUID_API int cpuid_feature_lookup(const char *name); /* -1 when unknown */
+CPUID_API const char *cpuid_feature_name(int feature); /* NULL if invalid */
+CPUID_API int cpuid_feature_count(void);
+/* 1 when CPUID reports the feature */
+CPUID_API int cpuid_has_feature(const cpuid_snapshot *snap, int feature);
+/* 1 when it is reported and the OS enabled its register state, i.e. code
+ * using it will run */
+CPUID_API int cpuid_feature_usable(const cpuid_snapshot *snap, int feature);
+/* Widest usable vector register in bits: 0, 128, 256 or 512 */
+CPUID_API uint32_t cpuid_vector_bits(const cpuid_snapshot *snap);
+
+/* Writes up to max caches, innermost first, and returns how many exist */
+CPUID_API size_t cpuid_cache_info(const cpuid_snapshot *snap,
+                                  cpuid_cache *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPUID_API_H */
@@ -0,0 +1,94 @@
+#include "cpuinfo.hpp"
+
+#include <algorithm>
+
+#include "tsc.hpp"
+#include "utils.hpp"
+
+// https://gist.github.com/9prady9/a5e1e8bdbc9dc58b3349
+CPUInfo::CPUInfo(const CpuidSnapshot &snap)
+    : CPUInfo(snap, decode_xsave(snap)) {}
+
+CPUInfo::CPUInfo(const CpuidSnapshot &snap, const XsaveInfo &xsave)
+    : mFeatures(snap),
+      mXsave(xsave),
+      mUsable(usable_features(mFeatures, xsave)),
+      mSimd(decode_simd(snap, mUsable)) {
+  // Get vendor name EAX=0
+  const CpuidLeaf &cpuID0 = snap.get(0x0);
+  uint32_t HFS = cpuID0.EAX();
+  mVendorId = regs_to_chars(cpuID0.EBX(), cpuID0.EDX(), cpuID0.ECX());
+  // Instruction set availability is decoded from kFeatures by mFeatures
+  const CpuidLeaf &cpuID1 = snap.get(0x1);
+
+  std::string upVId = mVendorId;
+  for_each(upVId.begin(), upVId.end(), [](char &in) { in = ::toupper(in); });
+  // Get num of cores
+  if (upVId.find("INTEL") != std::string::npos) {
+    if (HFS >= 11) {
+      // Walk every level the snapshot holds; it stops at level type 0
+      for (uint32_t lvl = 0; snap.contains(0x0B, lvl); ++lvl) {
+        const CpuidLeaf &cpuID4 = snap.get(0x0B, lvl);
+        uint32_t currLevel = (LVL_TYPE & cpuID4.ECX()) >> 8;
+        switch (currLevel) {
+          case 0x01:
+            mNumSMT = LVL_CORES & cpuID4.EBX();
+            break;
+          case 0x02:
+            mNumLogCpus = LVL_CORES & cpuID4.EBX();
+            break;
+          default:
+            break;
+        }
+      }
+      mNumCores = mNumLogCpus / std::max(mNumSMT, 1);
+    } else {
+      if (HFS >= 1) {
+        mNumLogCpus = leaf1::MaxLogicalIds::get(cpuID1);
+        if (HFS >= 4) {
+          mNumCores = 1 + ((snap.get(0x4).EAX() >> 26) & 0x3F);
+        }
+      }
+      if (isHyperThreaded()) {
+        if (!(mNumCores > 1)) {
+          mNumCores = 1;
+          mNumLogCpus = (mNumLogCpus >= 2 ? mNumLogCpus : 2);
+        }
+      } else {
+        mNumCores = mNumLogCpus = 1;
+      }
+    }
+  } else if (upVId.find("AMD") != std::string::npos) {
+    if (HFS >= 1) {
+      mNumLogCpus = leaf1::MaxLogicalIds::get(cpuID1);
+      if (snap.maxExtendedLeaf() >= 0x80000008) {
+        mNumCores = 1 + (snap.get(0x80000008).ECX() & 0xFF);
+      }
+    }
+    if (isHyperThreaded()) {
+      if (!(mNumCores > 1)) {
+        mNumCores = 1;
+        mNumLogCpus = (mNumLogCpus >= 2 ? mNumLogCpus : 2);
+      }
+    } else {
+      mNumCores = mNumLogCpus = 1;
+    }
+  }
+  // Other vendors keep one core and one logical CPU
+  // Base frequency from leaf 0x16, else the TSC rate the leaves report
+  TscInfo tsc = decode_tsc(snap);
+  mCPUMHz = tsc.baseMHz ? float(tsc.baseMHz) : float(tsc.tscHz) / 1e6f;
+  // Get processor brand string
+  // This seems to be working for both Intel & AMD vendors
+  for (uint32_t i = 0x80000002; i < 0x80000005; ++i) {
+    const CpuidLeaf &cpuID = snap.get(i);
+    mModelName +=
+        regs_to_chars(cpuID.EAX(), cpuID.EBX(), cpuID.ECX(), cpuID.EDX());
+  }
+}
+
+const CPUInfo &CPUInfo::host() {
+  static const CPUInfo info(CpuidSnapshot::host(),
+                            host_xsave(CpuidSnapshot::host()));
+  return info;
+}
@@ -0,0 +1,73 @@
+#ifndef CPUINFO_HPP
+#define CPUINFO_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "features.hpp"
+#include "simd.hpp"
+#include "snapshot.hpp"
+#include "xsave.hpp"
+
+class CPUInfo {
+ public:
+  // XSAVE state estimated from the leaves, as for a recorded machine
+  explicit CPUInfo(const CpuidSnapshot &snap);
+  CPUInfo(const CpuidSnapshot &snap, const XsaveInfo &xsave);
+  // Decoded once from CpuidSnapshot::host() and the live XCR0 on first use
+  static const CPUInfo &host();
+  std::string vendor() const { return mVendorId; }
+  std::string model() const { return mModelName; }
+  int cores() const { return mNumCores; }
+  float cpuSpeedInMHz() const { return mCPUMHz; }
+  bool isSSE() const { return has(Feature::SSE); }
+  bool isSSE2() const { return has(Feature::SSE2); }
+  bool isSSE3() const { return has(Feature::SSE3); }
+  bool isSSE41() const { return has(Feature::SSE41); }
+  bool isSSE42() const { return has(Feature::SSE42); }
+  bool isAVX() const { return usable(Feature::AVX); }
+  bool isAVX2() const { return usable(Feature::AVX2); }
+  bool isAVX512F() const { return usable(Feature::AVX512F); }
+  bool isAVX512BW() const { return usable(Feature::AVX512BW); }
+  bool isAVX512VL() const { return usable(Feature::AVX512VL); }
+  bool isAVX512VNNI() const { return usable(Feature::AVX512_VNNI); }
+  bool isAVX512BF16() const { return usable(Feature::AVX512_BF16); }
+  bool isAVX512FP16() const { return usable(Feature::AVX512_FP16); }
+  bool isAVX512VBMI2() const { return usable(Feature::AVX512_VBMI2); }
+  bool isAMX() const { return usable(Feature::AMX_TILE); }
+  // 0 without AVX10
+  int avx10Version() const { return mSimd.avx10.version; }
+  bool isHyperThreaded() const { return has(Feature::HTT); }
+  // Reported by CPUID, whether or not the OS enabled its register state
+  bool has(Feature f) const { return mFeatures.has(f); }
+  const FeatureSet &features() const { return mFeatures; }
+  // Reported by CPUID and backed by state the OS enabled for us; the set to
+  // select kernels from
+  bool usable(Feature f) const { return mUsable.has(f); }
+  const FeatureSet &usableFeatures() const { return mUsable; }
+  const XsaveInfo &xsave() const { return mXsave; }
+  VectorTier widestTier() const { return mSimd.tier; }
+  // Vector lengths, AVX10 and AMX geometry; input to advise()
+  const SimdCaps &simd() const { return mSimd; }
+  int logicalCpus() const { return mNumLogCpus; }
+
+ private:
+  // Bit positions for data extractions
+  static const uint32_t LVL_NUM = 0x000000FF;
+  static const uint32_t LVL_TYPE = 0x0000FF00;
+  static const uint32_t LVL_CORES = 0x0000FFFF;
+
+  // Attributes
+  std::string mVendorId;
+  std::string mModelName;
+  int mNumSMT = 1;
+  int mNumCores = 1;
+  int mNumLogCpus = 1;
+  float mCPUMHz = 0;
+  FeatureSet mFeatures;
+  XsaveInfo mXsave;
+  FeatureSet mUsable;
+  SimdCaps mSimd;
+};
+
+#endif  // CPUINFO_HPP
@@ -0,0 +1,44 @@
+#ifndef CPUSET_HPP
+#define CPUSET_HPP
+
+#include <sched.h>
+
+#include <vector>
+
+// Set of logical CPU numbers in the layout sched_setaffinity expects
+class CpuSet {
+ public:
+  CpuSet() { CPU_ZERO(&mSet); }
+
+  void add(int cpu) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &mSet);
+  }
+  void remove(int cpu) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_CLR(cpu, &mSet);
+  }
+  bool contains(int cpu) const {
+    return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &mSet);
+  }
+  int count() const { return CPU_COUNT(&mSet); }
+  bool empty() const { return count() == 0; }
+
+  std::vector<int> cpus() const {
+    std::vector<int> out;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &mSet)) out.push_back(cpu);
+    }
+    return out;
+  }
+
+  // Restricts the calling thread to this set
+  bool pinCurrentThread() const {
+    return sched_setaffinity(0, sizeof(mSet), &mSet) == 0;
+  }
+
+  const cpu_set_t &native() const { return mSet; }
+
+ private:
+  cpu_set_t mSet;
+};
+
+#endif  // CPUSET_HPP
@@ -0,0 +1,87 @@
+#ifndef DISPATCH_HPP
+#define DISPATCH_HPP
+
+#include <atomic>
+#include <span>
+#include <utility>
+
+#include "features.hpp"
+
+// One implementation of a kernel and the features it needs
+template <typename Fn>
+struct KernelImpl {
+  const char *name;
+  FeatureSet needs;
+  Fn *fn;
+};
+
+// Runtime-dispatched kernel. Implementations are listed best first and the
+// last one must require nothing. The chosen function pointer is published
+// once through an atomic, so a call is a load, a predictable null test and
+// an indirect call, with no per-call feature test.
+//
+// Nothing is detected at load time: the first call (or selected()) asks
+// `detect` for the features and resolves, so loading a library that holds
+// a Dispatcher costs no CPUID enumeration. That lazy choice is only
+// installed over a null pointer (compare-exchange), so an explicit
+// resolve() always wins, even against a first call racing it; concurrent
+// first calls pick the same implementation anyway.
+template <typename Fn>
+class Dispatcher {
+ public:
+  using Detect = FeatureSet (*)();
+
+  constexpr Dispatcher(std::span<const KernelImpl<Fn>> impls, Detect detect)
+      : mImpls(impls), mDetect(detect) {}
+
+  // Selects the first implementation whose requirements are met
+  const KernelImpl<Fn> &resolve(const FeatureSet &features) const {
+    const KernelImpl<Fn> &impl = best(features);
+    mFn.store(impl.fn, std::memory_order_release);
+    return impl;
+  }
+
+  template <typename... Args>
+  decltype(auto) operator()(Args &&...args) const {
+    return get()(std::forward<Args>(args)...);
+  }
+
+  Fn *get() const {
+    Fn *fn = mFn.load(std::memory_order_acquire);
+    if (fn == nullptr) [[unlikely]] {
+      // On failure `fn` holds whatever resolve() or another first call
+      // installed meanwhile
+      Fn *mine = best(mDetect()).fn;
+      if (mFn.compare_exchange_strong(fn, mine, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+        fn = mine;
+      }
+    }
+    return fn;
+  }
+  // The entry whose function is installed; found from the pointer itself,
+  // so it cannot disagree with what calls run
+  const KernelImpl<Fn> &selected() const {
+    Fn *fn = get();
+    for (const auto &impl : mImpls) {
+      if (impl.fn == fn) return impl;
+    }
+    return mImpls.back();
+  }
+  std::span<const KernelImpl<Fn>> impls() const { return mImpls; }
+
+ private:
+  const KernelImpl<Fn> &best(const FeatureSet &features) const {
+    for (const auto &impl : mImpls) {
+      if (features.hasAll(impl.needs)) return impl;
+    }
+    return mImpls.back();
+  }
+
+  std::span<const KernelImpl<Fn>> mImpls;
+  Detect mDetect;
+  // Null until the first resolve() or call
+  mutable std::atomic<Fn *> mFn{nullptr};
+};
+
+#endif  // DISPATCH_HPP
@@ -0,0 +1,21 @@
+#include "features.hpp"
+
+#include <bit>
+
+static_assert(FeatureNames{}[Feature::AVX512F] == "AVX512F");
+static_assert(FeatureNames{}["SSE4.2"] == Feature::SSE42);
+static_assert(!FeatureNames{}["not-a-feature"]);
+static_assert(FeatureSet{Feature::AVX2}.has(Feature::AVX2));
+
+FeatureSet::FeatureSet(const CpuidSnapshot &snap) {
+  for (const auto &desc : kFeatures) {
+    const CpuidLeaf &leaf = snap.get(desc.leaf, desc.subleaf);
+    set(desc.id, (leaf.regs[size_t(desc.reg)] >> desc.bit) & 1);
+  }
+}
+
+size_t FeatureSet::count() const {
+  size_t n = 0;
+  for (uint64_t w : mWords) n += std::popcount(w);
+  return n;
+}
@@ -0,0 +1,361 @@
+#ifndef FEATURES_HPP
+#define FEATURES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+
+#include "snapshot.hpp"
+
+// Every documented single-bit feature flag, as
+//   X(enumerator, name, leaf, subleaf, register, bit)
+// Sources: Intel SDM Vol. 2A (CPUID), Intel ISE reference, AMD APM Vol. 3.
+// Append-only within a leaf group so Feature values stay stable.
+#define CPUID_FEATURES(X)                                       \
+  /* CPUID.01H:ECX */                                           \
+  X(SSE3, "SSE3", 0x1, 0, ECX, 0)                               \
+  X(PCLMULQDQ, "PCLMULQDQ", 0x1, 0, ECX, 1)                     \
+  X(DTES64, "DTES64", 0x1, 0, ECX, 2)                           \
+  X(MONITOR, "MONITOR", 0x1, 0, ECX, 3)                         \
+  X(DS_CPL, "DS-CPL", 0x1, 0, ECX, 4)                           \
+  X(VMX, "VMX", 0x1, 0, ECX, 5)                                 \
+  X(SMX, "SMX", 0x1, 0, ECX, 6)                                 \
+  X(EIST, "EIST", 0x1, 0, ECX, 7)                               \
+  X(TM2, "TM2", 0x1, 0, ECX, 8)                                 \
+  X(SSSE3, "SSSE3", 0x1, 0, ECX, 9)                             \
+  X(CNXT_ID, "CNXT-ID", 0x1, 0, ECX, 10)                        \
+  X(SDBG, "SDBG", 0x1, 0, ECX, 11)                              \
+  X(FMA, "FMA", 0x1, 0, ECX, 12)                                \
+  X(CMPXCHG16B, "CMPXCHG16B", 0x1, 0, ECX, 13)                  \
+  X(XTPR, "xTPR", 0x1, 0, ECX, 14)                              \
+  X(PDCM, "PDCM", 0x1, 0, ECX, 15)                              \
+  X(PCID, "PCID", 0x1, 0, ECX, 17)                              \
+  X(DCA, "DCA", 0x1, 0, ECX, 18)                                \
+  X(SSE41, "SSE4.1", 0x1, 0, ECX, 19)                           \
+  X(SSE42, "SSE4.2", 0x1, 0, ECX, 20)                           \
+  X(X2APIC, "x2APIC", 0x1, 0, ECX, 21)                          \
+  X(MOVBE, "MOVBE", 0x1, 0, ECX, 22)                            \
+  X(POPCNT, "POPCNT", 0x1, 0, ECX, 23)                          \
+  X(TSC_DEADLINE, "TSC-Deadline", 0x1, 0, ECX, 24)              \
+  X(AESNI, "AESNI", 0x1, 0, ECX, 25)                            \
+  X(XSAVE, "XSAVE", 0x1, 0, ECX, 26)                            \
+  X(OSXSAVE, "OSXSAVE", 0x1, 0, ECX, 27)                        \
+  X(AVX, "AVX", 0x1, 0, ECX, 28)                                \
+  X(F16C, "F16C", 0x1, 0, ECX, 29)                              \
+  X(RDRAND, "RDRAND", 0x1, 0, ECX, 30)                          \
+  X(HYPERVISOR, "HYPERVISOR", 0x1, 0, ECX, 31)                  \
+  /* CPUID.01H:EDX */                                           \
+  X(FPU, "FPU", 0x1, 0, EDX, 0)                                 \
+  X(VME, "VME", 0x1, 0, EDX, 1)                                 \
+  X(DE, "DE", 0x1, 0, EDX, 2)                                   \
+  X(PSE, "PSE", 0x1, 0, EDX, 3)                                 \
+  X(TSC, "TSC", 0x1, 0, EDX, 4)                                 \
+  X(MSR, "MSR", 0x1, 0, EDX, 5)                                 \
+  X(PAE, "PAE", 0x1, 0, EDX, 6)                                 \
+  X(MCE, "MCE", 0x1, 0, EDX, 7)                                 \
+  X(CX8, "CX8", 0x1, 0, EDX, 8)                                 \
+  X(APIC, "APIC", 0x1, 0, EDX, 9)                               \
+  X(SEP, "SEP", 0x1, 0, EDX, 11)                                \
+  X(MTRR, "MTRR", 0x1, 0, EDX, 12)                              \
+  X(PGE, "PGE", 0x1, 0, EDX, 13)                                \
+  X(MCA, "MCA", 0x1, 0, EDX, 14)                                \
+  X(CMOV, "CMOV", 0x1, 0, EDX, 15)                              \
+  X(PAT, "PAT", 0x1, 0, EDX, 16)                                \
+  X(PSE36, "PSE-36", 0x1, 0, EDX, 17)                           \
+  X(PSN, "PSN", 0x1, 0, EDX, 18)                                \
+  X(CLFSH, "CLFSH", 0x1, 0, EDX, 19)                            \
+  X(DS, "DS", 0x1, 0, EDX, 21)                                  \
+  X(ACPI, "ACPI", 0x1, 0, EDX, 22)                              \
+  X(MMX, "MMX", 0x1, 0, EDX, 23)                                \
+  X(FXSR, "FXSR", 0x1, 0, EDX, 24)                              \
+  X(SSE, "SSE", 0x1, 0, EDX, 25)                                \
+  X(SSE2, "SSE2", 0x1, 0, EDX, 26)                              \
+  X(SS, "SS", 0x1, 0, EDX, 27)                                  \
+  X(HTT, "HTT", 0x1, 0, EDX, 28)                                \
+  X(TM, "TM", 0x1, 0, EDX, 29)                                  \
+  X(PBE, "PBE", 0x1, 0, EDX, 31)                                \
+  /* CPUID.(EAX=07H,ECX=0):EBX */                               \
+  X(FSGSBASE, "FSGSBASE", 0x7, 0, EBX, 0)                       \
+  X(TSC_ADJUST, "TSC_ADJUST", 0x7, 0, EBX, 1)                   \
+  X(SGX, "SGX", 0x7, 0, EBX, 2)                                 \
+  X(BMI1, "BMI1", 0x7, 0, EBX, 3)                               \
+  X(HLE, "HLE", 0x7, 0, EBX, 4)                                 \
+  X(AVX2, "AVX2", 0x7, 0, EBX, 5)                               \
+  X(FDP_EXCPTN_ONLY, "FDP_EXCPTN_ONLY", 0x7, 0, EBX, 6)         \
+  X(SMEP, "SMEP", 0x7, 0, EBX, 7)                               \
+  X(BMI2, "BMI2", 0x7, 0, EBX, 8)                               \
+  X(ERMS, "ERMS", 0x7, 0, EBX, 9)                               \
+  X(INVPCID, "INVPCID", 0x7, 0, EBX, 10)                        \
+  X(RTM, "RTM", 0x7, 0, EBX, 11)                                \
+  X(RDT_M, "RDT-M", 0x7, 0, EBX, 12)                            \
+  X(FPU_CSDS_DEPR, "FPU_CSDS_DEPR", 0x7, 0, EBX, 13)            \
+  X(MPX, "MPX", 0x7, 0, EBX, 14)                                \
+  X(RDT_A, "RDT-A", 0x7, 0, EBX, 15)                            \
+  X(AVX512F, "AVX512F", 0x7, 0, EBX, 16)                        \
+  X(AVX512DQ, "AVX512DQ", 0x7, 0, EBX, 17)                      \
+  X(RDSEED, "RDSEED", 0x7, 0, EBX, 18)                          \
+  X(ADX, "ADX", 0x7, 0, EBX, 19)                                \
+  X(SMAP, "SMAP", 0x7, 0, EBX, 20)                              \
+  X(AVX512_IFMA, "AVX512_IFMA", 0x7, 0, EBX, 21)                \
+  X(CLFLUSHOPT, "CLFLUSHOPT", 0x7, 0, EBX, 23)                  \
+  X(CLWB, "CLWB", 0x7, 0, EBX, 24)                              \
+  X(INTEL_PT, "INTEL_PT", 0x7, 0, EBX, 25)                      \
+  X(AVX512PF, "AVX512PF", 0x7, 0, EBX, 26)                      \
+  X(AVX512ER, "AVX512ER", 0x7, 0, EBX, 27)                      \
+  X(AVX512CD, "AVX512CD", 0x7, 0, EBX, 28)                      \
+  X(SHA, "SHA", 0x7, 0, EBX, 29)                                \
+  X(AVX512BW, "AVX512BW", 0x7, 0, EBX, 30)                      \
+  X(AVX512VL, "AVX512VL", 0x7, 0, EBX, 31)                      \
+  /* CPUID.(EAX=07H,ECX=0):ECX */                               \
+  X(PREFETCHWT1, "PREFETCHWT1", 0x7, 0, ECX, 0)                 \
+  X(AVX512_VBMI, "AVX512_VBMI", 0x7, 0, ECX, 1)                 \
+  X(UMIP, "UMIP", 0x7, 0, ECX, 2)                               \
+  X(PKU, "PKU", 0x7, 0, ECX, 3)                                 \
+  X(OSPKE, "OSPKE", 0x7, 0, ECX, 4)                             \
+  X(WAITPKG, "WAITPKG", 0x7, 0, ECX, 5)                         \
+  X(AVX512_VBMI2, "AVX512_VBMI2", 0x7, 0, ECX, 6)               \
+  X(CET_SS, "CET_SS", 0x7, 0, ECX, 7)                           \
+  X(GFNI, "GFNI", 0x7, 0, ECX, 8)                               \
+  X(VAES, "VAES", 0x7, 0, ECX, 9)                               \
+  X(VPCLMULQDQ, "VPCLMULQDQ", 0x7, 0, ECX, 10)                  \
+  X(AVX512_VNNI, "AVX512_VNNI", 0x7, 0, ECX, 11)                \
+  X(AVX512_BITALG, "AVX512_BITALG", 0x7, 0, ECX, 12)            \
+  X(TME_EN, "TME_EN", 0x7, 0, ECX, 13)                          \
+  X(AVX512_VPOPCNTDQ, "AVX512_VPOPCNTDQ", 0x7, 0, ECX, 14)      \
+  X(LA57, "LA57", 0x7, 0, ECX, 16)                              \
+  X(RDPID, "RDPID", 0x7, 0, ECX, 22)                            \
+  X(KL, "KL", 0x7, 0, ECX, 23)                                  \
+  X(BUS_LOCK_DETECT, "BUS_LOCK_DETECT", 0x7, 0, ECX, 24)        \
+  X(CLDEMOTE, "CLDEMOTE", 0x7, 0, ECX, 25)                      \
+  X(MOVDIRI, "MOVDIRI", 0x7, 0, ECX, 27)                        \
+  X(MOVDIR64B, "MOVDIR64B", 0x7, 0, ECX, 28)                    \
+  X(ENQCMD, "ENQCMD", 0x7, 0, ECX, 29)                          \
+  X(SGX_LC, "SGX_LC", 0x7, 0, ECX, 30)                          \
+  X(PKS, "PKS", 0x7, 0, ECX, 31)                                \
+  /* CPUID.(EAX=07H,ECX=0):EDX */                               \
+  X(SGX_KEYS, "SGX-KEYS", 0x7, 0, EDX, 1)                       \
+  X(AVX512_4VNNIW, "AVX512_4VNNIW", 0x7, 0, EDX, 2)             \
+  X(AVX512_4FMAPS, "AVX512_4FMAPS", 0x7, 0, EDX, 3)             \
+  X(FSRM, "FSRM", 0x7, 0, EDX, 4)                               \
+  X(UINTR, "UINTR", 0x7, 0, EDX, 5)                             \
+  X(AVX512_VP2INTERSECT, "AVX512_VP2INTERSECT", 0x7, 0, EDX, 8) \
+  X(SRBDS_CTRL, "SRBDS_CTRL", 0x7, 0, EDX, 9)                   \
+  X(MD_CLEAR, "MD_CLEAR", 0x7, 0, EDX, 10)                      \
+  X(RTM_ALWAYS_ABORT, "RTM_ALWAYS_ABORT", 0x7, 0, EDX, 11)      \
+  X(SERIALIZE, "SERIALIZE", 0x7, 0, EDX, 14)                    \
+  X(HYBRID, "Hybrid", 0x7, 0, EDX, 15)                          \
+  X(TSXLDTRK, "TSXLDTRK", 0x7, 0, EDX, 16)                      \
+  X(PCONFIG, "PCONFIG", 0x7, 0, EDX, 18)                        \
+  X(ARCH_LBR, "ARCH_LBR", 0x7, 0, EDX, 19)                      \
+  X(CET_IBT, "CET_IBT", 0x7, 0, EDX, 20)                        \
+  X(AMX_BF16, "AMX-BF16", 0x7, 0, EDX, 22)                      \
+  X(AVX512_FP16, "AVX512_FP16", 0x7, 0, EDX, 23)                \
+  X(AMX_TILE, "AMX-TILE", 0x7, 0, EDX, 24)                      \
+  X(AMX_INT8, "AMX-INT8", 0x7, 0, EDX, 25)                      \
+  X(IBRS_IBPB, "IBRS_IBPB", 0x7, 0, EDX, 26)                    \
+  X(STIBP, "STIBP", 0x7, 0, EDX, 27)                            \
+  X(L1D_FLUSH, "L1D_FLUSH", 0x7, 0, EDX, 28)                    \
+  X(ARCH_CAPABILITIES, "ARCH_CAPABILITIES", 0x7, 0, EDX, 29)    \
+  X(CORE_CAPABILITIES, "CORE_CAPABILITIES", 0x7, 0, EDX, 30)    \
+  X(SSBD, "SSBD", 0x7, 0, EDX, 31)                              \
+  /* CPUID.(EAX=07H,ECX=1):EAX */                               \
+  X(SHA512, "SHA512", 0x7, 1, EAX, 0)                           \
+  X(SM3, "SM3", 0x7, 1, EAX, 1)                                 \
+  X(SM4, "SM4", 0x7, 1, EAX, 2)                                 \
+  X(RAO_INT, "RAO-INT", 0x7, 1, EAX, 3)                         \
+  X(AVX_VNNI, "AVX-VNNI", 0x7, 1, EAX, 4)                       \
+  X(AVX512_BF16, "AVX512_BF16", 0x7, 1, EAX, 5)                 \
+  X(LASS, "LASS", 0x7, 1, EAX, 6)                               \
+  X(CMPCCXADD, "CMPCCXADD", 0x7, 1, EAX, 7)                     \
+  X(ARCH_PERFMON_EXT, "ARCH_PERFMON_EXT", 0x7, 1, EAX, 8)       \
+  X(FZLRM, "FZLRM", 0x7, 1, EAX, 10)                            \
+  X(FSRS, "FSRS", 0x7, 1, EAX, 11)                              \
+  X(FSRCS, "FSRCS", 0x7, 1, EAX, 12)                            \
+  X(FRED, "FRED", 0x7, 1, EAX, 17)                              \
+  X(LKGS, "LKGS", 0x7, 1, EAX, 18)                              \
+  X(WRMSRNS, "WRMSRNS", 0x7, 1, EAX, 19)                        \
+  X(AMX_FP16, "AMX-FP16", 0x7, 1, EAX, 21)                      \
+  X(HRESET, "HRESET", 0x7, 1, EAX, 22)                          \
+  X(AVX_IFMA, "AVX-IFMA", 0x7, 1, EAX, 23)                      \
+  X(LAM, "LAM", 0x7, 1, EAX, 26)                                \
+  X(MSRLIST, "MSRLIST", 0x7, 1, EAX, 27)                        \
+  /* CPUID.(EAX=07H,ECX=1):EDX */                               \
+  X(AVX_VNNI_INT8, "AVX-VNNI-INT8", 0x7, 1, EDX, 4)             \
+  X(AVX_NE_CONVERT, "AVX-NE-CONVERT", 0x7, 1, EDX, 5)           \
+  X(AMX_COMPLEX, "AMX-COMPLEX", 0x7, 1, EDX, 8)                 \
+  X(AVX_VNNI_INT16, "AVX-VNNI-INT16", 0x7, 1, EDX, 10)          \
+  X(PREFETCHI, "PREFETCHI", 0x7, 1, EDX, 14)                    \
+  X(USER_MSR, "USER_MSR", 0x7, 1, EDX, 15)                      \
+  X(CET_SSS, "CET_SSS", 0x7, 1, EDX, 18)                        \
+  X(AVX10, "AVX10", 0x7, 1, EDX, 19)                            \
+  X(APX_F, "APX_F", 0x7, 1, EDX, 21)                            \
+  /* CPUID.(EAX=07H,ECX=2):EDX */                               \
+  X(PSFD, "PSFD", 0x7, 2, EDX, 0)                               \
+  X(IPRED_CTRL, "IPRED_CTRL", 0x7, 2, EDX, 1)                   \
+  X(RRSBA_CTRL, "RRSBA_CTRL", 0x7, 2, EDX, 2)                   \
+  X(DDPD_U, "DDPD_U", 0x7, 2, EDX, 3)                           \
+  X(BHI_CTRL, "BHI_CTRL", 0x7, 2, EDX, 4)                       \
+  X(MCDT_NO, "MCDT_NO", 0x7, 2, EDX, 5)                         \
+  /* CPUID.(EAX=0DH,ECX=1):EAX */                               \
+  X(XSAVEOPT, "XSAVEOPT", 0xD, 1, EAX, 0)                       \
+  X(XSAVEC, "XSAVEC", 0xD, 1, EAX, 1)                           \
+  X(XGETBV_ECX1, "XGETBV_ECX1", 0xD, 1, EAX, 2)                 \
+  X(XSAVES, "XSAVES", 0xD, 1, EAX, 3)                           \
+  X(XFD, "XFD", 0xD, 1, EAX, 4)                                 \
+  /* CPUID.(EAX=14H,ECX=0): Intel Processor Trace */            \
+  X(PT_CR3_FILTER, "PT_CR3_FILTER", 0x14, 0, EBX, 0)            \
+  X(PT_PSB_CYC, "PT_PSB_CYC", 0x14, 0, EBX, 1)                  \
+  X(PT_IP_FILTER, "PT_IP_FILTER", 0x14, 0, EBX, 2)              \
+  X(PT_MTC, "PT_MTC", 0x14, 0, EBX, 3)                          \
+  X(PT_PTWRITE, "PT_PTWRITE", 0x14, 0, EBX, 4)                  \
+  X(PT_POWER_EVENT, "PT_POWER_EVENT", 0x14, 0, EBX, 5)          \
+  X(PT_TOPA, "PT_TOPA", 0x14, 0, ECX, 0)                        \
+  X(PT_TOPA_MULTI, "PT_TOPA_MULTI", 0x14, 0, ECX, 1)            \
+  X(PT_SINGLE_RANGE, "PT_SINGLE_RANGE", 0x14, 0, ECX, 2)        \
+  X(PT_TRANSPORT, "PT_TRANSPORT", 0x14, 0, ECX, 3)              \
+  X(PT_LIP, "PT_LIP", 0x14, 0, ECX, 31)                         \
+  /* CPUID.19H:EBX: Key Locker */                               \
+  X(KL_AESKLE, "KL_AESKLE", 0x19, 0, EBX, 0)                    \
+  X(KL_WIDE, "KL_WIDE", 0x19, 0, EBX, 2)                        \
+  X(KL_IWKEY_BACKUP, "KL_IWKEY_BACKUP", 0x19, 0, EBX, 4)        \
+  /* CPUID.80000001H:ECX */                                     \
+  X(LAHF_LM, "LAHF_LM", 0x80000001, 0, ECX, 0)                  \
+  X(CMP_LEGACY, "CMP_LEGACY", 0x80000001, 0, ECX, 1)            \
+  X(SVM, "SVM", 0x80000001, 0, ECX, 2)                          \
+  X(EXTAPIC, "EXTAPIC", 0x80000001, 0, ECX, 3)                  \
+  X(CR8_LEGACY, "CR8_LEGACY", 0x80000001, 0, ECX, 4)            \
+  X(LZCNT, "LZCNT", 0x80000001, 0, ECX, 5)                      \
+  X(SSE4A, "SSE4A", 0x80000001, 0, ECX, 6)                      \
+  X(MISALIGNSSE, "MISALIGNSSE", 0x80000001, 0, ECX, 7)          \
+  X(PREFETCHW, "PREFETCHW", 0x80000001, 0, ECX, 8)              \
+  X(OSVW, "OSVW", 0x80000001, 0, ECX, 9)                        \
+  X(IBS, "IBS", 0x80000001, 0, ECX, 10)                         \
+  X(XOP, "XOP", 0x80000001, 0, ECX, 11)                         \
+  X(SKINIT, "SKINIT", 0x80000001, 0, ECX, 12)                   \
+  X(WDT, "WDT", 0x80000001, 0, ECX, 13)                         \
+  X(LWP, "LWP", 0x80000001, 0, ECX, 15)                         \
+  X(FMA4, "FMA4", 0x80000001, 0, ECX, 16)                       \
+  X(TCE, "TCE", 0x80000001, 0, ECX, 17)                         \
+  X(NODEID_MSR, "NODEID_MSR", 0x80000001, 0, ECX, 19)           \
+  X(TBM, "TBM", 0x80000001, 0, ECX, 21)                         \
+  X(TOPOEXT, "TOPOEXT", 0x80000001, 0, ECX, 22)                 \
+  X(PERFCTR_CORE, "PERFCTR_CORE", 0x80000001, 0, ECX, 23)       \
+  X(PERFCTR_NB, "PERFCTR_NB", 0x80000001, 0, ECX, 24)           \
+  X(BPEXT, "BPEXT", 0x80000001, 0, ECX, 26)                     \
+  X(PTSC, "PTSC", 0x80000001, 0, ECX, 27)                       \
+  X(PERFCTR_LLC, "PERFCTR_LLC", 0x80000001, 0, ECX, 28)         \
+  X(MWAITX, "MWAITX", 0x80000001, 0, ECX, 29)                   \
+  X(ADDR_MASK_EXT, "ADDR_MASK_EXT", 0x80000001, 0, ECX, 30)     \
+  /* CPUID.80000001H:EDX */                                     \
+  X(SYSCALL, "SYSCALL", 0x80000001, 0, EDX, 11)                 \
+  X(MP, "MP", 0x80000001, 0, EDX, 19)                           \
+  X(NX, "NX", 0x80000001, 0, EDX, 20)                           \
+  X(MMXEXT, "MMXEXT", 0x80000001, 0, EDX, 22)                   \
+  X(FXSR_OPT, "FXSR_OPT", 0x80000001, 0, EDX, 25)               \
+  X(PDPE1GB, "PDPE1GB", 0x80000001, 0, EDX, 26)                 \
+  X(RDTSCP, "RDTSCP", 0x80000001, 0, EDX, 27)                   \
+  X(LM, "LM", 0x80000001, 0, EDX, 29)                           \
+  X(THREEDNOWEXT, "3DNowExt", 0x80000001, 0, EDX, 30)           \
+  X(THREEDNOW, "3DNow", 0x80000001, 0, EDX, 31)
+
+enum class Feature : uint16_t {
+#define CPUID_FEATURE_ENUM(id, name, leaf, subleaf, reg, bit) id,
+  CPUID_FEATURES(CPUID_FEATURE_ENUM)
+#undef CPUID_FEATURE_ENUM
+  kCount
+};
+
+inline constexpr size_t kFeatureCount = size_t(Feature::kCount);
+
+struct FeatureDesc {
+  Feature id;
+  std::string_view name;
+  uint32_t leaf;
+  uint32_t subleaf;
+  CpuidReg reg;
+  uint8_t bit;
+};
+
+// Indexed by Feature
+inline constexpr FeatureDesc kFeatures[] = {
+#define CPUID_FEATURE_DESC(id, name, leaf, subleaf, reg, bit) \
+  {Feature::id, name, leaf, subleaf, CpuidReg::reg, bit},
+    CPUID_FEATURES(CPUID_FEATURE_DESC)
+#undef CPUID_FEATURE_DESC
+};
+static_assert(std::size(kFeatures) == kFeatureCount);
+
+// Feature <-> name, usable in constant expressions:
+//   static_assert(FeatureNames{}[Feature::AVX2] == "AVX2");
+//   static_assert(FeatureNames{}["AVX2"] == Feature::AVX2);
+struct FeatureNames {
+  static constexpr std::string_view operator[](Feature f) noexcept {
+    return kFeatures[size_t(f)].name;
+  }
+
+  static constexpr std::optional<Feature> operator[](
+      std::string_view name) noexcept {
+    for (const auto &desc : kFeatures) {
+      if (desc.name == name) return desc.id;
+    }
+    return std::nullopt;
+  }
+};
+
+// Fixed-size bit set over Feature. has() is a single load and AND.
+class FeatureSet {
+ public:
+  constexpr FeatureSet() = default;
+  constexpr FeatureSet(std::initializer_list<Feature> features) {
+    for (Feature f : features) set(f);
+  }
+  // Decodes every entry of kFeatures from a snapshot
+  explicit FeatureSet(const CpuidSnapshot &snap);
+
+  constexpr bool has(Feature f) const {
+    return mWords[size_t(f) / 64] & (uint64_t(1) << (size_t(f) % 64));
+  }
+  // True when every feature in `other` is also present here
+  constexpr bool hasAll(const FeatureSet &other) const {
+    for (size_t i = 0; i < kWords; ++i) {
+      if ((mWords[i] & other.mWords[i]) != other.mWords[i]) return false;
+    }
+    return true;
+  }
+
+  constexpr void set(Feature f, bool value = true) {
+    uint64_t bit = uint64_t(1) << (size_t(f) % 64);
+    if (value) {
+      mWords[size_t(f) / 64] |= bit;
+    } else {
+      mWords[size_t(f) / 64] &= ~bit;
+    }
+  }
+
+  constexpr FeatureSet operator&(const FeatureSet &other) const {
+    FeatureSet r;
+    for (size_t i = 0; i < kWords; ++i) {
+      r.mWords[i] = mWords[i] & other.mWords[i];
+    }
+    return r;
+  }
+  constexpr FeatureSet operator|(const FeatureSet &other) const {
+    FeatureSet r;
+    for (size_t i = 0; i < kWords; ++i) {
+      r.mWords[i] = mWords[i] | other.mWords[i];
+    }
+    return r;
+  }
+  constexpr bool operator==(const FeatureSet &) const = default;
+
+  size_t count() const;
+
+ private:
+  static constexpr size_t kWords = (kFeatureCount + 63) / 64;
+  std::array<uint64_t, kWords> mWords{};
+};
+
+#endif  // FEATURES_HPP
@@ -0,0 +1,305 @@
+#include "fleet.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <span>
+
+#include "cache.hpp"
+#include "thread_pool.hpp"
+#include "topology.hpp"
+#include "uarch.hpp"
+
+std::string_view FleetTable::host(size_t i) const {
+  size_t begin = i ? nameEnd[i - 1] : 0;
+  return std::string_view(names).substr(begin, nameEnd[i] - begin);
+}
+
+void FleetTable::addHost(std::string_view name, const PerCpuSnapshot &all) {
+  if (all.size() == 0) return;
+  const CpuidSnapshot &first = all[0];
+  const CpuVendor v = first.vendor();
+  const CpuSignature sig = cpu_signature(v, first.get(0x1));
+  const CacheHierarchy caches = decode_caches(first);
+  auto bytes = [&](unsigned level) {
+    const CacheLevel *c = caches.data(level);
+    return c ? c->sizeBytes : 0;
+  };
+  const Topology topo(all);
+
+  names.append(name);
+  nameEnd.push_back(names.size());
+  vendor.push_back(v);
+  family.push_back(sig.family);
+  model.push_back(sig.model);
+  stepping.push_back(sig.stepping);
+  features.emplace_back(first);
+  l1dBytes.push_back(bytes(1));
+  l2Bytes.push_back(bytes(2));
+  l3Bytes.push_back(bytes(3));
+  logicalCpus.push_back(uint32_t(all.size()));
+  cores.push_back(uint32_t(topo.count(TopoLevel::Core)));
+  packages.push_back(uint32_t(topo.count(TopoLevel::Package)));
+}
+
+void FleetTable::append(const FleetTable &other) {
+  const size_t base = names.size();
+  names += other.names;
+  for (size_t end : other.nameEnd) nameEnd.push_back(base + end);
+  auto extend = [](auto &to, const auto &from) {
+    to.insert(to.end(), from.begin(), from.end());
+  };
+  extend(vendor, other.vendor);
+  extend(family, other.family);
+  extend(model, other.model);
+  extend(stepping, other.stepping);
+  extend(features, other.features);
+  extend(l1dBytes, other.l1dBytes);
+  extend(l2Bytes, other.l2Bytes);
+  extend(l3Bytes, other.l3Bytes);
+  extend(logicalCpus, other.logicalCpus);
+  extend(cores, other.cores);
+  extend(packages, other.packages);
+}
+
+namespace {
+
+// The whitespace sscanf skips within a line
+bool blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+void skip_blank(std::string_view &s) {
+  while (!s.empty() && blank(s.front())) s.remove_prefix(1);
+}
+
+bool consume(std::string_view &s, std::string_view prefix) {
+  if (!s.starts_with(prefix)) return false;
+  s.remove_prefix(prefix.size());
+  return true;
+}
+
+// A hex number after optional blanks and 0x, as sscanf's %x reads it
+bool hex(std::string_view &s, uint32_t &value) {
+  skip_blank(s);
+  if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    s.remove_prefix(2);
+  }
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value, 16);
+  if (ec != std::errc()) return false;
+  s.remove_prefix(size_t(end - s.data()));
+  return true;
+}
+
+// "CPU N:" or "CPU#N"
+bool cpu_header(std::string_view s, int &cpu) {
+  if (!consume(s, "CPU")) return false;
+  const bool hash = consume(s, "#");
+  skip_blank(s);
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), cpu);
+  if (ec != std::errc()) return false;
+  return hash || (end != s.data() + s.size() && *end == ':');
+}
+
+// The three record layouts of parse_cpuid_dump(), in its order
+bool cpuid_r_record(std::string_view s, CpuidLeaf &out) {
+  static constexpr std::string_view kRegs[] = {"eax=0x", "ebx=0x", "ecx=0x",
+                                               "edx=0x"};
+  if (!consume(s, "0x") || !hex(s, out.leaf)) return false;
+  skip_blank(s);
+  if (!consume(s, "0x") || !hex(s, out.subleaf) || !consume(s, ":")) {
+    return false;
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    skip_blank(s);
+    if (!consume(s, kRegs[i]) || !hex(s, out.regs[i])) return false;
+  }
+  return true;
+}
+
+bool instlat_record(std::string_view s, const CpuidLeaf *prev,
+                    CpuidLeaf &out) {
+  if (!consume(s, "CPUID") || !hex(s, out.leaf) || !consume(s, ":")) {
+    return false;
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    if ((i && !consume(s, "-")) || !hex(s, out.regs[i])) return false;
+  }
+  if (size_t sl = s.find("[SL "); sl != std::string_view::npos) {
+    s.remove_prefix(sl + 4);
+    return hex(s, out.subleaf);
+  }
+  out.subleaf = prev && prev->leaf == out.leaf ? prev->subleaf + 1 : 0;
+  return true;
+}
+
+bool plain_record(std::string_view s, CpuidLeaf &out) {
+  if (!hex(s, out.leaf) || !hex(s, out.subleaf)) return false;
+  for (uint32_t &r : out.regs) {
+    if (!hex(s, r)) return false;
+  }
+  skip_blank(s);
+  return s.empty();
+}
+
+// First line start at or after `pos` that opens a host
+size_t host_boundary(std::string_view text, size_t pos) {
+  if (pos == 0 && text.starts_with("HOST")) return 0;
+  size_t n = text.find("\nHOST", pos ? pos - 1 : 0);
+  return n == std::string_view::npos ? text.size() : n + 1;
+}
+
+// Turns the lines of one task's text into rows of its own table. Record
+// storage is reused from host to host, so only decoding a host allocates.
+class ChunkParser {
+ public:
+  explicit ChunkParser(FleetTable &out) : mOut(out) {}
+
+  void parse(std::string_view text) {
+    while (!text.empty()) {
+      size_t eol = text.find('\n');
+      line(text.substr(0, eol));
+      text.remove_prefix(eol == std::string_view::npos ? text.size()
+                                                       : eol + 1);
+    }
+    finishHost();
+  }
+
+ private:
+  void line(std::string_view s) {
+    if (s.starts_with("HOST") && (s.size() == 4 || blank(s[4]))) {
+      finishHost();
+      s.remove_prefix(4);
+      skip_blank(s);
+      while (!s.empty() && blank(s.back())) s.remove_suffix(1);
+      mHost = s;
+      return;
+    }
+    skip_blank(s);
+    int cpu;
+    if (cpu_header(s, cpu)) {
+      mCpus.push_back(cpu);
+      mCpuStart.push_back(mRecords.size());
+      return;
+    }
+    const CpuidLeaf *prev = !mCpuStart.empty() &&
+                                    mCpuStart.back() < mRecords.size()
+                                ? &mRecords.back()
+                                : nullptr;
+    CpuidLeaf leaf{};
+    if (!cpuid_r_record(s, leaf) && !instlat_record(s, prev, leaf) &&
+        !plain_record(s, leaf)) {
+      return;
+    }
+    // Records before any CPU header belong to CPU 0
+    if (mCpus.empty()) {
+      mCpus.push_back(0);
+      mCpuStart.push_back(0);
+    }
+    mRecords.push_back(leaf);
+  }
+
+  void finishHost() {
+    std::vector<int> cpus;
+    std::vector<CpuidSnapshot> snapshots;
+    for (size_t i = 0; i < mCpus.size(); ++i) {
+      const size_t begin = mCpuStart[i];
+      const size_t end =
+          i + 1 < mCpus.size() ? mCpuStart[i + 1] : mRecords.size();
+      if (begin == end) continue;
+      // Sorted and deduplicated as ReplayBackend does: the first wins
+      std::span<CpuidLeaf> leaves(mRecords.data() + begin, end - begin);
+      auto byKey = [](const CpuidLeaf &a, const CpuidLeaf &b) {
+        return a.key() < b.key();
+      };
+      if (!std::is_sorted(leaves.begin(), leaves.end(), byKey)) {
+        std::stable_sort(leaves.begin(), leaves.end(), byKey);
+      }
+      auto last = std::unique(leaves.begin(), leaves.end(),
+                              [](const CpuidLeaf &a, const CpuidLeaf &b) {
+                                return a.key() == b.key();
+                              });
+      cpus.push_back(mCpus[i]);
+      // The records outlive these snapshots, which only last for the row
+      snapshots.emplace_back(
+          std::span<const CpuidLeaf>(leaves.begin(), last), nullptr);
+    }
+    if (!snapshots.empty()) {
+      mOut.addHost(mHost, PerCpuSnapshot(cpus, std::move(snapshots)));
+    }
+    mHost = {};
+    mCpus.clear();
+    mCpuStart.clear();
+    mRecords.clear();
+  }
+
+  FleetTable &mOut;
+  std::string_view mHost;
+  std::vector<int> mCpus;
+  std::vector<size_t> mCpuStart;  // first record of each CPU in mRecords
+  std::vector<CpuidLeaf> mRecords;
+};
+
+}  // namespace
+
+FleetTable ingest_fleet_dump(std::string_view text,
+                             const IngestOptions &options) {
+  // Task boundaries; a host larger than chunkBytes stays in one task
+  std::vector<size_t> bounds{0};
+  const size_t step = std::max<size_t>(options.chunkBytes, 1);
+  for (size_t at = step; at < text.size();) {
+    size_t b = host_boundary(text, at);
+    if (b >= text.size()) break;
+    if (b > bounds.back()) bounds.push_back(b);
+    at = std::max(at + step, b + 1);
+  }
+  bounds.push_back(text.size());
+
+  std::vector<FleetTable> parts(bounds.size() - 1);
+  auto parse = [&](size_t i) {
+    ChunkParser(parts[i]).parse(
+        text.substr(bounds[i], bounds[i + 1] - bounds[i]));
+  };
+  if (options.threads == 1 || parts.size() == 1) {
+    for (size_t i = 0; i < parts.size(); ++i) parse(i);
+  } else {
+    ThreadPool pool(ThreadPool::Options{.workers = options.threads});
+    TaskGroup group(pool);
+    for (size_t i = 0; i < parts.size(); ++i) {
+      group.run([&parse, i] { parse(i); });
+    }
+    group.wait();
+  }
+
+  if (parts.size() == 1) return std::move(parts[0]);
+  FleetTable table;
+  for (const FleetTable &part : parts) table.append(part);
+  return table;
+}
+
+std::optional<FleetTable> load_fleet_dump(const std::string &path,
+                                          const IngestOptions &options) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::nullopt;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  const size_t size = size_t(st.st_size);
+  if (size == 0) {
+    close(fd);
+    return FleetTable{};
+  }
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return std::nullopt;
+  // Every task reads its range front to back
+  madvise(addr, size, MADV_SEQUENTIAL);
+  FleetTable table = ingest_fleet_dump(
+      std::string_view(static_cast<const char *>(addr), size), options);
+  munmap(addr, size);
+  return table;
+}
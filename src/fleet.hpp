@@ -0,0 +1,68 @@
+#ifndef FLEET_HPP
+#define FLEET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "features.hpp"
+#include "percpu.hpp"
+#include "snapshot.hpp"
+
+// Decoded fields of many hosts, one column per field and one row per host
+// in dump order. Columns are plain vectors, so a scan over one field
+// (e.g. every host's L3 size) reads only that field.
+struct FleetTable {
+  // Host i's name is names[nameEnd[i - 1], nameEnd[i])
+  std::string names;
+  std::vector<size_t> nameEnd;
+
+  std::vector<CpuVendor> vendor;
+  std::vector<uint16_t> family;  // display family/model, see CpuSignature
+  std::vector<uint8_t> model;
+  std::vector<uint8_t> stepping;
+  std::vector<FeatureSet> features;
+  // Bytes of the L1 data, L2 and L3 caches; 0 when absent
+  std::vector<uint32_t> l1dBytes;
+  std::vector<uint32_t> l2Bytes;
+  std::vector<uint32_t> l3Bytes;
+  // Logical CPUs in the dump, physical cores and packages among them
+  std::vector<uint32_t> logicalCpus;
+  std::vector<uint32_t> cores;
+  std::vector<uint32_t> packages;
+
+  size_t size() const { return vendor.size(); }
+  std::string_view host(size_t i) const;
+
+  // Decodes `all` into a new row: signature, features and caches from its
+  // first CPU, counts from its Topology. Ignored when `all` is empty.
+  void addHost(std::string_view name, const PerCpuSnapshot &all);
+  // Appends every row of `other`
+  void append(const FleetTable &other);
+};
+
+struct IngestOptions {
+  // Parsing threads; 0 uses one per physical core, 1 parses inline
+  unsigned threads = 0;
+  // Text per parsing task. Tasks start at the first host boundary at or
+  // after each multiple, so no host is split.
+  size_t chunkBytes = size_t(4) << 20;
+};
+
+// Parses a fleet dump: the concatenated dumps of many hosts, each started
+// by a "HOST name" line at the beginning of a line. Within a host every
+// line format of parse_cpuid_dump() is accepted, with the same CPU
+// headers; records before the first HOST line form a host with an empty
+// name. Lines are parsed in place with std::from_chars, and a host's
+// records are decoded without going through ReplayBackend. Hosts without
+// records get no row.
+FleetTable ingest_fleet_dump(std::string_view text,
+                             const IngestOptions &options = {});
+// Maps `path` read-only and ingests it; nullopt when it cannot be mapped
+std::optional<FleetTable> load_fleet_dump(const std::string &path,
+                                          const IngestOptions &options = {});
+
+#endif  // FLEET_HPP
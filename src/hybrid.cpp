@@ -0,0 +1,80 @@
+#include "hybrid.hpp"
+
+#include <algorithm>
+
+#include "features.hpp"
+
+#define INTEL_CORE_TYPE_ATOM 0x20
+#define INTEL_CORE_TYPE_CORE 0x40
+
+static CoreClass classify(const CpuidSnapshot &snap, bool hybrid,
+                          uint32_t *nativeModelId) {
+  if (!hybrid) return CoreClass::Performance;
+
+  CpuVendor vendor = snap.vendor();
+  if (vendor == CpuVendor::Intel) {
+    const CpuidLeaf &r = snap.get(0x1A);
+    *nativeModelId = r.EAX() & 0xFFFFFF;
+    switch (r.EAX() >> 24) {
+      case INTEL_CORE_TYPE_CORE:
+        return CoreClass::Performance;
+      case INTEL_CORE_TYPE_ATOM:
+        return CoreClass::Efficient;
+      default:
+        return CoreClass::Unknown;
+    }
+  }
+  // AMD Fn8000_0026 EBX[31:28]: 0 = performance, 1 = efficiency
+  switch (snap.get(0x80000026).EBX() >> 28) {
+    case 0:
+      return CoreClass::Performance;
+    case 1:
+      return CoreClass::Efficient;
+    default:
+      return CoreClass::Unknown;
+  }
+}
+
+static bool is_hybrid(const CpuidSnapshot &snap) {
+  if (snap.vendor() == CpuVendor::Intel) {
+    return FeatureSet(snap).has(Feature::HYBRID);
+  }
+  // AMD Fn8000_0026 EAX[30]: HeterogeneousCores
+  return snap.maxExtendedLeaf() >= 0x80000026 &&
+         (snap.get(0x80000026).EAX() >> 30) & 1;
+}
+
+CoreTypeMap::CoreTypeMap(const PerCpuSnapshot &cpus) {
+  if (cpus.size() == 0) return;
+  mHybrid = is_hybrid(cpus[0]);
+  mByCpu.resize(size_t(std::ranges::max(cpus.cpus())) + 1);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    Entry &e = mByCpu[cpus.cpu(i)];
+    e.cls = classify(cpus[i], mHybrid, &e.nativeModelId);
+    mSets[size_t(e.cls)].add(cpus.cpu(i));
+  }
+}
+
+const CoreTypeMap &CoreTypeMap::host() {
+  static const CoreTypeMap map(PerCpuSnapshot::host());
+  return map;
+}
+
+CoreClass CoreTypeMap::classOf(int cpu) const {
+  if (cpu < 0 || size_t(cpu) >= mByCpu.size()) return CoreClass::Unknown;
+  return mByCpu[cpu].cls;
+}
+
+uint32_t CoreTypeMap::nativeModelId(int cpu) const {
+  if (cpu < 0 || size_t(cpu) >= mByCpu.size()) return 0;
+  return mByCpu[cpu].nativeModelId;
+}
+
+const CpuSet &cpuset_for(CoreClass cls) {
+  return CoreTypeMap::host().cpuset(cls);
+}
+
+bool pin_to(CoreClass cls) {
+  const CpuSet &set = cpuset_for(cls);
+  return !set.empty() && set.pinCurrentThread();
+}
@@ -0,0 +1,46 @@
+#ifndef HYBRID_HPP
+#define HYBRID_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "cpuset.hpp"
+#include "percpu.hpp"
+
+enum class CoreClass : uint8_t { Unknown, Performance, Efficient };
+
+// Core type of every logical CPU. On Intel hybrid parts
+// (CPUID.07H.0H:EDX[15]) leaf 0x1A EAX[31:24] is 40H for a P-core and 20H
+// for an E-core; AMD heterogeneous parts report it in 0x80000026 EBX[31:28].
+// Non-hybrid parts are all Performance.
+class CoreTypeMap {
+ public:
+  explicit CoreTypeMap(const PerCpuSnapshot &cpus);
+  // Built from PerCpuSnapshot::host() on first use
+  static const CoreTypeMap &host();
+
+  bool isHybrid() const { return mHybrid; }
+  CoreClass classOf(int cpu) const;
+  // Leaf 0x1A EAX[23:0], 0 when not reported
+  uint32_t nativeModelId(int cpu) const;
+  const CpuSet &cpuset(CoreClass cls) const { return mSets[size_t(cls)]; }
+
+ private:
+  struct Entry {
+    CoreClass cls = CoreClass::Unknown;
+    uint32_t nativeModelId = 0;
+  };
+
+  bool mHybrid = false;
+  std::vector<Entry> mByCpu;  // indexed by cpu number
+  CpuSet mSets[3];
+};
+
+// CPUs of class `cls` on this host, e.g. to hand to a thread pool
+const CpuSet &cpuset_for(CoreClass cls);
+
+// Restricts the calling thread to CPUs of class `cls`. Returns false, and
+// leaves the affinity alone, when there are none or the kernel refuses.
+bool pin_to(CoreClass cls);
+
+#endif  // HYBRID_HPP
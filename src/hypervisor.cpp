@@ -0,0 +1,163 @@
+#include "hypervisor.hpp"
+
+#include <cpuid.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include "utils.hpp"
+
+// Enough to tell the signature apart; names without an entry are Other
+struct HypervisorSignature {
+  const char *signature;  // 12 bytes, EBX:ECX:EDX
+  Hypervisor vendor;
+  std::string_view name;
+};
+
+static constexpr HypervisorSignature kSignatures[] = {
+    {"KVMKVMKVM\0\0\0", Hypervisor::KVM, "kvm"},
+    {"Microsoft Hv", Hypervisor::HyperV, "hyperv"},
+    {"Linux KVM Hv", Hypervisor::HyperV, "hyperv"},  // KVM's Hyper-V face
+    {"XenVMMXenVMM", Hypervisor::Xen, "xen"},
+    {"VMwareVMware", Hypervisor::VMware, "vmware"},
+    {"VBoxVBoxVBox", Hypervisor::VirtualBox, "virtualbox"},
+    {"TCGTCGTCGTCG", Hypervisor::QemuTcg, "qemu-tcg"},
+    {"bhyve bhyve ", Hypervisor::Bhyve, "bhyve"},
+    {"ACRNACRNACRN", Hypervisor::Acrn, "acrn"},
+    {" lrpepyh  vr", Hypervisor::Parallels, "parallels"},
+};
+
+std::string_view hypervisor_name(Hypervisor hv) {
+  if (hv == Hypervisor::None) return "none";
+  for (const HypervisorSignature &s : kSignatures) {
+    if (s.vendor == hv) return s.name;
+  }
+  return "other";
+}
+
+static std::array<char, 12> signature_of(const CpuidLeaf &l) {
+  std::array<char, 12> sig;
+  std::memcpy(sig.data(), &l.regs[1], 12);  // EBX, ECX, EDX
+  return sig;
+}
+
+static Hypervisor classify(const std::array<char, 12> &sig) {
+  for (const HypervisorSignature &s : kSignatures) {
+    if (std::memcmp(sig.data(), s.signature, sig.size()) == 0) {
+      return s.vendor;
+    }
+  }
+  return Hypervisor::Other;
+}
+
+// CPUID.40000002H: Hyper-V version
+namespace leafhv {
+using Major = Field<CpuidReg::EBX, 31, 16>;  // 0x40000002
+using Minor = Field<CpuidReg::EBX, 15, 0>;
+}  // namespace leafhv
+
+// CPUID.(EAX=base+1): Xen version
+namespace leafxen {
+using Major = Field<CpuidReg::EAX, 31, 16>;
+using Minor = Field<CpuidReg::EAX, 15, 0>;
+}  // namespace leafxen
+
+HypervisorInfo decode_hypervisor(const CpuidSnapshot &snap) {
+  HypervisorInfo info;
+  if (!(snap.get(0x1).ECX() & (1U << 31))) return info;
+
+  info.signature = signature_of(snap.get(0x40000000));
+  info.vendor = classify(info.signature);
+  info.base = 0x40000000;
+  // KVM or Xen behind Hyper-V enlightenments: their own range is 0x100 up
+  if (info.vendor == Hypervisor::HyperV && snap.contains(0x40000100)) {
+    std::array<char, 12> sig = signature_of(snap.get(0x40000100));
+    Hypervisor inner = classify(sig);
+    if (inner == Hypervisor::KVM || inner == Hypervisor::Xen) {
+      info.vendor = inner;
+      info.signature = sig;
+      info.base = 0x40000100;
+    }
+  }
+  // KVM reports 0 here, meaning "base + 1 is the highest leaf"
+  info.maxLeaf = std::max(snap.get(info.base).EAX(), info.base + 1);
+
+  const CpuidLeaf &features = snap.get(info.base + 1);
+  if (info.vendor == Hypervisor::KVM) {
+    info.kvm.features = features.EAX();
+    info.kvm.realtime = features.EDX() & 1;
+  } else if (info.vendor == Hypervisor::Xen) {
+    info.xenMajor = uint16_t(leafxen::Major::get(features));
+    info.xenMinor = uint16_t(leafxen::Minor::get(features));
+  }
+
+  HyperVInfo &hv = info.hyperv;
+  hv.interface = snap.get(0x40000001).EAX();
+  if (hv.present()) {
+    const CpuidLeaf &version = snap.get(0x40000002);
+    hv.build = version.EAX();
+    hv.major = uint16_t(leafhv::Major::get(version));
+    hv.minor = uint16_t(leafhv::Minor::get(version));
+    const CpuidLeaf &priv = snap.get(0x40000003);
+    hv.privileges = priv.EAX() | uint64_t(priv.EBX()) << 32;
+    const CpuidLeaf &hints = snap.get(0x40000004);
+    hv.recommendations = hints.EAX();
+    hv.spinRetries = hints.EBX();
+    hv.maxVps = snap.get(0x40000005).EAX();
+    hv.hardware = snap.get(0x40000006).EAX();
+  }
+  return info;
+}
+
+VirtHints virt_hints(const HypervisorInfo &hv, const TscInfo &tsc) {
+  VirtHints hints;
+  if (!hv.present()) {
+    hints.tscStable = tsc.invariant;
+    return hints;
+  }
+
+  const KvmInfo &kvm = hv.kvm;
+  const HyperVInfo &hyperv = hv.hyperv;
+  hints.cacheCpuid = true;
+  hints.dedicatedCpus = kvm.realtime;
+  // The checks Linux makes before switching to paravirt spinlocks
+  hints.pvSpinlocks =
+      (kvm.has(KvmFeature::PvUnhalt) && !kvm.realtime) ||
+      (hyperv.present() && hyperv.has(HvPrivilege::GuestIdle) &&
+       hyperv.has(HvHint::ClusterIpi));
+  if (hyperv.present()) hints.spinRetries = hyperv.spinRetries;
+  // The invariant bit describes the host; across vCPUs and migrations the
+  // hypervisor must also vouch for its clock
+  hints.tscStable = tsc.invariant &&
+                    (kvm.has(KvmFeature::ClocksourceStable) ||
+                     hyperv.has(HvPrivilege::ReferenceTsc) ||
+                     hv.vendor == Hypervisor::VMware);
+  hints.stealTime = kvm.has(KvmFeature::StealTime);
+  // With dedicated vCPUs there is no preempted target to help
+  hints.pvTlbFlush = (kvm.has(KvmFeature::PvTlbFlush) && !kvm.realtime) ||
+                     hyperv.has(HvHint::RemoteTlbFlush);
+  hints.pvIpi = kvm.has(KvmFeature::PvSendIpi) ||
+                hyperv.has(HvHint::ClusterIpi);
+  hints.pvSchedYield = kvm.has(KvmFeature::PvSchedYield) && !kvm.realtime;
+  return hints;
+}
+
+double measure_cpuid_ns(uint32_t leaf, uint32_t subleaf, unsigned iters) {
+  constexpr unsigned kBatches = 5;
+  const unsigned perBatch = std::max(1U, iters / kBatches);
+  double best = std::numeric_limits<double>::max();
+  for (unsigned b = 0; b < kBatches; ++b) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < perBatch; ++i) {
+      unsigned eax, ebx, ecx, edx;
+      // volatile asm: never hoisted or merged
+      __cpuid_count(leaf, subleaf, eax, ebx, ecx, edx);
+    }
+    std::chrono::duration<double, std::nano> d =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count() / perBatch);
+  }
+  return best;
+}
@@ -0,0 +1,156 @@
+#ifndef HYPERVISOR_HPP
+#define HYPERVISOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "snapshot.hpp"
+#include "tsc.hpp"
+
+// Identified from the 12-byte signature at 0x40000000 (or 0x40000100)
+enum class Hypervisor : uint8_t {
+  None,  // CPUID.1:ECX[31] clear: bare metal, or a hypervisor hiding itself
+  KVM,
+  HyperV,
+  Xen,
+  VMware,
+  VirtualBox,
+  QemuTcg,
+  Bhyve,
+  Acrn,
+  Parallels,
+  Other,
+};
+std::string_view hypervisor_name(Hypervisor hv);
+
+// CPUID.40000001H:EAX bits of KVM (Linux kvm_para.h)
+enum class KvmFeature : uint8_t {
+  Clocksource = 0,
+  NopIoDelay = 1,
+  Clocksource2 = 3,
+  AsyncPf = 4,
+  StealTime = 5,
+  PvEoi = 6,
+  PvUnhalt = 7,  // halted vCPUs are kicked by hypercall: PV spinlocks
+  PvTlbFlush = 9,
+  AsyncPfVmexit = 10,
+  PvSendIpi = 11,
+  PollControl = 12,
+  PvSchedYield = 13,  // yield to a preempted vCPU instead of spinning
+  AsyncPfInt = 14,
+  MsiExtDestId = 15,
+  HcMapGpaRange = 16,
+  MigrationControl = 17,
+  ClocksourceStable = 24,  // kvmclock never goes backwards across vCPUs
+};
+
+struct KvmInfo {
+  uint32_t features = 0;  // 0x40000001 EAX
+  bool realtime = false;  // EDX[0]: vCPUs are pinned and never preempted
+
+  bool has(KvmFeature f) const { return features >> uint8_t(f) & 1; }
+};
+
+// CPUID.40000003H:EAX/EBX partition privileges (TLFS), EBX in the upper half
+enum class HvPrivilege : uint8_t {
+  VpRuntime = 0,
+  TimeRefCount = 1,
+  SynIc = 2,
+  SynTimer = 3,
+  ApicMsrs = 4,
+  Hypercall = 5,
+  VpIndex = 6,
+  Reset = 7,
+  ReferenceTsc = 9,  // TSC page: a clock read without an exit
+  GuestIdle = 10,
+  FrequencyMsrs = 11,
+  Reenlightenment = 13,  // notified when migration changes the TSC rate
+};
+
+// CPUID.40000004H:EAX implementation recommendations
+enum class HvHint : uint8_t {
+  AddressSpaceSwitch = 0,
+  LocalTlbFlush = 1,
+  RemoteTlbFlush = 2,  // flush other vCPUs by hypercall, not by IPI
+  ApicMsrs = 3,
+  ResetMsr = 4,
+  RelaxedTiming = 5,  // do not expect watchdog-accurate timing
+  DeprecateAutoEoi = 9,
+  ClusterIpi = 10,
+  ExProcessorMasks = 11,
+  NestedHypervisor = 12,  // this Hyper-V itself runs nested
+  EnlightenedVmcs = 14,
+};
+
+struct HyperVInfo {
+  uint32_t interface = 0;  // 0x40000001 EAX, "Hv#1"
+  uint16_t major = 0;      // 0x40000002 EBX
+  uint16_t minor = 0;
+  uint32_t build = 0;         // 0x40000002 EAX
+  uint64_t privileges = 0;    // 0x40000003 EAX | EBX << 32
+  uint32_t recommendations = 0;  // 0x40000004 EAX
+  // Spins before a lock waiter notifies the hypervisor; kNeverNotify when
+  // it should keep spinning
+  uint32_t spinRetries = 0;  // 0x40000004 EBX
+  uint32_t maxVps = 0;       // 0x40000005 EAX
+  uint32_t hardware = 0;     // 0x40000006 EAX, host features in use
+
+  static constexpr uint32_t kNeverNotify = 0xFFFFFFFF;
+
+  bool present() const { return interface == 0x31237648; }  // "Hv#1"
+  bool has(HvPrivilege p) const { return privileges >> uint8_t(p) & 1; }
+  bool has(HvHint h) const { return recommendations >> uint8_t(h) & 1; }
+};
+
+struct HypervisorInfo {
+  Hypervisor vendor = Hypervisor::None;
+  std::array<char, 12> signature{};
+  uint32_t base = 0;     // first leaf of the vendor's range
+  uint32_t maxLeaf = 0;  // highest leaf of that range
+  KvmInfo kvm;
+  // Hyper-V itself, or the enlightenments KVM and Xen offer at 0x40000000
+  HyperVInfo hyperv;
+  uint16_t xenMajor = 0;
+  uint16_t xenMinor = 0;
+
+  bool present() const { return vendor != Hypervisor::None; }
+  std::string_view signatureView() const {
+    std::string_view s(signature.data(), signature.size());
+    return s.substr(0, s.find('\0'));
+  }
+};
+
+HypervisorInfo decode_hypervisor(const CpuidSnapshot &snap);
+
+// What to do differently on this (virtual) machine. Each hint comes from
+// what the hypervisor advertises; nothing is measured here.
+struct VirtHints {
+  // Every `cpuid` exits to the hypervisor: read leaves once (snapshot,
+  // shared segment) instead of executing `cpuid` on hot paths
+  bool cacheCpuid = false;
+  // A lock holder's vCPU can be descheduled: spin briefly, then block or
+  // yield through the hypervisor rather than spinning out the time slice
+  bool pvSpinlocks = false;
+  // vCPUs are dedicated to physical CPUs: plain spinning is fine
+  bool dedicatedCpus = false;
+  // TSC rate constant and consistent across vCPUs (and migrations): rdtsc
+  // can back a clock
+  bool tscStable = false;
+  // The guest can see time stolen by other guests
+  bool stealTime = false;
+  bool pvTlbFlush = false;
+  bool pvIpi = false;
+  bool pvSchedYield = false;
+  // Hyper-V spin count before notifying; 0 when not advised
+  uint32_t spinRetries = 0;
+};
+
+VirtHints virt_hints(const HypervisorInfo &hv, const TscInfo &tsc);
+
+// Mean nanoseconds per `cpuid` of (leaf, subleaf) on the calling CPU, the
+// best of a few batches. Under a hypervisor this is the trap round trip.
+double measure_cpuid_ns(uint32_t leaf, uint32_t subleaf = 0,
+                        unsigned iters = 2000);
+
+#endif  // HYPERVISOR_HPP
@@ -0,0 +1,154 @@
+#include "kernels.hpp"
+
+#include <immintrin.h>
+
+#include <cstring>
+
+#include "cpuinfo.hpp"
+
+namespace kernels {
+
+uint64_t popcount_scalar(const uint8_t *data, size_t n) {
+  uint64_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    // Kernighan's loop: no POPCNT instruction at the baseline ISA
+    for (uint8_t b = data[i]; b; b &= b - 1) ++count;
+  }
+  return count;
+}
+
+__attribute__((target("sse4.2,popcnt"))) uint64_t popcount_sse42(
+    const uint8_t *data, size_t n) {
+  uint64_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    count += _mm_popcnt_u64(word);
+  }
+  for (; i < n; ++i) count += _mm_popcnt_u32(data[i]);
+  return count;
+}
+
+// Nibble lookup through VPSHUFB, summed with VPSADBW (Mula et al.)
+__attribute__((target("avx2,popcnt"))) uint64_t popcount_avx2(
+    const uint8_t *data, size_t n) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(
+        lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(
+        acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  uint64_t count = uint64_t(_mm256_extract_epi64(acc, 0)) +
+                   uint64_t(_mm256_extract_epi64(acc, 1)) +
+                   uint64_t(_mm256_extract_epi64(acc, 2)) +
+                   uint64_t(_mm256_extract_epi64(acc, 3));
+  for (; i < n; ++i) count += _mm_popcnt_u32(data[i]);
+  return count;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) uint64_t
+popcount_avx512(const uint8_t *data, size_t n) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i v = _mm512_loadu_si512(data + i);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+  }
+  uint64_t count = _mm512_reduce_add_epi64(acc);
+  for (; i < n; ++i) count += _mm_popcnt_u32(data[i]);
+  return count;
+}
+
+uint64_t sum_scalar(const uint32_t *data, size_t n) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < n; ++i) total += data[i];
+  return total;
+}
+
+// PMOVZXDQ is SSE4.1; grouped with the SSE4.2 tier
+__attribute__((target("sse4.2"))) uint64_t sum_sse42(const uint32_t *data,
+                                                     size_t n) {
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data + i));
+    acc = _mm_add_epi64(acc, _mm_cvtepu32_epi64(v));
+  }
+  uint64_t total = uint64_t(_mm_extract_epi64(acc, 0)) +
+                   uint64_t(_mm_extract_epi64(acc, 1));
+  for (; i < n; ++i) total += data[i];
+  return total;
+}
+
+__attribute__((target("avx2"))) uint64_t sum_avx2(const uint32_t *data,
+                                                  size_t n) {
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(v));
+  }
+  uint64_t total = uint64_t(_mm256_extract_epi64(acc, 0)) +
+                   uint64_t(_mm256_extract_epi64(acc, 1)) +
+                   uint64_t(_mm256_extract_epi64(acc, 2)) +
+                   uint64_t(_mm256_extract_epi64(acc, 3));
+  for (; i < n; ++i) total += data[i];
+  return total;
+}
+
+__attribute__((target("avx512f"))) uint64_t sum_avx512(const uint32_t *data,
+                                                       size_t n) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    acc = _mm512_add_epi64(acc, _mm512_cvtepu32_epi64(v));
+  }
+  uint64_t total = _mm512_reduce_add_epi64(acc);
+  for (; i < n; ++i) total += data[i];
+  return total;
+}
+
+// Best first; the last entry is the baseline
+static constexpr KernelImpl<PopcountFn> kPopcountImpls[] = {
+    {"avx512",
+     {Feature::AVX512F, Feature::AVX512_VPOPCNTDQ, Feature::POPCNT},
+     popcount_avx512},
+    {"avx2", {Feature::AVX2, Feature::POPCNT}, popcount_avx2},
+    {"sse4.2", {Feature::SSE42, Feature::POPCNT}, popcount_sse42},
+    {"scalar", {}, popcount_scalar},
+};
+static constexpr KernelImpl<SumFn> kSumImpls[] = {
+    {"avx512", {Feature::AVX512F}, sum_avx512},
+    {"avx2", {Feature::AVX2}, sum_avx2},
+    {"sse4.2", {Feature::SSE41, Feature::SSE42}, sum_sse42},
+    {"scalar", {}, sum_scalar},
+};
+
+// Features whose register state the OS enabled, rather than the raw
+// CPUID bits; asked for on the first kernel call, not at load time
+static FeatureSet usable_features() {
+  return CPUInfo::host().usableFeatures();
+}
+
+constinit Dispatcher<PopcountFn> popcount_dispatch{kPopcountImpls,
+                                                   usable_features};
+constinit Dispatcher<SumFn> sum_dispatch{kSumImpls, usable_features};
+
+void resolve(const FeatureSet &features) {
+  popcount_dispatch.resolve(features);
+  sum_dispatch.resolve(features);
+}
+
+}  // namespace kernels
@@ -0,0 +1,43 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "dispatch.hpp"
+
+// Sample buffer kernels with scalar / SSE4.2 / AVX2 / AVX-512 variants,
+// selected on first use from CPUInfo::host().usableFeatures().
+namespace kernels {
+
+using PopcountFn = uint64_t(const uint8_t *data, size_t n);
+using SumFn = uint64_t(const uint32_t *data, size_t n);
+
+// Individual variants, for benchmarks and direct calls
+uint64_t popcount_scalar(const uint8_t *data, size_t n);
+uint64_t popcount_sse42(const uint8_t *data, size_t n);
+uint64_t popcount_avx2(const uint8_t *data, size_t n);
+uint64_t popcount_avx512(const uint8_t *data, size_t n);
+uint64_t sum_scalar(const uint32_t *data, size_t n);
+uint64_t sum_sse42(const uint32_t *data, size_t n);
+uint64_t sum_avx2(const uint32_t *data, size_t n);
+uint64_t sum_avx512(const uint32_t *data, size_t n);
+
+extern Dispatcher<PopcountFn> popcount_dispatch;
+extern Dispatcher<SumFn> sum_dispatch;
+
+// Number of set bits in `n` bytes
+inline uint64_t popcount(const uint8_t *data, size_t n) {
+  return popcount_dispatch(data, n);
+}
+// Sum of `n` 32-bit values, widened to 64 bits
+inline uint64_t sum(const uint32_t *data, size_t n) {
+  return sum_dispatch(data, n);
+}
+
+// Re-selects every kernel for `features`, e.g. to force a narrower tier
+void resolve(const FeatureSet &features);
+
+}  // namespace kernels
+
+#endif  // KERNELS_HPP
@@ -1,30 +1,45 @@
-#include <cpuid.h>
 #include <fmt/ranges.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <charconv>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <thread>
+#include <tuple>
 #include <vector>
 // use qstring in qt6
 #include <QString>
 
-#include "cpuid.hpp"
+#include "backend.hpp"
+#include "cache.hpp"
+#include "cpuinfo.hpp"
+#include "features.hpp"
+#include "fleet.hpp"
+#include "hybrid.hpp"
+#include "hypervisor.hpp"
+#include "percpu.hpp"
+#include "pmu.hpp"
+#include "rdt.hpp"
+#include "report.hpp"
+#include "resctrl.hpp"
+#include "shared_snapshot.hpp"
+#include "simd.hpp"
+#include "snapshot.hpp"
+#include "snapshot_file.hpp"
+#include "topology.hpp"
+#include "tsc.hpp"
+#include "uarch.hpp"
 #include "utils.hpp"
+#include "watch.hpp"
+#include "xsave.hpp"
 
-#define MAX_INTEL_TOP_LVL 4
-
-static inline void do_cpuid(uint32_t selector, uint32_t *data) {
-  __asm__ volatile("cpuid"
-                   : "=a"(data[0]), "=b"(data[1]), "=c"(data[2]), "=d"(data[3])
-                   : "a"(selector), "b"(0), "c"(0), "d"(0));
-}
-auto cpuid_fn(uint32_t selector, uint32_t *result) {
-  do_cpuid(selector, result);
-  printf("cpuid_fn(0x%08x) eax:0x%08x ebx:0x%08x ecx:0x%08x edx:0x%08x\n",
-         selector, result[0], result[1], result[2], result[3]);
-}
 struct CPUVendorID {
   unsigned int ebx;
   unsigned int edx;
@@ -34,8 +49,8 @@ struct CPUVendorID {
     return std::string(reinterpret_cast<const char *>(this), 12);
   }
 };
-auto vendor() {
-  CPUID cpuID(0);  // Get CPU vendor
+auto vendor(const CpuidSnapshot &snap) {
+  const CpuidLeaf &cpuID = snap.get(0x0);  // Get CPU vendor
   // store vendor in C char array
   char vendor_c[12];
 
@@ -52,157 +67,20 @@ auto vendor() {
   std::cout << std::format("vendor ecx: {}\n", cpuID.ECX());
   std::cout << std::format("vendor edx: {}\n", cpuID.EDX());
 
-  //
-  unsigned int level = 0;
-  unsigned int eax = 0;
-  unsigned int ebx;
-  unsigned int ecx;
-  unsigned int edx;
-  __get_cpuid(level, &eax, &ebx, &ecx, &edx);
-
-  CPUVendorID vendorID{.ebx = ebx, .edx = edx, .ecx = ecx};
+  CPUVendorID vendorID{
+      .ebx = cpuID.EBX(), .edx = cpuID.EDX(), .ecx = cpuID.ECX()};
 
   auto vendorIDString = vendorID.toString();
   std::cout << std::format("vendorIDString: {}\n", vendorIDString);
 }
-class CPUInfo {
- public:
-  CPUInfo();
-  std::string vendor() const { return mVendorId; }
-  std::string model() const { return mModelName; }
-  int cores() const { return mNumCores; }
-  float cpuSpeedInMHz() const { return mCPUMHz; }
-  bool isSSE() const { return mIsSSE; }
-  bool isSSE2() const { return mIsSSE2; }
-  bool isSSE3() const { return mIsSSE3; }
-  bool isSSE41() const { return mIsSSE41; }
-  bool isSSE42() const { return mIsSSE42; }
-  bool isAVX() const { return mIsAVX; }
-  bool isAVX2() const { return mIsAVX2; }
-  bool isHyperThreaded() const { return mIsHTT; }
-  int logicalCpus() const { return mNumLogCpus; }
-
- private:
-  // Bit positions for data extractions
-  static const uint32_t SSE_POS = 0x02000000;
-  static const uint32_t SSE2_POS = 0x04000000;
-  static const uint32_t SSE3_POS = 0x00000001;
-  static const uint32_t SSE41_POS = 0x00080000;
-  static const uint32_t SSE42_POS = 0x00100000;
-  static const uint32_t AVX_POS = 0x10000000;
-  static const uint32_t AVX2_POS = 0x00000020;
-  static const uint32_t LVL_NUM = 0x000000FF;
-  static const uint32_t LVL_TYPE = 0x0000FF00;
-  static const uint32_t LVL_CORES = 0x0000FFFF;
-
-  // Attributes
-  std::string mVendorId;
-  std::string mModelName;
-  int mNumSMT;
-  int mNumCores;
-  int mNumLogCpus;
-  float mCPUMHz;
-  bool mIsHTT;
-  bool mIsSSE;
-  bool mIsSSE2;
-  bool mIsSSE3;
-  bool mIsSSE41;
-  bool mIsSSE42;
-  bool mIsAVX;
-  bool mIsAVX2;
-};
-// https://gist.github.com/9prady9/a5e1e8bdbc9dc58b3349
-CPUInfo::CPUInfo() {
-  // Get vendor name EAX=0
-  CPUID2 cpuID0(0, 0);
-  uint32_t HFS = cpuID0.EAX();
-  mVendorId += std::string((const char *)&cpuID0.EBX(), 4);
-  mVendorId += std::string((const char *)&cpuID0.EDX(), 4);
-  mVendorId += std::string((const char *)&cpuID0.ECX(), 4);
-  // Get SSE instructions availability
-  CPUID2 cpuID1(0x1, 0);
-  mIsHTT = cpuID1.EDX() & AVX_POS;
-  mIsSSE = cpuID1.EDX() & SSE_POS;
-  mIsSSE2 = cpuID1.EDX() & SSE2_POS;
-  mIsSSE3 = cpuID1.ECX() & SSE3_POS;
-  mIsSSE41 = cpuID1.ECX() & SSE41_POS;
-  mIsSSE42 = cpuID1.ECX() & SSE41_POS;
-  mIsAVX = cpuID1.ECX() & AVX_POS;
-  // Get AVX2 instructions availability
-  CPUID2 cpuID7(7, 0);
-  mIsAVX2 = cpuID7.EBX() & AVX2_POS;
-
-  std::string upVId = mVendorId;
-  for_each(upVId.begin(), upVId.end(), [](char &in) { in = ::toupper(in); });
-  // Get num of cores
-  if (upVId.find("INTEL") != std::string::npos) {
-    if (HFS >= 11) {
-      for (int lvl = 0; lvl < MAX_INTEL_TOP_LVL; ++lvl) {
-        CPUID2 cpuID4(0x0B, lvl);
-        uint32_t currLevel = (LVL_TYPE & cpuID4.ECX()) >> 8;
-        switch (currLevel) {
-          case 0x01:
-            mNumSMT = LVL_CORES & cpuID4.EBX();
-            break;
-          case 0x02:
-            mNumLogCpus = LVL_CORES & cpuID4.EBX();
-            break;
-          default:
-            break;
-        }
-      }
-      mNumCores = mNumLogCpus / mNumSMT;
-    } else {
-      if (HFS >= 1) {
-        mNumLogCpus = (cpuID1.EBX() >> 16) & 0xFF;
-        if (HFS >= 4) {
-          mNumCores = 1 + (CPUID2(4, 0).EAX() >> 26) & 0x3F;
-        }
-      }
-      if (mIsHTT) {
-        if (!(mNumCores > 1)) {
-          mNumCores = 1;
-          mNumLogCpus = (mNumLogCpus >= 2 ? mNumLogCpus : 2);
-        }
-      } else {
-        mNumCores = mNumLogCpus = 1;
-      }
-    }
-  } else if (upVId.find("AMD") != std::string::npos) {
-    if (HFS >= 1) {
-      mNumLogCpus = (cpuID1.EBX() >> 16) & 0xFF;
-      if (CPUID2(0x80000000, 0).EAX() >= 8) {
-        mNumCores = 1 + (CPUID2(0x80000008, 0).ECX() & 0xFF);
-      }
-    }
-    if (mIsHTT) {
-      if (!(mNumCores > 1)) {
-        mNumCores = 1;
-        mNumLogCpus = (mNumLogCpus >= 2 ? mNumLogCpus : 2);
-      }
-    } else {
-      mNumCores = mNumLogCpus = 1;
-    }
-  } else {
-    std::cout << "Unexpected vendor id\n";
-  }
-  // Get processor brand string
-  // This seems to be working for both Intel & AMD vendors
-  for (int i = 0x80000002; i < 0x80000005; ++i) {
-    CPUID2 cpuID(i, 0);
-    mModelName += std::string((const char *)&cpuID.EAX(), 4);
-    mModelName += std::string((const char *)&cpuID.EBX(), 4);
-    mModelName += std::string((const char *)&cpuID.ECX(), 4);
-    mModelName += std::string((const char *)&cpuID.EDX(), 4);
-  }
-}
-auto test_cpuinfo() {
-  CPUInfo cinfo;
+auto test_cpuinfo(const CpuidSnapshot &snap) {
+  CPUInfo cinfo(snap);
 
   std::cout << std::format("CPU vendor = {}\n", cinfo.vendor());
   std::cout << std::format("CPU Brand String = {}\n", cinfo.model());
   std::cout << std::format("# of cores = {}\n", cinfo.cores());
   std::cout << std::format("# of logical cores = {}\n", cinfo.logicalCpus());
+  std::cout << std::format("CPU speed = {} MHz\n", cinfo.cpuSpeedInMHz());
   std::cout << std::format("Is CPU Hyper threaded = {}\n",
                            cinfo.isHyperThreaded());
   std::cout << std::format("CPU SSE = {}\n ", cinfo.isSSE());
@@ -213,18 +91,6 @@ auto test_cpuinfo() {
   std::cout << std::format("CPU AVX = {}\n", cinfo.isAVX());
   std::cout << std::format("CPU AVX2 = {}\n", cinfo.isAVX2());
 }
-static void cpuid_set_generic_info() {
-  uint32_t reg[4];
-  char str[128], *p;
-
-  /* do cpuid 0 to get vendor */
-  char cpuid_vendor[16];
-  cpuid_fn(0, reg);
-  // bcopy((char *)&reg[ebx], cpuid_vendor[0], 4); /* ug */
-  // bcopy((char *)&reg[ecx], cpuid_vendor[8], 4);
-  // bcopy((char *)&reg[edx], cpuid_vendor[4], 4);
-  // cpuid_vendor[12] = 0;
-}
 #define MAX_DIGITS 15
 auto test_char() {
   int n = 9876;  // number to be converted
@@ -241,15 +107,15 @@ auto test_char() {
 auto num_to_byte_arr(int num) {
   return std::string((const char *)num, sizeof num);
 }
-auto test_hybrid_flag() {
+auto test_hybrid_flag(const PerCpuSnapshot &all) {
   // The Hybrid Flag can be obtained by calling CPUID with the value “07H” in
   // the EAX register and reading the 15th bit of the EDX register.
   // If the bit is set, the processor supports the Hybrid feature.
   // If 1, the processor is identified as a hybrid part. Additionally, on
   // hybrid parts (CPUID.07H.0H:EDX[15]=1), software must consult the native
   // model ID and core type from the Hybrid Information Enumeration Leaf.
-  CPUID2 cpuID(0x07, 0);
-  std::cout << std::format("Hybrid Flag = {}\n", (cpuID.EDX() >> 15) & 0x1);
+  CoreTypeMap types(all);
+  std::cout << std::format("Hybrid Flag = {}\n", types.isHybrid());
 
   // The Core Type Flag can be obtained by calling CPUID on each logical
   // processor with a value of “1AH” in the EAX register; this will return each
@@ -260,13 +126,229 @@ auto test_hybrid_flag() {
   // However, the return value for Core Type does not differentiate between
   // physical and SMT cores for Intel Core processor. Both will be represented
   // as Intel Core (40H).
-  CPUID2 cpuID2(0x1A, 0);
-  std::cout << std::format("{}\n", cpuID2.EAX());
-  std::cout << std::format("Core Type = {}\n", (cpuID2.EAX() >> 24) & 0xFF);
-  std::cout << std::format("Core Type = {}\n",
-                           extract_bits(cpuID2.EAX(), 24, 31));
+  static constexpr const char *kClasses[] = {"Unknown", "P-core", "E-core"};
+  for (size_t i = 0; i < all.size(); ++i) {
+    int cpu = all.cpu(i);
+    std::cout << std::format("cpu {}: Core Type = {}, native model {:#X}\n",
+                             cpu, kClasses[size_t(types.classOf(cpu))],
+                             types.nativeModelId(cpu));
+  }
+  std::cout << std::format(
+      "P-cores = {}, E-cores = {}\n",
+      types.cpuset(CoreClass::Performance).count(),
+      types.cpuset(CoreClass::Efficient).count());
+}
+// Scan every logical CPU concurrently and show the per-CPU APIC IDs
+auto test_per_cpu(const PerCpuSnapshot &all) {
+  std::cout << std::format("per-CPU scan: {} CPUs, {} threads, {} us\n",
+                           all.size(), all.threads(),
+                           all.wallTime().count() / 1000);
+  for (size_t i = 0; i < all.size(); ++i) {
+    std::cout << std::format("cpu {}: x2APIC ID = {:#X}\n", all.cpu(i),
+                             all[i].get(0xB).EDX());
+  }
+}
+auto test_topology(const PerCpuSnapshot &all) {
+  Topology topo(all);
+  static constexpr const char *kLevels[] = {"SMT",  "Core", "Module",
+                                            "Tile", "Die",  "Package"};
+  for (size_t l = 0; l < kTopoLevels; ++l) {
+    std::cout << std::format("{}: shift {}, {} domains\n", kLevels[l],
+                             topo.shift(TopoLevel(l)),
+                             topo.count(TopoLevel(l)));
+  }
+  for (size_t i = 0; i < topo.size(); ++i) {
+    const LogicalCpu &c = topo[i];
+    std::cout << std::format(
+        "cpu {}: pkg {} die {} tile {} module {} core {} smt {}, "
+        "{} L3 siblings\n",
+        c.cpu, c.ids[5], c.ids[4], c.ids[3], c.ids[2], c.ids[1], c.ids[0],
+        topo.cacheSiblings(c.cpu, 3).count());
+  }
+}
+auto test_tsc(const CpuidSnapshot &snap) {
+  TscInfo info = decode_tsc(snap);
+  std::cout << std::format("invariant TSC = {}\n", info.invariant);
+  std::cout << std::format("TSC/crystal = {}/{}, crystal = {} Hz\n",
+                           info.ratioNumerator, info.ratioDenominator,
+                           info.crystalHz);
+  std::cout << std::format("base = {} MHz, max = {} MHz, bus = {} MHz\n",
+                           info.baseMHz, info.maxMHz, info.busMHz);
+  const TscClock &clock = TscClock::host();
+  std::cout << std::format("TSC = {} Hz (source {}), RDTSCP {}\n",
+                           clock.tscHz(), int(clock.source()),
+                           clock.hasRdtscp());
+  if (!clock.invariant()) {
+    std::cout << "TSC is not invariant: now_ns() drifts with frequency\n";
+  }
+}
+auto test_hypervisor(const CpuidSnapshot &snap, bool live) {
+  const HypervisorInfo hv = decode_hypervisor(snap);
+  std::cout << std::format("hypervisor = {} \"{}\", leaves {:#x}..{:#x}\n",
+                           hypervisor_name(hv.vendor), hv.signatureView(),
+                           hv.base, hv.maxLeaf);
+  if (hv.vendor == Hypervisor::KVM) {
+    std::cout << std::format(
+        "KVM features = {:#x}: PV_UNHALT {}, PV_SCHED_YIELD {}, steal time "
+        "{}, stable clock {}, realtime {}\n",
+        hv.kvm.features, hv.kvm.has(KvmFeature::PvUnhalt),
+        hv.kvm.has(KvmFeature::PvSchedYield),
+        hv.kvm.has(KvmFeature::StealTime),
+        hv.kvm.has(KvmFeature::ClocksourceStable), hv.kvm.realtime);
+  }
+  if (hv.hyperv.present()) {
+    std::cout << std::format(
+        "Hyper-V {}.{} build {}: privileges {:#x}, recommendations {:#x}, "
+        "spin retries {:#x}\n",
+        hv.hyperv.major, hv.hyperv.minor, hv.hyperv.build,
+        hv.hyperv.privileges, hv.hyperv.recommendations,
+        hv.hyperv.spinRetries);
+  }
+  const VirtHints hints = virt_hints(hv, decode_tsc(snap));
+  std::cout << std::format(
+      "hints: cache cpuid {}, PV spinlocks {}, dedicated CPUs {}, stable TSC "
+      "{}\n",
+      hints.cacheCpuid, hints.pvSpinlocks, hints.dedicatedCpus,
+      hints.tscStable);
+  // A recorded machine's trap cost cannot be measured from here
+  if (live) {
+    std::cout << std::format("cpuid cost: leaf 0x0 {:.0f} ns, leaf 0x1 {:.0f} "
+                             "ns\n",
+                             measure_cpuid_ns(0x0), measure_cpuid_ns(0x1));
+  }
 }
-auto cpuid_01H() {
+auto test_pmu(const CpuidSnapshot &snap) {
+  const PmuInfo pmu = decode_pmu(snap);
+  if (!pmu.present()) {
+    std::cout << "PMU = none reported\n";
+    return;
+  }
+  std::cout << std::format(
+      "PMU v{}: {} general counters x {} bits (mask {:#x}), {} fixed x {} "
+      "bits (mask {:#x})\n",
+      pmu.version, pmu.gpCounters, pmu.gpWidth, pmu.gpMask,
+      pmu.fixedCounters, pmu.fixedWidth, pmu.fixedMask);
+  std::string events;
+  for (size_t i = 0; i < kPmuEventCount; ++i) {
+    if (!pmu.has(PmuEvent(i))) continue;
+    if (!events.empty()) events += ' ';
+    events += pmu_event_name(PmuEvent(i));
+  }
+  std::cout << std::format("PMU events = {}\n", events);
+}
+auto test_rdt(const CpuidSnapshot &snap) {
+  const RdtInfo rdt = decode_rdt(snap);
+  if (!rdt.present()) {
+    std::cout << "RDT = none reported\n";
+    return;
+  }
+  const RdtMonitoring &mon = rdt.monitoring;
+  std::cout << std::format(
+      "RDT monitoring: occupancy {}, total BW {}, local BW {}, RMIDs {}, "
+      "{} B/unit, {}-bit counters\n",
+      mon.l3Occupancy, mon.l3TotalBandwidth, mon.l3LocalBandwidth,
+      mon.l3MaxRmid + 1, mon.upscale, mon.counterWidth);
+  for (const auto &[name, cat] :
+       {std::pair{"L3", rdt.l3}, std::pair{"L2", rdt.l2}}) {
+    if (!cat.present()) continue;
+    std::cout << std::format(
+        "RDT {} CAT: {}-bit mask, shared {:#x}, {} CLOS, CDP {}\n", name,
+        cat.cbmLength, cat.sharedMask, cat.closCount, cat.cdp);
+  }
+  if (rdt.bandwidth.present()) {
+    std::cout << std::format("RDT MBA: max {} ({}), {} CLOS\n",
+                             rdt.bandwidth.maxThrottle,
+                             rdt.bandwidth.absolute ? "1/8 GB/s units"
+                                                    : "throttle",
+                             rdt.bandwidth.closCount);
+  }
+}
+// Lists the resctrl groups under ROOT with their masks and L3 counters
+static int run_resctrl(const std::string &root) {
+  std::optional<Resctrl> resctrl = Resctrl::open(root);
+  if (!resctrl) {
+    std::cerr << std::format("{}: resctrl not mounted\n", root);
+    return 1;
+  }
+  std::cout << std::format("{}: cbm_mask {:#x}, shareable {:#x}, {} CLOSIDs, "
+                           "{} L3 domains\n",
+                           root, resctrl->l3().cbmMask,
+                           resctrl->l3().shareableBits,
+                           resctrl->l3().numClosids,
+                           resctrl->domains().size());
+  std::vector<std::string> groups = resctrl->groups();
+  groups.insert(groups.begin(), "");
+  for (const std::string &group : groups) {
+    std::cout << std::format("{}: mask {:#x}, {} tasks\n",
+                             group.empty() ? "(default)" : group,
+                             resctrl->mask(group).value_or(0),
+                             resctrl->tasks(group).size());
+    for (const ResctrlUsage &u : resctrl->usage(group)) {
+      std::cout << std::format(
+          "  L3 {}: occupancy {} KiB, total {} MiB, local {} MiB\n",
+          u.domain, u.llcOccupancyBytes >> 10, u.mbmTotalBytes >> 20,
+          u.mbmLocalBytes >> 20);
+    }
+  }
+  return 0;
+}
+auto test_xsave(const CpuidSnapshot &snap, const XsaveInfo &xsave) {
+  std::cout << std::format(
+      "OSXSAVE = {}, XCR0 = {:#x} ({}), permitted = {:#x}\n", xsave.osxsave,
+      xsave.xcr0, xsave.xcr0Read ? "xgetbv" : "estimated", xsave.permitted);
+  std::cout << std::format("XSAVE area: {} B enabled, {} B max\n",
+                           xsave.enabledSize, xsave.maxSize);
+  for (unsigned i = 2; i < xsave.components.size(); ++i) {
+    const XStateComponent &c = xsave.components[i];
+    if (!c.size) continue;
+    std::cout << std::format("  {:2} {:10} {:5} B at {:5}{}{}\n", i,
+                             xstate_name(i), c.size, c.offset,
+                             c.supervisor ? " supervisor" : "",
+                             xsave.usable() >> i & 1 ? " usable" : "");
+  }
+  const FeatureSet usable = usable_features(FeatureSet(snap), xsave);
+  for (size_t t = 1; t < std::size(kTierState); ++t) {
+    std::cout << std::format(
+        "{:6} state: {:5} B standard, {:5} B compacted\n",
+        tier_name(VectorTier(t)), xsave.standardSize(kTierState[t]),
+        xsave.compactedSize(kTierState[t]));
+  }
+  std::cout << std::format("widest usable tier = {}\n",
+                           tier_name(widest_tier(usable)));
+}
+auto test_simd(const CPUInfo &cinfo) {
+  const SimdCaps &caps = cinfo.simd();
+  std::cout << std::format("AVX-512 F/BW/VL/VNNI/BF16/FP16/VBMI2 = "
+                           "{}/{}/{}/{}/{}/{}/{}\n",
+                           cinfo.isAVX512F(), cinfo.isAVX512BW(),
+                           cinfo.isAVX512VL(), cinfo.isAVX512VNNI(),
+                           cinfo.isAVX512BF16(), cinfo.isAVX512FP16(),
+                           cinfo.isAVX512VBMI2());
+  std::cout << std::format("AVX10 version {}, up to {} bits\n",
+                           caps.avx10.version, caps.avx10.maxBits());
+  const AmxPalette &p = caps.amx.palette();
+  std::cout << std::format(
+      "AMX: {} palettes, {} tiles of {} rows x {} B ({} B), TMUL K {} N {}\n",
+      caps.amx.paletteCount, p.maxNames, p.maxRows, p.bytesPerRow,
+      p.bytesPerTile, caps.amx.tmulMaxK, caps.amx.tmulMaxN);
+
+  // An int8 dot-product kernel with AMX, AVX-512 VNNI, AVX-VNNI and SSE
+  // variants, best first
+  static const KernelVariant kDot[] = {
+      {VectorTier::AMX, {Feature::AMX_INT8}},
+      {VectorTier::AVX512, {Feature::AVX512_VNNI, Feature::AVX512BW}},
+      {VectorTier::AVX, {Feature::AVX_VNNI, Feature::AVX2}},
+      {VectorTier::SSE, {Feature::SSSE3}},
+      {VectorTier::Scalar, {}},
+  };
+  for (KernelLoad load : {KernelLoad::Light, KernelLoad::Heavy}) {
+    SimdAdvice a = advise(caps, kDot, load);
+    std::cout << std::format("int8 dot ({}): {} at {} bits, {}\n",
+                             load == KernelLoad::Heavy ? "heavy" : "light",
+                             tier_name(a.tier), a.vectorBits, a.reason);
+  }
+}
+auto cpuid_01H(const CpuidSnapshot &snap) {
   // EAX=01H
   // EAX
   // Type, Family, Model, and Stepping ID
@@ -278,95 +360,40 @@ auto cpuid_01H() {
   // Stepping ID is bits 0 - 3.
   // Extended Model ID: bits 16 - 19
   // Extended Family ID: bits 20 - 27
-  CPUID2 cpuID(0x01, 0);
-  std::cout << std::format("Type = {:#X}\n", extract_bits(cpuID.EAX(), 12, 13));
-  std::cout << std::format("Family = {:#X}\n",
-                           extract_bits(cpuID.EAX(), 8, 11));
-  std::cout << std::format("Model = {:#X}\n", extract_bits(cpuID.EAX(), 4, 7));
+  const CpuidLeaf &cpuID = snap.get(0x01);
+  std::cout << std::format("Type = {:#X}\n", leaf1::Type::get(cpuID));
+  std::cout << std::format("Family = {:#X}\n", leaf1::Family::get(cpuID));
+  std::cout << std::format("Model = {:#X}\n", leaf1::Model::get(cpuID));
   std::cout << std::format("Stepping ID = {:#X}\n",
-                           extract_bits(cpuID.EAX(), 0, 3));
+                           leaf1::Stepping::get(cpuID));
   std::cout << std::format("Extended Model ID = {:#X}\n",
-                           extract_bits(cpuID.EAX(), 16, 19));
+                           leaf1::ExtendedModel::get(cpuID));
   std::cout << std::format("Extended Family ID = {:#X}\n",
-                           extract_bits(cpuID.EAX(), 20, 27));
-  auto real_model = (extract_bits(cpuID.EAX(), 16, 19) << 4) |
-                    extract_bits(cpuID.EAX(), 4, 7);
-  std::cout << std::format("Real Model = {:#X}\n", real_model);
+                           leaf1::ExtendedFamily::get(cpuID));
+  std::cout << std::format("Real Model = {:#X}\n", leaf1::real_model(cpuID));
+  const Uarch *uarch = find_uarch(snap);
+  std::cout << std::format("Microarchitecture = {} ({})\n",
+                           uarch ? uarch->name : "unknown",
+                           uarch ? uarch->core : "unknown");
 
   // EBX
   // Bits 07-00: Brand Index.
   // Bits 15-08: CLFLUSH line size (Value ∗ 8 = cache line size in bytes; used
   // also by CLFLUSHOPT). Bits 23-16: Maximum number of addressable IDs for
   // logical processors in this physical package*. Bits 31-24: Initial APIC ID**
-  auto apic_id = extract_bits(cpuID.EBX(), 24, 31);
-  std::cout << std::format("APIC ID = {:#X}\n", apic_id);
+  std::cout << std::format("CLFLUSH line size = {} bytes\n",
+                           leaf1::ClflushLineSize::get(cpuID) * 8);
+  std::cout << std::format("APIC ID = {:#X}\n",
+                           leaf1::InitialApicId::get(cpuID));
 
-  // ECX Feature Information
-  // Bit 0: SSE3
-  // Bit 1: PCLMULQDQ
-  // Bit 2: DTEST64
-  // Bit 3: MONITOR
-  // Bit 4: DS-CPL
-  // Bit 5: VMX
-  // Bit 6: SMX
-  // Bit 7: EIST
-  // Bit 8: TM2
-  // Bit 9: SSSE3
-  // Bit 10: CNXT-ID
-  // Bit 11: SDBG
-  // Bit 12: FMA
-  // Bit 13: CMPXCHG16B
-  // Bit 14: xTPR Update Control
-  // Bit 15: PDCM
-  // 16 Reserved Reserved
-  // Bit 17: PCID
-  // Bit 18: DCA
-  // Bit 19: SSE4.1
-  // Bit 20: SSE4.2
-  // Bit 21: x2APIC
-  // Bit 22: MOVBE
-  // Bit 23: POPCNT
-  // Bit 24: TSC-Deadline
-  // 25 AESNI
-  // 26 XSAVE
-  // 27 OSXSAVE
-  // 28 AVX
-  // 29 F16C
-  // 30 RDRAND
-  // 31 Not Used Always returns 0.
-  std::cout << std::format("SSE3 = {}\n", extract_bits(cpuID.ECX(), 0, 0));
-  std::cout << std::format("PCLMULQDQ = {}\n", (cpuID.ECX() >> 1) & 0x1);
-  std::cout << std::format("DTEST64 = {}\n", (cpuID.ECX() >> 2) & 0x1);
-  std::cout << std::format("MONITOR = {}\n", (cpuID.ECX() >> 3) & 0x1);
-  std::cout << std::format("DS-CPL = {}\n", (cpuID.ECX() >> 4) & 0x1);
-  std::cout << std::format("VMX = {}\n", (cpuID.ECX() >> 5) & 0x1);
-  std::cout << std::format("SMX = {}\n", (cpuID.ECX() >> 6) & 0x1);
-  std::cout << std::format("EIST = {}\n", (cpuID.ECX() >> 7) & 0x1);
-  std::cout << std::format("TM2 = {}\n", (cpuID.ECX() >> 8) & 0x1);
-  std::cout << std::format("SSSE3 = {}\n", (cpuID.ECX() >> 9) & 0x1);
-  std::cout << std::format("CNXT-ID = {}\n", (cpuID.ECX() >> 10) & 0x1);
-  std::cout << std::format("SDBG = {}\n", (cpuID.ECX() >> 11) & 0x1);
-  std::cout << std::format("FMA = {}\n", extract_bits(cpuID.ECX(), 12, 12));
-  std::cout << std::format("CMPXCHG16B = {}\n",
-                           extract_bits(cpuID.ECX(), 13, 13));
-  std::cout << std::format("xTPR Update Control = {}\n",
-                           extract_bits(cpuID.ECX(), 14, 14));
-  std::cout << std::format("PDCM = {}\n", extract_bits(cpuID.ECX(), 15, 15));
-  std::cout << std::format("PCID = {}\n", extract_bits(cpuID.ECX(), 17, 17));
-  std::cout << std::format("DCA = {}\n", extract_bits(cpuID.ECX(), 18, 18));
-  std::cout << std::format("SSE4.1 = {}\n", extract_bits(cpuID.ECX(), 19, 19));
-  std::cout << std::format("SSE4.2 = {}\n", extract_bits(cpuID.ECX(), 20, 20));
-  std::cout << std::format("x2APIC = {}\n", extract_bits(cpuID.ECX(), 21, 21));
-  std::cout << std::format("MOVBE = {}\n", extract_bits(cpuID.ECX(), 22, 22));
-  std::cout << std::format("POPCNT = {}\n", extract_bits(cpuID.ECX(), 23, 23));
-  std::cout << std::format("TSC-Deadline = {}\n",
-                           extract_bits(cpuID.ECX(), 24, 24));
-  std::cout << std::format("AESNI = {}\n", extract_bits(cpuID.ECX(), 25, 25));
-  std::cout << std::format("XSAVE = {}\n", extract_bits(cpuID.ECX(), 26, 26));
-  std::cout << std::format("OSXSAVE = {}\n", extract_bit(cpuID.ECX(), 27));
-  std::cout << std::format("AVX = {}\n", extract_bit(cpuID.ECX(), 28));
-  std::cout << std::format("F16C = {}\n", extract_bit(cpuID.ECX(), 29));
-  std::cout << std::format("RDRAND = {}\n", extract_bit(cpuID.ECX(), 30));
+  // ECX Feature Information, decoded through the kFeatures table
+  const FeatureSet features(snap);
+  for (const auto &desc : kFeatures) {
+    if (desc.leaf == 0x1 && desc.reg == CpuidReg::ECX) {
+      std::cout << std::format("{} = {}\n", desc.name,
+                               int(features.has(desc.id)));
+    }
+  }
 }
 
 // INPUT EAX = 02H: TLB/Cache/Prefetch Information Returned in EAX, EBX, ECX,
@@ -386,11 +413,26 @@ auto cpuid_01H() {
 // appear in any order. Note also a processor may report a general descriptor
 // type (FFH) and not report any byte descriptor of “cache type” via CPUID leaf
 // 2
-auto cache_info() { CPUID2 cpuid(0x2, 0x0); }
-auto test_processor_serial() {
+auto cache_info(const CpuidSnapshot &snap) {
+  CacheHierarchy caches = decode_caches(snap);
+  static constexpr const char *kTypes[] = {"Null", "Data", "Instruction",
+                                           "Unified"};
+  for (uint8_t i = 0; i < caches.count; ++i) {
+    const CacheLevel &c = caches.caches[i];
+    std::cout << std::format(
+        "L{} {}: {} KiB, {}-way, {} B line, {} sets, shared by {}\n", c.level,
+        kTypes[size_t(c.type)], c.sizeBytes / 1024, c.ways, c.lineSize,
+        c.sets, c.sharedBy);
+  }
+  CacheBlocking b = recommend_blocking(caches, sizeof(double), 3);
+  std::cout << std::format(
+      "double x3 blocking: L1 tile {}, L2 tile {}, L3 block {} elements\n",
+      b.l1Tile, b.l2Tile, b.l3Elements);
+}
+auto test_processor_serial(const CpuidSnapshot &snap) {
   // The processor serial number can be obtained by calling CPUID with the
   // value “03H” in the EAX register and reading the EDX register.
-  CPUID2 cpuID(0x03, 0);
+  const CpuidLeaf &cpuID = snap.get(0x03);
   std::cout << std::format("Processor Serial Number = {}\n", cpuID.EDX());
 }
 // initial EAX=0H
@@ -398,93 +440,271 @@ auto test_processor_serial() {
 // EBX “Genu”
 // ECX “ntel”
 // EDX “ineI”
-auto cpuid_0H() {
-  CPUID2 cpuid(0x0, 0x0);
+auto cpuid_0H(const CpuidSnapshot &snap) {
+  const CpuidLeaf &cpuid = snap.get(0x0);
   std::cout << std::format("EAX = {:#X}\n", cpuid.EAX());
   std::cout << std::format("EBX = {:#X}, {}\n", cpuid.EBX(),
-                           num_to_str(cpuid.EBX()));
+                           regs_to_chars(cpuid.EBX()));
   std::cout << std::format("ECX = {:#X}, {}\n", cpuid.ECX(),
-                           num_to_str(cpuid.ECX()));
+                           regs_to_chars(cpuid.ECX()));
   std::cout << std::format("EDX = {:#X}, {}\n", cpuid.EDX(),
-                           num_to_str(cpuid.EDX()));
+                           regs_to_chars(cpuid.EDX()));
 }
 // To use the brand string method, execute CPUID with EAX input of 8000002H
 // through 80000004H. For each input value, CPUID returns 16 ASCII characters
 // using EAX, EBX, ECX, and EDX. The returned string will be NULL-terminated.
-auto brand_string() {
+auto brand_string(const CpuidSnapshot &snap) {
   std::string res;
-  CPUID2 cpuid(0x80000002, 0x0);
+  const CpuidLeaf &cpuid = snap.get(0x80000002);
   std::cout << std::format("EAX = {:#X}, {}\n", cpuid.EAX(),
-                           num_to_str(cpuid.EAX()));
+                           regs_to_chars(cpuid.EAX()));
   std::cout << std::format("EBX = {:#X}, {}\n", cpuid.EBX(),
-                           num_to_str(cpuid.EBX()));
+                           regs_to_chars(cpuid.EBX()));
   std::cout << std::format("ECX = {:#X}, {}\n", cpuid.ECX(),
-                           num_to_str(cpuid.ECX()));
+                           regs_to_chars(cpuid.ECX()));
   std::cout << std::format("EDX = {:#X}, {}\n", cpuid.EDX(),
-                           num_to_str(cpuid.EDX()));
-  CPUID2 cpuid2(0x80000003, 0x0);
+                           regs_to_chars(cpuid.EDX()));
+  const CpuidLeaf &cpuid2 = snap.get(0x80000003);
   std::cout << std::format("EAX = {:#X}, {}\n", cpuid2.EAX(),
-                           num_to_str(cpuid2.EAX()));
+                           regs_to_chars(cpuid2.EAX()));
   std::cout << std::format("EBX = {:#X}, {}\n", cpuid2.EBX(),
-                           num_to_str(cpuid2.EBX()));
+                           regs_to_chars(cpuid2.EBX()));
   std::cout << std::format("ECX = {:#X}, {}\n", cpuid2.ECX(),
-                           num_to_str(cpuid2.ECX()));
+                           regs_to_chars(cpuid2.ECX()));
   std::cout << std::format("EDX = {:#X}, {}\n", cpuid2.EDX(),
-                           num_to_str(cpuid2.EDX()));
-  CPUID2 cpuid3(0x80000004, 0x0);
+                           regs_to_chars(cpuid2.EDX()));
+  const CpuidLeaf &cpuid3 = snap.get(0x80000004);
   std::cout << std::format("EAX = {:#X}, {}\n", cpuid3.EAX(),
-                           num_to_str(cpuid3.EAX()));
+                           regs_to_chars(cpuid3.EAX()));
   std::cout << std::format("EBX = {:#X}, {}\n", cpuid3.EBX(),
-                           num_to_str(cpuid3.EBX()));
+                           regs_to_chars(cpuid3.EBX()));
   std::cout << std::format("ECX = {:#X}, {}\n", cpuid3.ECX(),
-                           num_to_str(cpuid3.ECX()));
+                           regs_to_chars(cpuid3.ECX()));
   std::cout << std::format("EDX = {:#X}, {}\n", cpuid3.EDX(),
-                           num_to_str(cpuid3.EDX()));
+                           regs_to_chars(cpuid3.EDX()));
   for (auto i = 0x80000002; i <= 0x80000004; i++) {
-    CPUID2 cpuid(i, 0x0);
-    // res += num_to_str(cpuid.EAX());
-    // res += num_to_str(cpuid.EBX());
-    // res += num_to_str(cpuid.ECX());
-    // res += num_to_str(cpuid.EDX());
-    res.append(num_to_str(cpuid.EAX()));
-    res.append(num_to_str(cpuid.EBX()));
-    res.append(num_to_str(cpuid.ECX()));
-    res.append(num_to_str(cpuid.EDX()));
+    const CpuidLeaf &cpuid = snap.get(i);
+    // res += regs_to_chars(cpuid.EAX());
+    // res += regs_to_chars(cpuid.EBX());
+    // res += regs_to_chars(cpuid.ECX());
+    // res += regs_to_chars(cpuid.EDX());
+    res.append(regs_to_chars(cpuid.EAX()));
+    res.append(regs_to_chars(cpuid.EBX()));
+    res.append(regs_to_chars(cpuid.ECX()));
+    res.append(regs_to_chars(cpuid.EDX()));
   }
   std::cout << std::format("brand string: {}\n", res);
 
   // use qstring
   QString qs;
   for (auto i = 0x80000002; i <= 0x80000004; i++) {
-    CPUID2 cpuid(i, 0x0);
-    qs.append(QString::fromStdString(num_to_str(cpuid.EAX())));
-    qs.append(QString::fromStdString(num_to_str(cpuid.EBX())));
-    qs.append(QString::fromStdString(num_to_str(cpuid.ECX())));
-    qs.append(QString::fromStdString(num_to_str(cpuid.EDX())));
+    const CpuidLeaf &cpuid = snap.get(i);
+    qs.append(QString::fromLatin1(regs_to_chars(cpuid.EAX()).chars.data(), 4));
+    qs.append(QString::fromLatin1(regs_to_chars(cpuid.EBX()).chars.data(), 4));
+    qs.append(QString::fromLatin1(regs_to_chars(cpuid.ECX()).chars.data(), 4));
+    qs.append(QString::fromLatin1(regs_to_chars(cpuid.EDX()).chars.data(), 4));
   }
   qs.trimmed();
   std::cout << std::format("brand string: {}----\n", qs.toStdString());
 }
-int main() {
-  brand_string();
-  cpuid_0H();
+// Publishes this host into shared memory, then (with an interval)
+// re-enumerates and republishes whenever a leaf changes
+static int run_publisher(const std::string &name, unsigned seconds) {
+  std::optional<SnapshotPublisher> publisher = SnapshotPublisher::create(name);
+  if (!publisher) {
+    std::cerr << std::format(
+        "{}: cannot create shared segment, or it has a publisher\n", name);
+    return 1;
+  }
+  const uint64_t tscHz = TscClock::host().tscHz();
+  // Leaf 1 EBX[31:24] and leaf 0xB/0x1F EDX hold the APIC ID of whichever
+  // CPU runs the scan, so every scan runs on the same CPU
+  std::vector<int> cpus = allowed_cpus();
+  if (cpus.empty() || !pin_thread_to_cpu(cpus.front())) {
+    std::cerr << std::format("{}: cannot pin the publisher\n", name);
+    return 1;
+  }
+  CpuidSnapshot last;
+  uint32_t microcode = host_fingerprint().microcode;
+  if (!publisher->publish(last, host_xsave(last), tscHz)) return 1;
+  std::cout << std::format("{}: generation {}, {} leaves\n", name,
+                           publisher->generation(), last.size());
+  while (seconds) {
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    CpuidSnapshot snap;
+    // A late microcode load can leave every leaf as it was, but readers
+    // check the revision in the fingerprint
+    const uint32_t revision = host_fingerprint().microcode;
+    // CpuidLeaf has no padding, so equal bytes mean equal records
+    if (revision == microcode && snap.size() == last.size() &&
+        std::memcmp(snap.leaves().data(), last.leaves().data(),
+                    snap.leaves().size_bytes()) == 0) {
+      continue;
+    }
+    if (!publisher->publish(snap, host_xsave(snap), tscHz)) return 1;
+    std::cout << std::format("{}: generation {}, {} leaves\n", name,
+                             publisher->generation(), snap.size());
+    last = std::move(snap);
+    microcode = revision;
+  }
+  return 0;
+}
+// Ingests a fleet dump and counts its hosts per CPU model
+static int run_fleet(const std::string &path) {
+  auto start = std::chrono::steady_clock::now();
+  std::optional<FleetTable> table = load_fleet_dump(path);
+  std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+  if (!table) {
+    std::cerr << std::format("{}: cannot read\n", path);
+    return 1;
+  }
+  std::cout << std::format("{}: {} hosts in {:.3f} s\n", path, table->size(),
+                           took.count());
+  constexpr const char *kVendors[] = {"other", "Intel", "AMD", "Hygon"};
+  std::map<std::tuple<CpuVendor, uint16_t, uint8_t>, size_t> models;
+  for (size_t i = 0; i < table->size(); ++i) {
+    ++models[{table->vendor[i], table->family[i], table->model[i]}];
+  }
+  for (const auto &[key, hosts] : models) {
+    const auto &[vendor, family, model] = key;
+    std::cout << std::format(
+        "  {:<5} family {:#04x} model {:#04x}: {} hosts\n",
+        kVendors[size_t(vendor)], family, model, hosts);
+  }
+  return 0;
+}
+// Prints what changes as CPUs go on/offline or get new microcode. A fake
+// SYSROOT is watched through inotify, and DEVROOT reads CPUs through fake
+// cpuid devices instead of pinned threads.
+static int run_watch(const std::string &sysRoot, const char *devRoot) {
+  CpuWatcher::Options options;
+  options.sysRoot = sysRoot;
+  options.netlink = sysRoot == kSysCpuRoot;
+  if (devRoot) {
+    options.read = [root = std::string(devRoot)](
+                       int cpu) -> std::optional<CpuidSnapshot> {
+      DevCpuBackend dev(cpu, root);
+      if (!dev.ok()) return std::nullopt;
+      return CpuidSnapshot(dev);
+    };
+  }
+  CpuWatcher watcher(std::move(options));
+  std::cout << std::format("{}: {} CPUs online, {} enumerated, via {}\n",
+                           sysRoot, watcher.state().online.size(),
+                           watcher.cpus().size(), watcher.source());
+  for (;;) {
+    // Refresh on every timeout too: an event can be missed or never sent
+    watcher.wait(std::chrono::seconds(1));
+    std::cout << format_changes(watcher.refresh()) << std::flush;
+  }
+}
+int main(int argc, char **argv) {
+  std::string_view mode = argc > 1 ? argv[1] : "";
+  const char *path = argc > 2 ? argv[2] : nullptr;
+  // --dump: print every CPU's raw leaves in the `cpuid -r` layout
+  if (mode == "--dump") {
+    std::cout << format_cpuid_dump(PerCpuSnapshot());
+    return 0;
+  }
+  // --report FMT: the standard report as human, json, csv or binary
+  if (mode == "--report" && path) {
+    std::optional<ReportFormat> format = parse_report_format(path);
+    if (!format) {
+      std::cerr << std::format("unknown report format {}\n", path);
+      return 1;
+    }
+    static ReportBuffer buffer;
+    ReportWriter writer(buffer, *format);
+    const CpuidSnapshot snap;
+    write_report(writer, snap, host_xsave(snap));
+    return buffer.flush(STDOUT_FILENO) ? 0 : 1;
+  }
+  // --save PATH: write a host-wide snapshot file for other processes
+  if (mode == "--save" && path) {
+    return write_snapshot_file(path, CpuidSnapshot(), host_fingerprint())
+               ? 0
+               : 1;
+  }
+  // --publish [NAME [SECONDS]]: publish this host to a shared-memory
+  // segment for every process on it, refreshing every SECONDS
+  if (mode == "--publish") {
+    return run_publisher(path ? path : kSharedSnapshotName,
+                         argc > 3 ? unsigned(std::atoi(argv[3])) : 0);
+  }
+  // --watch [SYSROOT [DEVROOT]]: follow CPU hotplug and microcode loads
+  if (mode == "--watch") {
+    return run_watch(path ? path : kSysCpuRoot, argc > 3 ? argv[3] : nullptr);
+  }
+  // --resctrl [ROOT]: resctrl groups, their L3 masks and counters
+  if (mode == "--resctrl") {
+    return run_resctrl(path ? path : kResctrlRoot);
+  }
+  // --fleet PATH: ingest a multi-host dump, one "HOST name" line per host
+  if (mode == "--fleet" && path) {
+    return run_fleet(path);
+  }
+  // --replay PATH: decode a recorded machine instead of this one
+  std::optional<CpuidDump> dump;
+  if (mode == "--replay" && path) {
+    dump = load_cpuid_dump(path);
+    if (!dump) {
+      std::cerr << std::format("{}: no CPUID records\n", path);
+      return 1;
+    }
+  }
+  // --attach [NAME]: copy the leaves a publisher put in shared memory
+  std::optional<CpuidSnapshot> shared;
+  if (mode == "--attach") {
+    const char *name = path ? path : kSharedSnapshotName;
+    std::optional<SnapshotReader> reader = SnapshotReader::open(name);
+    if (!reader) {
+      std::cerr << std::format("{}: no published snapshot\n", name);
+      return 1;
+    }
+    shared = reader->snapshot();
+    if (!shared) {
+      std::cerr << std::format("{}: publisher stopped mid-write\n", name);
+      return 1;
+    }
+  }
+  // Enumerate every leaf once, or map the --load PATH snapshot when it
+  // matches this host; everything below reads from memory
+  CpuidSnapshot snap = dump     ? CpuidSnapshot(dump->backends[0])
+                       : shared ? *shared
+                       : mode == "--load" && path ? load_or_enumerate(path)
+                                                  : CpuidSnapshot();
+  brand_string(snap);
+  cpuid_0H(snap);
   std::cout << "------------------\n";
-  cpuid_01H();
-  test_processor_serial();
+  cpuid_01H(snap);
+  test_processor_serial(snap);
   test_char();
-  test_hybrid_flag();
-  vendor();
-  test_cpuinfo();
+  vendor(snap);
+  test_cpuinfo(snap);
+  PerCpuSnapshot all = dump ? PerCpuSnapshot(*dump) : PerCpuSnapshot();
+  test_hybrid_flag(all);
+  test_per_cpu(all);
+  test_topology(all);
+  cache_info(snap);
+  test_tsc(snap);
+  test_hypervisor(snap, !dump && !shared);
+  test_pmu(snap);
+  test_rdt(snap);
+  const XsaveInfo xsave = dump ? decode_xsave(snap) : host_xsave(snap);
+  test_xsave(snap, xsave);
+  test_simd(CPUInfo(snap, xsave));
+  std::cout << std::format("cpuid executions = {} for {} leaves\n",
+                           snap.executions(), snap.size());
   // std::cout << std::format("{}", num_to_byte_arr(1970169159));
   // fmt::print("{}\n", fmt::join(ToLEBytes(0x12345678), ", "));
-  // u32 number to vector of char
+  // u32 number to array of bytes
   auto char_arr = ToLEBytes(1970169159);
   std::cout << fmt::format("{::#x}\n", char_arr);
 
-  // vector of char to string
+  // array of bytes to string
   std::string s(char_arr.begin(), char_arr.end());
   std::cout << std::format("{}\n", s);
   std::cout << std::format("---\n");
-  std::cout << std::format("{}\n", num_to_str2(0X65746E49));
+  std::cout << std::format("{}\n", regs_to_chars(0X65746E49U));
   return 0;
 }
\ No newline at end of file
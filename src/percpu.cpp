@@ -0,0 +1,164 @@
+#include "percpu.hpp"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <optional>
+#include <thread>
+
+#include "backend.hpp"
+
+std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+bool pin_thread_to_cpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  // pid 0 means the calling thread, not the whole process
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+std::optional<CpuidSnapshot> PerCpuSnapshot::readPinned(int cpu) {
+  // A CPU can go offline between sched_getaffinity and here; skip it
+  if (!pin_thread_to_cpu(cpu)) return std::nullopt;
+  return CpuidSnapshot();
+}
+
+PerCpuSnapshot::PerCpuSnapshot(unsigned threads)
+    : PerCpuSnapshot(allowed_cpus(), threads, readPinned) {}
+
+PerCpuSnapshot::PerCpuSnapshot(const std::vector<int> &cpus, unsigned threads,
+                               const ReadCpu &read) {
+  auto start = std::chrono::steady_clock::now();
+
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  mThreads = std::min<unsigned>(threads, std::max<size_t>(cpus.size(), 1));
+
+  // One preallocated slot per CPU; each slot is written by exactly one worker
+  std::vector<std::optional<CpuidSnapshot>> slots(cpus.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) <
+                   cpus.size();) {
+      slots[i] = read(cpus[i]);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(mThreads);
+  for (unsigned t = 0; t < mThreads; ++t) pool.emplace_back(worker);
+  for (auto &t : pool) t.join();
+
+  mCpus.reserve(cpus.size());
+  mSnapshots.reserve(cpus.size());
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (!slots[i]) continue;
+    mCpus.push_back(cpus[i]);
+    mSnapshots.push_back(std::move(*slots[i]));
+  }
+  reindex();
+
+  mWallTime = std::chrono::steady_clock::now() - start;
+}
+
+std::optional<PerCpuSnapshot> PerCpuSnapshot::fromDevices(
+    const std::string &root, unsigned threads) {
+  std::vector<int> cpus = device_cpus(root);
+  // No driver, or no permission to read it
+  if (cpus.empty() || !DevCpuBackend(cpus.front(), root).ok()) {
+    return std::nullopt;
+  }
+  return PerCpuSnapshot(cpus, threads,
+                        [&root](int cpu) -> std::optional<CpuidSnapshot> {
+                          DevCpuBackend dev(cpu, root);
+                          if (!dev.ok()) return std::nullopt;
+                          return CpuidSnapshot(dev);
+                        });
+}
+
+PerCpuSnapshot::PerCpuSnapshot(const CpuidDump &dump) {
+  auto start = std::chrono::steady_clock::now();
+
+  // Dumps list CPUs in file order, which need not be ascending
+  std::vector<CpuidSnapshot> snapshots;
+  snapshots.reserve(dump.backends.size());
+  for (const ReplayBackend &backend : dump.backends) {
+    snapshots.emplace_back(backend);
+  }
+  adopt(dump.cpus, std::move(snapshots));
+
+  mWallTime = std::chrono::steady_clock::now() - start;
+}
+
+PerCpuSnapshot::PerCpuSnapshot(const std::vector<int> &cpus,
+                               std::vector<CpuidSnapshot> snapshots) {
+  adopt(cpus, std::move(snapshots));
+}
+
+void PerCpuSnapshot::adopt(const std::vector<int> &cpus,
+                           std::vector<CpuidSnapshot> snapshots) {
+  mThreads = 1;
+  std::vector<size_t> order(std::min(cpus.size(), snapshots.size()));
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return cpus[a] < cpus[b]; });
+  mCpus.reserve(order.size());
+  mSnapshots.reserve(order.size());
+  for (size_t i : order) {
+    if (cpus[i] < 0 || (!mCpus.empty() && mCpus.back() == cpus[i])) continue;
+    mCpus.push_back(cpus[i]);
+    mSnapshots.push_back(std::move(snapshots[i]));
+  }
+  reindex();
+}
+
+const PerCpuSnapshot &PerCpuSnapshot::host() {
+  static const PerCpuSnapshot all;
+  return all;
+}
+
+void PerCpuSnapshot::set(int cpu, CpuidSnapshot snap) {
+  auto it = std::lower_bound(mCpus.begin(), mCpus.end(), cpu);
+  size_t i = size_t(it - mCpus.begin());
+  if (it != mCpus.end() && *it == cpu) {
+    mSnapshots[i] = std::move(snap);
+    return;
+  }
+  mCpus.insert(it, cpu);
+  mSnapshots.insert(mSnapshots.begin() + i, std::move(snap));
+  reindex();
+}
+
+bool PerCpuSnapshot::erase(int cpu) {
+  auto it = std::lower_bound(mCpus.begin(), mCpus.end(), cpu);
+  if (it == mCpus.end() || *it != cpu) return false;
+  mSnapshots.erase(mSnapshots.begin() + (it - mCpus.begin()));
+  mCpus.erase(it);
+  reindex();
+  return true;
+}
+
+void PerCpuSnapshot::reindex() {
+  mIndex.assign(mCpus.empty() ? 0 : mCpus.back() + 1, -1);
+  for (size_t i = 0; i < mCpus.size(); ++i) mIndex[mCpus[i]] = int(i);
+}
+
+const CpuidSnapshot *PerCpuSnapshot::forCpu(int cpu) const {
+  if (cpu < 0 || size_t(cpu) >= mIndex.size() || mIndex[cpu] < 0) {
+    return nullptr;
+  }
+  return &mSnapshots[mIndex[cpu]];
+}
@@ -0,0 +1,85 @@
+#ifndef PERCPU_HPP
+#define PERCPU_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "snapshot.hpp"
+
+struct CpuidDump;
+
+// CpuidSnapshot of every logical CPU the process may run on. Leaves such as
+// 0x1 (APIC ID), 0xB/0x1F (x2APIC topology) and 0x1A (core type) differ per
+// CPU, so each one is read by a worker thread pinned to that CPU. Workers
+// run concurrently, so a full-machine scan costs about one CPU's scan.
+class PerCpuSnapshot {
+ public:
+  // Builds one CPU's snapshot on a worker thread; nullopt skips the CPU
+  using ReadCpu = std::function<std::optional<CpuidSnapshot>(int cpu)>;
+
+  // threads == 0 uses one worker per CPU, capped at hardware_concurrency()
+  explicit PerCpuSnapshot(unsigned threads = 0);
+  // Runs `read` for each of `cpus` (ascending) on `threads` workers
+  PerCpuSnapshot(const std::vector<int> &cpus, unsigned threads,
+                 const ReadCpu &read);
+  // Snapshots of a recorded machine, one per CPU in the dump; nothing is
+  // pinned and no `cpuid` is executed
+  explicit PerCpuSnapshot(const CpuidDump &dump);
+  // Takes snapshots built elsewhere, e.g. wrapping records parsed in
+  // place; `cpus[i]` is the CPU of `snapshots[i]`. Entries are sorted by
+  // CPU and the first of a repeated CPU wins.
+  PerCpuSnapshot(const std::vector<int> &cpus,
+                 std::vector<CpuidSnapshot> snapshots);
+  // Reads every CPU with a `root`/N/cpuid device through DevCpuBackend.
+  // Workers are never pinned, so the scan ignores the affinity mask and
+  // leaves other pinned threads alone. nullopt when the cpuid driver is
+  // missing or unreadable.
+  static std::optional<PerCpuSnapshot> fromDevices(
+      const std::string &root = "/dev/cpu", unsigned threads = 0);
+  // Scan of the process's CPUs, built once on first use
+  static const PerCpuSnapshot &host();
+
+  size_t size() const { return mSnapshots.size(); }
+  // Logical CPU number of the i-th entry
+  int cpu(size_t i) const { return mCpus[i]; }
+  const CpuidSnapshot &operator[](size_t i) const { return mSnapshots[i]; }
+  // nullptr when `cpu` is offline or outside the affinity mask
+  const CpuidSnapshot *forCpu(int cpu) const;
+
+  const std::vector<int> &cpus() const { return mCpus; }
+  std::chrono::nanoseconds wallTime() const { return mWallTime; }
+  unsigned threads() const { return mThreads; }
+
+  // Replaces (or adds, keeping CPUs ascending) one CPU's snapshot, e.g.
+  // after it came online; the other entries are untouched
+  void set(int cpu, CpuidSnapshot snap);
+  // Drops `cpu`, e.g. after it went offline; false when it was absent
+  bool erase(int cpu);
+
+  // Pinned-thread reader used by the default constructor
+  static std::optional<CpuidSnapshot> readPinned(int cpu);
+
+ private:
+  // Sorts by CPU, keeps the first of a repeated CPU, drops negative ones
+  void adopt(const std::vector<int> &cpus,
+             std::vector<CpuidSnapshot> snapshots);
+  void reindex();
+
+  std::vector<int> mCpus;
+  std::vector<CpuidSnapshot> mSnapshots;
+  std::vector<int> mIndex;  // cpu number -> position in mSnapshots, or -1
+  std::chrono::nanoseconds mWallTime{};
+  unsigned mThreads = 0;
+};
+
+// Logical CPUs in the calling thread's affinity mask, ascending
+std::vector<int> allowed_cpus();
+
+// Pins the calling thread to `cpu`; returns false if the kernel refuses
+bool pin_thread_to_cpu(int cpu);
+
+#endif  // PERCPU_HPP
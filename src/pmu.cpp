@@ -0,0 +1,140 @@
+#include "pmu.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <initializer_list>
+
+#include "utils.hpp"
+
+static constexpr std::string_view kEventNames[kPmuEventCount] = {
+    "core-cycles",
+    "instructions",
+    "ref-cycles",
+    "llc-references",
+    "llc-misses",
+    "branch-instructions",
+    "branch-misses",
+    "topdown-slots",
+    "topdown-backend-bound",
+    "topdown-bad-speculation",
+    "topdown-frontend-bound",
+    "topdown-retiring",
+    "lbr-inserts",
+};
+
+std::string_view pmu_event_name(PmuEvent event) {
+  return size_t(event) < kPmuEventCount ? kEventNames[size_t(event)] : "?";
+}
+
+// CPUID.0AH: architectural performance monitoring
+namespace leafa {
+using Version = Field<CpuidReg::EAX, 7, 0>;
+using GpCounters = Field<CpuidReg::EAX, 15, 8>;
+using GpWidth = Field<CpuidReg::EAX, 23, 16>;
+using EventsLength = Field<CpuidReg::EAX, 31, 24>;  // valid bits of EBX
+using FixedCounters = Field<CpuidReg::EDX, 4, 0>;
+using FixedWidth = Field<CpuidReg::EDX, 12, 5>;
+using AnyThreadDeprecated = Bit<CpuidReg::EDX, 15>;
+}  // namespace leafa
+
+// CPUID.80000022H: AMD extended performance monitoring and debug
+namespace leaf80000022 {
+using PerfMonV2 = Bit<CpuidReg::EAX, 0>;
+using CoreCounters = Field<CpuidReg::EBX, 3, 0>;
+using LbrStackSize = Field<CpuidReg::EBX, 9, 4>;
+using NorthbridgeCounters = Field<CpuidReg::EBX, 15, 10>;
+using UmcCounters = Field<CpuidReg::EBX, 21, 16>;
+}  // namespace leaf80000022
+
+static uint32_t low_bits(unsigned n) {
+  return n >= 32 ? ~0U : (1U << n) - 1;
+}
+
+static PmuInfo decode_intel(const CpuidSnapshot &snap) {
+  PmuInfo pmu;
+  if (snap.maxBasicLeaf() < 0xA) return pmu;
+  const CpuidLeaf &a = snap.get(0xA);
+  pmu.version = uint8_t(leafa::Version::get(a));
+  if (pmu.version == 0) return pmu;
+  pmu.source = PmuSource::Leaf0A;
+  pmu.gpCounters = uint8_t(leafa::GpCounters::get(a));
+  pmu.gpWidth = uint8_t(leafa::GpWidth::get(a));
+  pmu.gpMask = low_bits(pmu.gpCounters);
+  // EBX bits are set for events that are NOT available, and only the
+  // first EventsLength of them are defined
+  unsigned length =
+      std::min<unsigned>(leafa::EventsLength::get(a), kPmuEventCount);
+  pmu.events = ~a.EBX() & low_bits(length);
+  if (pmu.version > 1) {
+    pmu.fixedCounters = uint8_t(leafa::FixedCounters::get(a));
+    pmu.fixedWidth = uint8_t(leafa::FixedWidth::get(a));
+    pmu.fixedMask = low_bits(pmu.fixedCounters);
+    // Version 5 also lists fixed counters beyond the contiguous ones
+    if (pmu.version >= 5) pmu.fixedMask |= a.ECX();
+    pmu.anyThreadDeprecated = leafa::AnyThreadDeprecated::get(a);
+  }
+
+  // Leaf 0x23, present with CPUID.(7,1):EAX[8] ArchPerfmonExt, supersedes
+  // the counts with bitmaps, which differ between P- and E-cores
+  if (snap.maxBasicLeaf() >= 0x23 && (snap.get(0x7, 1).EAX() & (1U << 8))) {
+    uint32_t subleaves = snap.get(0x23).EAX();
+    if (subleaves & (1U << 1)) {
+      const CpuidLeaf &counters = snap.get(0x23, 1);
+      pmu.gpMask = counters.EAX();
+      pmu.fixedMask = counters.EBX();
+      pmu.gpCounters = uint8_t(std::popcount(pmu.gpMask));
+      pmu.fixedCounters = uint8_t(std::popcount(pmu.fixedMask));
+      pmu.source = PmuSource::Leaf23;
+    }
+    if (subleaves & (1U << 3)) {
+      pmu.events = snap.get(0x23, 3).EAX() & low_bits(kPmuEventCount);
+      pmu.source = PmuSource::Leaf23;
+    }
+  }
+  return pmu;
+}
+
+static PmuInfo decode_amd(const CpuidSnapshot &snap) {
+  PmuInfo pmu;
+  const uint32_t maxExt = snap.maxExtendedLeaf();
+  if (maxExt >= 0x80000022 &&
+      leaf80000022::PerfMonV2::get(snap.get(0x80000022))) {
+    const CpuidLeaf &l = snap.get(0x80000022);
+    pmu.version = 2;
+    pmu.gpCounters = uint8_t(leaf80000022::CoreCounters::get(l));
+    pmu.lbrDepth = uint8_t(leaf80000022::LbrStackSize::get(l));
+    pmu.northbridgeCounters =
+        uint8_t(leaf80000022::NorthbridgeCounters::get(l));
+    pmu.umcCounters = uint8_t(leaf80000022::UmcCounters::get(l));
+    pmu.source = PmuSource::Amd80000022;
+  } else if (maxExt >= 0x80000001) {
+    // PerfCtrExtCore: six core counters instead of the original four.
+    // A hypervisor hiding the PMU cannot say so here; perf_event_open
+    // is what finds out.
+    pmu.gpCounters = (snap.get(0x80000001).ECX() & (1U << 23)) ? 6 : 4;
+    pmu.source = PmuSource::AmdLegacy;
+  }
+  if (!pmu.gpCounters) return pmu;
+  pmu.gpWidth = 48;
+  pmu.gpMask = low_bits(pmu.gpCounters);
+  // AMD has no architectural event list; these have fixed encodings on
+  // every family. The generic cache events count L2, not L3, on Zen, so
+  // they are not claimed as LLC events.
+  for (PmuEvent e : {PmuEvent::CoreCycles, PmuEvent::Instructions,
+                     PmuEvent::BranchInstructions, PmuEvent::BranchMisses}) {
+    pmu.events |= 1U << unsigned(e);
+  }
+  return pmu;
+}
+
+PmuInfo decode_pmu(const CpuidSnapshot &snap) {
+  switch (snap.vendor()) {
+    case CpuVendor::Intel:
+      return decode_intel(snap);
+    case CpuVendor::AMD:
+    case CpuVendor::Hygon:
+      return decode_amd(snap);
+    default:
+      return {};
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef PMU_HPP
+#define PMU_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "snapshot.hpp"
+
+// Architectural events, in the bit order of leaf 0xA EBX / leaf 0x23
+// subleaf 3 EAX
+enum class PmuEvent : uint8_t {
+  CoreCycles,
+  Instructions,
+  RefCycles,
+  LlcReferences,
+  LlcMisses,
+  BranchInstructions,
+  BranchMisses,
+  TopdownSlots,
+  TopdownBackendBound,
+  TopdownBadSpeculation,
+  TopdownFrontendBound,
+  TopdownRetiring,
+  LbrInserts,
+};
+inline constexpr size_t kPmuEventCount = 13;
+
+std::string_view pmu_event_name(PmuEvent event);
+
+// Where PmuInfo was decoded from
+enum class PmuSource : uint8_t {
+  None,
+  Leaf0A,       // Intel architectural perfmon
+  Leaf23,       // leaf 0xA refined by the extended leaf (counter bitmaps)
+  Amd80000022,  // AMD PerfMonV2
+  AmdLegacy,    // 0x80000001 ECX[23] PerfCtrExtCore
+};
+
+struct PmuInfo {
+  uint8_t version = 0;  // leaf 0xA EAX[7:0]; 2 for AMD PerfMonV2
+  uint8_t gpCounters = 0;
+  uint8_t gpWidth = 0;  // bits
+  uint8_t fixedCounters = 0;
+  uint8_t fixedWidth = 0;
+  // Counters present, one bit each; leaf 0x23 may report holes
+  uint32_t gpMask = 0;
+  uint32_t fixedMask = 0;
+  uint32_t events = 0;  // one bit per PmuEvent
+  bool anyThreadDeprecated = false;  // leaf 0xA EDX[15]
+  // AMD: counters of the data fabric (northbridge) and memory controllers
+  uint8_t northbridgeCounters = 0;
+  uint8_t umcCounters = 0;
+  uint8_t lbrDepth = 0;  // AMD LbrExtV2 stack size
+  PmuSource source = PmuSource::None;
+
+  bool present() const { return gpCounters > 0; }
+  bool has(PmuEvent e) const { return events & (1U << unsigned(e)); }
+};
+
+// Leaf 0xA and 0x23 on Intel, 0x80000022 or the legacy counter count on
+// AMD. Hypervisors that hide the PMU report version 0 and no counters.
+PmuInfo decode_pmu(const CpuidSnapshot &snap);
+
+#endif  // PMU_HPP
@@ -0,0 +1,276 @@
+#include "profiler.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <format>
+
+#include "snapshot.hpp"
+#include "tsc.hpp"
+
+std::string_view profile_source_name(ProfileSource source) {
+  switch (source) {
+    case ProfileSource::Hardware:
+      return "hardware";
+    case ProfileSource::Software:
+      return "software";
+    case ProfileSource::Clock:
+      return "clock";
+  }
+  return "?";
+}
+
+struct Profiler::Buffer {
+  // Written by one thread at a time, so no slot is shared
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> calls{0};
+    std::array<std::atomic<uint64_t>, kProfileEvents> totals{};
+  };
+  std::array<Slot, kMaxProfileRegions> slots;
+};
+
+struct Profiler::Thread {
+  Profiler *owner = nullptr;
+  Buffer *buffer = nullptr;
+  std::array<int, kProfileEvents> fds{-1, -1, -1};
+  std::array<const volatile perf_event_mmap_page *, kProfileEvents> pages{};
+  size_t count = 0;
+  bool rdpmc = false;  // every page allows user-space reads
+
+  Thread() = default;
+  Thread(const Thread &) = delete;
+  Thread &operator=(const Thread &) = delete;
+  ~Thread() {
+    close();
+    if (owner && buffer) owner->releaseBuffer(buffer);
+  }
+
+  void close() {
+    for (size_t i = 0; i < kProfileEvents; ++i) {
+      if (pages[i]) {
+        munmap(const_cast<perf_event_mmap_page *>(pages[i]),
+               size_t(sysconf(_SC_PAGESIZE)));
+      }
+      if (fds[i] >= 0) ::close(fds[i]);
+      pages[i] = nullptr;
+      fds[i] = -1;
+    }
+    count = 0;
+    rdpmc = false;
+  }
+};
+
+// Only the owning thread writes its buffer
+static void bump(std::atomic<uint64_t> &counter, uint64_t n) {
+  counter.store(counter.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+}
+
+// The count of one event without a syscall: the kernel's offset plus the
+// live PMC, sign-extended from its width, under the page's seqlock.
+// False when the event is not on a counter right now (or never allows it).
+static bool rdpmc_read(const volatile perf_event_mmap_page *pc,
+                       uint64_t &out) {
+  uint32_t seq;
+  do {
+    seq = pc->lock;
+    std::atomic_signal_fence(std::memory_order_acq_rel);
+    uint32_t index = pc->index;
+    if (!pc->cap_user_rdpmc || index == 0) return false;
+    int64_t pmc = int64_t(__rdpmc(int(index - 1)));
+    unsigned shift = 64 - pc->pmc_width;
+    out = uint64_t(pc->offset + ((pmc << shift) >> shift));
+    std::atomic_signal_fence(std::memory_order_acq_rel);
+  } while (pc->lock != seq);
+  return true;
+}
+
+Profiler::Profiler(const PmuInfo &pmu) {
+  // Generic perf events; the kernel maps them to the architectural
+  // encodings, and PERF_COUNT_HW_CACHE_MISSES is the LLC miss event
+  if (pmu.present()) {
+    auto add = [&](PmuEvent event, uint64_t config, std::string_view name) {
+      if (!pmu.has(event)) return;
+      mConfigs[mCount] = {PERF_TYPE_HARDWARE, config};
+      mNames[mCount++] = name;
+    };
+    add(PmuEvent::CoreCycles, PERF_COUNT_HW_CPU_CYCLES, "cycles");
+    add(PmuEvent::Instructions, PERF_COUNT_HW_INSTRUCTIONS, "instructions");
+    add(PmuEvent::LlcMisses, PERF_COUNT_HW_CACHE_MISSES, "llc-misses");
+    mSource = ProfileSource::Hardware;
+  }
+
+  // Probe on this thread; the events it cannot open are what every thread
+  // will be denied (hidden vPMU, paranoid setting, container seccomp)
+  Thread probe;
+  if (mCount && open(probe)) return;
+  probe.close();
+  mConfigs = {{{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}}};
+  mNames = {"task-clock-ns", "page-faults", "migrations"};
+  mCount = kProfileEvents;
+  mSource = ProfileSource::Software;
+  if (open(probe)) return;
+  mConfigs = {};
+  mNames = {"ns"};
+  mCount = 1;
+  mSource = ProfileSource::Clock;
+}
+
+Profiler &Profiler::host() {
+  static Profiler profiler(decode_pmu(CpuidSnapshot::host()));
+  return profiler;
+}
+
+bool Profiler::open(Thread &t) const {
+  const long pageSize = sysconf(_SC_PAGESIZE);
+  t.rdpmc = true;
+  for (size_t i = 0; i < mCount; ++i) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = mConfigs[i].type;
+    attr.config = mConfigs[i].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // User space only, which perf_event_paranoid 2 still permits
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1,
+                         i ? t.fds[0] : -1, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0) {
+      t.close();
+      return false;
+    }
+    t.fds[i] = fd;
+    t.count = i + 1;
+    void *page =
+        mmap(nullptr, size_t(pageSize), PROT_READ, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+      t.rdpmc = false;
+      continue;
+    }
+    t.pages[i] = static_cast<const volatile perf_event_mmap_page *>(page);
+    if (!t.pages[i]->cap_user_rdpmc) t.rdpmc = false;
+  }
+  return true;
+}
+
+Profiler::Thread &Profiler::thread() {
+  thread_local Thread t;
+  if (!t.owner) {
+    t.owner = this;
+    t.buffer = acquireBuffer();
+    // A thread that cannot open the events still counts calls
+    if (mSource != ProfileSource::Clock) open(t);
+  }
+  return t;
+}
+
+bool Profiler::userRead() { return thread().rdpmc; }
+
+Profiler::Buffer *Profiler::acquireBuffer() {
+  std::lock_guard lock(mLock);
+  if (!mFree.empty()) {
+    Buffer *b = mFree.back();
+    mFree.pop_back();
+    return b;
+  }
+  return mBuffers.emplace_back(std::make_unique<Buffer>()).get();
+}
+
+void Profiler::releaseBuffer(Buffer *buffer) {
+  std::lock_guard lock(mLock);
+  mFree.push_back(buffer);
+}
+
+ProfileRegion Profiler::region(std::string_view name) {
+  std::lock_guard lock(mLock);
+  uint32_t n = mRegionCount.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < n; ++i) {
+    if (mRegionNames[i] == name) return {i};
+  }
+  if (n == kMaxProfileRegions) return {};
+  mRegionNames[n] = name;
+  mRegionCount.store(n + 1, std::memory_order_release);
+  return {n};
+}
+
+void Profiler::read(std::array<uint64_t, kProfileEvents> &out) {
+  out = {};
+  if (mSource == ProfileSource::Clock) {
+    out[0] = TscClock::host().now_ns();
+    return;
+  }
+  Thread &t = thread();
+  if (t.rdpmc) {
+    bool ok = true;
+    for (size_t i = 0; i < t.count && ok; ++i) {
+      ok = rdpmc_read(t.pages[i], out[i]);
+    }
+    if (ok) return;
+  }
+  if (t.count) {
+    // PERF_FORMAT_GROUP: nr, then one value per member
+    uint64_t values[1 + kProfileEvents];
+    if (::read(t.fds[0], values, sizeof(values)) > 0) {
+      for (size_t i = 0; i < std::min<uint64_t>(values[0], t.count); ++i) {
+        out[i] = values[1 + i];
+      }
+    }
+  }
+}
+
+void Profiler::record(ProfileRegion region,
+                      const std::array<uint64_t, kProfileEvents> &begin,
+                      const std::array<uint64_t, kProfileEvents> &end) {
+  if (!region.valid()) return;
+  Buffer::Slot &slot = thread().buffer->slots[region.id];
+  bump(slot.calls, 1);
+  for (size_t i = 0; i < mCount; ++i) bump(slot.totals[i], end[i] - begin[i]);
+}
+
+std::vector<RegionProfile> Profiler::collect() const {
+  std::lock_guard lock(mLock);
+  std::vector<RegionProfile> out;
+  uint32_t n = mRegionCount.load(std::memory_order_acquire);
+  for (uint32_t id = 0; id < n; ++id) {
+    RegionProfile r;
+    r.name = mRegionNames[id];
+    for (const auto &b : mBuffers) {
+      const Buffer::Slot &slot = b->slots[id];
+      r.calls += slot.calls.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < kProfileEvents; ++i) {
+        r.totals[i] += slot.totals[i].load(std::memory_order_relaxed);
+      }
+    }
+    if (r.calls) out.push_back(std::move(r));
+  }
+  return out;
+}
+
+std::string format_profile(const Profiler &profiler) {
+  const auto &names = profiler.eventNames();
+  const size_t count = profiler.eventCount();
+  std::string out = std::format("profile source: {}\n",
+                                profile_source_name(profiler.source()));
+  const bool ipc = profiler.source() == ProfileSource::Hardware &&
+                   count >= 2 && names[0] == "cycles" &&
+                   names[1] == "instructions";
+  for (const RegionProfile &r : profiler.collect()) {
+    out += std::format("{:<24} {:>10} calls", r.name, r.calls);
+    for (size_t i = 0; i < count; ++i) {
+      out += std::format("  {} {} ({:.1f}/call)", names[i], r.totals[i],
+                         double(r.totals[i]) / double(r.calls));
+    }
+    if (ipc && r.totals[0]) {
+      out += std::format("  IPC {:.2f}",
+                         double(r.totals[1]) / double(r.totals[0]));
+    }
+    out += '\n';
+  }
+  return out;
+}
@@ -0,0 +1,127 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pmu.hpp"
+
+inline constexpr size_t kProfileEvents = 3;
+inline constexpr size_t kMaxProfileRegions = 256;
+
+// What the profiler counts, best first
+enum class ProfileSource : uint8_t {
+  Hardware,  // cycles, instructions and LLC misses, as the PMU supports
+  Software,  // no usable PMU: kernel task clock, page faults, migrations
+  Clock,     // perf_event_open denied (seccomp, perf_event_paranoid): TSC ns
+};
+
+std::string_view profile_source_name(ProfileSource source);
+
+// Handle of a named region; obtain once, e.g. in a function-local static
+struct ProfileRegion {
+  uint32_t id = UINT32_MAX;
+  bool valid() const { return id < kMaxProfileRegions; }
+};
+
+struct RegionProfile {
+  std::string name;
+  uint64_t calls = 0;
+  std::array<uint64_t, kProfileEvents> totals{};  // per Profiler::eventNames
+};
+
+// Scoped-region profiler on perf_event_open. Every thread opens its own
+// counter group on its first region and reads it with rdpmc where the
+// kernel allows user-space reads, else with one read() of the group.
+// Totals go into a buffer owned by that thread, so the hot path takes no
+// lock; collect() sums the buffers. Buffers of exited threads are reused
+// by new ones, keeping their totals.
+class Profiler {
+ public:
+  // Picks the events from decode_pmu(CpuidSnapshot::host()) and probes,
+  // on the first calling thread, which of them this process may open
+  static Profiler &host();
+
+  ProfileSource source() const { return mSource; }
+  // Names of RegionProfile::totals; empty for unused slots
+  const std::array<std::string_view, kProfileEvents> &eventNames() const {
+    return mNames;
+  }
+  size_t eventCount() const { return mCount; }
+  // Whether the calling thread reads its counters with rdpmc
+  bool userRead();
+
+  // The same name always yields the same region; invalid once
+  // kMaxProfileRegions names exist
+  ProfileRegion region(std::string_view name);
+
+  // Current values of the calling thread's counters
+  void read(std::array<uint64_t, kProfileEvents> &out);
+  void record(ProfileRegion region,
+              const std::array<uint64_t, kProfileEvents> &begin,
+              const std::array<uint64_t, kProfileEvents> &end);
+
+  // Totals of every region with at least one call, over all threads
+  std::vector<RegionProfile> collect() const;
+
+ private:
+  struct Buffer;
+  struct Thread;
+
+  struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+  };
+
+  explicit Profiler(const PmuInfo &pmu);
+  // The calling thread's counters, opened on first use
+  Thread &thread();
+  bool open(Thread &t) const;
+  Buffer *acquireBuffer();
+  void releaseBuffer(Buffer *buffer);
+
+  ProfileSource mSource = ProfileSource::Clock;
+  std::array<EventConfig, kProfileEvents> mConfigs{};
+  std::array<std::string_view, kProfileEvents> mNames{};
+  size_t mCount = 0;
+
+  mutable std::mutex mLock;  // registration and collection only
+  std::array<std::string, kMaxProfileRegions> mRegionNames;
+  std::atomic<uint32_t> mRegionCount{0};
+  std::vector<std::unique_ptr<Buffer>> mBuffers;
+  std::vector<Buffer *> mFree;
+};
+
+// Counts what runs between construction and destruction into `region`
+class ProfileScope {
+ public:
+  explicit ProfileScope(ProfileRegion region) : mRegion(region) {
+    if (mRegion.valid()) Profiler::host().read(mBegin);
+  }
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+  ~ProfileScope() {
+    if (!mRegion.valid()) return;
+    std::array<uint64_t, kProfileEvents> end;
+    Profiler &p = Profiler::host();
+    p.read(end);
+    p.record(mRegion, mBegin, end);
+  }
+
+ private:
+  ProfileRegion mRegion;
+  std::array<uint64_t, kProfileEvents> mBegin;
+};
+
+// One line per region: calls, totals and per-call means, plus IPC when
+// cycles and instructions were counted
+std::string format_profile(const Profiler &profiler);
+
+#endif  // PROFILER_HPP
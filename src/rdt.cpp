@@ -0,0 +1,100 @@
+#include "rdt.hpp"
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+// CPUID.0FH.1: L3 monitoring
+namespace leaff {
+using CounterWidth = Field<CpuidReg::EAX, 7, 0>;  // minus 24
+using OverflowBit = Bit<CpuidReg::EAX, 8>;
+using Occupancy = Bit<CpuidReg::EDX, 0>;
+using TotalBandwidth = Bit<CpuidReg::EDX, 1>;
+using LocalBandwidth = Bit<CpuidReg::EDX, 2>;
+}  // namespace leaff
+
+// CPUID.10H: allocation; subleaf 1 is L3, 2 is L2, 3 is MBA
+namespace leaf10 {
+using L3 = Bit<CpuidReg::EBX, 1>;  // subleaf 0
+using L2 = Bit<CpuidReg::EBX, 2>;
+using Mba = Bit<CpuidReg::EBX, 3>;
+using CbmLength = Field<CpuidReg::EAX, 4, 0>;  // minus 1
+using Cdp = Bit<CpuidReg::ECX, 2>;
+using NonContiguous = Bit<CpuidReg::ECX, 3>;
+using HighestClos = Field<CpuidReg::EDX, 15, 0>;
+using MaxThrottle = Field<CpuidReg::EAX, 11, 0>;  // minus 1
+using Linear = Bit<CpuidReg::ECX, 2>;
+}  // namespace leaf10
+
+// CPUID.80000020H: AMD PQoS extensions; subleaf 1 is L3 bandwidth
+namespace leaf80000020 {
+using Mba = Bit<CpuidReg::EBX, 1>;  // subleaf 0
+using BandwidthLength = Field<CpuidReg::EAX, 7, 0>;  // BW_LEN
+using HighestClos = Field<CpuidReg::EDX, 15, 0>;
+}  // namespace leaf80000020
+
+static RdtCacheAllocation decode_cat(const CpuidLeaf &l) {
+  RdtCacheAllocation cat;
+  cat.cbmLength = uint8_t(leaf10::CbmLength::get(l) + 1);
+  cat.sharedMask = l.EBX();
+  cat.closCount = uint16_t(leaf10::HighestClos::get(l) + 1);
+  cat.cdp = leaf10::Cdp::get(l);
+  cat.nonContiguous = leaf10::NonContiguous::get(l);
+  return cat;
+}
+
+RdtInfo decode_rdt(const CpuidSnapshot &snap) {
+  RdtInfo rdt;
+  const CpuidLeaf &l7 = snap.get(0x7);
+  const bool monitoring = l7.EBX() & (1U << 12);
+  const bool allocation = l7.EBX() & (1U << 15);
+
+  if (monitoring && snap.maxBasicLeaf() >= 0xF) {
+    RdtMonitoring &mon = rdt.monitoring;
+    mon.maxRmid = snap.get(0xF).EBX();
+    if (snap.get(0xF).EDX() & (1U << 1)) {
+      const CpuidLeaf &l3 = snap.get(0xF, 1);
+      mon.l3Occupancy = leaff::Occupancy::get(l3);
+      mon.l3TotalBandwidth = leaff::TotalBandwidth::get(l3);
+      mon.l3LocalBandwidth = leaff::LocalBandwidth::get(l3);
+      mon.l3MaxRmid = l3.ECX();
+      mon.upscale = l3.EBX();
+      mon.counterWidth = uint8_t(24 + leaff::CounterWidth::get(l3));
+      mon.overflowBit = leaff::OverflowBit::get(l3);
+    }
+  }
+
+  if (!allocation) return rdt;
+  const bool amd = snap.vendor() == CpuVendor::AMD ||
+                   snap.vendor() == CpuVendor::Hygon;
+  rdt.source = amd ? RdtSource::Amd : RdtSource::Intel;
+  // AMD enumerates L3 allocation through leaf 0x10 as well
+  if (snap.maxBasicLeaf() >= 0x10) {
+    const CpuidLeaf &l0 = snap.get(0x10);
+    if (leaf10::L3::get(l0)) rdt.l3 = decode_cat(snap.get(0x10, 1));
+    if (leaf10::L2::get(l0)) rdt.l2 = decode_cat(snap.get(0x10, 2));
+    if (!amd && leaf10::Mba::get(l0)) {
+      const CpuidLeaf &l = snap.get(0x10, 3);
+      rdt.bandwidth.maxThrottle = leaf10::MaxThrottle::get(l) + 1;
+      rdt.bandwidth.closCount = uint16_t(leaf10::HighestClos::get(l) + 1);
+      rdt.bandwidth.linear = leaf10::Linear::get(l);
+    }
+  }
+  if (amd && snap.maxExtendedLeaf() >= 0x80000020 &&
+      leaf80000020::Mba::get(snap.get(0x80000020))) {
+    const CpuidLeaf &l = snap.get(0x80000020, 1);
+    // As Linux: the largest cap is 1 << BW_LEN, not a BW_LEN-bit maximum
+    unsigned bits = leaf80000020::BandwidthLength::get(l);
+    rdt.bandwidth.maxThrottle = 1U << std::min(bits, 31U);
+    rdt.bandwidth.closCount = uint16_t(leaf80000020::HighestClos::get(l) + 1);
+    rdt.bandwidth.linear = true;
+    rdt.bandwidth.absolute = true;
+  }
+  return rdt;
+}
+
+size_t rdt_bytes_per_bit(const RdtCacheAllocation &cat,
+                         const CacheLevel *cache) {
+  if (!cat.present() || !cache || !cache->sizeBytes) return 0;
+  return cache->sizeBytes / cat.cbmLength;
+}
@@ -0,0 +1,79 @@
+#ifndef RDT_HPP
+#define RDT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cache.hpp"
+#include "snapshot.hpp"
+
+// Resource monitoring (leaf 0xF): RMIDs tag what a thread brings into L3
+// and the bandwidth it uses
+struct RdtMonitoring {
+  bool l3Occupancy = false;       // 0xF.1 EDX[0]
+  bool l3TotalBandwidth = false;  // EDX[1]
+  bool l3LocalBandwidth = false;  // EDX[2]
+  uint32_t maxRmid = 0;     // highest RMID of any resource, 0xF.0 EBX
+  uint32_t l3MaxRmid = 0;   // highest RMID of L3, 0xF.1 ECX
+  uint32_t upscale = 0;     // bytes per counter unit, 0xF.1 EBX
+  uint8_t counterWidth = 0; // bits, 24 + 0xF.1 EAX[7:0]
+  bool overflowBit = false; // 0xF.1 EAX[8]
+
+  bool present() const {
+    return l3Occupancy || l3TotalBandwidth || l3LocalBandwidth;
+  }
+};
+
+// Cache allocation (CAT) of one level: each class of service (CLOS) gets a
+// capacity bitmask over the cache's ways
+struct RdtCacheAllocation {
+  uint8_t cbmLength = 0;    // bits in a capacity mask; 0 when absent
+  uint32_t sharedMask = 0;  // bits other agents (I/O, GPU) also fill
+  uint16_t closCount = 0;   // highest COS + 1
+  bool cdp = false;         // code and data prioritization
+  bool nonContiguous = false;  // masks may have holes
+
+  bool present() const { return cbmLength > 0; }
+  uint32_t fullMask() const {
+    return cbmLength >= 32 ? ~0U : (1U << cbmLength) - 1;
+  }
+};
+
+// Memory bandwidth allocation per CLOS: on Intel a throttle from 0 (none)
+// to maxThrottle, on AMD a cap in 1/8 GB/s units up to maxThrottle
+struct RdtBandwidthAllocation {
+  uint32_t maxThrottle = 0;  // 0 when absent
+  uint16_t closCount = 0;
+  bool linear = false;    // the delay scale is linear
+  bool absolute = false;  // AMD: the value is a bandwidth cap
+
+  bool present() const { return maxThrottle > 0; }
+};
+
+// Where the allocation half of RdtInfo came from
+enum class RdtSource : uint8_t { None, Intel, Amd };
+
+struct RdtInfo {
+  RdtMonitoring monitoring;
+  RdtCacheAllocation l3;
+  RdtCacheAllocation l2;
+  RdtBandwidthAllocation bandwidth;
+  RdtSource source = RdtSource::None;
+
+  bool present() const {
+    return monitoring.present() || l3.present() || l2.present() ||
+           bandwidth.present();
+  }
+};
+
+// Leaves 0xF and 0x10 (Intel RDT), 0xF and 0x80000020 (AMD PQoS); each
+// part only when CPUID.7:EBX announces monitoring (bit 12) or allocation
+// (bit 15).
+RdtInfo decode_rdt(const CpuidSnapshot &snap);
+
+// Bytes of `cache` one capacity-mask bit stands for; 0 when either side
+// is unknown
+size_t rdt_bytes_per_bit(const RdtCacheAllocation &cat,
+                         const CacheLevel *cache);
+
+#endif  // RDT_HPP
@@ -0,0 +1,413 @@
+#include "report.hpp"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "cache.hpp"
+#include "features.hpp"
+#include "hypervisor.hpp"
+#include "pmu.hpp"
+#include "rdt.hpp"
+#include "simd.hpp"
+#include "tsc.hpp"
+#include "uarch.hpp"
+#include "utils.hpp"
+
+std::optional<ReportFormat> parse_report_format(std::string_view name) {
+  if (name == "human") return ReportFormat::Human;
+  if (name == "json") return ReportFormat::Json;
+  if (name == "csv") return ReportFormat::Csv;
+  if (name == "binary") return ReportFormat::Binary;
+  return std::nullopt;
+}
+
+void ReportBuffer::commit(size_t wanted) {
+  if (wanted > kCapacity - mSize) {
+    // format_to_n wrote the part that fit; drop it so no record is torn
+    mOverflow = true;
+    return;
+  }
+  mSize += wanted;
+}
+
+void ReportBuffer::append(std::string_view s) { append(s.data(), s.size()); }
+
+void ReportBuffer::append(const void *data, size_t n) {
+  if (n > kCapacity - mSize) {
+    mOverflow = true;
+    return;
+  }
+  std::memcpy(mData.data() + mSize, data, n);
+  mSize += n;
+}
+
+bool ReportBuffer::flush(int fd) {
+  bool ok = !mOverflow;
+  const char *p = mData.data();
+  size_t n = mSize;
+  // One write(2) unless the kernel takes less (e.g. a signal or a full pipe)
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      ok = false;
+      break;
+    }
+    p += w;
+    n -= size_t(w);
+  }
+  clear();
+  return ok;
+}
+
+namespace {
+
+enum BinaryTag : uint8_t {
+  kTagSection = 0,
+  kTagU64 = 1,
+  kTagBool = 2,
+  kTagString = 3,
+  kTagEnd = 0xFF
+};
+
+constexpr uint8_t kBinaryVersion = 1;
+
+}  // namespace
+
+ReportWriter::ReportWriter(ReportBuffer &out, ReportFormat format)
+    : mOut(out), mFormat(format) {}
+
+void ReportWriter::begin() {
+  mFirstSection = true;
+  switch (mFormat) {
+    case ReportFormat::Human:
+      break;
+    case ReportFormat::Json:
+      mOut.append("{");
+      break;
+    case ReportFormat::Csv:
+      mOut.append("section,key,value\n");
+      break;
+    case ReportFormat::Binary:
+      mOut.append("CPUR");
+      mOut.append(&kBinaryVersion, 1);
+      break;
+  }
+}
+
+void ReportWriter::section(std::string_view name) {
+  mSection = name;
+  mFirstField = true;
+  switch (mFormat) {
+    case ReportFormat::Human:
+      mOut.print("{}[{}]\n", mFirstSection ? "" : "\n", name);
+      break;
+    case ReportFormat::Json:
+      if (!mFirstSection) mOut.append("},");
+      jsonString(name);
+      mOut.append(":{");
+      break;
+    case ReportFormat::Csv:
+      break;
+    case ReportFormat::Binary:
+      binaryKey(kTagSection, name);
+      break;
+  }
+  mFirstSection = false;
+}
+
+void ReportWriter::field(std::string_view key, uint64_t value) {
+  switch (mFormat) {
+    case ReportFormat::Human:
+      mOut.print("{} = {}\n", key, value);
+      break;
+    case ReportFormat::Json:
+      jsonKey(key);
+      mOut.print("{}", value);
+      break;
+    case ReportFormat::Csv:
+      mOut.print("{},{},{}\n", mSection, key, value);
+      break;
+    case ReportFormat::Binary:
+      binaryKey(kTagU64, key);
+      // x86 is little-endian, so the in-memory bytes are the wire bytes
+      mOut.append(&value, sizeof(value));
+      break;
+  }
+}
+
+void ReportWriter::hexField(std::string_view key, uint64_t value) {
+  if (mFormat == ReportFormat::Human) {
+    mOut.print("{} = {:#X}\n", key, value);
+  } else {
+    field(key, value);
+  }
+}
+
+void ReportWriter::field(std::string_view key, bool value) {
+  switch (mFormat) {
+    case ReportFormat::Human:
+      mOut.print("{} = {}\n", key, int(value));
+      break;
+    case ReportFormat::Json:
+      jsonKey(key);
+      mOut.append(value ? "true" : "false");
+      break;
+    case ReportFormat::Csv:
+      mOut.print("{},{},{}\n", mSection, key, int(value));
+      break;
+    case ReportFormat::Binary: {
+      binaryKey(kTagBool, key);
+      uint8_t b = value;
+      mOut.append(&b, 1);
+      break;
+    }
+  }
+}
+
+void ReportWriter::field(std::string_view key, std::string_view value) {
+  switch (mFormat) {
+    case ReportFormat::Human:
+      mOut.print("{} = {}\n", key, value);
+      break;
+    case ReportFormat::Json:
+      jsonKey(key);
+      jsonString(value);
+      break;
+    case ReportFormat::Csv:
+      // Quote the value; CSV escapes a quote by doubling it
+      mOut.print("{},{},\"", mSection, key);
+      for (char c : value) {
+        if (c == '"') mOut.append("\"");
+        mOut.append(&c, 1);
+      }
+      mOut.append("\"\n");
+      break;
+    case ReportFormat::Binary: {
+      binaryKey(kTagString, key);
+      uint16_t n = uint16_t(std::min<size_t>(value.size(), UINT16_MAX));
+      mOut.append(&n, sizeof(n));
+      mOut.append(value.data(), n);
+      break;
+    }
+  }
+}
+
+void ReportWriter::end() {
+  switch (mFormat) {
+    case ReportFormat::Human:
+    case ReportFormat::Csv:
+      break;
+    case ReportFormat::Json:
+      mOut.append(mFirstSection ? "}\n" : "}}\n");
+      break;
+    case ReportFormat::Binary: {
+      uint8_t tag = kTagEnd;
+      mOut.append(&tag, 1);
+      break;
+    }
+  }
+}
+
+void ReportWriter::binaryKey(uint8_t tag, std::string_view key) {
+  uint8_t n = uint8_t(std::min<size_t>(key.size(), UINT8_MAX));
+  mOut.append(&tag, 1);
+  mOut.append(&n, 1);
+  mOut.append(key.data(), n);
+}
+
+void ReportWriter::jsonKey(std::string_view key) {
+  if (!mFirstField) mOut.append(",");
+  mFirstField = false;
+  jsonString(key);
+  mOut.append(":");
+}
+
+void ReportWriter::jsonString(std::string_view s) {
+  mOut.append("\"");
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      mOut.print("\\{}", c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      mOut.print("\\u{:04x}", unsigned(c));
+    } else {
+      mOut.append(&c, 1);
+    }
+  }
+  mOut.append("\"");
+}
+
+void write_report(ReportWriter &w, const CpuidSnapshot &snap) {
+  write_report(w, snap, decode_xsave(snap));
+}
+
+void write_report(ReportWriter &w, const CpuidSnapshot &snap,
+                  const XsaveInfo &xsave) {
+  w.begin();
+
+  const CpuidLeaf &l0 = snap.get(0x0);
+  w.section("vendor");
+  w.hexField("max_basic_leaf", l0.EAX());
+  w.hexField("max_extended_leaf", snap.maxExtendedLeaf());
+  w.field("vendor", regs_to_chars(l0.EBX(), l0.EDX(), l0.ECX()).view());
+
+  // Leaf 1 EAX/EBX, as decoded by cpuid_01H()
+  const CpuidLeaf &l1 = snap.get(0x1);
+  w.section("signature");
+  w.hexField("type", leaf1::Type::get(l1));
+  w.hexField("family", leaf1::Family::get(l1));
+  w.hexField("model", leaf1::Model::get(l1));
+  w.hexField("stepping", leaf1::Stepping::get(l1));
+  w.hexField("extended_model", leaf1::ExtendedModel::get(l1));
+  w.hexField("extended_family", leaf1::ExtendedFamily::get(l1));
+  w.hexField("real_model", leaf1::real_model(l1));
+  w.hexField("apic_id", leaf1::InitialApicId::get(l1));
+
+  // 48 characters from 0x80000002..4, NUL-padded, often space-prefixed
+  const CpuidLeaf &b0 = snap.get(0x80000002);
+  const CpuidLeaf &b1 = snap.get(0x80000003);
+  const CpuidLeaf &b2 = snap.get(0x80000004);
+  const auto brand =
+      regs_to_chars(b0.EAX(), b0.EBX(), b0.ECX(), b0.EDX(), b1.EAX(),
+                    b1.EBX(), b1.ECX(), b1.EDX(), b2.EAX(), b2.EBX(),
+                    b2.ECX(), b2.EDX());
+  std::string_view b = brand.view();
+  b = b.substr(0, b.find('\0'));
+  while (!b.empty() && b.front() == ' ') b.remove_prefix(1);
+  while (!b.empty() && b.back() == ' ') b.remove_suffix(1);
+  w.section("brand");
+  w.field("brand", b);
+
+  static constexpr std::string_view kClasses[] = {"core", "atom",
+                                                  "xeon_phi", "quark"};
+  static constexpr std::string_view kAvx512[] = {"unsupported", "heavy",
+                                                 "light", "none"};
+  w.section("uarch");
+  if (const Uarch *u = find_uarch(snap)) {
+    w.field("name", u->name);
+    w.field("core", u->core);
+    w.field("class", kClasses[size_t(u->cls)]);
+    w.field("avx512_downclock", kAvx512[size_t(u->avx512)]);
+    w.hexField("traits", u->traits);
+  } else {
+    w.field("name", std::string_view("unknown"));
+  }
+
+  static constexpr std::string_view kSuffix[] = {"", "d", "i", ""};
+  CacheHierarchy caches = decode_caches(snap);
+  w.section("cache");
+  for (uint8_t i = 0; i < caches.count; ++i) {
+    const CacheLevel &c = caches.caches[i];
+    char key[16];
+    auto r = std::format_to_n(key, sizeof(key), "L{}{}_bytes", c.level,
+                              kSuffix[size_t(c.type)]);
+    w.field(std::string_view(key, std::min(size_t(r.size), sizeof(key))),
+            uint64_t(c.sizeBytes));
+  }
+  w.field("line_size", uint64_t(caches.lineSize()));
+
+  TscInfo tsc = decode_tsc(snap);
+  w.section("tsc");
+  w.field("invariant", tsc.invariant);
+  w.field("hz", tsc.tscHz);
+  w.field("base_mhz", uint64_t(tsc.baseMHz));
+  w.field("max_mhz", uint64_t(tsc.maxMHz));
+
+  const HypervisorInfo hv = decode_hypervisor(snap);
+  const VirtHints hints = virt_hints(hv, tsc);
+  w.section("hypervisor");
+  w.field("vendor", hypervisor_name(hv.vendor));
+  w.field("signature", hv.signatureView());
+  w.hexField("base", hv.base);
+  w.hexField("max_leaf", hv.maxLeaf);
+  w.hexField("kvm_features", hv.kvm.features);
+  w.field("kvm_realtime", hv.kvm.realtime);
+  w.field("hyperv", hv.hyperv.present());
+  w.hexField("hyperv_privileges", hv.hyperv.privileges);
+  w.hexField("hyperv_recommendations", hv.hyperv.recommendations);
+  w.field("cache_cpuid", hints.cacheCpuid);
+  w.field("pv_spinlocks", hints.pvSpinlocks);
+  w.field("dedicated_cpus", hints.dedicatedCpus);
+  w.field("tsc_stable", hints.tscStable);
+  w.field("steal_time", hints.stealTime);
+  w.field("pv_tlb_flush", hints.pvTlbFlush);
+  w.field("pv_ipi", hints.pvIpi);
+  w.field("pv_sched_yield", hints.pvSchedYield);
+  w.field("spin_retries", uint64_t(hints.spinRetries));
+
+  const PmuInfo pmu = decode_pmu(snap);
+  w.section("pmu");
+  w.field("version", uint64_t(pmu.version));
+  w.field("gp_counters", uint64_t(pmu.gpCounters));
+  w.field("gp_width", uint64_t(pmu.gpWidth));
+  w.field("fixed_counters", uint64_t(pmu.fixedCounters));
+  w.field("fixed_width", uint64_t(pmu.fixedWidth));
+  w.hexField("gp_mask", pmu.gpMask);
+  w.hexField("fixed_mask", pmu.fixedMask);
+  w.hexField("events", pmu.events);
+
+  const RdtInfo rdt = decode_rdt(snap);
+  w.section("rdt");
+  w.field("l3_occupancy", rdt.monitoring.l3Occupancy);
+  w.field("l3_total_bandwidth", rdt.monitoring.l3TotalBandwidth);
+  w.field("l3_local_bandwidth", rdt.monitoring.l3LocalBandwidth);
+  w.field("max_rmid", uint64_t(rdt.monitoring.maxRmid));
+  w.field("l3_cbm_bits", uint64_t(rdt.l3.cbmLength));
+  w.field("l3_clos", uint64_t(rdt.l3.closCount));
+  w.field("l3_cdp", rdt.l3.cdp);
+  w.field("l2_cbm_bits", uint64_t(rdt.l2.cbmLength));
+  w.field("l2_clos", uint64_t(rdt.l2.closCount));
+  w.field("mba_max", uint64_t(rdt.bandwidth.maxThrottle));
+  w.field("mba_clos", uint64_t(rdt.bandwidth.closCount));
+
+  const FeatureSet features(snap);
+  const FeatureSet usable = usable_features(features, xsave);
+  w.section("xsave");
+  w.field("osxsave", xsave.osxsave);
+  w.hexField("xcr0", xsave.xcr0);
+  w.field("xcr0_source",
+          std::string_view(xsave.xcr0Read ? "xgetbv" : "estimated"));
+  w.hexField("permitted", xsave.permitted);
+  w.field("enabled_size", uint64_t(xsave.enabledSize));
+  w.field("max_size", uint64_t(xsave.maxSize));
+  w.field("xsavec", xsave.xsavec);
+  w.field("widest_tier", tier_name(widest_tier(usable)));
+  // What a context switch saves for each tier
+  for (size_t t = size_t(VectorTier::SSE); t < std::size(kTierState); ++t) {
+    char key[24];
+    auto r = std::format_to_n(key, sizeof(key), "{}_state_bytes",
+                              tier_name(VectorTier(t)));
+    w.field(std::string_view(key, std::min(size_t(r.size), sizeof(key))),
+            uint64_t(xsave.switchSize(kTierState[t])));
+  }
+  const SimdCaps simd = decode_simd(snap, usable);
+  w.section("simd");
+  w.field("max_bits", uint64_t(simd.maxBits));
+  w.field("avx10_version", uint64_t(simd.avx10.version));
+  w.field("avx10_max_bits", uint64_t(simd.avx10.maxBits()));
+  w.field("amx_palettes", uint64_t(simd.amx.paletteCount));
+  w.field("amx_tiles", uint64_t(simd.amx.palette().maxNames));
+  w.field("amx_max_rows", uint64_t(simd.amx.palette().maxRows));
+  w.field("amx_bytes_per_row", uint64_t(simd.amx.palette().bytesPerRow));
+  w.field("amx_tile_bytes", uint64_t(simd.amx.palette().bytesPerTile));
+  w.field("tmul_max_k", uint64_t(simd.amx.tmulMaxK));
+  w.field("tmul_max_n", uint64_t(simd.amx.tmulMaxN));
+
+  // CPUID reports these, but their register state is not enabled for us
+  w.section("withheld");
+  for (const FeatureDesc &desc : kFeatures) {
+    if (features.has(desc.id) && !usable.has(desc.id)) {
+      w.field(desc.name, false);
+    }
+  }
+
+  w.section("features");
+  for (const FeatureDesc &desc : kFeatures) {
+    w.field(desc.name, features.has(desc.id));
+  }
+
+  w.end();
+}
@@ -0,0 +1,98 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string_view>
+
+#include "snapshot.hpp"
+#include "xsave.hpp"
+
+enum class ReportFormat : uint8_t { Human, Json, Csv, Binary };
+
+// "human", "json", "csv" or "binary"
+std::optional<ReportFormat> parse_report_format(std::string_view name);
+
+// Fixed-capacity output buffer. Text is formatted in place with
+// std::format_to_n and handed to the kernel with one write(2), so building
+// and emitting a report never touches the heap. Output that does not fit
+// is dropped and flagged rather than grown.
+class ReportBuffer {
+ public:
+  static constexpr size_t kCapacity = 64 * 1024;
+
+  template <typename... Args>
+  void print(std::format_string<Args...> fmt, Args &&...args) {
+    auto r = std::format_to_n(mData.data() + mSize, kCapacity - mSize, fmt,
+                              std::forward<Args>(args)...);
+    commit(size_t(r.size));
+  }
+  void append(std::string_view s);
+  void append(const void *data, size_t n);
+
+  std::string_view view() const { return {mData.data(), mSize}; }
+  size_t size() const { return mSize; }
+  // True once anything was dropped for lack of space
+  bool overflowed() const { return mOverflow; }
+  void clear() {
+    mSize = 0;
+    mOverflow = false;
+  }
+
+  // Writes the contents to `fd` (normally with a single write(2)) and
+  // clears the buffer. Returns false on I/O error or earlier overflow.
+  bool flush(int fd);
+
+ private:
+  void commit(size_t wanted);
+
+  std::array<char, kCapacity> mData;
+  size_t mSize = 0;
+  bool mOverflow = false;
+};
+
+// Emits (section, key, value) fields in one of the ReportFormat layouts:
+//   Human   "[section]" headers, then "key = value" lines
+//   Json    {"section":{"key":value,...},...}
+//   Csv     "section,key,value" rows after a header row
+//   Binary  "CPUR" + version byte, then records of
+//           u8 tag, u8 key length, key, value; values are u64 LE (tag 1),
+//           u8 (tag 2) or u16 LE length + bytes (tag 3); tag 0 opens a
+//           section, tag 0xFF ends the report
+class ReportWriter {
+ public:
+  ReportWriter(ReportBuffer &out, ReportFormat format);
+
+  void begin();
+  void section(std::string_view name);
+  void field(std::string_view key, uint64_t value);
+  // Human output prints these in hex
+  void hexField(std::string_view key, uint64_t value);
+  void field(std::string_view key, bool value);
+  void field(std::string_view key, std::string_view value);
+  void end();
+
+ private:
+  void binaryKey(uint8_t tag, std::string_view key);
+  void jsonKey(std::string_view key);
+  void jsonString(std::string_view s);
+
+  ReportBuffer &mOut;
+  ReportFormat mFormat;
+  std::string_view mSection;
+  bool mFirstSection = true;
+  bool mFirstField = true;
+};
+
+// The standard host report: vendor and signature (leaves 0 and 1), brand
+// string, caches, TSC, XSAVE state, vector capabilities and every feature
+// flag. Allocation-free.
+void write_report(ReportWriter &w, const CpuidSnapshot &snap,
+                  const XsaveInfo &xsave);
+// XSAVE state estimated from the leaves (see decode_xsave())
+void write_report(ReportWriter &w, const CpuidSnapshot &snap);
+
+#endif  // REPORT_HPP
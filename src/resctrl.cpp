@@ -0,0 +1,287 @@
+#include "resctrl.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string_view>
+
+namespace {
+
+// One schemata line: "L3:0=7ff;1=7ff", names padded with spaces
+struct SchemataLine {
+  std::string resource;
+  std::vector<std::pair<uint32_t, std::string>> values;  // domain, value
+};
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\n')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+std::vector<SchemataLine> read_schemata(const std::string &path) {
+  std::vector<SchemataLine> out;
+  std::ifstream in(path);
+  for (std::string raw; std::getline(in, raw);) {
+    std::string_view line = trim(raw);
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) continue;
+    SchemataLine &l = out.emplace_back();
+    l.resource = trim(line.substr(0, colon));
+    std::string_view rest = line.substr(colon + 1);
+    while (!rest.empty()) {
+      size_t semi = rest.find(';');
+      std::string_view item = trim(rest.substr(0, semi));
+      rest = semi == std::string_view::npos ? "" : rest.substr(semi + 1);
+      size_t eq = item.find('=');
+      uint32_t domain;
+      if (eq == std::string_view::npos ||
+          std::from_chars(item.data(), item.data() + eq, domain).ec !=
+              std::errc()) {
+        continue;
+      }
+      l.values.emplace_back(domain, std::string(item.substr(eq + 1)));
+    }
+  }
+  return out;
+}
+
+std::optional<uint64_t> read_number(const std::string &path, int base = 10) {
+  std::ifstream in(path);
+  std::string text;
+  if (!std::getline(in, text)) return std::nullopt;
+  std::string_view v = trim(text);
+  uint64_t value;
+  auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), value, base);
+  if (ec != std::errc() || end != v.data() + v.size()) return std::nullopt;
+  return value;
+}
+
+// resctrl applies (and validates) what one write() carries, so the whole
+// text goes in a single call. O_CREAT only matters for stand-in trees.
+bool write_file(const std::string &path, std::string_view text, int flags) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+  if (fd < 0) return false;
+  ssize_t n = ::write(fd, text.data(), text.size());
+  bool ok = n == ssize_t(text.size());
+  return ::close(fd) == 0 && ok;
+}
+
+// One directory directly under the root: no separators, no way up, and
+// none of the kernel's own entries there ("" is the root group itself)
+bool group_name(std::string_view name) {
+  return name.find('/') == std::string_view::npos &&
+         name.find("..") == std::string_view::npos && name != "." &&
+         name != "info" && name != "mon_groups" && name != "mon_data";
+}
+
+std::string domain_values(const std::vector<uint32_t> &domains,
+                          std::string_view value) {
+  std::string out;
+  for (uint32_t d : domains) {
+    out += std::format("{}{}={}", out.empty() ? "" : ";", d, value);
+  }
+  return out;
+}
+
+}  // namespace
+
+std::optional<Resctrl> Resctrl::open(const std::string &root) {
+  Resctrl r(root);
+  for (const SchemataLine &l : read_schemata(root + "/schemata")) {
+    std::vector<uint32_t> *domains = nullptr;
+    if (l.resource == "L3" || l.resource == "L3DATA") {
+      domains = &r.mDomains;
+      r.mCdp = l.resource == "L3DATA";
+    } else if (l.resource == "MB") {
+      domains = &r.mMbDomains;
+    }
+    if (!domains) continue;
+    domains->clear();
+    for (const auto &[domain, value] : l.values) domains->push_back(domain);
+  }
+
+  // With CDP mounted the L3 info lives under L3DATA (and L3CODE)
+  std::string info = root + (r.mCdp ? "/info/L3DATA" : "/info/L3");
+  r.mL3.cbmMask = uint32_t(read_number(info + "/cbm_mask", 16).value_or(0));
+  r.mL3.minCbmBits = uint32_t(read_number(info + "/min_cbm_bits").value_or(1));
+  r.mL3.shareableBits =
+      uint32_t(read_number(info + "/shareable_bits", 16).value_or(0));
+  r.mL3.numClosids = uint32_t(read_number(info + "/num_closids").value_or(0));
+  if (!r.mL3.present() || r.mDomains.empty()) return std::nullopt;
+  return r;
+}
+
+std::string Resctrl::path(const std::string &name) const {
+  return name.empty() ? mRoot : mRoot + "/" + name;
+}
+
+unsigned Resctrl::waysFor(size_t bytes, size_t l3Bytes) const {
+  const unsigned bits = unsigned(std::popcount(mL3.cbmMask));
+  if (bits == 0) return 0;
+  const size_t perWay = l3Bytes / bits;
+  unsigned ways = perWay ? unsigned((bytes + perWay - 1) / perWay) : bits;
+  return std::clamp(ways, std::min(mL3.minCbmBits, bits), bits);
+}
+
+unsigned Resctrl::waysFor(size_t bytes, const CacheHierarchy &caches) const {
+  const CacheLevel *l3 = caches.data(3);
+  return waysFor(bytes, l3 ? l3->sizeBytes : 0);
+}
+
+uint32_t Resctrl::lowMask(unsigned ways) const {
+  uint32_t mask = 0;
+  for (uint32_t bit = 1; bit && ways; bit <<= 1) {
+    if (mL3.cbmMask & bit) {
+      mask |= bit;
+      --ways;
+    }
+  }
+  return mask;
+}
+
+bool Resctrl::writeSchemata(const std::string &name, uint32_t l3Mask,
+                            std::optional<unsigned> bandwidth) const {
+  if (bandwidth && mMbDomains.empty()) return false;
+  const std::string file = path(name) + "/schemata";
+  std::string mask = std::format("{:x}", l3Mask);
+  std::string text;
+  if (mCdp) {
+    text = std::format("L3CODE:{0}\nL3DATA:{0}\n",
+                       domain_values(mDomains, mask));
+  } else {
+    text = std::format("L3:{}\n", domain_values(mDomains, mask));
+  }
+  if (bandwidth) {
+    text += std::format("MB:{}\n",
+                        domain_values(mMbDomains, std::to_string(*bandwidth)));
+  }
+  // Other resources are written back unchanged: the kernel keeps what a
+  // write leaves out anyway, a plain file would lose it
+  for (const SchemataLine &l : read_schemata(file)) {
+    if (l.resource.starts_with("L3") || (bandwidth && l.resource == "MB")) {
+      continue;
+    }
+    std::string values;
+    for (const auto &[domain, value] : l.values) {
+      values += std::format("{}{}={}", values.empty() ? "" : ";", domain,
+                            value);
+    }
+    text += std::format("{}:{}\n", l.resource, values);
+  }
+  return write_file(file, text, O_TRUNC);
+}
+
+bool Resctrl::createGroup(const std::string &name, uint32_t l3Mask,
+                          std::optional<unsigned> bandwidth) {
+  if ((l3Mask & ~mL3.cbmMask) ||
+      unsigned(std::popcount(l3Mask)) < mL3.minCbmBits) {
+    return false;
+  }
+  if (!group_name(name)) return false;
+  // Out of CLOSIDs, mkdir fails with ENOSPC
+  if (!name.empty() && mkdir(path(name).c_str(), 0755) != 0 &&
+      errno != EEXIST) {
+    return false;
+  }
+  return writeSchemata(name, l3Mask, bandwidth);
+}
+
+std::optional<uint32_t> Resctrl::reserve(const std::string &name,
+                                         size_t bytes,
+                                         const CacheHierarchy &caches) {
+  if (name.empty()) return std::nullopt;
+  const uint32_t mine = lowMask(waysFor(bytes, caches));
+  const uint32_t rest = mL3.cbmMask & ~mine;
+  if (unsigned(std::popcount(rest)) < mL3.minCbmBits) return std::nullopt;
+  if (!createGroup(name, mine) || !writeSchemata("", rest, std::nullopt)) {
+    return std::nullopt;
+  }
+  return mine;
+}
+
+bool Resctrl::removeGroup(const std::string &name) {
+  if (name.empty() || !group_name(name)) return false;
+  // The kernel drops a group's files with the directory; a stand-in tree
+  // is its creator's to clean up
+  return rmdir(path(name).c_str()) == 0;
+}
+
+bool Resctrl::assignTask(const std::string &name, pid_t tid) {
+  if (tid == 0) tid = gettid();
+  return write_file(path(name) + "/tasks", std::format("{}\n", tid),
+                    O_APPEND);
+}
+
+std::vector<pid_t> Resctrl::tasks(const std::string &name) const {
+  std::vector<pid_t> out;
+  std::ifstream in(path(name) + "/tasks");
+  for (pid_t tid; in >> tid;) out.push_back(tid);
+  return out;
+}
+
+std::vector<std::string> Resctrl::groups() const {
+  std::vector<std::string> out;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(mRoot, ec)) {
+    std::string name = entry.path().filename().string();
+    if (!entry.is_directory() || name == "info" || name == "mon_groups" ||
+        name == "mon_data") {
+      continue;
+    }
+    out.push_back(std::move(name));
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+std::optional<uint32_t> Resctrl::mask(const std::string &name) const {
+  for (const SchemataLine &l : read_schemata(path(name) + "/schemata")) {
+    if ((l.resource != "L3" && l.resource != "L3DATA") || l.values.empty()) {
+      continue;
+    }
+    const std::string &v = l.values.front().second;
+    uint32_t mask;
+    if (std::from_chars(v.data(), v.data() + v.size(), mask, 16).ec ==
+        std::errc()) {
+      return mask;
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<ResctrlUsage> Resctrl::usage(const std::string &name) const {
+  std::vector<ResctrlUsage> out;
+  std::error_code ec;
+  const std::string dir = path(name) + "/mon_data";
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string domainDir = entry.path().filename().string();
+    constexpr std::string_view kPrefix = "mon_L3_";
+    if (!domainDir.starts_with(kPrefix)) continue;
+    ResctrlUsage &u = out.emplace_back();
+    std::from_chars(domainDir.data() + kPrefix.size(),
+                    domainDir.data() + domainDir.size(), u.domain);
+    // "Unavailable" (no RMID reading yet) leaves a counter at 0
+    const std::string base = entry.path().string();
+    u.llcOccupancyBytes = read_number(base + "/llc_occupancy").value_or(0);
+    u.mbmTotalBytes = read_number(base + "/mbm_total_bytes").value_or(0);
+    u.mbmLocalBytes = read_number(base + "/mbm_local_bytes").value_or(0);
+  }
+  std::sort(out.begin(), out.end(),
+            [](const ResctrlUsage &a, const ResctrlUsage &b) {
+              return a.domain < b.domain;
+            });
+  return out;
+}
@@ -0,0 +1,102 @@
+#ifndef RESCTRL_HPP
+#define RESCTRL_HPP
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+
+inline constexpr const char *kResctrlRoot = "/sys/fs/resctrl";
+
+// info/L3 of a mounted resctrl file system
+struct ResctrlCacheInfo {
+  uint32_t cbmMask = 0;        // cbm_mask: every way
+  uint32_t minCbmBits = 1;     // min_cbm_bits
+  uint32_t shareableBits = 0;  // shareable_bits: ways I/O also fills
+  uint32_t numClosids = 0;     // num_closids
+
+  bool present() const { return cbmMask != 0; }
+};
+
+// Monitoring counters of a group on one L3 domain
+struct ResctrlUsage {
+  uint32_t domain = 0;  // L3 cache id
+  uint64_t llcOccupancyBytes = 0;
+  // Running totals since the group was created
+  uint64_t mbmTotalBytes = 0;
+  uint64_t mbmLocalBytes = 0;
+};
+
+// Resource groups under a resctrl mount. `root` can be a stand-in tree
+// with the same layout: a `schemata` file (L3 and optionally MB lines),
+// info/L3/{cbm_mask,min_cbm_bits,shareable_bits,num_closids}, and per
+// group `schemata`, `tasks` and mon_data/mon_L3_NN/{llc_occupancy,
+// mbm_total_bytes,mbm_local_bytes}. The empty group name is the default
+// group, the root itself.
+class Resctrl {
+ public:
+  // nullopt unless `root` has a schemata file and info/L3
+  static std::optional<Resctrl> open(const std::string &root = kResctrlRoot);
+
+  const std::string &root() const { return mRoot; }
+  const ResctrlCacheInfo &l3() const { return mL3; }
+  // L3 cache ids, from the default group's schemata
+  const std::vector<uint32_t> &domains() const { return mDomains; }
+  // Schemata carries L3CODE/L3DATA lines instead of L3
+  bool cdp() const { return mCdp; }
+  // Memory bandwidth allocation is mounted (an MB line)
+  bool bandwidth() const { return !mMbDomains.empty(); }
+
+  // Ways whose share of an L3 of `l3Bytes` covers `bytes`, clamped to
+  // min_cbm_bits and the whole mask
+  unsigned waysFor(size_t bytes, size_t l3Bytes) const;
+  unsigned waysFor(size_t bytes, const CacheHierarchy &caches) const;
+  // The lowest `ways` bits of cbm_mask. Current parts put the shareable
+  // (I/O) ways at the top, so they stay with the default group.
+  uint32_t lowMask(unsigned ways) const;
+
+  // Creates `name` (or reuses it) and sets its L3 mask on every domain,
+  // plus the MB value (percent, or AMD bandwidth units) when given. Group
+  // names may not contain '/' or "..", nor be ".", "info", "mon_groups" or
+  // "mon_data".
+  bool createGroup(const std::string &name, uint32_t l3Mask,
+                   std::optional<unsigned> bandwidth = std::nullopt);
+  // Gives `name` the low ways covering `bytes` and shrinks the default
+  // group to the remaining ways, so tasks left there stop evicting it.
+  // Returns the group's mask; nullopt when too few ways would remain.
+  std::optional<uint32_t> reserve(const std::string &name, size_t bytes,
+                                  const CacheHierarchy &caches);
+  // rmdir of the group, as the kernel expects; on a stand-in tree that
+  // fails while the group still holds files
+  bool removeGroup(const std::string &name);
+
+  // Moves thread `tid` (0: the calling thread) into `name`
+  bool assignTask(const std::string &name, pid_t tid = 0);
+  std::vector<pid_t> tasks(const std::string &name) const;
+  // Groups other than the default one
+  std::vector<std::string> groups() const;
+  // The group's L3 mask on its first domain, from its schemata
+  std::optional<uint32_t> mask(const std::string &name) const;
+  // One entry per mon_data/mon_L3_NN directory; empty without monitoring
+  std::vector<ResctrlUsage> usage(const std::string &name) const;
+
+ private:
+  explicit Resctrl(std::string root) : mRoot(std::move(root)) {}
+  std::string path(const std::string &name) const;
+  bool writeSchemata(const std::string &name, uint32_t l3Mask,
+                     std::optional<unsigned> bandwidth) const;
+
+  std::string mRoot;
+  ResctrlCacheInfo mL3;
+  std::vector<uint32_t> mDomains;
+  std::vector<uint32_t> mMbDomains;
+  bool mCdp = false;
+};
+
+#endif  // RESCTRL_HPP
@@ -0,0 +1,206 @@
+#include "shared_snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "simd.hpp"
+#include "tsc.hpp"
+
+static size_t segment_size(uint32_t capacity) {
+  return sizeof(SharedSnapshotHeader) + size_t(capacity) * sizeof(CpuidLeaf);
+}
+
+static bool layout_matches(const SharedSnapshotHeader *h, size_t size) {
+  return std::memcmp(h->magic, kSharedSnapshotMagic,
+                     sizeof(kSharedSnapshotMagic)) == 0 &&
+         h->version == kSharedSnapshotVersion &&
+         h->featureCount == kFeatureCount &&
+         h->recordSize == sizeof(CpuidLeaf) &&
+         size == segment_size(h->capacity);
+}
+
+std::optional<SnapshotPublisher> SnapshotPublisher::create(
+    const std::string &name, uint32_t capacity) {
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) return std::nullopt;
+  // One writer per segment; taken before the size is looked at, so a
+  // second publisher never sees a half-initialized header either
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  struct stat st;
+  bool fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+  size_t size = fresh ? segment_size(capacity) : size_t(st.st_size);
+  if (fresh && ftruncate(fd, off_t(size)) != 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  auto *header = static_cast<SharedSnapshotHeader *>(addr);
+  if (fresh) {
+    // ftruncate zero-filled the segment: seq 0, no leaves. The magic goes
+    // last so readers reject it until the layout fields are in place.
+    header->version = kSharedSnapshotVersion;
+    header->capacity = capacity;
+    header->featureCount = kFeatureCount;
+    header->recordSize = sizeof(CpuidLeaf);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, kSharedSnapshotMagic, sizeof(header->magic));
+  } else if (!layout_matches(header, size)) {
+    munmap(addr, size);
+    close(fd);
+    return std::nullopt;
+  }
+  return SnapshotPublisher(header, size, fd);
+}
+
+SnapshotPublisher::SnapshotPublisher(SnapshotPublisher &&other) noexcept
+    : mHeader(std::exchange(other.mHeader, nullptr)),
+      mSize(other.mSize),
+      mFd(std::exchange(other.mFd, -1)) {}
+
+SnapshotPublisher::~SnapshotPublisher() {
+  if (mHeader) munmap(mHeader, mSize);
+  // Closing the last descriptor releases the lock
+  if (mFd >= 0) close(mFd);
+}
+
+bool SnapshotPublisher::publish(const CpuidSnapshot &snap,
+                                const XsaveInfo &xsave, uint64_t tscHz) {
+  std::span<const CpuidLeaf> leaves = snap.leaves();
+  if (leaves.size() > mHeader->capacity) return false;
+
+  // Decode before entering the write section so it stays short
+  SharedHostInfo info{};
+  const CpuidLeaf &l0 = snap.get(0x0);
+  info.fingerprint = {.vendor = {l0.EBX(), l0.EDX(), l0.ECX()},
+                      .signature = snap.get(0x1).EAX(),
+                      .microcode = host_fingerprint().microcode,
+                      .reserved = 0};
+  info.generation = mHeader->info.generation + 1;
+  info.xcr0 = xsave.xcr0;
+  info.tscHz = tscHz;
+  info.features = FeatureSet(snap);
+  info.usable = usable_features(info.features, xsave);
+  const SimdCaps simd = decode_simd(snap, info.usable);
+  info.maxVectorBits = simd.maxBits;
+  info.tier = uint8_t(simd.tier);
+  info.invariantTsc = decode_tsc(snap).invariant;
+  info.lineSize = uint16_t(decode_caches(snap).lineSize());
+
+  // A publisher that died mid-write left the counter odd; start past it
+  uint64_t seq = mHeader->seq.load(std::memory_order_relaxed);
+  seq += seq & 1;
+  mHeader->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&mHeader->info, &info, sizeof(info));
+  mHeader->leafCount = uint32_t(leaves.size());
+  std::memcpy(reinterpret_cast<CpuidLeaf *>(mHeader + 1), leaves.data(),
+              leaves.size_bytes());
+  mHeader->seq.store(seq + 2, std::memory_order_release);
+  return true;
+}
+
+bool SnapshotPublisher::unlink(const std::string &name) {
+  return shm_unlink(name.c_str()) == 0;
+}
+
+std::optional<SnapshotReader> SnapshotReader::open(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) return std::nullopt;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      size_t(st.st_size) < sizeof(SharedSnapshotHeader)) {
+    close(fd);
+    return std::nullopt;
+  }
+  size_t size = size_t(st.st_size);
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return std::nullopt;
+
+  auto *header = static_cast<const SharedSnapshotHeader *>(addr);
+  if (!layout_matches(header, size)) {
+    munmap(addr, size);
+    return std::nullopt;
+  }
+  return SnapshotReader(header, size);
+}
+
+SnapshotReader::SnapshotReader(SnapshotReader &&other) noexcept
+    : mHeader(std::exchange(other.mHeader, nullptr)), mSize(other.mSize) {}
+
+SnapshotReader::~SnapshotReader() {
+  if (mHeader) munmap(const_cast<SharedSnapshotHeader *>(mHeader), mSize);
+}
+
+std::span<const CpuidLeaf> SnapshotReader::leaves() const {
+  return {reinterpret_cast<const CpuidLeaf *>(mHeader + 1),
+          std::min(mHeader->leafCount, mHeader->capacity)};
+}
+
+std::optional<SharedHostInfo> SnapshotReader::info() const {
+  return read([](const SharedHostInfo &info, auto) { return info; });
+}
+
+std::optional<bool> SnapshotReader::has(Feature f) const {
+  return read(
+      [f](const SharedHostInfo &info, auto) { return info.features.has(f); });
+}
+
+std::optional<bool> SnapshotReader::usable(Feature f) const {
+  return read(
+      [f](const SharedHostInfo &info, auto) { return info.usable.has(f); });
+}
+
+std::optional<uint64_t> SnapshotReader::generation() const {
+  return read(
+      [](const SharedHostInfo &info, auto) { return info.generation; });
+}
+
+std::optional<CpuidLeaf> SnapshotReader::get(uint32_t leaf,
+                                             uint32_t subleaf) const {
+  uint64_t key = (uint64_t(leaf) << 32) | subleaf;
+  return read([key](const SharedHostInfo &,
+                    std::span<const CpuidLeaf> leaves) {
+    // The records are sorted unless torn, and a torn read is retried
+    auto it = std::lower_bound(
+        leaves.begin(), leaves.end(), key,
+        [](const CpuidLeaf &l, uint64_t k) { return l.key() < k; });
+    if (it == leaves.end() || it->key() != key) {
+      return CpuidLeaf{uint32_t(key >> 32), uint32_t(key), {0, 0, 0, 0}};
+    }
+    return *it;
+  });
+}
+
+std::optional<CpuidSnapshot> SnapshotReader::snapshot() const {
+  // Sized outside the read section: allocating inside it would stretch
+  // the window a publish can tear
+  auto owned = std::make_shared<std::vector<CpuidLeaf>>(mHeader->capacity);
+  std::optional<size_t> n = read([&](const SharedHostInfo &,
+                                     std::span<const CpuidLeaf> leaves) {
+    std::copy(leaves.begin(), leaves.end(), owned->begin());
+    return leaves.size();
+  });
+  if (!n) return std::nullopt;
+  owned->resize(*n);
+  std::span<const CpuidLeaf> records(*owned);
+  return CpuidSnapshot(records, std::move(owned));
+}
@@ -0,0 +1,174 @@
+#ifndef SHARED_SNAPSHOT_HPP
+#define SHARED_SNAPSHOT_HPP
+
+#include <immintrin.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "features.hpp"
+#include "snapshot.hpp"
+#include "snapshot_file.hpp"
+#include "xsave.hpp"
+
+// POSIX shared-memory name of the host-wide segment
+inline constexpr const char *kSharedSnapshotName = "/cpuid-snapshot";
+
+// What every process would otherwise decode for itself. Fixed layout, so
+// it can be copied out of the segment as plain bytes.
+struct SharedHostInfo {
+  HostFingerprint fingerprint;
+  uint64_t generation;  // bumped by every publish
+  uint64_t xcr0;
+  uint64_t tscHz;  // 0 when neither the leaves nor calibration gave one
+  FeatureSet features;  // as reported by CPUID
+  FeatureSet usable;    // backed by enabled XSAVE state (AMX tile data
+                        // still needs each process's own permission)
+  uint16_t maxVectorBits;
+  uint8_t tier;  // VectorTier
+  uint8_t invariantTsc;
+  uint16_t lineSize;
+  uint16_t reserved;
+};
+
+// Segment layout, native endian (x86 only). Everything from `info` on is
+// written under the sequence counter: odd while the publisher writes,
+// bumped to the next even value when it is done.
+struct SharedSnapshotHeader {
+  char magic[8];  // "CPUIDSHM"
+  uint32_t version;
+  uint32_t capacity;      // CpuidLeaf records after the header
+  uint32_t featureCount;  // kFeatureCount of the publisher
+  uint32_t recordSize;
+  alignas(64) std::atomic<uint64_t> seq;
+  alignas(64) SharedHostInfo info;
+  uint32_t leafCount;
+};
+
+inline constexpr char kSharedSnapshotMagic[8] = {'C', 'P', 'U', 'I',
+                                                 'D', 'S', 'H', 'M'};
+inline constexpr uint32_t kSharedSnapshotVersion = 1;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the sequence counter is shared between processes");
+static_assert(sizeof(SharedSnapshotHeader) % alignof(CpuidLeaf) == 0);
+
+// Creates (or reopens) the segment and rewrites it on demand. Readers never
+// wait for the publisher: a publish is a handful of stores bracketed by the
+// sequence counter, and readers that overlap it retry. Two writers would
+// corrupt the counter, so a publisher holds an exclusive flock() on the
+// segment for its lifetime; the kernel drops it when the process dies.
+class SnapshotPublisher {
+ public:
+  // Maps `name` read-write, creating it with room for `capacity` leaves.
+  // An existing segment is reused (mapped readers stay valid) when its
+  // layout matches; otherwise nullopt. Also nullopt while another
+  // publisher holds the segment.
+  static std::optional<SnapshotPublisher> create(
+      const std::string &name = kSharedSnapshotName, uint32_t capacity = 1024);
+
+  SnapshotPublisher(SnapshotPublisher &&other) noexcept;
+  SnapshotPublisher &operator=(SnapshotPublisher &&other) noexcept {
+    std::swap(mHeader, other.mHeader);
+    std::swap(mSize, other.mSize);
+    std::swap(mFd, other.mFd);
+    return *this;
+  }
+  ~SnapshotPublisher();
+
+  // Writes `snap`, decoded against `xsave`, as the next generation.
+  // Returns false when it holds more leaves than the segment.
+  bool publish(const CpuidSnapshot &snap, const XsaveInfo &xsave,
+               uint64_t tscHz);
+  uint64_t generation() const { return mHeader->info.generation; }
+
+  // Removes the name; mapped readers keep their view
+  static bool unlink(const std::string &name = kSharedSnapshotName);
+
+ private:
+  SnapshotPublisher(SharedSnapshotHeader *header, size_t size, int fd)
+      : mHeader(header), mSize(size), mFd(fd) {}
+
+  SharedSnapshotHeader *mHeader;
+  size_t mSize;
+  int mFd;  // holds the publisher lock
+};
+
+// Read-only view of a published segment. Mapping it costs one shm_open and
+// one mmap; after that every query is plain loads under the sequence
+// counter, with no system call and no lock.
+class SnapshotReader {
+ public:
+  // nullopt when the segment is missing, from another layout version, or
+  // from a build with a different feature table
+  static std::optional<SnapshotReader> open(
+      const std::string &name = kSharedSnapshotName);
+
+  SnapshotReader(SnapshotReader &&other) noexcept;
+  SnapshotReader &operator=(SnapshotReader &&other) noexcept {
+    std::swap(mHeader, other.mHeader);
+    std::swap(mSize, other.mSize);
+    return *this;
+  }
+  ~SnapshotReader();
+
+  // Attempts before read() gives up: the first kReadSpins pause, the rest
+  // yield. A publish takes microseconds, so running out means the counter
+  // is stuck odd, i.e. the publisher died mid-write and no new one has
+  // started yet.
+  static constexpr uint32_t kReadSpins = 256;
+  static constexpr uint32_t kReadAttempts = 1U << 16;
+
+  // Runs `f(info, leaves)` until it sees a state no publish overlapped and
+  // returns its result; nullopt after kReadAttempts tries. `f` must only
+  // copy out of the segment: it can see a torn state, which is then
+  // discarded.
+  template <typename F>
+  auto read(F &&f) const
+      -> std::optional<decltype(f(std::declval<const SharedHostInfo &>(),
+                                  std::span<const CpuidLeaf>()))> {
+    for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt) {
+      uint64_t seq = mHeader->seq.load(std::memory_order_acquire);
+      if (seq & 1) {
+        if (attempt < kReadSpins) {
+          _mm_pause();
+        } else {
+          std::this_thread::yield();
+        }
+        continue;
+      }
+      auto result = f(mHeader->info, leaves());
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (mHeader->seq.load(std::memory_order_relaxed) == seq) return result;
+    }
+    return std::nullopt;
+  }
+
+  // Each is nullopt when read() gives up
+  std::optional<SharedHostInfo> info() const;
+  std::optional<bool> has(Feature f) const;
+  std::optional<bool> usable(Feature f) const;
+  std::optional<uint64_t> generation() const;
+  // All-zero record when the leaf was not published, as CpuidSnapshot::get
+  std::optional<CpuidLeaf> get(uint32_t leaf, uint32_t subleaf = 0) const;
+  // Consistent private copy of every published leaf
+  std::optional<CpuidSnapshot> snapshot() const;
+
+ private:
+  SnapshotReader(const SharedSnapshotHeader *header, size_t size)
+      : mHeader(header), mSize(size) {}
+
+  // Bounded by the capacity, so a torn count cannot read past the mapping
+  std::span<const CpuidLeaf> leaves() const;
+
+  const SharedSnapshotHeader *mHeader;
+  size_t mSize;
+};
+
+#endif  // SHARED_SNAPSHOT_HPP
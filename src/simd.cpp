@@ -0,0 +1,154 @@
+#include "simd.hpp"
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+// CPUID.(EAX=24H,ECX=0): AVX10 converged vector ISA
+namespace leaf24 {
+using Version = Field<CpuidReg::EBX, 7, 0>;
+using Vl128 = Bit<CpuidReg::EBX, 16>;
+using Vl256 = Bit<CpuidReg::EBX, 17>;
+using Vl512 = Bit<CpuidReg::EBX, 18>;
+}  // namespace leaf24
+
+// CPUID.(EAX=1DH,ECX=palette): tile information
+namespace leaf1d {
+using MaxPalette = Field<CpuidReg::EAX, 31, 0>;  // subleaf 0
+using TotalTileBytes = Field<CpuidReg::EAX, 15, 0>;
+using BytesPerTile = Field<CpuidReg::EAX, 31, 16>;
+using BytesPerRow = Field<CpuidReg::EBX, 15, 0>;
+using MaxNames = Field<CpuidReg::EBX, 31, 16>;
+using MaxRows = Field<CpuidReg::ECX, 15, 0>;
+}  // namespace leaf1d
+
+// CPUID.(EAX=1EH,ECX=0): TMUL information
+namespace leaf1e {
+using MaxK = Field<CpuidReg::EBX, 7, 0>;
+using MaxN = Field<CpuidReg::EBX, 23, 8>;
+}  // namespace leaf1e
+
+SimdCaps decode_simd(const CpuidSnapshot &snap, const FeatureSet &usable) {
+  SimdCaps caps;
+  caps.usable = usable;
+  caps.tier = widest_tier(usable);
+
+  const FeatureSet cpuid(snap);
+  if (cpuid.has(Feature::AVX10) && snap.maxBasicLeaf() >= 0x24) {
+    const CpuidLeaf &l = snap.get(0x24);
+    caps.avx10.version = leaf24::Version::get(l);
+    caps.avx10.vl128 = leaf24::Vl128::get(l);
+    caps.avx10.vl256 = leaf24::Vl256::get(l);
+    caps.avx10.vl512 = leaf24::Vl512::get(l);
+  }
+
+  if (cpuid.has(Feature::AMX_TILE) && snap.maxBasicLeaf() >= 0x1D) {
+    AmxInfo &amx = caps.amx;
+    amx.paletteCount = uint8_t(std::min<uint32_t>(
+        leaf1d::MaxPalette::get(snap.get(0x1D, 0)), AmxInfo::kMaxPalettes));
+    for (uint8_t p = 0; p < amx.paletteCount; ++p) {
+      const CpuidLeaf &l = snap.get(0x1D, p + 1);
+      amx.palettes[p] = {uint16_t(leaf1d::TotalTileBytes::get(l)),
+                         uint16_t(leaf1d::BytesPerTile::get(l)),
+                         uint16_t(leaf1d::BytesPerRow::get(l)),
+                         uint16_t(leaf1d::MaxNames::get(l)),
+                         uint16_t(leaf1d::MaxRows::get(l))};
+    }
+    if (snap.maxBasicLeaf() >= 0x1E) {
+      const CpuidLeaf &l = snap.get(0x1E, 0);
+      amx.tmulMaxK = uint8_t(leaf1e::MaxK::get(l));
+      amx.tmulMaxN = uint16_t(leaf1e::MaxN::get(l));
+    }
+  }
+
+  // AVX10 can cap EVEX vectors below 512 bits; otherwise the tier decides
+  if (usable.has(Feature::AVX512F)) {
+    caps.maxBits = 512;
+  } else if (usable.has(Feature::AVX10)) {
+    caps.maxBits = caps.avx10.maxBits();
+  } else if (usable.has(Feature::AVX)) {
+    caps.maxBits = 256;
+  } else if (usable.has(Feature::SSE2)) {
+    caps.maxBits = 128;
+  }
+
+  if (const Uarch *u = find_uarch(snap)) {
+    caps.avx512Freq = u->avx512;
+    caps.traits = u->traits;
+  }
+  return caps;
+}
+
+// The features a tier itself requires; AVX10 stands in for AVX512F
+static bool tier_usable(const SimdCaps &caps, VectorTier tier) {
+  switch (tier) {
+    case VectorTier::Scalar:
+      return true;
+    case VectorTier::SSE:
+      return caps.has(Feature::SSE2);
+    case VectorTier::AVX:
+      return caps.has(Feature::AVX);
+    case VectorTier::AVX512:
+      return caps.has(Feature::AVX512F) || caps.has(Feature::AVX10);
+    case VectorTier::AMX:
+      return caps.has(Feature::AMX_TILE);
+  }
+  return false;
+}
+
+SimdAdvice advise(const SimdCaps &caps,
+                  std::span<const KernelVariant> variants, KernelLoad load) {
+  SimdAdvice advice;
+  advice.reason = "no variant runs here";
+  for (size_t i = 0; i < variants.size(); ++i) {
+    const KernelVariant &v = variants[i];
+    if (!tier_usable(caps, v.tier) || !caps.usable.hasAll(v.needs)) continue;
+    advice.variant = i;
+    advice.tier = v.tier;
+    break;
+  }
+  if (advice.variant == SimdAdvice::npos) return advice;
+
+  switch (advice.tier) {
+    case VectorTier::Scalar:
+      advice.vectorBits = 0;
+      advice.reason = "scalar variant";
+      break;
+    case VectorTier::SSE:
+      advice.vectorBits = 128;
+      advice.reason = "SSE registers";
+      break;
+    case VectorTier::AVX:
+      if (caps.has(UarchTrait::Split256)) {
+        // Two 128-bit halves per op: no throughput gain, only longer
+        // latency and AVX-SSE transition hazards
+        advice.vectorBits = 128;
+        advice.reason = "256-bit ops split in two on this core";
+      } else {
+        advice.vectorBits = 256;
+        advice.reason = "full-width 256-bit units";
+      }
+      break;
+    case VectorTier::AVX512:
+    case VectorTier::AMX: {
+      // EVEX code at 256 bits needs AVX512VL (or AVX10/256)
+      bool narrow = caps.has(Feature::AVX512VL) || caps.avx10.vl256;
+      if (caps.maxBits < 512) {
+        advice.vectorBits = caps.maxBits;
+        advice.reason = "AVX10 vector length limit";
+      } else if (load == KernelLoad::Heavy &&
+                 caps.avx512Freq == Avx512Freq::LicenseHeavy && narrow) {
+        advice.vectorBits = 256;
+        advice.reason = "512-bit heavy ops lower the core clock";
+      } else if (caps.has(UarchTrait::Avx512DoublePumped)) {
+        advice.vectorBits = 512;
+        advice.reason = "double-pumped 512-bit ops, no clock penalty";
+      } else {
+        advice.vectorBits = 512;
+        advice.reason = "full-width 512-bit units";
+      }
+      break;
+    }
+  }
+  return advice;
+}
@@ -0,0 +1,96 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "features.hpp"
+#include "snapshot.hpp"
+#include "uarch.hpp"
+#include "xsave.hpp"
+
+// AVX10 version and vector lengths, CPUID.(EAX=24H,ECX=0):EBX
+struct Avx10Info {
+  uint8_t version = 0;  // EBX[7:0]; 0 without AVX10
+  bool vl128 = false;   // EBX[16]
+  bool vl256 = false;   // EBX[17]
+  bool vl512 = false;   // EBX[18]
+
+  uint16_t maxBits() const {
+    return vl512 ? 512 : vl256 ? 256 : vl128 ? 128 : 0;
+  }
+};
+
+// One tile palette, CPUID.(EAX=1DH,ECX=palette)
+struct AmxPalette {
+  uint16_t totalTileBytes = 0;  // EAX[15:0]
+  uint16_t bytesPerTile = 0;    // EAX[31:16]
+  uint16_t bytesPerRow = 0;     // EBX[15:0]
+  uint16_t maxNames = 0;        // EBX[31:16], tile registers
+  uint16_t maxRows = 0;         // ECX[15:0]
+};
+
+// Tile geometry (leaf 0x1D) and TMUL limits (leaf 0x1E)
+struct AmxInfo {
+  static constexpr size_t kMaxPalettes = 4;
+
+  uint8_t paletteCount = 0;  // palettes 1..paletteCount; 0 is reserved
+  std::array<AmxPalette, kMaxPalettes> palettes{};
+  uint8_t tmulMaxK = 0;      // 0x1E EBX[7:0], rows and columns
+  uint16_t tmulMaxN = 0;     // 0x1E EBX[23:8], column bytes
+
+  // Palette 1, the one LDTILECFG programs today
+  const AmxPalette &palette() const { return palettes[0]; }
+};
+
+// What vector code can use on this host. Geometry is decoded from the raw
+// leaves; tier and maxBits only count state the OS enabled (see
+// usable_features()).
+struct SimdCaps {
+  FeatureSet usable;
+  VectorTier tier = VectorTier::Scalar;
+  uint16_t maxBits = 0;  // widest usable vector register
+  Avx10Info avx10;
+  AmxInfo amx;
+  // From the microarchitecture table; Unsupported and 0 when unknown
+  Avx512Freq avx512Freq = Avx512Freq::Unsupported;
+  uint32_t traits = 0;
+
+  bool has(Feature f) const { return usable.has(f); }
+  bool has(UarchTrait t) const { return traits & uint32_t(t); }
+};
+
+SimdCaps decode_simd(const CpuidSnapshot &snap, const FeatureSet &usable);
+
+// One implementation of a kernel: the tier it is written for and the
+// extensions it needs beyond that tier's baseline (SSE2, AVX, AVX512F or
+// AVX10, AMX-TILE), e.g. {VectorTier::AVX512, {Feature::AVX512_VNNI}}
+struct KernelVariant {
+  VectorTier tier;
+  FeatureSet needs;
+};
+
+// Heavy kernels keep the FP or integer multipliers busy on every lane;
+// those are the ones Skylake-SP style frequency licences punish
+enum class KernelLoad : uint8_t { Light, Heavy };
+
+struct SimdAdvice {
+  static constexpr size_t npos = size_t(-1);
+
+  size_t variant = npos;  // index of the chosen KernelVariant
+  VectorTier tier = VectorTier::Scalar;
+  uint16_t vectorBits = 0;  // preferred width; 0 for scalar code
+  std::string_view reason;
+};
+
+// Picks the first of `variants` (listed best first, as for Dispatcher)
+// this host can run and the vector width it should run at. With no match
+// the advice is scalar with variant == npos.
+SimdAdvice advise(const SimdCaps &caps,
+                  std::span<const KernelVariant> variants,
+                  KernelLoad load = KernelLoad::Light);
+
+#endif  // SIMD_HPP
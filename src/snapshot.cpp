@@ -0,0 +1,223 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+
+#include "backend.hpp"
+
+// Upper bounds so a buggy or hostile (virtual) CPU cannot make us loop forever
+#define MAX_LEAVES_PER_RANGE 0x100
+#define MAX_SUBLEAVES        64
+
+CpuidSnapshot::CpuidSnapshot() : CpuidSnapshot(NativeBackend::instance()) {}
+
+CpuidSnapshot::CpuidSnapshot(const CpuidBackend &backend) {
+  mOwned.reserve(128);
+
+  // Basic leaves: EAX=0 returns the highest supported basic leaf
+  mMaxBasic = std::min(query(backend, 0x0, 0).EAX(),
+                       uint32_t(MAX_LEAVES_PER_RANGE - 1));
+  enumerateRange(backend, 0x1, mMaxBasic);
+
+  // Hypervisor leaves are only meaningful with CPUID.1:ECX[31] set
+  if (get(0x1).ECX() & (1U << 31)) {
+    mMaxHypervisor = query(backend, 0x40000000, 0).EAX();
+    // KVM reports 0 here, meaning "0x40000001 is the highest leaf"
+    if (mMaxHypervisor < 0x40000001) mMaxHypervisor = 0x40000001;
+    mMaxHypervisor = std::min(
+        mMaxHypervisor, uint32_t(0x40000000 + MAX_LEAVES_PER_RANGE - 1));
+    enumerateRange(backend, 0x40000001, mMaxHypervisor);
+    // KVM and Xen move their own leaves up by 0x100 when they also offer
+    // Hyper-V enlightenments at 0x40000000
+    uint32_t maxAlt = query(backend, 0x40000100, 0).EAX();
+    if (maxAlt > 0x40000100 &&
+        maxAlt < 0x40000100 + MAX_LEAVES_PER_RANGE) {
+      enumerateRange(backend, 0x40000101, maxAlt);
+    }
+  }
+
+  // Extended leaves: a max value outside 0x8000xxxx means "not supported"
+  uint32_t maxExt = query(backend, 0x80000000, 0).EAX();
+  if ((maxExt & 0xFFFF0000) == 0x80000000) {
+    mMaxExtended =
+        std::min(maxExt, uint32_t(0x80000000 + MAX_LEAVES_PER_RANGE - 1));
+    enumerateRange(backend, 0x80000001, mMaxExtended);
+  }
+}
+
+CpuidSnapshot::CpuidSnapshot(std::span<const CpuidLeaf> leaves,
+                             std::shared_ptr<const void> owner)
+    : mOwner(std::move(owner)), mLeaves(leaves) {
+  // Limits are the highest leaf present in each range
+  for (const CpuidLeaf &l : mLeaves) {
+    if (l.leaf < 0x40000000) {
+      mMaxBasic = l.leaf;
+    } else if (l.leaf < 0x80000000) {
+      // Not the relocated 0x400001xx range
+      if (l.leaf < 0x40000100) mMaxHypervisor = l.leaf;
+    } else if ((get(0x80000000).EAX() & 0xFFFF0000) == 0x80000000) {
+      mMaxExtended = l.leaf;
+    }
+  }
+}
+
+CpuidSnapshot &CpuidSnapshot::operator=(const CpuidSnapshot &other) {
+  if (this == &other) return *this;
+  mOwned = other.mOwned;
+  mOwner = other.mOwner;
+  mLeaves = mOwner ? other.mLeaves : std::span<const CpuidLeaf>(mOwned);
+  mMaxBasic = other.mMaxBasic;
+  mMaxExtended = other.mMaxExtended;
+  mMaxHypervisor = other.mMaxHypervisor;
+  mExecutions = other.mExecutions;
+  return *this;
+}
+
+const CpuidSnapshot &CpuidSnapshot::host() {
+  static const CpuidSnapshot snap;
+  return snap;
+}
+
+CpuVendor CpuidSnapshot::vendor() const {
+  // First four characters of the vendor string, in EBX
+  switch (get(0x0).EBX()) {
+    case 0x756E6547:  // "GenuineIntel"
+      return CpuVendor::Intel;
+    case 0x68747541:  // "AuthenticAMD"
+      return CpuVendor::AMD;
+    case 0x6F677948:  // "HygonGenuine"
+      return CpuVendor::Hygon;
+    default:
+      return CpuVendor::Other;
+  }
+}
+
+const CpuidLeaf &CpuidSnapshot::query(const CpuidBackend &backend,
+                                      uint32_t leaf, uint32_t subleaf) {
+  ++mExecutions;
+  mOwned.push_back(backend.query(leaf, subleaf));
+  mLeaves = mOwned;
+  return mOwned.back();
+}
+
+void CpuidSnapshot::enumerateRange(const CpuidBackend &backend,
+                                   uint32_t first, uint32_t last) {
+  // Subleaf 0 of every leaf in the range is one batch; the subleaves each
+  // leaf needs depend on its subleaf 0, so they follow one leaf at a time.
+  std::vector<CpuidLeaf> batch;
+  batch.reserve(last - first + 1);
+  for (uint32_t leaf = first; leaf <= last; ++leaf) {
+    batch.push_back({leaf, 0, {0, 0, 0, 0}});
+  }
+  backend.queryBatch(batch);
+  mExecutions += batch.size();
+
+  // Ranges and subleaves are visited in ascending order, so mOwned stays
+  // sorted without an explicit sort.
+  for (const CpuidLeaf &l : batch) {
+    mOwned.push_back(l);
+    mLeaves = mOwned;
+    enumerateSubleaves(backend, l);
+  }
+}
+
+// Subleaf enumeration rules, per Intel SDM Vol. 2A and AMD APM Vol. 3
+void CpuidSnapshot::enumerateSubleaves(const CpuidBackend &backend,
+                                       const CpuidLeaf &first) {
+  const uint32_t leaf = first.leaf;
+  const uint32_t eax = first.EAX();
+
+  switch (leaf) {
+    // Deterministic cache parameters: stop at cache type 0 (null)
+    case 0x4:
+    case 0x8000001D:
+      for (uint32_t sub = 1; (eax & 0x1F) && sub < MAX_SUBLEAVES; ++sub) {
+        if ((query(backend, leaf, sub).EAX() & 0x1F) == 0) break;
+      }
+      break;
+
+    // Topology levels: stop at level type 0 (invalid)
+    case 0xB:
+    case 0x1F:
+    case 0x80000026:
+      for (uint32_t sub = 1;
+           ((first.ECX() >> 8) & 0xFF) && sub < MAX_SUBLEAVES; ++sub) {
+        if (((query(backend, leaf, sub).ECX() >> 8) & 0xFF) == 0) break;
+      }
+      break;
+
+    // Subleaf 0 EAX reports the highest valid subleaf
+    case 0x7:
+    case 0x14:
+    case 0x17:
+    case 0x18:
+    case 0x1D:
+    case 0x1E:
+    case 0x20:
+    case 0x24:
+      for (uint32_t sub = 1; sub <= std::min(eax, uint32_t(MAX_SUBLEAVES));
+           ++sub) {
+        query(backend, leaf, sub);
+      }
+      break;
+
+    // XSAVE: subleaf 1, then one subleaf per supported XCR0 | IA32_XSS bit
+    case 0xD: {
+      uint64_t mask = (uint64_t(first.EDX()) << 32) | first.EAX();
+      const CpuidLeaf &sub1 = query(backend, leaf, 1);
+      mask |= (uint64_t(sub1.EDX()) << 32) | sub1.ECX();
+      for (uint32_t sub = 2; sub < 63; ++sub) {
+        if (mask & (uint64_t(1) << sub)) query(backend, leaf, sub);
+      }
+      break;
+    }
+
+    // RDT monitoring / allocation: subleaf 0 holds a bitmap of resource IDs
+    case 0xF:
+    case 0x10:
+    case 0x80000020: {
+      uint32_t bitmap = leaf == 0xF ? first.EDX() : first.EBX();
+      for (uint32_t sub = 1; sub < 32; ++sub) {
+        if (bitmap & (1U << sub)) query(backend, leaf, sub);
+      }
+      break;
+    }
+
+    // SGX: attributes in subleaf 1, then EPC sections until type 0
+    case 0x12:
+      if (!(get(0x7).EBX() & (1U << 2))) break;
+      query(backend, leaf, 1);
+      for (uint32_t sub = 2; sub < MAX_SUBLEAVES; ++sub) {
+        if ((query(backend, leaf, sub).EAX() & 0xF) == 0) break;
+      }
+      break;
+
+    // Architectural PMU extended leaf: subleaf 0 EAX is a bitmap
+    case 0x23:
+      for (uint32_t sub = 1; sub < 32; ++sub) {
+        if (eax & (1U << sub)) query(backend, leaf, sub);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+const CpuidLeaf *CpuidSnapshot::find(uint32_t leaf, uint32_t subleaf) const {
+  uint64_t key = (uint64_t(leaf) << 32) | subleaf;
+  auto it = std::lower_bound(
+      mLeaves.begin(), mLeaves.end(), key,
+      [](const CpuidLeaf &l, uint64_t k) { return l.key() < k; });
+  if (it == mLeaves.end() || it->key() != key) return nullptr;
+  return &*it;
+}
+
+const CpuidLeaf &CpuidSnapshot::get(uint32_t leaf, uint32_t subleaf) const {
+  static const CpuidLeaf kEmpty{};
+  const CpuidLeaf *l = find(leaf, subleaf);
+  return l ? *l : kEmpty;
+}
+
+bool CpuidSnapshot::contains(uint32_t leaf, uint32_t subleaf) const {
+  return find(leaf, subleaf) != nullptr;
+}
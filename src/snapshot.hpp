@@ -0,0 +1,94 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+class CpuidBackend;
+
+enum class CpuVendor : uint8_t { Other, Intel, AMD, Hygon };
+
+// Index into CpuidLeaf::regs
+enum class CpuidReg : uint8_t { EAX, EBX, ECX, EDX };
+
+// One CPUID result, keyed by (leaf, subleaf).
+struct CpuidLeaf {
+  uint32_t leaf;
+  uint32_t subleaf;
+  uint32_t regs[4];
+
+  const uint32_t &EAX() const { return regs[0]; }
+  const uint32_t &EBX() const { return regs[1]; }
+  const uint32_t &ECX() const { return regs[2]; }
+  const uint32_t &EDX() const { return regs[3]; }
+
+  uint64_t key() const { return (uint64_t(leaf) << 32) | subleaf; }
+};
+
+// Every basic, hypervisor and extended leaf (with its subleaves) of the
+// calling CPU, queried once and kept in a flat array sorted by (leaf,
+// subleaf). Lookups never execute `cpuid` again.
+class CpuidSnapshot {
+ public:
+  // Enumerates the calling CPU through NativeBackend
+  CpuidSnapshot();
+  // Enumerates through `backend`, e.g. a ReplayBackend holding a recorded
+  // machine; the backend is not used after construction
+  explicit CpuidSnapshot(const CpuidBackend &backend);
+  // Wraps records owned elsewhere (e.g. a mapped snapshot file) without
+  // copying them; `owner` keeps them alive. Records must be sorted by key().
+  CpuidSnapshot(std::span<const CpuidLeaf> leaves,
+                std::shared_ptr<const void> owner);
+
+  CpuidSnapshot(const CpuidSnapshot &other) { *this = other; }
+  CpuidSnapshot &operator=(const CpuidSnapshot &other);
+  CpuidSnapshot(CpuidSnapshot &&) noexcept = default;
+  CpuidSnapshot &operator=(CpuidSnapshot &&) noexcept = default;
+
+  // Snapshot of the CPU that first calls it, built once per process
+  static const CpuidSnapshot &host();
+
+  // Returns the record for (leaf, subleaf), or an all-zero record when the
+  // leaf was not enumerated (the same answer an unsupported leaf gives).
+  const CpuidLeaf &get(uint32_t leaf, uint32_t subleaf = 0) const;
+  bool contains(uint32_t leaf, uint32_t subleaf = 0) const;
+
+  // Decoded from the leaf 0 vendor string
+  CpuVendor vendor() const;
+
+  uint32_t maxBasicLeaf() const { return mMaxBasic; }
+  uint32_t maxExtendedLeaf() const { return mMaxExtended; }
+  // 0 when no hypervisor is present
+  uint32_t maxHypervisorLeaf() const { return mMaxHypervisor; }
+
+  std::span<const CpuidLeaf> leaves() const { return mLeaves; }
+  size_t size() const { return mLeaves.size(); }
+  // Number of backend queries made to build the snapshot; equals size()
+  // since every (leaf, subleaf) is queried exactly once, and 0 for a
+  // snapshot wrapping existing records.
+  size_t executions() const { return mExecutions; }
+
+ private:
+  const CpuidLeaf *find(uint32_t leaf, uint32_t subleaf) const;
+  const CpuidLeaf &query(const CpuidBackend &backend, uint32_t leaf,
+                         uint32_t subleaf);
+  // Queries the subleaves that `first` (subleaf 0, already recorded) implies
+  void enumerateSubleaves(const CpuidBackend &backend, const CpuidLeaf &first);
+  void enumerateRange(const CpuidBackend &backend, uint32_t first,
+                      uint32_t last);
+
+  std::vector<CpuidLeaf> mOwned;
+  // Keeps externally owned records alive; null when mOwned is used
+  std::shared_ptr<const void> mOwner;
+  // The records, in mOwned or external storage
+  std::span<const CpuidLeaf> mLeaves;
+  uint32_t mMaxBasic = 0;
+  uint32_t mMaxExtended = 0;
+  uint32_t mMaxHypervisor = 0;
+  size_t mExecutions = 0;
+};
+
+#endif  // SNAPSHOT_HPP
@@ -0,0 +1,139 @@
+#include "snapshot_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "cpuid.hpp"
+
+static uint64_t fnv1a(const void *data, size_t n) {
+  auto *p = static_cast<const unsigned char *>(data);
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < n; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static uint32_t read_microcode() {
+  // Same value for every CPU after a late load; cpu0 is always present
+  FILE *f = fopen("/sys/devices/system/cpu/cpu0/microcode/version", "r");
+  if (!f) return 0;
+  unsigned rev = 0;
+  if (fscanf(f, "%x", &rev) != 1) rev = 0;
+  fclose(f);
+  return rev;
+}
+
+HostFingerprint host_fingerprint() {
+  CPUID2 leaf0(0x0, 0);
+  CPUID2 leaf1(0x1, 0);
+  return {.vendor = {leaf0.EBX(), leaf0.EDX(), leaf0.ECX()},
+          .signature = leaf1.EAX(),
+          .microcode = read_microcode(),
+          .reserved = 0};
+}
+
+static bool write_all(int fd, const void *data, size_t n) {
+  auto *p = static_cast<const char *>(data);
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0) return false;
+    p += w;
+    n -= size_t(w);
+  }
+  return true;
+}
+
+bool write_snapshot_file(const std::string &path, const CpuidSnapshot &snap,
+                         const HostFingerprint &fingerprint) {
+  std::span<const CpuidLeaf> leaves = snap.leaves();
+  SnapshotFileHeader header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.headerSize = sizeof(header);
+  header.fingerprint = fingerprint;
+  header.leafCount = uint32_t(leaves.size());
+  header.recordSize = sizeof(CpuidLeaf);
+  header.checksum = fnv1a(leaves.data(), leaves.size_bytes());
+
+  // Readers never observe a partial file: write aside, then rename
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+  bool ok = write_all(fd, &header, sizeof(header)) &&
+            write_all(fd, leaves.data(), leaves.size_bytes()) &&
+            fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+// Owns a read-only mapping; released when the last snapshot drops it
+struct Mapping {
+  Mapping(void *a, size_t n) : addr(a), size(n) {}
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  ~Mapping() { munmap(addr, size); }
+
+  void *addr;
+  size_t size;
+};
+
+}  // namespace
+
+std::optional<CpuidSnapshot> map_snapshot_file(
+    const std::string &path, const HostFingerprint &expected) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::nullopt;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SnapshotFileHeader)) {
+    close(fd);
+    return std::nullopt;
+  }
+  size_t size = size_t(st.st_size);
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return std::nullopt;
+  auto mapping = std::make_shared<const Mapping>(addr, size);
+
+  auto *header = static_cast<const SnapshotFileHeader *>(addr);
+  if (std::memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) ||
+      header->version != kSnapshotVersion ||
+      header->headerSize != sizeof(SnapshotFileHeader) ||
+      header->recordSize != sizeof(CpuidLeaf) ||
+      size != sizeof(SnapshotFileHeader) +
+                  size_t(header->leafCount) * sizeof(CpuidLeaf) ||
+      !(header->fingerprint == expected)) {
+    return std::nullopt;
+  }
+
+  std::span<const CpuidLeaf> leaves(
+      reinterpret_cast<const CpuidLeaf *>(header + 1), header->leafCount);
+  if (fnv1a(leaves.data(), leaves.size_bytes()) != header->checksum ||
+      !std::is_sorted(leaves.begin(), leaves.end(),
+                      [](const CpuidLeaf &a, const CpuidLeaf &b) {
+                        return a.key() < b.key();
+                      })) {
+    return std::nullopt;
+  }
+  return CpuidSnapshot(leaves, std::move(mapping));
+}
+
+CpuidSnapshot load_or_enumerate(const std::string &path) {
+  if (auto mapped = map_snapshot_file(path, host_fingerprint())) {
+    return std::move(*mapped);
+  }
+  return CpuidSnapshot();
+}
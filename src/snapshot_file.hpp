@@ -0,0 +1,58 @@
+#ifndef SNAPSHOT_FILE_HPP
+#define SNAPSHOT_FILE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "snapshot.hpp"
+
+// Identifies the CPU a snapshot file was written on. A snapshot is only
+// reused when every field matches the live host.
+struct HostFingerprint {
+  uint32_t vendor[3];  // leaf 0 EBX, EDX, ECX
+  uint32_t signature;  // leaf 1 EAX: family/model/stepping
+  uint32_t microcode;  // revision from sysfs, 0 when unreadable
+  uint32_t reserved;
+
+  bool operator==(const HostFingerprint &) const = default;
+};
+
+// Fingerprint of the running host: two `cpuid` calls and one sysfs read
+HostFingerprint host_fingerprint();
+
+// On-disk layout, native endian (x86 only):
+//   SnapshotFileHeader, then leafCount packed CpuidLeaf records
+struct SnapshotFileHeader {
+  char magic[8];  // "CPUIDSNP"
+  uint32_t version;
+  uint32_t headerSize;
+  HostFingerprint fingerprint;
+  uint32_t leafCount;
+  uint32_t recordSize;
+  uint64_t checksum;  // FNV-1a over the records
+};
+
+inline constexpr char kSnapshotMagic[8] = {'C', 'P', 'U', 'I',
+                                           'D', 'S', 'N', 'P'};
+inline constexpr uint32_t kSnapshotVersion = 1;
+
+static_assert(sizeof(CpuidLeaf) == 24, "record layout is part of the format");
+static_assert(sizeof(SnapshotFileHeader) == 56,
+              "header layout is part of the format");
+
+// Writes `snap` atomically (temporary file + rename). Returns false on I/O
+// errors.
+bool write_snapshot_file(const std::string &path, const CpuidSnapshot &snap,
+                         const HostFingerprint &fingerprint);
+
+// Maps `path` read-only and wraps its records without copying. Returns
+// nullopt when the file is missing, malformed, or not from `expected`.
+std::optional<CpuidSnapshot> map_snapshot_file(const std::string &path,
+                                               const HostFingerprint &expected);
+
+// Reuses the host-wide snapshot at `path` when it matches this host, else
+// enumerates live.
+CpuidSnapshot load_or_enumerate(const std::string &path);
+
+#endif  // SNAPSHOT_FILE_HPP
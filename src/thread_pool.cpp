@@ -0,0 +1,340 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Worker identity of the calling thread
+thread_local const ThreadPool *tlPool = nullptr;
+thread_local int tlWorker = -1;
+
+// Idle rounds a worker spends stealing before it sleeps
+constexpr unsigned kSpinRounds = 64;
+
+uint64_t next_random(uint64_t &state) {
+  // xorshift64
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Only the owning worker writes its counters
+void bump(std::atomic<uint64_t> &counter, uint64_t n = 1) {
+  counter.store(counter.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+}
+
+}  // namespace
+
+StealLevel steal_level(const Topology &topo, int thief, int victim) {
+  if (topo.siblings(thief, TopoLevel::Core).contains(victim)) {
+    return StealLevel::Smt;
+  }
+  if (topo.cacheSiblings(thief, 2).contains(victim)) return StealLevel::L2;
+  if (topo.cacheSiblings(thief, 3).contains(victim)) return StealLevel::L3;
+  if (topo.siblings(thief, TopoLevel::Die).contains(victim)) {
+    return StealLevel::Die;
+  }
+  if (topo.siblings(thief, TopoLevel::Package).contains(victim)) {
+    return StealLevel::Package;
+  }
+  return StealLevel::Remote;
+}
+
+bool ThreadPool::Deque::push(Node *node) {
+  int64_t b = mBottom.load(std::memory_order_relaxed);
+  int64_t t = mTop.load(std::memory_order_acquire);
+  if (b - t >= kCapacity) return false;
+  mSlots[b & (kCapacity - 1)].store(node, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  mBottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+ThreadPool::Node *ThreadPool::Deque::pop() {
+  int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+  mBottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = mTop.load(std::memory_order_relaxed);
+  if (t > b) {
+    mBottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Node *node = mSlots[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // Last task: race the thieves for it
+    if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      node = nullptr;
+    }
+    mBottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return node;
+}
+
+ThreadPool::Node *ThreadPool::Deque::steal() {
+  int64_t t = mTop.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = mBottom.load(std::memory_order_acquire);
+  if (t >= b) return nullptr;
+  Node *node = mSlots[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+  // Lost to the owner or another thief; the caller moves on
+  if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return node;
+}
+
+ThreadPool::ThreadPool(const Topology &topo, Options options)
+    : mOrder(options.order) {
+  // First thread of every core in x2APIC order, then their SMT siblings
+  std::vector<const LogicalCpu *> byApic;
+  for (size_t i = 0; i < topo.size(); ++i) byApic.push_back(&topo[i]);
+  std::sort(byApic.begin(), byApic.end(),
+            [](const LogicalCpu *a, const LogicalCpu *b) {
+              return a->x2apicId < b->x2apicId;
+            });
+  std::vector<int> primary, secondary;
+  std::vector<const CpuSet *> seenCores;
+  for (const LogicalCpu *c : byApic) {
+    const CpuSet *core = &topo.siblings(c->cpu, TopoLevel::Core);
+    if (std::find(seenCores.begin(), seenCores.end(), core) ==
+        seenCores.end()) {
+      seenCores.push_back(core);
+      primary.push_back(c->cpu);
+    } else {
+      secondary.push_back(c->cpu);
+    }
+  }
+  std::vector<int> cpus = primary;
+  if (options.smt || options.workers > primary.size()) {
+    cpus.insert(cpus.end(), secondary.begin(), secondary.end());
+  }
+  size_t count = options.workers ? options.workers
+                 : options.smt   ? cpus.size()
+                                 : primary.size();
+  count = std::max<size_t>(count, 1);
+
+  // More workers than CPUs share them round-robin; with no topology at
+  // all they float
+  for (size_t i = 0; i < count; ++i) {
+    auto w = std::make_unique<Worker>();
+    w->cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    w->rng = 0x9E3779B97F4A7C15ull * (i + 1);
+    mWorkers.push_back(std::move(w));
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Worker &w = *mWorkers[i];
+    for (size_t j = 0; j < count; ++j) {
+      if (j == i) continue;
+      w.victims.push_back(
+          {uint32_t(j), steal_level(topo, w.cpu, mWorkers[j]->cpu)});
+    }
+    std::stable_sort(w.victims.begin(), w.victims.end(),
+                     [](const Victim &a, const Victim &b) {
+                       return a.level < b.level;
+                     });
+    for (size_t l = 0; l < kStealLevels; ++l) {
+      w.levelEnd[l] = uint32_t(std::count_if(
+          w.victims.begin(), w.victims.end(),
+          [l](const Victim &v) { return size_t(v.level) <= l; }));
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    mWorkers[i]->thread = std::thread([this, i, pin = options.pin] {
+      tlPool = this;
+      tlWorker = int(i);
+      Worker &w = *mWorkers[i];
+      if (pin && w.cpu >= 0) pin_thread_to_cpu(w.cpu);
+      run(w);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  mStop.store(true, std::memory_order_seq_cst);
+  mEpoch.fetch_add(1, std::memory_order_seq_cst);
+  mEpoch.notify_all();
+  for (auto &w : mWorkers) w->thread.join();
+}
+
+int ThreadPool::currentWorker() const {
+  return tlPool == this ? tlWorker : -1;
+}
+
+void ThreadPool::push(Task task, TaskGroup *group) {
+  Node *node = new Node{std::move(task), group};
+  int self = currentWorker();
+  if (self >= 0) {
+    Worker &w = *mWorkers[self];
+    if (!w.deque.push(node)) {
+      execute(w, node);
+      return;
+    }
+  } else {
+    std::lock_guard lock(mInjectLock);
+    mInjected.push_back(node);
+    mInjectedCount.fetch_add(1, std::memory_order_release);
+  }
+  wake();
+}
+
+void ThreadPool::wake() {
+  // Pairs with the sleeper's increment of mSleeping: either it is seen
+  // here or the sleeper's last scan sees the task just pushed
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (mSleeping.load(std::memory_order_relaxed) > 0) {
+    mEpoch.fetch_add(1, std::memory_order_release);
+    mEpoch.notify_one();
+  }
+}
+
+ThreadPool::Node *ThreadPool::find(Worker &w) {
+  if (Node *node = w.deque.pop()) {
+    bump(w.counters[kLocal]);
+    return node;
+  }
+  if (mInjectedCount.load(std::memory_order_acquire) > 0) {
+    std::lock_guard lock(mInjectLock);
+    if (!mInjected.empty()) {
+      Node *node = mInjected.front();
+      mInjected.pop_front();
+      mInjectedCount.fetch_sub(1, std::memory_order_relaxed);
+      bump(w.counters[kInjected]);
+      return node;
+    }
+  }
+  return steal(w);
+}
+
+ThreadPool::Node *ThreadPool::steal(Worker &w) {
+  const size_t n = w.victims.size();
+  if (n == 0) return nullptr;
+  uint64_t failed = 0;
+  Node *node = nullptr;
+  const Victim *from = nullptr;
+
+  if (mOrder == StealOrder::Random) {
+    for (size_t k = 0; k < n && !node; ++k) {
+      from = &w.victims[next_random(w.rng) % n];
+      node = mWorkers[from->worker]->deque.steal();
+      failed += !node;
+    }
+  } else {
+    uint32_t begin = 0;
+    for (size_t l = 0; l < kStealLevels && !node; ++l) {
+      uint32_t end = w.levelEnd[l];
+      uint32_t size = end - begin;
+      // Random start so the thieves of one level spread over its victims
+      uint32_t start = size ? uint32_t(next_random(w.rng) % size) : 0;
+      for (uint32_t k = 0; k < size && !node; ++k) {
+        from = &w.victims[begin + (start + k) % size];
+        node = mWorkers[from->worker]->deque.steal();
+        failed += !node;
+      }
+      begin = end;
+    }
+  }
+
+  if (failed) bump(w.counters[kFailed], failed);
+  if (node) bump(w.counters[kSteals + size_t(from->level)]);
+  return node;
+}
+
+void ThreadPool::execute(Worker &w, Node *node) {
+  node->fn();
+  TaskGroup *group = node->group;
+  delete node;
+  bump(w.counters[kExecuted]);
+  if (group) group->done();
+}
+
+void ThreadPool::run(Worker &w) {
+  unsigned idle = 0;
+  for (;;) {
+    if (Node *node = find(w)) {
+      execute(w, node);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kSpinRounds) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    mSleeping.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t epoch = mEpoch.load(std::memory_order_seq_cst);
+    Node *node = find(w);
+    if (!node && !mStop.load(std::memory_order_seq_cst)) {
+      mEpoch.wait(epoch, std::memory_order_seq_cst);
+    }
+    mSleeping.fetch_sub(1, std::memory_order_relaxed);
+    idle = 0;
+    if (node) {
+      execute(w, node);
+    } else if (mStop.load(std::memory_order_seq_cst)) {
+      // Nothing left anywhere this worker can see
+      if (!(node = find(w))) return;
+      execute(w, node);
+    }
+  }
+}
+
+std::vector<WorkerStats> ThreadPool::stats() const {
+  std::vector<WorkerStats> out;
+  for (const auto &w : mWorkers) {
+    auto get = [&w](size_t c) {
+      return w->counters[c].load(std::memory_order_relaxed);
+    };
+    WorkerStats &s = out.emplace_back();
+    s.executed = get(kExecuted);
+    s.local = get(kLocal);
+    s.injected = get(kInjected);
+    s.failedSteals = get(kFailed);
+    for (size_t l = 0; l < kStealLevels; ++l) s.steals[l] = get(kSteals + l);
+  }
+  return out;
+}
+
+WorkerStats ThreadPool::totalStats() const {
+  WorkerStats total;
+  for (const WorkerStats &s : stats()) {
+    total.executed += s.executed;
+    total.local += s.local;
+    total.injected += s.injected;
+    total.failedSteals += s.failedSteals;
+    for (size_t l = 0; l < kStealLevels; ++l) total.steals[l] += s.steals[l];
+  }
+  return total;
+}
+
+void ThreadPool::resetStats() {
+  for (auto &w : mWorkers) {
+    for (auto &c : w->counters) c.store(0, std::memory_order_relaxed);
+  }
+}
+
+void TaskGroup::wait() {
+  int self = mPool.currentWorker();
+  if (self < 0) {
+    // mDone lives in the pool, so the last done() may notify it after
+    // this group is gone
+    for (;;) {
+      uint32_t done = mPool.mDone.load(std::memory_order_acquire);
+      if (mPending.load(std::memory_order_acquire) == 0) return;
+      mPool.mDone.wait(done, std::memory_order_acquire);
+    }
+  }
+  ThreadPool::Worker &w = *mPool.mWorkers[self];
+  while (mPending.load(std::memory_order_acquire) != 0) {
+    if (ThreadPool::Node *node = mPool.find(w)) {
+      mPool.execute(w, node);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
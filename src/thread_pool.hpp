@@ -0,0 +1,188 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "topology.hpp"
+
+// How far a stolen task travelled, nearest first: from an SMT sibling, a
+// core sharing L2, one sharing L3, the same die, the same package, or
+// another package
+enum class StealLevel : uint8_t { Smt, L2, L3, Die, Package, Remote };
+inline constexpr size_t kStealLevels = 6;
+
+// Classifies `thief` against `victim`; both must be in `topo`
+StealLevel steal_level(const Topology &topo, int thief, int victim);
+
+// Victim selection: Locality tries nearer workers first (random start
+// within each level); Random picks victims uniformly, the classic scheme
+enum class StealOrder : uint8_t { Locality, Random };
+
+// Counters of one worker, kept by that worker alone
+struct WorkerStats {
+  uint64_t executed = 0;  // tasks run
+  uint64_t local = 0;     // taken from its own deque
+  uint64_t injected = 0;  // taken from the queue of external submissions
+  std::array<uint64_t, kStealLevels> steals{};  // by StealLevel
+  uint64_t failedSteals = 0;  // victims that had nothing
+
+  uint64_t totalSteals() const {
+    uint64_t n = 0;
+    for (uint64_t s : steals) n += s;
+    return n;
+  }
+};
+
+class TaskGroup;
+
+// Work-stealing pool with one pinned worker per chosen logical CPU. Tasks
+// forked by a worker go to the bottom of its own deque and are run LIFO;
+// idle workers steal the oldest task of a victim, nearest victims first,
+// so forked work stays in the caches it was produced in and crosses a
+// socket only when nothing closer is left.
+class ThreadPool {
+ public:
+  using Task = std::move_only_function<void()>;
+
+  struct Options {
+    // 0: one worker per physical core (per logical CPU with `smt`)
+    unsigned workers = 0;
+    bool smt = false;
+    bool pin = true;
+    StealOrder order = StealOrder::Locality;
+  };
+
+  // Workers go on the cores of `topo` in x2APIC order, i.e. filling one
+  // package before the next, first SMT threads before their siblings
+  ThreadPool(const Topology &topo, Options options);
+  explicit ThreadPool(Options options) : ThreadPool(Topology::host(), options) {}
+  ThreadPool() : ThreadPool(Options{}) {}
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  // Runs every queued task, then joins the workers
+  ~ThreadPool();
+
+  size_t size() const { return mWorkers.size(); }
+  int workerCpu(size_t worker) const { return mWorkers[worker]->cpu; }
+  // Index of the calling worker of this pool, -1 on any other thread
+  int currentWorker() const;
+
+  // Fire-and-forget from any thread
+  void submit(Task task) { push(std::move(task), nullptr); }
+
+  std::vector<WorkerStats> stats() const;
+  // Sum over workers
+  WorkerStats totalStats() const;
+  // Only meaningful while the pool is quiescent
+  void resetStats();
+
+ private:
+  friend class TaskGroup;
+
+  struct Node {
+    Task fn;
+    TaskGroup *group;
+  };
+
+  // Chase-Lev deque of a fixed capacity: the owner pushes and pops at the
+  // bottom, thieves take from the top. A full deque refuses the push and
+  // the owner runs the task inline.
+  class Deque {
+   public:
+    static constexpr int64_t kCapacity = 4096;
+
+    bool push(Node *node);
+    Node *pop();
+    Node *steal();
+
+   private:
+    alignas(64) std::atomic<int64_t> mTop{0};
+    alignas(64) std::atomic<int64_t> mBottom{0};
+    alignas(64) std::array<std::atomic<Node *>, kCapacity> mSlots{};
+  };
+
+  struct Victim {
+    uint32_t worker;
+    StealLevel level;
+  };
+
+  struct alignas(64) Worker {
+    int cpu;
+    Deque deque;
+    // Other workers sorted by StealLevel; levelEnd[l] is the end of level l
+    std::vector<Victim> victims;
+    std::array<uint32_t, kStealLevels> levelEnd{};
+    uint64_t rng;
+    // Updated with relaxed stores by the owner, read by stats()
+    std::array<std::atomic<uint64_t>, 4 + kStealLevels> counters{};
+    std::thread thread;
+  };
+  enum Counter { kExecuted, kLocal, kInjected, kFailed, kSteals };
+
+  void push(Task task, TaskGroup *group);
+  void run(Worker &w);
+  // Own deque, then the injection queue, then one round of steals
+  Node *find(Worker &w);
+  Node *steal(Worker &w);
+  void execute(Worker &w, Node *node);
+  void wake();
+
+  std::vector<std::unique_ptr<Worker>> mWorkers;
+  StealOrder mOrder;
+
+  std::mutex mInjectLock;
+  std::deque<Node *> mInjected;
+  std::atomic<size_t> mInjectedCount{0};
+
+  // Sleeping workers wait for mEpoch to move; pushes bump it when anyone
+  // sleeps
+  alignas(64) std::atomic<uint32_t> mEpoch{0};
+  std::atomic<uint32_t> mSleeping{0};
+  std::atomic<bool> mStop{false};
+  // Bumped whenever a TaskGroup empties, for waiters outside the pool
+  std::atomic<uint32_t> mDone{0};
+};
+
+// Fork/join scope: run() forks, wait() joins. A worker that waits keeps
+// executing tasks (its own first) instead of blocking, so nested groups
+// cannot deadlock the pool.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool &pool) : mPool(pool) {}
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+  ~TaskGroup() { wait(); }
+
+  void run(ThreadPool::Task task) {
+    mPending.fetch_add(1, std::memory_order_relaxed);
+    mPool.push(std::move(task), this);
+  }
+  void wait();
+
+ private:
+  friend class ThreadPool;
+
+  void done() {
+    // Once mPending reaches zero a waiter may return and destroy the group,
+    // so only the pool is touched after the decrement
+    ThreadPool &pool = mPool;
+    if (mPending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pool.mDone.fetch_add(1, std::memory_order_release);
+      pool.mDone.notify_all();
+    }
+  }
+
+  ThreadPool &mPool;
+  std::atomic<size_t> mPending{0};
+};
+
+#endif  // THREAD_POOL_HPP
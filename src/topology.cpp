@@ -0,0 +1,203 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+#include "cache.hpp"
+#include "features.hpp"
+
+namespace {
+
+// Smallest n with (1 << n) >= count
+unsigned ceil_log2(uint32_t count) {
+  return count <= 1 ? 0 : unsigned(std::bit_width(count - 1));
+}
+
+uint32_t x2apic_id(const CpuidSnapshot &snap, TopoSource source) {
+  switch (source) {
+    case TopoSource::Leaf1F:
+      return snap.get(0x1F).EDX();
+    case TopoSource::LeafB:
+      return snap.get(0xB).EDX();
+    default:
+      // 8-bit initial APIC ID
+      return snap.get(0x1).EBX() >> 24;
+  }
+}
+
+// Groups CPUs by `key` into dense domain indexes
+template <typename Key>
+void build_domains(const std::vector<LogicalCpu> &cpus, Key key,
+                   std::vector<CpuSet> &domains,
+                   std::vector<uint32_t> &domainOf) {
+  std::unordered_map<uint32_t, uint32_t> byKey;
+  domainOf.resize(cpus.size());
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    auto [it, inserted] = byKey.try_emplace(key(cpus[i]), domains.size());
+    if (inserted) domains.emplace_back();
+    domains[it->second].add(cpus[i].cpu);
+    domainOf[i] = it->second;
+  }
+}
+
+}  // namespace
+
+void Topology::decodeShifts(const CpuidSnapshot &snap) {
+  // Leaf 0x1F supersedes 0xB; both list levels innermost first with
+  // EAX[4:0] = bits to shift right to reach the next level's ID
+  std::array<bool, kTopoLevels> seen{};
+  for (uint32_t leaf : {0x1FU, 0xBU}) {
+    if (snap.maxBasicLeaf() < leaf || snap.get(leaf).EBX() == 0) continue;
+    mSource = leaf == 0x1F ? TopoSource::Leaf1F : TopoSource::LeafB;
+    for (uint32_t sub = 0; snap.contains(leaf, sub); ++sub) {
+      const CpuidLeaf &r = snap.get(leaf, sub);
+      uint32_t type = (r.ECX() >> 8) & 0xFF;
+      if (type == 0) break;
+      unsigned shift = r.EAX() & 0x1F;
+      // Types 1..5 are SMT, Core, Module, Tile, Die; anything above
+      // (e.g. DieGrp) only widens the package shift.
+      if (type <= 5) {
+        mShift[type - 1] = shift;
+        seen[type - 1] = true;
+      }
+      mShift[size_t(TopoLevel::Package)] = shift;
+    }
+    break;
+  }
+
+  if (mSource == TopoSource::Legacy) {
+    // Leaf 1 EBX[23:16]: addressable IDs per package; cores from leaf 4 on
+    // Intel or 0x80000008 on AMD
+    uint32_t logical = 1;
+    if (snap.get(0x1).EDX() & (1U << 28)) {
+      logical = (snap.get(0x1).EBX() >> 16) & 0xFF;
+    }
+    uint32_t cores = 1;
+    CpuVendor vendor = snap.vendor();
+    if (vendor == CpuVendor::AMD || vendor == CpuVendor::Hygon) {
+      if (snap.maxExtendedLeaf() >= 0x80000008) {
+        const CpuidLeaf &r = snap.get(0x80000008);
+        uint32_t apicIdSize = (r.ECX() >> 12) & 0xF;
+        cores = apicIdSize ? 1U << apicIdSize : (r.ECX() & 0xFF) + 1;
+      }
+    } else if (snap.maxBasicLeaf() >= 4) {
+      cores = ((snap.get(0x4).EAX() >> 26) & 0x3F) + 1;
+    }
+    unsigned pkg = ceil_log2(std::max(logical, cores));
+    mShift[size_t(TopoLevel::SMT)] = pkg - ceil_log2(cores);
+    seen[size_t(TopoLevel::SMT)] = true;
+    // Nothing between the core and the package is enumerated, so the
+    // module, tile and die levels collapse into the package
+    mShift[size_t(TopoLevel::Core)] = pkg;
+    seen[size_t(TopoLevel::Core)] = true;
+    mShift[size_t(TopoLevel::Package)] = pkg;
+  }
+
+  // An absent level has the width of the level below, so its domains
+  // collapse into the next level up
+  for (size_t l = 1; l < size_t(TopoLevel::Package); ++l) {
+    if (!seen[l]) mShift[l] = mShift[l - 1];
+  }
+}
+
+Topology::Topology(const PerCpuSnapshot &cpus) {
+  if (cpus.size() == 0) return;
+  const CpuidSnapshot &first = cpus[0];
+  decodeShifts(first);
+
+  mCpus.reserve(cpus.size());
+  mIndex.assign(size_t(std::ranges::max(cpus.cpus())) + 1, -1);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    LogicalCpu c{
+        .cpu = cpus.cpu(i), .x2apicId = x2apic_id(cpus[i], mSource), .ids = {}};
+    unsigned below = 0;
+    for (size_t l = 0; l < kTopoLevels; ++l) {
+      if (l == size_t(TopoLevel::Package)) {
+        // Above every enumerated level, DieGrp and wider ones included
+        c.ids[l] = c.x2apicId >> mShift[l];
+      } else {
+        uint32_t mask = (uint64_t(1) << mShift[l]) - 1;
+        c.ids[l] = (c.x2apicId & mask) >> below;
+        below = mShift[l];
+      }
+    }
+    mIndex[c.cpu] = int(mCpus.size());
+    mCpus.push_back(c);
+  }
+
+  // A level-L domain is identified by the x2APIC ID bits above level L-1:
+  // Core domains key on apic >> SMT shift, Package on apic >> the package
+  // shift, which also covers levels above Die
+  mDomainOf.resize(mCpus.size());
+  std::vector<uint32_t> domainOf;
+  for (size_t l = 0; l < kTopoLevels; ++l) {
+    unsigned below = l == 0 ? 0 : mShift[l - 1];
+    if (l == size_t(TopoLevel::Package)) below = mShift[l];
+    domainOf.clear();
+    build_domains(
+        mCpus, [&](const LogicalCpu &c) { return c.x2apicId >> below; },
+        mDomains[l], domainOf);
+    for (size_t i = 0; i < mCpus.size(); ++i) mDomainOf[i][l] = domainOf[i];
+  }
+
+  // Caches: CPUs whose x2APIC IDs agree above log2(sharing) bits share it.
+  // Hybrid parts report sharing per core type (an E-core cluster's L2 is
+  // shared by four), so there every CPU's own leaves are decoded.
+  auto cacheShifts = [](const CpuidSnapshot &snap) {
+    std::array<unsigned, 3> shifts{};
+    CacheHierarchy caches = decode_caches(snap);
+    for (unsigned level = 1; level <= 3; ++level) {
+      const CacheLevel *c = caches.data(level);
+      shifts[level - 1] = c ? ceil_log2(c->sharedBy) : 0;
+    }
+    return shifts;
+  };
+  std::vector<std::array<unsigned, 3>> shifts(mCpus.size(),
+                                              cacheShifts(first));
+  if (FeatureSet(first).has(Feature::HYBRID)) {
+    for (size_t i = 1; i < cpus.size(); ++i) shifts[i] = cacheShifts(cpus[i]);
+  }
+  mCacheDomainOf.resize(mCpus.size());
+  for (unsigned level = 1; level <= 3; ++level) {
+    // Keyed on the domain's first x2APIC ID, which is unique across widths
+    auto key = [&](const LogicalCpu &cpu) {
+      unsigned shift = shifts[size_t(&cpu - mCpus.data())][level - 1];
+      return cpu.x2apicId >> shift << shift;
+    };
+    domainOf.clear();
+    build_domains(mCpus, key, mCacheDomains[level - 1], domainOf);
+    for (size_t i = 0; i < mCpus.size(); ++i) {
+      mCacheDomainOf[i][level - 1] = domainOf[i];
+    }
+  }
+}
+
+const Topology &Topology::host() {
+  static const Topology topo(PerCpuSnapshot::host());
+  return topo;
+}
+
+int Topology::index(int cpu) const {
+  if (cpu < 0 || size_t(cpu) >= mIndex.size()) return -1;
+  return mIndex[cpu];
+}
+
+const LogicalCpu *Topology::forCpu(int cpu) const {
+  int i = index(cpu);
+  return i < 0 ? nullptr : &mCpus[i];
+}
+
+const CpuSet &Topology::siblings(int cpu, TopoLevel level) const {
+  static const CpuSet kEmpty;
+  int i = index(cpu);
+  if (i < 0) return kEmpty;
+  return mDomains[size_t(level)][mDomainOf[i][size_t(level)]];
+}
+
+const CpuSet &Topology::cacheSiblings(int cpu, unsigned cacheLevel) const {
+  static const CpuSet kEmpty;
+  int i = index(cpu);
+  if (i < 0 || cacheLevel < 1 || cacheLevel > 3) return kEmpty;
+  return mCacheDomains[cacheLevel - 1][mCacheDomainOf[i][cacheLevel - 1]];
+}
@@ -0,0 +1,80 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpuset.hpp"
+#include "percpu.hpp"
+
+// x2APIC topology domains, innermost first (leaf 0x1F level types)
+enum class TopoLevel : uint8_t { SMT, Core, Module, Tile, Die, Package };
+inline constexpr size_t kTopoLevels = 6;
+
+struct LogicalCpu {
+  int cpu;
+  uint32_t x2apicId;
+  // ID of this CPU's unit at each level, relative to the enclosing level
+  // (SMT ID within its core, core ID within its module, ...). The package
+  // ID is system-wide.
+  std::array<uint32_t, kTopoLevels> ids;
+};
+
+// Where the x2APIC shift widths came from
+enum class TopoSource : uint8_t { Leaf1F, LeafB, Legacy };
+
+// Package/die/tile/module/core/SMT placement of every logical CPU, decoded
+// from the x2APIC ID shift widths of leaf 0x1F (or 0xB), with inverse
+// indexes from each CPU to the CpuSet of every domain that contains it.
+class Topology {
+ public:
+  explicit Topology(const PerCpuSnapshot &cpus);
+
+  // Of PerCpuSnapshot::host(), decoded once
+  static const Topology &host();
+
+  size_t size() const { return mCpus.size(); }
+  const LogicalCpu &operator[](size_t i) const { return mCpus[i]; }
+  const LogicalCpu *forCpu(int cpu) const;
+
+  // Number of x2APIC ID bits below the next level up
+  unsigned shift(TopoLevel level) const { return mShift[size_t(level)]; }
+  TopoSource source() const { return mSource; }
+
+  // Every distinct domain at `level`; Core domains hold SMT siblings,
+  // Package domains a whole socket.
+  const std::vector<CpuSet> &domains(TopoLevel level) const {
+    return mDomains[size_t(level)];
+  }
+  // The `level` domain containing `cpu` (O(1)); empty for unknown CPUs
+  const CpuSet &siblings(int cpu, TopoLevel level) const;
+
+  // CPUs sharing the L2/L3 (data or unified) cache, from the leaf 4 /
+  // 0x8000001D sharing counts (per CPU on hybrid parts); cacheLevel is 1..3.
+  const std::vector<CpuSet> &cacheDomains(unsigned cacheLevel) const {
+    return mCacheDomains[cacheLevel - 1];
+  }
+  const CpuSet &cacheSiblings(int cpu, unsigned cacheLevel) const;
+
+  // Number of distinct domains, e.g. count(TopoLevel::Core) physical cores
+  size_t count(TopoLevel level) const { return domains(level).size(); }
+
+ private:
+  void decodeShifts(const CpuidSnapshot &snap);
+  int index(int cpu) const;
+
+  std::vector<LogicalCpu> mCpus;
+  std::vector<int> mIndex;  // cpu number -> position in mCpus, or -1
+  std::array<unsigned, kTopoLevels> mShift{};
+  TopoSource mSource = TopoSource::Legacy;
+
+  std::array<std::vector<CpuSet>, kTopoLevels> mDomains;
+  std::array<std::vector<CpuSet>, 3> mCacheDomains;
+  // Position in mDomains / mCacheDomains, parallel to mCpus
+  std::vector<std::array<uint32_t, kTopoLevels>> mDomainOf;
+  std::vector<std::array<uint32_t, 3>> mCacheDomainOf;
+};
+
+#endif  // TOPOLOGY_HPP
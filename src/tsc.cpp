@@ -0,0 +1,98 @@
+#include "tsc.hpp"
+
+#include <time.h>
+
+TscInfo decode_tsc(const CpuidSnapshot &snap) {
+  TscInfo info;
+  if (snap.maxExtendedLeaf() >= 0x80000007) {
+    info.invariant = (snap.get(0x80000007).EDX() >> 8) & 1;
+  }
+  if (snap.maxExtendedLeaf() >= 0x80000001) {
+    info.rdtscp = (snap.get(0x80000001).EDX() >> 27) & 1;
+  }
+  if (snap.maxBasicLeaf() >= 0x16) {
+    const CpuidLeaf &r = snap.get(0x16);
+    info.baseMHz = r.EAX() & 0xFFFF;
+    info.maxMHz = r.EBX() & 0xFFFF;
+    info.busMHz = r.ECX() & 0xFFFF;
+  }
+  if (snap.maxBasicLeaf() >= 0x15) {
+    const CpuidLeaf &r = snap.get(0x15);
+    info.ratioDenominator = r.EAX();
+    info.ratioNumerator = r.EBX();
+    info.crystalHz = r.ECX();
+  }
+
+  if (info.ratioNumerator && info.ratioDenominator) {
+    if (info.crystalHz) {
+      info.tscHz = uint64_t(info.crystalHz) * info.ratioNumerator /
+                   info.ratioDenominator;
+      info.source = TscSource::Leaf15;
+    } else if (info.baseMHz) {
+      // SDM: without a crystal value, the TSC runs at the base frequency
+      info.tscHz = uint64_t(info.baseMHz) * 1000000;
+      info.source = TscSource::Leaf16;
+    }
+  }
+  if (!info.tscHz && snap.maxHypervisorLeaf() >= 0x40000010) {
+    uint32_t khz = snap.get(0x40000010).EAX();
+    if (khz) {
+      info.tscHz = uint64_t(khz) * 1000;
+      info.source = TscSource::Hypervisor;
+    }
+  }
+  return info;
+}
+
+static uint64_t raw_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Reads the TSC between two clock reads and returns the clock midpoint;
+// retries to keep the bracket narrow when we get preempted.
+static void paired_read(bool rdtscp, uint64_t *tsc, uint64_t *ns) {
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 8; ++i) {
+    uint64_t t0 = raw_ns();
+    uint64_t c = rdtscp ? TscClock::rdtscp() : TscClock::rdtscLfence();
+    uint64_t t1 = raw_ns();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+      *tsc = c;
+      *ns = t0 + (t1 - t0) / 2;
+    }
+  }
+}
+
+uint64_t calibrate_tsc_hz(bool rdtscp, std::chrono::microseconds window) {
+  uint64_t tsc0, ns0, tsc1, ns1;
+  paired_read(rdtscp, &tsc0, &ns0);
+  uint64_t until = ns0 + uint64_t(window.count()) * 1000;
+  while (raw_ns() < until) {
+  }
+  paired_read(rdtscp, &tsc1, &ns1);
+  if (ns1 <= ns0) return 0;
+  return uint64_t((unsigned __int128)(tsc1 - tsc0) * 1000000000 /
+                  (ns1 - ns0));
+}
+
+TscClock::TscClock(const TscInfo &info)
+    : mTscHz(info.tscHz),
+      mSource(info.source),
+      mInvariant(info.invariant),
+      mRdtscp(info.rdtscp) {
+  if (!mTscHz) {
+    mTscHz = calibrate_tsc_hz(mRdtscp);
+    mSource = TscSource::Calibrated;
+  }
+  mMult = mTscHz ? uint64_t(((unsigned __int128)1000000000 << kShift) / mTscHz)
+                 : 0;
+  mBaseTsc = rdtsc();
+}
+
+const TscClock &TscClock::host() {
+  static const TscClock clock(decode_tsc(CpuidSnapshot::host()));
+  return clock;
+}
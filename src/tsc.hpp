@@ -0,0 +1,95 @@
+#ifndef TSC_HPP
+#define TSC_HPP
+
+#include <x86intrin.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "snapshot.hpp"
+
+// Where TscInfo::tscHz came from
+enum class TscSource : uint8_t {
+  None,
+  Leaf15,      // crystal clock * EBX / EAX
+  Leaf16,      // base frequency, when leaf 0x15 has no crystal clock
+  Hypervisor,  // 0x40000010 EAX, TSC frequency in kHz (VMware, KVM)
+  Calibrated,  // measured against CLOCK_MONOTONIC_RAW
+};
+
+struct TscInfo {
+  bool invariant = false;         // 0x80000007:EDX[8]
+  bool rdtscp = false;            // 0x80000001:EDX[27]
+  uint32_t ratioNumerator = 0;    // leaf 0x15 EBX
+  uint32_t ratioDenominator = 0;  // leaf 0x15 EAX
+  uint32_t crystalHz = 0;         // leaf 0x15 ECX
+  uint16_t baseMHz = 0;           // leaf 0x16 EAX
+  uint16_t maxMHz = 0;            // leaf 0x16 EBX
+  uint16_t busMHz = 0;            // leaf 0x16 ECX
+  uint64_t tscHz = 0;
+  TscSource source = TscSource::None;
+};
+
+// TSC frequency from leaves 0x15/0x16 and the hypervisor timing leaf; tscHz
+// stays 0 when none of them report it.
+TscInfo decode_tsc(const CpuidSnapshot &snap);
+
+// Measures the TSC rate against CLOCK_MONOTONIC_RAW over `window`. Reads
+// the TSC with RDTSCP only when `rdtscp` says the CPU has it (some guest
+// CPU models hide it), else with LFENCE; RDTSC.
+uint64_t calibrate_tsc_hz(bool rdtscp, std::chrono::microseconds window =
+                                           std::chrono::milliseconds(20));
+
+// Nanosecond clock on top of rdtsc. Ticks are converted with one 64x64
+// multiply and a shift; there is no syscall and no vDSO call.
+// Meaningful only with an invariant TSC: check invariant() before relying
+// on it across frequency changes and idle states.
+class TscClock {
+ public:
+  // Calibrates when `info` carries no frequency
+  explicit TscClock(const TscInfo &info);
+  // Decoded from CpuidSnapshot::host() on first use
+  static const TscClock &host();
+
+  static uint64_t rdtsc() { return __rdtsc(); }
+  // Waits for earlier instructions to retire before reading the TSC.
+  // Raises #UD without CPUID.80000001H:EDX[27]; see TscInfo::rdtscp.
+  static uint64_t rdtscp() {
+    unsigned aux;
+    return __rdtscp(&aux);
+  }
+  // The same ordering on any x86-64 CPU
+  static uint64_t rdtscLfence() {
+    _mm_lfence();
+    return __rdtsc();
+  }
+
+  // Nanoseconds since the clock was constructed
+  uint64_t now_ns() const { return toNs(rdtsc() - mBaseTsc); }
+  // RDTSCP when the CPU has it, LFENCE; RDTSC otherwise
+  uint64_t now_ns_ordered() const {
+    return toNs((mRdtscp ? rdtscp() : rdtscLfence()) - mBaseTsc);
+  }
+  uint64_t toNs(uint64_t ticks) const {
+    return uint64_t((unsigned __int128)ticks * mMult >> kShift);
+  }
+
+  uint64_t tscHz() const { return mTscHz; }
+  TscSource source() const { return mSource; }
+  // The TSC ticks at a constant rate in every P-, C- and T-state, so
+  // now_ns() tracks wall time
+  bool invariant() const { return mInvariant; }
+  bool hasRdtscp() const { return mRdtscp; }
+
+ private:
+  static constexpr unsigned kShift = 32;
+
+  uint64_t mBaseTsc;
+  uint64_t mMult;  // (1e9 << kShift) / tscHz
+  uint64_t mTscHz;
+  TscSource mSource;
+  bool mInvariant;
+  bool mRdtscp;
+};
+
+#endif  // TSC_HPP
@@ -0,0 +1,32 @@
+#include "uarch.hpp"
+
+// Lookups below are resolved entirely at compile time
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_SAPPHIRERAPIDS_X, 8)
+                  ->name == "Sapphire Rapids");
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_SKYLAKE_X, 4)->name ==
+              "Skylake-SP");
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_SKYLAKE_X, 7)->name ==
+              "Cascade Lake");
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_SKYLAKE_X, 11)
+                  ->avx512 == Avx512Freq::LicenseHeavy);
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_ALDERLAKE, 2)
+                  ->has(UarchTrait::Hybrid));
+static_assert(find_uarch(CpuVendor::Intel, 6, INTEL_FAM6_ATOM_TREMONT, 0)
+                  ->cls == UarchClass::Atom);
+static_assert(find_uarch(CpuVendor::AMD, 0x19, 0x61, 2)->core == "Zen 4");
+static_assert(find_uarch(CpuVendor::AMD, 0x17, 0x31, 0)->core == "Zen 2");
+static_assert(!find_uarch(CpuVendor::AMD, 0x17, 0x50, 0));
+static_assert(!find_uarch(CpuVendor::Intel, 6, 0x01, 0));
+static_assert(!find_uarch(CpuVendor::Other, 6, INTEL_FAM6_HASWELL, 0));
+
+// Zen 4 Raphael: base family 0xF + extended 0xA, model 0x61
+static_assert(cpu_signature(CpuVendor::AMD,
+                            {0x1, 0, {0x00A60F12, 0, 0, 0}})
+                  .family == 0x19);
+static_assert(cpu_signature(CpuVendor::AMD,
+                            {0x1, 0, {0x00A60F12, 0, 0, 0}})
+                  .model == 0x61);
+
+const Uarch *find_uarch(const CpuidSnapshot &snap) {
+  return find_uarch(cpu_signature(snap.vendor(), snap.get(0x1)));
+}
@@ -0,0 +1,349 @@
+#ifndef UARCH_HPP
+#define UARCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "intel_family.hpp"
+#include "snapshot.hpp"
+#include "utils.hpp"
+
+// Display family/model/stepping, as vendors document them
+struct CpuSignature {
+  CpuVendor vendor = CpuVendor::Other;
+  uint16_t family = 0;
+  uint8_t model = 0;
+  uint8_t stepping = 0;
+};
+
+// Applies the extended family (family 0xF) and extended model (Intel
+// family 6 and 0xF, AMD family 0xF and up) to CPUID.01H:EAX
+constexpr CpuSignature cpu_signature(CpuVendor vendor, const CpuidLeaf &l1) {
+  uint32_t family = leaf1::Family::get(l1);
+  uint32_t model = leaf1::Model::get(l1);
+  bool extModel = family == 0xF || (vendor == CpuVendor::Intel && family == 6);
+  if (family == 0xF) family += leaf1::ExtendedFamily::get(l1);
+  if (extModel) model |= leaf1::ExtendedModel::get(l1) << 4;
+  return {vendor, uint16_t(family), uint8_t(model),
+          uint8_t(leaf1::Stepping::get(l1))};
+}
+
+enum class UarchClass : uint8_t { Core, Atom, XeonPhi, Quark };
+
+// How the core clocks down while running 512-bit vector code
+enum class Avx512Freq : uint8_t {
+  Unsupported,   // no AVX-512 (or fused off, as on hybrid parts)
+  LicenseHeavy,  // Skylake-SP family: per-core license levels, large drops
+  LicenseLight,  // Ice Lake and later: smaller drops, heavy FP only
+  NoPenalty,     // AMD: no AVX-512 specific frequency reduction
+};
+
+// Performance quirks that change kernel or layout choices
+enum class UarchTrait : uint32_t {
+  Hybrid = 1U << 0,               // P-cores and E-cores, see CoreTypeMap
+  StoreForward4KAlias = 1U << 1,  // loads stall on stores 4 KiB apart
+  Split256 = 1U << 2,             // 256-bit AVX ops issue as two halves
+  Avx512DoublePumped = 1U << 3,   // 512-bit ops issue as two 256-bit halves
+  SlowPdepPext = 1U << 4,         // PDEP/PEXT microcoded, latency ~ bits set
+  SlowGather = 1U << 5,           // vector gathers slower than scalar loads
+};
+
+constexpr uint32_t operator|(UarchTrait a, UarchTrait b) {
+  return uint32_t(a) | uint32_t(b);
+}
+constexpr uint32_t operator|(uint32_t a, UarchTrait b) {
+  return a | uint32_t(b);
+}
+
+struct Uarch {
+  CpuVendor vendor;
+  uint16_t family;
+  uint8_t modelLo;  // AMD assigns model ranges; Intel entries use one model
+  uint8_t modelHi;
+  uint8_t minStepping;  // first stepping of a refresh sharing the model
+  std::string_view name;
+  std::string_view core;
+  UarchClass cls;
+  Avx512Freq avx512;
+  uint32_t traits;
+
+  constexpr bool has(UarchTrait t) const { return traits & uint32_t(t); }
+};
+
+namespace uarch_detail {
+
+using enum CpuVendor;
+using enum UarchClass;
+using enum Avx512Freq;
+using enum UarchTrait;
+
+constexpr uint32_t kIntelCore = uint32_t(StoreForward4KAlias);
+constexpr uint32_t kIntelHybrid = StoreForward4KAlias | Hybrid;
+
+// One family 6 model from intel_family.hpp; _S variants start at a
+// later stepping of the same model
+#define INTEL6_S(m, step, name, core, cls, avx512, traits)           \
+  Uarch {                                                           \
+    Intel, 6, INTEL_FAM6_##m, INTEL_FAM6_##m, step, name, core, cls, \
+        avx512, traits                                              \
+  }
+#define INTEL6(m, name, core, cls, avx512, traits) \
+  INTEL6_S(m, 0, name, core, cls, avx512, traits)
+
+// In intel_family.hpp order; sorted for lookup below
+inline constexpr Uarch kList[] = {
+    INTEL6(CORE_YONAH, "Yonah", "Yonah", Core, Unsupported, kIntelCore),
+    INTEL6(CORE2_MEROM, "Merom", "Core", Core, Unsupported, kIntelCore),
+    INTEL6(CORE2_MEROM_L, "Merom-L", "Core", Core, Unsupported, kIntelCore),
+    INTEL6(CORE2_PENRYN, "Penryn", "Core", Core, Unsupported, kIntelCore),
+    INTEL6(CORE2_DUNNINGTON, "Dunnington", "Core", Core, Unsupported,
+           kIntelCore),
+    INTEL6(NEHALEM, "Nehalem", "Nehalem", Core, Unsupported, kIntelCore),
+    INTEL6(NEHALEM_G, "Auburndale", "Nehalem", Core, Unsupported, kIntelCore),
+    INTEL6(NEHALEM_EP, "Nehalem-EP", "Nehalem", Core, Unsupported,
+           kIntelCore),
+    INTEL6(NEHALEM_EX, "Nehalem-EX", "Nehalem", Core, Unsupported,
+           kIntelCore),
+    INTEL6(WESTMERE, "Westmere", "Westmere", Core, Unsupported, kIntelCore),
+    INTEL6(WESTMERE_EP, "Westmere-EP", "Westmere", Core, Unsupported,
+           kIntelCore),
+    INTEL6(WESTMERE_EX, "Westmere-EX", "Westmere", Core, Unsupported,
+           kIntelCore),
+    INTEL6(SANDYBRIDGE, "Sandy Bridge", "Sandy Bridge", Core, Unsupported,
+           kIntelCore),
+    INTEL6(SANDYBRIDGE_X, "Sandy Bridge-E", "Sandy Bridge", Core,
+           Unsupported, kIntelCore),
+    INTEL6(IVYBRIDGE, "Ivy Bridge", "Ivy Bridge", Core, Unsupported,
+           kIntelCore),
+    INTEL6(IVYBRIDGE_X, "Ivy Bridge-E", "Ivy Bridge", Core, Unsupported,
+           kIntelCore),
+    INTEL6(HASWELL, "Haswell", "Haswell", Core, Unsupported, kIntelCore),
+    INTEL6(HASWELL_X, "Haswell-E", "Haswell", Core, Unsupported, kIntelCore),
+    INTEL6(HASWELL_L, "Haswell-ULT", "Haswell", Core, Unsupported,
+           kIntelCore),
+    INTEL6(HASWELL_G, "Crystal Well", "Haswell", Core, Unsupported,
+           kIntelCore),
+    INTEL6(BROADWELL, "Broadwell", "Broadwell", Core, Unsupported,
+           kIntelCore),
+    INTEL6(BROADWELL_G, "Broadwell-H", "Broadwell", Core, Unsupported,
+           kIntelCore),
+    INTEL6(BROADWELL_X, "Broadwell-E", "Broadwell", Core, Unsupported,
+           kIntelCore),
+    INTEL6(BROADWELL_D, "Broadwell-DE", "Broadwell", Core, Unsupported,
+           kIntelCore),
+    // Skylake through Tiger Lake: gathers are slow under the Downfall
+    // (GDS) microcode mitigation
+    INTEL6(SKYLAKE_L, "Skylake-U", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6(SKYLAKE, "Skylake", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6(SKYLAKE_X, "Skylake-SP", "Skylake", Core, LicenseHeavy,
+           kIntelCore | SlowGather),
+    INTEL6_S(SKYLAKE_X, 7, "Cascade Lake", "Skylake", Core, LicenseHeavy,
+             kIntelCore | SlowGather),
+    INTEL6_S(SKYLAKE_X, 11, "Cooper Lake", "Skylake", Core, LicenseHeavy,
+             kIntelCore | SlowGather),
+    INTEL6(KABYLAKE_L, "Kaby Lake-U", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6_S(KABYLAKE_L, 9, "Amber Lake", "Skylake", Core, Unsupported,
+             kIntelCore | SlowGather),
+    INTEL6_S(KABYLAKE_L, 10, "Coffee Lake-U", "Skylake", Core, Unsupported,
+             kIntelCore | SlowGather),
+    INTEL6_S(KABYLAKE_L, 11, "Whiskey Lake", "Skylake", Core, Unsupported,
+             kIntelCore | SlowGather),
+    INTEL6(KABYLAKE, "Kaby Lake", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6_S(KABYLAKE, 10, "Coffee Lake", "Skylake", Core, Unsupported,
+             kIntelCore | SlowGather),
+    INTEL6(COMETLAKE, "Comet Lake", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6(COMETLAKE_L, "Comet Lake-U", "Skylake", Core, Unsupported,
+           kIntelCore | SlowGather),
+    INTEL6(CANNONLAKE_L, "Cannon Lake", "Palm Cove", Core, LicenseLight,
+           kIntelCore),
+    INTEL6(ICELAKE_X, "Ice Lake-SP", "Sunny Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(ICELAKE_D, "Ice Lake-D", "Sunny Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(ICELAKE, "Ice Lake", "Sunny Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(ICELAKE_L, "Ice Lake-U", "Sunny Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(ICELAKE_NNPI, "Spring Hill", "Sunny Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(LAKEFIELD, "Lakefield", "Sunny Cove / Tremont", Core, Unsupported,
+           kIntelHybrid),
+    INTEL6(ROCKETLAKE, "Rocket Lake", "Cypress Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(TIGERLAKE_L, "Tiger Lake-U", "Willow Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(TIGERLAKE, "Tiger Lake", "Willow Cove", Core, LicenseLight,
+           kIntelCore | SlowGather),
+    INTEL6(SAPPHIRERAPIDS_X, "Sapphire Rapids", "Golden Cove", Core,
+           LicenseLight, kIntelCore),
+    INTEL6(EMERALDRAPIDS_X, "Emerald Rapids", "Raptor Cove", Core,
+           LicenseLight, kIntelCore),
+    INTEL6(GRANITERAPIDS_X, "Granite Rapids", "Redwood Cove", Core,
+           LicenseLight, kIntelCore),
+    INTEL6(GRANITERAPIDS_D, "Granite Rapids-D", "Redwood Cove", Core,
+           LicenseLight, kIntelCore),
+    INTEL6(ALDERLAKE, "Alder Lake", "Golden Cove / Gracemont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(ALDERLAKE_L, "Alder Lake-P", "Golden Cove / Gracemont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(ALDERLAKE_N, "Alder Lake-N", "Gracemont", Atom, Unsupported, 0),
+    INTEL6(RAPTORLAKE, "Raptor Lake", "Raptor Cove / Gracemont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(RAPTORLAKE_P, "Raptor Lake-P", "Raptor Cove / Gracemont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(RAPTORLAKE_S, "Raptor Lake-S", "Raptor Cove / Gracemont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(METEORLAKE, "Meteor Lake", "Redwood Cove / Crestmont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(METEORLAKE_L, "Meteor Lake-U", "Redwood Cove / Crestmont", Core,
+           Unsupported, kIntelHybrid),
+    INTEL6(LUNARLAKE_M, "Lunar Lake", "Lion Cove / Skymont", Core,
+           Unsupported, kIntelHybrid),
+
+    INTEL6(ATOM_BONNELL, "Diamondville", "Bonnell", Atom, Unsupported, 0),
+    INTEL6(ATOM_BONNELL_MID, "Silverthorne", "Bonnell", Atom, Unsupported,
+           0),
+    INTEL6(ATOM_SALTWELL, "Cedarview", "Saltwell", Atom, Unsupported, 0),
+    INTEL6(ATOM_SALTWELL_MID, "Penwell", "Saltwell", Atom, Unsupported, 0),
+    INTEL6(ATOM_SALTWELL_TABLET, "Cloverview", "Saltwell", Atom, Unsupported,
+           0),
+    INTEL6(ATOM_SILVERMONT, "Bay Trail", "Silvermont", Atom, Unsupported, 0),
+    INTEL6(ATOM_SILVERMONT_D, "Avoton", "Silvermont", Atom, Unsupported, 0),
+    INTEL6(ATOM_SILVERMONT_MID, "Merrifield", "Silvermont", Atom,
+           Unsupported, 0),
+    INTEL6(ATOM_AIRMONT, "Cherry Trail", "Airmont", Atom, Unsupported, 0),
+    INTEL6(ATOM_AIRMONT_MID, "Moorefield", "Airmont", Atom, Unsupported, 0),
+    INTEL6(ATOM_AIRMONT_NP, "Lightning Mountain", "Airmont", Atom,
+           Unsupported, 0),
+    INTEL6(ATOM_GOLDMONT, "Apollo Lake", "Goldmont", Atom, Unsupported, 0),
+    INTEL6(ATOM_GOLDMONT_D, "Denverton", "Goldmont", Atom, Unsupported, 0),
+    INTEL6(ATOM_GOLDMONT_PLUS, "Gemini Lake", "Goldmont Plus", Atom,
+           Unsupported, 0),
+    INTEL6(ATOM_TREMONT_D, "Jacobsville", "Tremont", Atom, Unsupported, 0),
+    INTEL6(ATOM_TREMONT, "Elkhart Lake", "Tremont", Atom, Unsupported, 0),
+    INTEL6(ATOM_TREMONT_L, "Jasper Lake", "Tremont", Atom, Unsupported, 0),
+    INTEL6(SIERRAFOREST_X, "Sierra Forest", "Crestmont", Atom, Unsupported,
+           0),
+    INTEL6(GRANDRIDGE, "Grand Ridge", "Crestmont", Atom, Unsupported, 0),
+
+    INTEL6(XEON_PHI_KNL, "Knights Landing", "Silvermont", XeonPhi,
+           LicenseLight, 0),
+    INTEL6(XEON_PHI_KNM, "Knights Mill", "Silvermont", XeonPhi, LicenseLight,
+           0),
+
+    {Intel, 5, INTEL_FAM5_QUARK_X1000, INTEL_FAM5_QUARK_X1000, 0,
+     "Quark X1000", "Lakemont", Quark, Unsupported, 0},
+
+    // AMD assigns each product a block of models within a family
+    {AMD, 0x17, 0x00, 0x07, 0, "Naples", "Zen", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x08, 0x0F, 0, "Pinnacle Ridge", "Zen+", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x10, 0x17, 0, "Raven Ridge", "Zen", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x18, 0x1F, 0, "Picasso", "Zen+", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x20, 0x2F, 0, "Dali", "Zen", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x30, 0x3F, 0, "Rome", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x60, 0x67, 0, "Renoir", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x68, 0x6F, 0, "Lucienne", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x70, 0x7F, 0, "Matisse", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0x90, 0x9F, 0, "Van Gogh", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x17, 0xA0, 0xAF, 0, "Mendocino", "Zen 2", Core, Unsupported,
+     SlowPdepPext | SlowGather},
+    {AMD, 0x19, 0x00, 0x0F, 0, "Milan", "Zen 3", Core, Unsupported, 0},
+    {AMD, 0x19, 0x10, 0x1F, 0, "Genoa", "Zen 4", Core, NoPenalty,
+     uint32_t(Avx512DoublePumped)},
+    {AMD, 0x19, 0x20, 0x2F, 0, "Vermeer", "Zen 3", Core, Unsupported, 0},
+    {AMD, 0x19, 0x40, 0x4F, 0, "Rembrandt", "Zen 3+", Core, Unsupported, 0},
+    {AMD, 0x19, 0x50, 0x5F, 0, "Cezanne", "Zen 3", Core, Unsupported, 0},
+    {AMD, 0x19, 0x60, 0x6F, 0, "Raphael", "Zen 4", Core, NoPenalty,
+     uint32_t(Avx512DoublePumped)},
+    {AMD, 0x19, 0x70, 0x7F, 0, "Phoenix", "Zen 4", Core, NoPenalty,
+     uint32_t(Avx512DoublePumped)},
+    {AMD, 0x19, 0xA0, 0xAF, 0, "Bergamo", "Zen 4c", Core, NoPenalty,
+     uint32_t(Avx512DoublePumped)},
+    {AMD, 0x1A, 0x00, 0x0F, 0, "Turin", "Zen 5", Core, NoPenalty, 0},
+    {AMD, 0x1A, 0x10, 0x1F, 0, "Turin Dense", "Zen 5c", Core, NoPenalty, 0},
+    {AMD, 0x1A, 0x20, 0x2F, 0, "Strix Point", "Zen 5", Core, NoPenalty,
+     uint32_t(Avx512DoublePumped)},
+    {AMD, 0x1A, 0x40, 0x4F, 0, "Granite Ridge", "Zen 5", Core, NoPenalty, 0},
+    {AMD, 0x1A, 0x70, 0x7F, 0, "Strix Halo", "Zen 5", Core, NoPenalty, 0},
+
+    // Zen licensed to Hygon
+    {Hygon, 0x18, 0x00, 0x0F, 0, "Dhyana", "Zen", Core, Unsupported,
+     Split256 | SlowPdepPext | SlowGather},
+};
+
+#undef INTEL6
+#undef INTEL6_S
+
+constexpr auto kKey = [](CpuVendor v, unsigned family, unsigned model,
+                         unsigned stepping) {
+  return (uint64_t(v) << 32) | (uint64_t(family) << 16) | (model << 8) |
+         stepping;
+};
+
+constexpr uint64_t key(const Uarch &u) {
+  return kKey(u.vendor, u.family, u.modelLo, u.minStepping);
+}
+
+consteval auto sorted() {
+  std::array<Uarch, std::size(kList)> table{};
+  std::copy(std::begin(kList), std::end(kList), table.begin());
+  std::sort(table.begin(), table.end(), [](const Uarch &a, const Uarch &b) {
+    return key(a) < key(b);
+  });
+  return table;
+}
+
+}  // namespace uarch_detail
+
+// Every known microarchitecture, sorted by (vendor, family, model,
+// stepping) at compile time
+inline constexpr auto kUarchTable = uarch_detail::sorted();
+
+static_assert(std::adjacent_find(kUarchTable.begin(), kUarchTable.end(),
+                                 [](const Uarch &a, const Uarch &b) {
+                                   return uarch_detail::key(a) ==
+                                          uarch_detail::key(b);
+                                 }) == kUarchTable.end(),
+              "duplicate uarch entry");
+
+// The entry covering a signature, or nullptr. A binary search over
+// kUarchTable; folds to a constant when the arguments are constants.
+constexpr const Uarch *find_uarch(CpuVendor vendor, unsigned family,
+                                  unsigned model, unsigned stepping) {
+  uint64_t k = uarch_detail::kKey(vendor, family, model, stepping);
+  auto it = std::upper_bound(
+      kUarchTable.begin(), kUarchTable.end(), k,
+      [](uint64_t k, const Uarch &u) { return k < uarch_detail::key(u); });
+  if (it == kUarchTable.begin()) return nullptr;
+  const Uarch &u = *--it;
+  if (u.vendor != vendor || u.family != family || model > u.modelHi) {
+    return nullptr;
+  }
+  return &u;
+}
+
+constexpr const Uarch *find_uarch(const CpuSignature &sig) {
+  return find_uarch(sig.vendor, sig.family, sig.model, sig.stepping);
+}
+
+// Microarchitecture of the CPU `snap` was taken on, or nullptr
+const Uarch *find_uarch(const CpuidSnapshot &snap);
+
+#endif  // UARCH_HPP
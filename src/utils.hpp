@@ -1,40 +1,117 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
-#include <string>
-#include <vector>
 
-/* Only for 32bit values */
-#define bit32(n) (1U << (n))
-#define bitmask32(h, l) ((bit32(h) | (bit32(h) - 1)) & ~(bit32(l) - 1))
-#define bitfield32(x, h, l) (((x & bitmask32(h, l)) >> l))
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string_view>
+#include <type_traits>
+
+#include "snapshot.hpp"
+
+static_assert(std::endian::native == std::endian::little,
+              "CPUID register strings are laid out little-endian");
+
+// Only for 32bit values. Each argument is evaluated once, and a bad range
+// is a compile error in constant expressions.
+constexpr uint32_t bit32(unsigned n) { return uint32_t(1) << n; }
+
+// Bits h..l (inclusive) set
+constexpr uint32_t bitmask32(unsigned h, unsigned l) {
+  return (bit32(h) | (bit32(h) - 1)) & ~(bit32(l) - 1);
+}
+
+// Bits h..l of x, shifted down to bit 0
+constexpr uint32_t bitfield32(uint32_t x, unsigned h, unsigned l) {
+  return (x & bitmask32(h, l)) >> l;
+}
 
 // extract bits from a 32-bit value, from bit start to bit end
-// e.g. extract_bits(0x12345678, 31, 24) returns 0x12
-// e.g. extract_bits(0x12345678, 23, 16) returns 0x34
-#define extract_bits(x, start, end) bitfield32(x, end, start)
-#define extract_bit(x, n) extract_bits(x, n, n)
+// e.g. extract_bits(0x12345678, 24, 31) returns 0x12
+// e.g. extract_bits(0x12345678, 16, 23) returns 0x34
+constexpr uint32_t extract_bits(uint32_t x, unsigned start, unsigned end) {
+  return bitfield32(x, end, start);
+}
+constexpr uint32_t extract_bit(uint32_t x, unsigned n) {
+  return bitfield32(x, n, n);
+}
 
-// https://github.com/LibreOffice/online/blob/d0edfeabbdc969a9a66cf90976a63c2f4403a6d3/wsd/ProofKey.cpp#L41-L83
-std::vector<unsigned char> getBytesLE(const unsigned char *bytesInHostOrder,
-                                      const size_t n);
+// Bits Hi..Lo of register R, with the range checked at compile time. get()
+// is a shift and a mask.
+template <CpuidReg R, unsigned Hi, unsigned Lo>
+struct Field {
+  static_assert(Lo <= Hi && Hi < 32, "field must lie within a 32-bit register");
 
-std::vector<unsigned char> getBytesBE(const unsigned char *bytesInHostOrder,
-                                      const size_t n);
+  static constexpr CpuidReg kReg = R;
+  static constexpr unsigned kWidth = Hi - Lo + 1;
+  static constexpr uint32_t kMask = bitmask32(Hi, Lo);
 
-// Returns passed number as vector of bytes (little-endian)
-template <typename T>
-std::vector<unsigned char> ToLEBytes(const T &x) {
-  return getBytesLE(reinterpret_cast<const unsigned char *>(&x), sizeof(x));
+  static constexpr uint32_t get(uint32_t reg) { return (reg & kMask) >> Lo; }
+  static constexpr uint32_t get(const CpuidLeaf &leaf) {
+    return get(leaf.regs[size_t(R)]);
+  }
+};
+
+template <CpuidReg R, unsigned N>
+using Bit = Field<R, N, N>;
+
+// CPUID.01H fields
+namespace leaf1 {
+using Stepping = Field<CpuidReg::EAX, 3, 0>;
+using Model = Field<CpuidReg::EAX, 7, 4>;
+using Family = Field<CpuidReg::EAX, 11, 8>;
+using Type = Field<CpuidReg::EAX, 13, 12>;
+using ExtendedModel = Field<CpuidReg::EAX, 19, 16>;
+using ExtendedFamily = Field<CpuidReg::EAX, 27, 20>;
+using BrandIndex = Field<CpuidReg::EBX, 7, 0>;
+using ClflushLineSize = Field<CpuidReg::EBX, 15, 8>;  // in 8-byte units
+using MaxLogicalIds = Field<CpuidReg::EBX, 23, 16>;
+using InitialApicId = Field<CpuidReg::EBX, 31, 24>;
+
+// Display model: the extended model is prepended to the model
+constexpr uint32_t real_model(const CpuidLeaf &leaf) {
+  return (ExtendedModel::get(leaf) << 4) | Model::get(leaf);
 }
+}  // namespace leaf1
 
-// Returns passed number as vector of bytes (network order = big-endian)
-template <typename T>
-std::vector<unsigned char> ToNetworkOrderBytes(const T &x) {
-  return getBytesBE(reinterpret_cast<const unsigned char *>(&x), sizeof(x));
+// Characters held in one or more registers, e.g. the vendor string in
+// EBX, EDX, ECX. Lives on the stack and formats as a string.
+template <size_t N>
+struct RegString {
+  std::array<char, N> chars;
+
+  constexpr std::string_view view() const { return {chars.data(), N}; }
+  constexpr operator std::string_view() const { return view(); }
+};
+
+template <std::same_as<uint32_t>... Regs>
+constexpr RegString<4 * sizeof...(Regs)> regs_to_chars(Regs... regs) {
+  std::array<uint32_t, sizeof...(Regs)> words{regs...};
+  return {std::bit_cast<std::array<char, 4 * sizeof...(Regs)>>(words)};
 }
 
-std::string num_to_str(int num);
+template <size_t N>
+struct std::formatter<RegString<N>> : std::formatter<std::string_view> {
+  auto format(const RegString<N> &s, std::format_context &ctx) const {
+    return std::formatter<std::string_view>::format(s.view(), ctx);
+  }
+};
 
-char *num_to_str2(int num);
+// Returns the bytes of x, least significant first
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+constexpr std::array<unsigned char, sizeof(T)> ToLEBytes(const T &x) {
+  return std::bit_cast<std::array<unsigned char, sizeof(T)>>(x);
+}
+
+// Returns the bytes of x in network order (big-endian)
+template <std::integral T>
+constexpr std::array<unsigned char, sizeof(T)> ToNetworkOrderBytes(T x) {
+  return std::bit_cast<std::array<unsigned char, sizeof(T)>>(
+      std::byteswap(x));
+}
 
-#endif  // UTILS_HPP
\ No newline at end of file
+#endif  // UTILS_HPP
@@ -0,0 +1,290 @@
+#include "watch.hpp"
+
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <thread>
+
+std::vector<int> parse_cpu_list(std::string_view list) {
+  std::vector<int> cpus;
+  while (!list.empty()) {
+    size_t comma = list.find(',');
+    std::string_view range = list.substr(0, comma);
+    list = comma == std::string_view::npos ? "" : list.substr(comma + 1);
+
+    int first = 0;
+    auto [end, ec] =
+        std::from_chars(range.data(), range.data() + range.size(), first);
+    if (ec != std::errc()) continue;
+    int last = first;
+    if (end < range.data() + range.size() && *end == '-') {
+      std::from_chars(end + 1, range.data() + range.size(), last);
+    }
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+SysCpuState read_sys_cpu_state(const std::string &root) {
+  SysCpuState state;
+  std::string line;
+  if (std::ifstream online(root + "/online"); std::getline(online, line)) {
+    state.online = parse_cpu_list(line);
+  }
+  if (state.online.empty()) return state;
+
+  state.microcode.assign(state.online.back() + 1, 0);
+  for (int cpu : state.online) {
+    std::ifstream version(std::format("{}/cpu{}/microcode/version", root, cpu));
+    if (!std::getline(version, line)) continue;
+    // "0x2b000620"; from_chars takes no prefix
+    std::string_view hex = line;
+    if (hex.starts_with("0x")) hex.remove_prefix(2);
+    std::from_chars(hex.data(), hex.data() + hex.size(), state.microcode[cpu],
+                    16);
+  }
+  return state;
+}
+
+std::vector<LeafChange> diff_snapshots(const CpuidSnapshot &before,
+                                       const CpuidSnapshot &after) {
+  static constexpr uint32_t kZero[4] = {0, 0, 0, 0};
+  std::vector<LeafChange> changes;
+  auto compare = [&](uint32_t leaf, uint32_t subleaf, const uint32_t *a,
+                     const uint32_t *b) {
+    for (uint8_t r = 0; r < 4; ++r) {
+      if (a[r] != b[r]) {
+        changes.push_back({leaf, subleaf, CpuidReg(r), a[r], b[r]});
+      }
+    }
+  };
+
+  // Both sides are sorted by key(): one merge walk
+  std::span<const CpuidLeaf> a = before.leaves(), b = after.leaves();
+  size_t i = 0, j = 0;
+  while (i < a.size() || j < b.size()) {
+    if (j == b.size() || (i < a.size() && a[i].key() < b[j].key())) {
+      compare(a[i].leaf, a[i].subleaf, a[i].regs, kZero);
+      ++i;
+    } else if (i == a.size() || b[j].key() < a[i].key()) {
+      compare(b[j].leaf, b[j].subleaf, kZero, b[j].regs);
+      ++j;
+    } else {
+      compare(a[i].leaf, a[i].subleaf, a[i].regs, b[j].regs);
+      ++i;
+      ++j;
+    }
+  }
+  return changes;
+}
+
+std::string format_changes(const std::vector<CpuChange> &changes) {
+  static constexpr const char *kRegNames[] = {"EAX", "EBX", "ECX", "EDX"};
+  std::string out;
+  for (const CpuChange &c : changes) {
+    const auto &ids = c.topology.ids;
+    switch (c.kind) {
+      case CpuChange::Kind::Online:
+        out += std::format(
+            "+cpu {} x2apic {:#x} pkg {} die {} core {} smt {} "
+            "microcode {:#x}\n",
+            c.cpu, c.topology.x2apicId, ids[size_t(TopoLevel::Package)],
+            ids[size_t(TopoLevel::Die)], ids[size_t(TopoLevel::Core)],
+            ids[size_t(TopoLevel::SMT)], c.newMicrocode);
+        break;
+      case CpuChange::Kind::Offline:
+        out += std::format("-cpu {}\n", c.cpu);
+        break;
+      case CpuChange::Kind::Changed:
+        if (c.oldMicrocode != c.newMicrocode) {
+          out += std::format("~cpu {} microcode {:#x} -> {:#x}\n", c.cpu,
+                             c.oldMicrocode, c.newMicrocode);
+        }
+        for (const LeafChange &l : c.leaves) {
+          out += std::format("~cpu {} {:#x}.{} {} {:#010x} -> {:#010x}\n",
+                             c.cpu, l.leaf, l.subleaf,
+                             kRegNames[size_t(l.reg)], l.before, l.after);
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+CpuWatcher::CpuWatcher(Options options)
+    : mOptions(std::move(options)),
+      mState(read_sys_cpu_state(mOptions.sysRoot)),
+      mCpus(mState.online, 0, mOptions.read),
+      mTopology(mCpus) {
+  if (mOptions.netlink) {
+    mNetlinkFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_KOBJECT_UEVENT);
+    // Group 1 carries the kernel's own uevents (udev rebroadcasts on 2)
+    sockaddr_nl addr{.nl_family = AF_NETLINK, .nl_pad = 0, .nl_pid = 0,
+                     .nl_groups = 1};
+    if (mNetlinkFd >= 0 &&
+        bind(mNetlinkFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+            0) {
+      close(mNetlinkFd);
+      mNetlinkFd = -1;
+    }
+  }
+
+  // sysfs attributes do not raise inotify events when the kernel changes
+  // them, so on the real tree this only catches writes made through it;
+  // a fake tree written by a test is watched completely
+  mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (mInotifyFd >= 0 &&
+      inotify_add_watch(mInotifyFd, mOptions.sysRoot.c_str(),
+                        IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE |
+                            IN_DELETE) < 0) {
+    close(mInotifyFd);
+    mInotifyFd = -1;
+  }
+  watchMicrocodeDirs();
+}
+
+CpuWatcher::~CpuWatcher() {
+  if (mNetlinkFd >= 0) close(mNetlinkFd);
+  if (mInotifyFd >= 0) close(mInotifyFd);
+}
+
+std::string_view CpuWatcher::source() const {
+  if (mNetlinkFd >= 0) return mInotifyFd >= 0 ? "netlink+inotify" : "netlink";
+  return mInotifyFd >= 0 ? "inotify" : "poll";
+}
+
+void CpuWatcher::watchMicrocodeDirs() {
+  if (mInotifyFd < 0) return;
+  // Re-adding a watched path returns its existing descriptor, and the
+  // kernel drops the watches of directories that went away with a CPU
+  for (int cpu : mState.online) {
+    std::string dir = std::format("{}/cpu{}/microcode", mOptions.sysRoot, cpu);
+    inotify_add_watch(mInotifyFd, dir.c_str(),
+                      IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO);
+  }
+}
+
+bool CpuWatcher::drainUevents() {
+  // "ACTION@DEVPATH\0KEY=VALUE\0...": only CPU devices (online/offline)
+  // and the CPU subsystem root (change after a late microcode load)
+  bool relevant = false;
+  char buf[8192];
+  for (;;) {
+    sockaddr_nl from{};
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(mNetlinkFd, buf, sizeof(buf) - 1, 0,
+                         reinterpret_cast<sockaddr *>(&from), &len);
+    if (n <= 0) break;
+    if (from.nl_pid != 0) continue;  // not from the kernel
+    buf[n] = '\0';
+    std::string_view header(buf);
+    size_t at = header.find('@');
+    if (at != std::string_view::npos &&
+        header.substr(at + 1).starts_with("/devices/system/cpu")) {
+      relevant = true;
+    }
+  }
+  return relevant;
+}
+
+bool CpuWatcher::wait(std::chrono::milliseconds timeout) {
+  pollfd fds[2];
+  nfds_t n = 0;
+  if (mNetlinkFd >= 0) fds[n++] = {mNetlinkFd, POLLIN, 0};
+  if (mInotifyFd >= 0) fds[n++] = {mInotifyFd, POLLIN, 0};
+  if (n == 0) {
+    std::this_thread::sleep_for(timeout);
+    return false;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (;;) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (poll(fds, n, int(std::max<int64_t>(left.count(), 0))) <= 0) {
+      return false;
+    }
+    bool woke = false;
+    for (nfds_t i = 0; i < n; ++i) {
+      if (!(fds[i].revents & POLLIN)) continue;
+      if (fds[i].fd == mNetlinkFd) {
+        woke |= drainUevents();
+      } else {
+        alignas(inotify_event) char buf[4096];
+        while (read(mInotifyFd, buf, sizeof(buf)) > 0) woke = true;
+      }
+    }
+    // Uevents for other devices share the socket; keep waiting
+    if (woke) return true;
+  }
+}
+
+std::vector<CpuChange> CpuWatcher::refresh() {
+  SysCpuState now = read_sys_cpu_state(mOptions.sysRoot);
+  std::vector<CpuChange> changes;
+
+  const std::vector<int> known = mCpus.cpus();
+  for (int cpu : known) {
+    if (std::binary_search(now.online.begin(), now.online.end(), cpu)) {
+      continue;
+    }
+    mCpus.erase(cpu);
+    CpuChange &c = changes.emplace_back();
+    c.cpu = cpu;
+    c.kind = CpuChange::Kind::Offline;
+    c.oldMicrocode = mState.microcodeOf(cpu);
+  }
+
+  // A CPU that was online but unreadable (e.g. outside the affinity mask)
+  // is only retried when its microcode changes
+  std::vector<int> reread;
+  for (int cpu : now.online) {
+    bool wasOnline =
+        std::binary_search(mState.online.begin(), mState.online.end(), cpu);
+    if (!wasOnline || now.microcodeOf(cpu) != mState.microcodeOf(cpu)) {
+      reread.push_back(cpu);
+    }
+  }
+
+  if (!reread.empty()) {
+    PerCpuSnapshot fresh(reread, 0, mOptions.read);
+    for (size_t i = 0; i < fresh.size(); ++i) {
+      int cpu = fresh.cpu(i);
+      CpuChange &c = changes.emplace_back();
+      c.cpu = cpu;
+      c.kind = CpuChange::Kind::Online;
+      c.newMicrocode = now.microcodeOf(cpu);
+      if (const CpuidSnapshot *old = mCpus.forCpu(cpu)) {
+        c.kind = CpuChange::Kind::Changed;
+        c.oldMicrocode = mState.microcodeOf(cpu);
+        c.leaves = diff_snapshots(*old, fresh[i]);
+      }
+      mCpus.set(cpu, fresh[i]);
+    }
+  }
+
+  bool hotplug = now.online != mState.online;
+  mState = std::move(now);
+  if (changes.empty()) return changes;
+
+  // Sibling sets and domain counts move with every hotplug; the table is
+  // already current, so this executes no `cpuid`
+  mTopology = Topology(mCpus);
+  for (CpuChange &c : changes) {
+    if (const LogicalCpu *l = mTopology.forCpu(c.cpu)) c.topology = *l;
+  }
+  if (hotplug) watchMicrocodeDirs();
+  std::sort(changes.begin(), changes.end(),
+            [](const CpuChange &a, const CpuChange &b) { return a.cpu < b.cpu; });
+  return changes;
+}
@@ -0,0 +1,107 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "percpu.hpp"
+#include "snapshot.hpp"
+#include "topology.hpp"
+
+inline constexpr const char *kSysCpuRoot = "/sys/devices/system/cpu";
+
+// "0-3,8,10-11" (the sysfs cpulist format) -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parse_cpu_list(std::string_view list);
+
+// What sysfs says about the CPUs; `root` can be a fake tree with the same
+// layout: an `online` cpulist and cpuN/microcode/version (hex) files
+struct SysCpuState {
+  std::vector<int> online;           // ascending
+  std::vector<uint32_t> microcode;   // indexed by CPU; 0 when unreadable
+
+  uint32_t microcodeOf(int cpu) const {
+    return size_t(cpu) < microcode.size() ? microcode[cpu] : 0;
+  }
+};
+SysCpuState read_sys_cpu_state(const std::string &root = kSysCpuRoot);
+
+// One register that differs between two snapshots of a CPU; a leaf present
+// on one side only compares against zeros
+struct LeafChange {
+  uint32_t leaf;
+  uint32_t subleaf;
+  CpuidReg reg;
+  uint32_t before;
+  uint32_t after;
+};
+std::vector<LeafChange> diff_snapshots(const CpuidSnapshot &before,
+                                       const CpuidSnapshot &after);
+
+struct CpuChange {
+  enum class Kind : uint8_t { Online, Offline, Changed };
+
+  int cpu = -1;
+  Kind kind = Kind::Changed;
+  uint32_t oldMicrocode = 0;
+  uint32_t newMicrocode = 0;
+  std::vector<LeafChange> leaves;  // Changed only
+  LogicalCpu topology{};           // Online and Changed
+};
+
+// One line per CPU event, then one per changed register:
+//   +cpu 4 x2apic 0x8 pkg 0 die 0 core 4 smt 0 microcode 0x2b000620
+//   -cpu 3
+//   ~cpu 2 microcode 0x2b000603 -> 0x2b000620
+//   ~cpu 2 0x7.0 EDX 0x... -> 0x...
+std::string format_changes(const std::vector<CpuChange> &changes);
+
+// Keeps a per-CPU table and topology current across CPU hotplug and late
+// microcode loads. Events only wake the watcher; refresh() diffs sysfs
+// against the last state and re-reads just the CPUs that came online or
+// changed microcode revision, so a missed or coalesced event costs nothing
+// but latency. The topology is rebuilt from the in-memory snapshots
+// (sibling sets change with every hotplug) without executing `cpuid`.
+class CpuWatcher {
+ public:
+  struct Options {
+    std::string sysRoot = kSysCpuRoot;
+    // How to read a CPU, e.g. pinned (default) or through /dev/cpu
+    PerCpuSnapshot::ReadCpu read = PerCpuSnapshot::readPinned;
+    // Kernel uevents; only meaningful for the real sysfs root
+    bool netlink = true;
+  };
+
+  explicit CpuWatcher(Options options);
+  CpuWatcher(const CpuWatcher &) = delete;
+  CpuWatcher &operator=(const CpuWatcher &) = delete;
+  ~CpuWatcher();
+
+  const PerCpuSnapshot &cpus() const { return mCpus; }
+  const Topology &topology() const { return mTopology; }
+  const SysCpuState &state() const { return mState; }
+  // "netlink+inotify", "netlink", "inotify" or "poll"
+  std::string_view source() const;
+
+  // Blocks until a CPU uevent or a change under the sysfs root arrives, or
+  // `timeout` passes; true when something arrived
+  bool wait(std::chrono::milliseconds timeout);
+  // Re-reads sysfs, re-enumerates the affected CPUs and returns what
+  // changed (empty when nothing did)
+  std::vector<CpuChange> refresh();
+
+ private:
+  bool drainUevents();
+  void watchMicrocodeDirs();
+
+  Options mOptions;
+  SysCpuState mState;
+  PerCpuSnapshot mCpus;
+  Topology mTopology;
+  int mNetlinkFd = -1;
+  int mInotifyFd = -1;
+};
+
+#endif  // WATCH_HPP
@@ -0,0 +1,210 @@
+#include "xsave.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "backend.hpp"
+#include "utils.hpp"
+
+// arch_prctl codes from <asm/prctl.h>, for headers older than Linux 5.16
+#ifndef ARCH_GET_XCOMP_PERM
+#define ARCH_GET_XCOMP_PERM 0x1022
+#endif
+#ifndef ARCH_REQ_XCOMP_PERM
+#define ARCH_REQ_XCOMP_PERM 0x1023
+#endif
+
+// Legacy region (x87, SSE) plus the XSAVE header
+#define XSAVE_LEGACY_SIZE 576
+
+static_assert(kTierState[size_t(VectorTier::AVX)] == 0x7);
+static_assert(kTierState[size_t(VectorTier::AVX512)] == 0xE7);
+static_assert(kTierState[size_t(VectorTier::AMX)] == 0x600E7);
+
+std::string_view xstate_name(unsigned component) {
+  static constexpr std::string_view kNames[] = {
+      "x87",   "SSE",      "AVX",       "BNDREGS",  "BNDCSR",
+      "opmask", "ZMM_Hi256", "Hi16_ZMM", "PT",       "PKRU",
+      "PASID", "CET_U",    "CET_S",     "HDC",      "UINTR",
+      "LBR",   "HWP",      "XTILECFG",  "XTILEDATA", "APX"};
+  return component < std::size(kNames) ? kNames[component] : "";
+}
+
+std::string_view tier_name(VectorTier tier) {
+  static constexpr std::string_view kNames[] = {"scalar", "sse", "avx",
+                                                "avx512", "amx"};
+  return kNames[size_t(tier)];
+}
+
+uint32_t XsaveInfo::standardSize(uint64_t mask) const {
+  if (!mask) return 0;
+  uint32_t size = XSAVE_LEGACY_SIZE;
+  for (unsigned i = 2; i < components.size(); ++i) {
+    const XStateComponent &c = components[i];
+    if ((mask >> i & 1) && !c.supervisor) {
+      size = std::max(size, c.offset + c.size);
+    }
+  }
+  return size;
+}
+
+uint32_t XsaveInfo::compactedSize(uint64_t mask) const {
+  if (!mask) return 0;
+  uint32_t size = XSAVE_LEGACY_SIZE;
+  for (unsigned i = 2; i < components.size(); ++i) {
+    if (!(mask >> i & 1)) continue;
+    if (components[i].aligned) size = (size + 63) & ~uint32_t(63);
+    size += components[i].size;
+  }
+  return size;
+}
+
+XsaveInfo decode_xsave(const CpuidSnapshot &snap, uint64_t xcr0,
+                       uint64_t permitted) {
+  XsaveInfo info;
+  const CpuidLeaf &l1 = snap.get(0x1);
+  info.osxsave = Bit<CpuidReg::ECX, 27>::get(l1);
+  // Without CR4.OSXSAVE no XCR0 component counts as enabled
+  info.xcr0 = info.osxsave ? xcr0 : 0;
+  info.permitted = permitted;
+  if (!Bit<CpuidReg::ECX, 26>::get(l1) || snap.maxBasicLeaf() < 0xD) {
+    return info;
+  }
+
+  const CpuidLeaf &d0 = snap.get(0xD, 0);
+  const CpuidLeaf &d1 = snap.get(0xD, 1);
+  info.userMask = (uint64_t(d0.EDX()) << 32) | d0.EAX();
+  info.supervisorMask = (uint64_t(d1.EDX()) << 32) | d1.ECX();
+  info.enabledSize = d0.EBX();
+  info.maxSize = d0.ECX();
+  info.xsavesSize = d1.EBX();
+  info.xsaveopt = Bit<CpuidReg::EAX, 0>::get(d1);
+  info.xsavec = Bit<CpuidReg::EAX, 1>::get(d1);
+  info.xsaves = Bit<CpuidReg::EAX, 3>::get(d1);
+  info.xfd = Bit<CpuidReg::EAX, 4>::get(d1);
+
+  const uint64_t all = info.userMask | info.supervisorMask;
+  for (unsigned i = 2; i < info.components.size(); ++i) {
+    if (!(all >> i & 1)) continue;
+    const CpuidLeaf &l = snap.get(0xD, i);
+    XStateComponent &c = info.components[i];
+    c.size = l.EAX();
+    c.offset = l.EBX();
+    c.supervisor = Bit<CpuidReg::ECX, 0>::get(l);
+    c.aligned = Bit<CpuidReg::ECX, 1>::get(l);
+    c.xfd = Bit<CpuidReg::ECX, 2>::get(l);
+  }
+  return info;
+}
+
+XsaveInfo decode_xsave(const CpuidSnapshot &snap) {
+  XsaveInfo info = decode_xsave(snap, 0, 0);
+  if (!info.osxsave || !info.userMask) return info;
+
+  // An upper bound: a component laid out below the highest enabled one is
+  // counted even if the OS left it off (e.g. MPX on current kernels)
+  uint64_t xcr0 = xstate_bit(XState::X87) | xstate_bit(XState::SSE);
+  for (unsigned i = 2; i < 64; ++i) {
+    const XStateComponent &c = info.components[i];
+    if ((info.userMask >> i & 1) && c.offset + c.size <= info.enabledSize) {
+      xcr0 |= uint64_t(1) << i;
+    }
+  }
+  info.xcr0 = info.permitted = xcr0;
+  return info;
+}
+
+XsaveInfo host_xsave(const CpuidSnapshot &snap) {
+  std::optional<uint64_t> read = read_xcr0();
+  uint64_t xcr0 = read.value_or(0);
+  XsaveInfo info =
+      decode_xsave(snap, xcr0, read_xcomp_perm().value_or(xcr0));
+  // Without CR4.OSXSAVE there was no XGETBV, and 0 is only a default
+  info.xcr0Read = read.has_value();
+  return info;
+}
+
+std::optional<uint64_t> read_xcr0() {
+  // OSXSAVE is read live: a recorded leaf says nothing about this kernel
+  if (!Bit<CpuidReg::ECX, 27>::get(NativeBackend::instance().query(0x1, 0))) {
+    return std::nullopt;
+  }
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (uint64_t(hi) << 32) | lo;
+}
+
+std::optional<uint64_t> read_xcomp_perm() {
+  uint64_t mask = 0;
+  if (syscall(SYS_arch_prctl, ARCH_GET_XCOMP_PERM, &mask) != 0) {
+    return std::nullopt;
+  }
+  return mask;
+}
+
+bool request_xcomp_perm(XState component) {
+  return syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM,
+                 static_cast<unsigned long>(component)) == 0;
+}
+
+namespace {
+
+// Features that read or write the register state in `mask`
+struct StateRequirement {
+  uint64_t mask;
+  FeatureSet features;
+};
+
+constexpr uint64_t kAvxState = kTierState[size_t(VectorTier::AVX)];
+constexpr uint64_t kAvx512State = kTierState[size_t(VectorTier::AVX512)];
+
+constexpr StateRequirement kRequirements[] = {
+    // The XSAVE extensions fault without CR4.OSXSAVE, i.e. with XCR0 unread
+    {kTierState[size_t(VectorTier::SSE)],
+     {Feature::XSAVEOPT, Feature::XSAVEC, Feature::XGETBV_ECX1,
+      Feature::XSAVES, Feature::XFD}},
+    // VEX-encoded instructions touch the upper YMM halves
+    {kAvxState,
+     {Feature::AVX, Feature::AVX2, Feature::FMA, Feature::F16C, Feature::VAES,
+      Feature::VPCLMULQDQ, Feature::AVX_VNNI, Feature::AVX_IFMA,
+      Feature::AVX_VNNI_INT8, Feature::AVX_NE_CONVERT, Feature::AVX_VNNI_INT16,
+      Feature::SHA512, Feature::SM3, Feature::SM4}},
+    {kAvx512State,
+     {Feature::AVX512F, Feature::AVX512DQ, Feature::AVX512_IFMA,
+      Feature::AVX512PF, Feature::AVX512ER, Feature::AVX512CD,
+      Feature::AVX512BW, Feature::AVX512VL, Feature::AVX512_VBMI,
+      Feature::AVX512_VBMI2, Feature::AVX512_VNNI, Feature::AVX512_BITALG,
+      Feature::AVX512_VPOPCNTDQ, Feature::AVX512_4VNNIW,
+      Feature::AVX512_4FMAPS, Feature::AVX512_VP2INTERSECT,
+      Feature::AVX512_FP16, Feature::AVX512_BF16, Feature::AVX10}},
+    {kTierState[size_t(VectorTier::AMX)],
+     {Feature::AMX_TILE, Feature::AMX_INT8, Feature::AMX_BF16,
+      Feature::AMX_FP16, Feature::AMX_COMPLEX}},
+    {xstate_bit(XState::BNDREGS) | xstate_bit(XState::BNDCSR), {Feature::MPX}},
+    {xstate_bit(XState::APX), {Feature::APX_F}},
+};
+
+}  // namespace
+
+FeatureSet usable_features(const FeatureSet &cpuid, const XsaveInfo &xsave) {
+  FeatureSet usable = cpuid;
+  for (const StateRequirement &req : kRequirements) {
+    if (xsave.usable(req.mask)) continue;
+    for (const FeatureDesc &desc : kFeatures) {
+      if (req.features.has(desc.id)) usable.set(desc.id, false);
+    }
+  }
+  return usable;
+}
+
+VectorTier widest_tier(const FeatureSet &usable) {
+  if (usable.has(Feature::AVX512F)) {
+    return usable.has(Feature::AMX_TILE) ? VectorTier::AMX
+                                         : VectorTier::AVX512;
+  }
+  if (usable.has(Feature::AVX)) return VectorTier::AVX;
+  if (usable.has(Feature::SSE2)) return VectorTier::SSE;
+  return VectorTier::Scalar;
+}
@@ -0,0 +1,138 @@
+#ifndef XSAVE_HPP
+#define XSAVE_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "features.hpp"
+#include "snapshot.hpp"
+
+// XSAVE state components: bit numbers in XCR0 and IA32_XSS, and the
+// subleaf of CPUID.0DH that describes each (Intel SDM Vol. 1, 13.1)
+enum class XState : uint8_t {
+  X87 = 0,
+  SSE = 1,
+  AVX = 2,  // upper halves of YMM0-15
+  BNDREGS = 3,
+  BNDCSR = 4,
+  Opmask = 5,    // k0-k7
+  ZmmHi256 = 6,  // upper halves of ZMM0-15
+  Hi16Zmm = 7,   // ZMM16-31
+  PT = 8,
+  PKRU = 9,
+  PASID = 10,
+  CetUser = 11,
+  CetSupervisor = 12,
+  HDC = 13,
+  UINTR = 14,
+  LBR = 15,
+  HWP = 16,
+  TileCfg = 17,
+  TileData = 18,
+  APX = 19,  // extended GPRs R16-R31
+};
+
+constexpr uint64_t xstate_bit(XState s) { return uint64_t(1) << unsigned(s); }
+
+// "AVX", "Hi16_ZMM", ...; "" for components without a name
+std::string_view xstate_name(unsigned component);
+
+// Widest SIMD path and the state it makes the OS save on every context
+// switch. Tiers include the ones below them.
+enum class VectorTier : uint8_t { Scalar, SSE, AVX, AVX512, AMX };
+
+inline constexpr uint64_t kTierState[] = {
+    0,
+    xstate_bit(XState::X87) | xstate_bit(XState::SSE),
+    xstate_bit(XState::X87) | xstate_bit(XState::SSE) |
+        xstate_bit(XState::AVX),
+    xstate_bit(XState::X87) | xstate_bit(XState::SSE) |
+        xstate_bit(XState::AVX) | xstate_bit(XState::Opmask) |
+        xstate_bit(XState::ZmmHi256) | xstate_bit(XState::Hi16Zmm),
+    xstate_bit(XState::X87) | xstate_bit(XState::SSE) |
+        xstate_bit(XState::AVX) | xstate_bit(XState::Opmask) |
+        xstate_bit(XState::ZmmHi256) | xstate_bit(XState::Hi16Zmm) |
+        xstate_bit(XState::TileCfg) | xstate_bit(XState::TileData),
+};
+
+// "scalar", "sse", "avx", "avx512" or "amx"
+std::string_view tier_name(VectorTier tier);
+
+// CPUID.(EAX=0DH,ECX=i) for i >= 2
+struct XStateComponent {
+  uint32_t size = 0;            // EAX, bytes
+  uint32_t offset = 0;          // EBX, standard format; 0 for supervisor state
+  bool supervisor = false;      // ECX[0]: enabled through IA32_XSS, not XCR0
+  bool aligned = false;         // ECX[1]: 64-byte aligned when compacted
+  bool xfd = false;             // ECX[2]: XFD can arm a fault on first use
+};
+
+// Leaf 0xD decoded against the state the OS actually enabled. A CPUID bit
+// only says the silicon has an instruction set; executing it also needs
+// CR4.OSXSAVE and the matching XCR0 bits, and on Linux the AMX tile data
+// additionally needs a per-process arch_prctl permission. Without them
+// the first vector instruction raises #UD (or #NM) and we die with SIGILL.
+struct XsaveInfo {
+  bool osxsave = false;         // CPUID.01H:ECX[27], the OS set CR4.OSXSAVE
+  bool xcr0Read = false;        // xcr0 came from XGETBV, not an estimate
+  uint64_t xcr0 = 0;            // components the OS enabled
+  uint64_t permitted = 0;       // components this process may touch
+  uint64_t userMask = 0;        // CPUID.(0DH,0):EDX:EAX, XCR0-settable bits
+  uint64_t supervisorMask = 0;  // CPUID.(0DH,1):EDX:ECX, IA32_XSS bits
+  uint32_t enabledSize = 0;     // CPUID.(0DH,0):EBX, XSAVE area for XCR0
+  uint32_t maxSize = 0;         // CPUID.(0DH,0):ECX, every user component
+  uint32_t xsavesSize = 0;      // CPUID.(0DH,1):EBX, XCR0|XSS compacted
+  bool xsaveopt = false;
+  bool xsavec = false;
+  bool xsaves = false;
+  bool xfd = false;
+  std::array<XStateComponent, 64> components{};
+
+  // Components that are both enabled and permitted
+  uint64_t usable() const { return xcr0 & permitted; }
+  bool usable(uint64_t mask) const { return (usable() & mask) == mask; }
+
+  // Bytes XSAVE writes for `mask`: the standard layout runs to the end of
+  // the highest component, the compacted one (XSAVEC/XSAVES, which Linux
+  // uses) packs the selected components. Both include the 512-byte legacy
+  // area and the 64-byte header.
+  uint32_t standardSize(uint64_t mask) const;
+  uint32_t compactedSize(uint64_t mask) const;
+  // What a context switch saves: compacted when the kernel can use XSAVES
+  uint32_t switchSize(uint64_t mask) const {
+    return xsaves ? compactedSize(mask) : standardSize(mask);
+  }
+};
+
+// Decodes `snap` against an explicit XCR0 and permitted mask
+XsaveInfo decode_xsave(const CpuidSnapshot &snap, uint64_t xcr0,
+                       uint64_t permitted);
+// For recorded snapshots, where XCR0 was never read: estimates it as the
+// user components that fit in CPUID.(0DH,0):EBX, which is sized for the
+// XCR0 in force when the leaves were captured. permitted equals xcr0.
+XsaveInfo decode_xsave(const CpuidSnapshot &snap);
+// For snapshots of the running machine: XCR0 from read_xcr0() and the
+// permitted mask from read_xcomp_perm()
+XsaveInfo host_xsave(const CpuidSnapshot &snap);
+
+// XGETBV(0) on the calling CPU; nullopt when CR4.OSXSAVE is clear, in which
+// case XGETBV itself would fault
+std::optional<uint64_t> read_xcr0();
+// Components this process may use (Linux ARCH_GET_XCOMP_PERM); nullopt on
+// kernels without dynamic XSAVE features, where that is all of XCR0
+std::optional<uint64_t> read_xcomp_perm();
+// Asks the kernel for a dynamically enabled component, e.g.
+// XState::TileData before the first AMX instruction
+bool request_xcomp_perm(XState component);
+
+// `cpuid` with every feature whose register state is not usable in
+// `xsave` removed: the AVX, AVX-512, AMX, MPX and APX families and the
+// XSAVE extensions themselves
+FeatureSet usable_features(const FeatureSet &cpuid, const XsaveInfo &xsave);
+
+// Widest tier `usable` (from usable_features()) can run
+VectorTier widest_tier(const FeatureSet &usable);
+
+#endif  // XSAVE_HPP
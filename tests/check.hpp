@@ -0,0 +1,57 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Minimal assertions for the CTest executables in tests/. A failed check
+// prints its expression, location and (for CHECK_EQ) both values, and the
+// test keeps going; check_exit() turns any failure into exit status 1.
+inline int gCheckFailures = 0;
+
+template <typename T>
+std::string check_repr(const T &value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    return value ? "true" : "false";
+  } else if constexpr (std::is_enum_v<T>) {
+    return std::to_string(int64_t(value));
+  } else if constexpr (std::is_arithmetic_v<T>) {
+    return std::to_string(value);
+  } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    return std::string(std::string_view(value));
+  } else {
+    return "?";
+  }
+}
+
+inline void check_fail(const char *expr, const char *file, int line,
+                       const std::string &detail = {}) {
+  ++gCheckFailures;
+  std::cerr << file << ":" << line << ": CHECK(" << expr << ") failed"
+            << detail << "\n";
+}
+
+#define CHECK(cond)                                   \
+  do {                                                \
+    if (!(cond)) check_fail(#cond, __FILE__, __LINE__); \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                   \
+  do {                                                                   \
+    const auto &check_a = (a);                                           \
+    const auto &check_b = (b);                                           \
+    if (!(check_a == check_b)) {                                         \
+      check_fail(#a " == " #b, __FILE__, __LINE__,                       \
+                 ": " + check_repr(check_a) + " != " + check_repr(check_b)); \
+    }                                                                    \
+  } while (0)
+
+inline int check_exit() {
+  if (gCheckFailures) std::cerr << gCheckFailures << " check(s) failed\n";
+  return gCheckFailures ? 1 : 0;
+}
+
+#endif  // CHECK_HPP
@@ -0,0 +1,93 @@
+// PerCpuSnapshot::fromDevices() and DevCpuBackend against a stand-in for
+// /dev/cpu: sparse files holding the leaves of a recorded machine where
+// DevCpuBackend reads regular files.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+
+#include "backend.hpp"
+#include "percpu.hpp"
+#include "topology.hpp"
+
+#include "check.hpp"
+
+static bool write_device(const std::string &root, int cpu,
+                         const CpuidSnapshot &snap) {
+  std::string dir = std::format("{}/{}", root, cpu);
+  std::filesystem::create_directories(dir);
+  int fd = open((dir + "/cpuid").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) return false;
+  bool ok = true;
+  for (const CpuidLeaf &l : snap.leaves()) {
+    off_t offset = off_t(DevCpuBackend::fileOffset(l.leaf, l.subleaf));
+    ok = ok && pwrite(fd, l.regs, sizeof(l.regs), offset) == sizeof(l.regs);
+  }
+  close(fd);
+  return ok;
+}
+
+static bool same_leaves(const CpuidSnapshot &a, const CpuidSnapshot &b) {
+  return std::equal(a.leaves().begin(), a.leaves().end(), b.leaves().begin(),
+                    b.leaves().end(),
+                    [](const CpuidLeaf &x, const CpuidLeaf &y) {
+                      return x.key() == y.key() &&
+                             std::equal(x.regs, x.regs + 4, y.regs);
+                    });
+}
+
+static void test_devices(const std::string &root) {
+  std::optional<CpuidDump> dump =
+      load_cpuid_dump(std::string(CPUID_CORPUS_DIR) + "/amd_zen3_5950x.txt");
+  CHECK(dump.has_value());
+  if (!dump) return;
+  const PerCpuSnapshot recorded(*dump);
+  // CPU 5 has no device, as when it is offline
+  for (size_t i = 0; i < recorded.size(); ++i) {
+    if (recorded.cpu(i) != 5) {
+      CHECK(write_device(root, recorded.cpu(i), recorded[i]));
+    }
+  }
+  // Not a CPU directory
+  std::filesystem::create_directories(root + "/microcode");
+
+  CHECK(DevCpuBackend(0, root).ok());
+  CHECK(!DevCpuBackend(5, root).ok());
+  // Records the file does not hold read as zero
+  CHECK_EQ(DevCpuBackend(0, root).query(0x12345, 0).EAX(), 0U);
+
+  for (unsigned threads : {1U, 4U}) {
+    std::optional<PerCpuSnapshot> devices =
+        PerCpuSnapshot::fromDevices(root, threads);
+    CHECK(devices.has_value());
+    if (!devices) continue;
+    CHECK_EQ(devices->size(), recorded.size() - 1);
+    CHECK(devices->forCpu(5) == nullptr);
+    for (size_t i = 0; i < devices->size(); ++i) {
+      const CpuidSnapshot *want = recorded.forCpu(devices->cpu(i));
+      CHECK(want && same_leaves((*devices)[i], *want));
+    }
+    // Per-CPU APIC IDs came through: one L3 per CCD
+    CHECK_EQ(Topology(*devices).cacheDomains(3).size(), size_t(2));
+  }
+}
+
+int main() {
+  char tmpl[] = "/tmp/cpuid-percpu-test-XXXXXX";
+  const char *made = mkdtemp(tmpl);
+  CHECK(made != nullptr);
+  if (!made) return check_exit();
+  const std::string root = made;
+
+  CHECK(!PerCpuSnapshot::fromDevices(root).has_value());
+  CHECK(!PerCpuSnapshot::fromDevices(root + "/missing").has_value());
+  test_devices(root);
+
+  std::filesystem::remove_all(root);
+  return check_exit();
+}
@@ -0,0 +1,281 @@
+// The decoder stack against the recorded machines in tests/corpus, read
+// through parse_cpuid_dump() and ReplayBackend: vendor and signature,
+// features, caches, topology and core types.
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "backend.hpp"
+#include "cache.hpp"
+#include "features.hpp"
+#include "hybrid.hpp"
+#include "hypervisor.hpp"
+#include "percpu.hpp"
+#include "topology.hpp"
+#include "uarch.hpp"
+
+#include "check.hpp"
+
+static std::optional<PerCpuSnapshot> load(const std::string &name) {
+  std::optional<CpuidDump> dump =
+      load_cpuid_dump(std::string(CPUID_CORPUS_DIR) + "/" + name);
+  if (!dump) {
+    check_fail(("load " + name).c_str(), __FILE__, __LINE__);
+    return std::nullopt;
+  }
+  return PerCpuSnapshot(*dump);
+}
+
+static uint32_t cache_bytes(const CacheHierarchy &caches, unsigned level) {
+  const CacheLevel *c = caches.data(level);
+  return c ? c->sizeBytes : 0;
+}
+
+static void test_alderlake() {
+  std::optional<PerCpuSnapshot> all = load("intel_alderlake_12900k.txt");
+  if (!all) return;
+  const CpuidSnapshot &p = (*all)[0];
+  CHECK_EQ(all->size(), size_t(24));
+  CHECK_EQ(p.vendor(), CpuVendor::Intel);
+  const CpuSignature sig = cpu_signature(p.vendor(), p.get(0x1));
+  CHECK_EQ(sig.family, 6);
+  CHECK_EQ(sig.model, 0x97);
+  CHECK_EQ(sig.stepping, 2);
+  const Uarch *u = find_uarch(p);
+  CHECK(u && u->name == "Alder Lake");
+
+  const FeatureSet features(p);
+  CHECK(features.has(Feature::HYBRID));
+  CHECK(features.has(Feature::AVX2));
+  CHECK(features.has(Feature::AVX_VNNI));
+  CHECK(features.has(Feature::SHA));
+  CHECK(features.has(Feature::RDTSCP));
+  CHECK(!features.has(Feature::AVX512F));
+
+  // Golden Cove and Gracemont report their own leaf 4
+  const CacheHierarchy pCaches = decode_caches(p);
+  CHECK_EQ(pCaches.source, CacheSource::Leaf4);
+  CHECK_EQ(cache_bytes(pCaches, 1), 48U << 10);
+  CHECK_EQ(pCaches.data(1)->ways, 12);
+  CHECK_EQ(cache_bytes(pCaches, 2), 1280U << 10);
+  CHECK_EQ(cache_bytes(pCaches, 3), 30U << 20);
+  const CacheHierarchy eCaches = decode_caches((*all)[16]);
+  CHECK_EQ(cache_bytes(eCaches, 1), 32U << 10);
+  CHECK_EQ(eCaches.instruction(1)->sizeBytes, 64U << 10);
+  CHECK_EQ(cache_bytes(eCaches, 2), 2U << 20);
+  CHECK_EQ(eCaches.data(2)->sharedBy, 8);
+
+  const Topology topo(*all);
+  CHECK_EQ(topo.source(), TopoSource::Leaf1F);
+  CHECK_EQ(topo.count(TopoLevel::Package), size_t(1));
+  CHECK_EQ(topo.count(TopoLevel::Core), size_t(16));
+  CHECK_EQ(topo.siblings(0, TopoLevel::Core).count(), 2);
+  CHECK_EQ(topo.siblings(16, TopoLevel::Core).count(), 1);
+  // One L2 per P-core, one per cluster of four E-cores, one L3
+  CHECK_EQ(topo.cacheDomains(2).size(), size_t(10));
+  CHECK_EQ(topo.cacheSiblings(16, 2).count(), 4);
+  CHECK_EQ(topo.cacheDomains(3).size(), size_t(1));
+
+  const CoreTypeMap types(*all);
+  CHECK(types.isHybrid());
+  CHECK_EQ(types.cpuset(CoreClass::Performance).count(), 16);
+  CHECK_EQ(types.cpuset(CoreClass::Efficient).count(), 8);
+  CHECK_EQ(types.classOf(23), CoreClass::Efficient);
+  CHECK_EQ(types.nativeModelId(0), 1U);
+}
+
+// The same CPUs with every record passed through `patch`; a record it
+// returns false for is dropped
+template <typename Patch>
+static PerCpuSnapshot rewrite(const PerCpuSnapshot &all, Patch &&patch) {
+  std::vector<CpuidSnapshot> snapshots;
+  for (size_t i = 0; i < all.size(); ++i) {
+    std::vector<CpuidLeaf> leaves;
+    for (CpuidLeaf l : all[i].leaves()) {
+      if (patch(all.cpu(i), l)) leaves.push_back(l);
+    }
+    snapshots.emplace_back(ReplayBackend(std::move(leaves)));
+  }
+  return PerCpuSnapshot(all.cpus(), std::move(snapshots));
+}
+
+// Alder Lake as a part from before leaf 0xB: the shifts come from leaf 1
+// EBX[23:16] (128 IDs) and leaf 4 EAX[31:26] (64 cores)
+static void test_legacy_topology() {
+  std::optional<PerCpuSnapshot> adl = load("intel_alderlake_12900k.txt");
+  if (!adl) return;
+  const PerCpuSnapshot all = rewrite(*adl, [](int, CpuidLeaf &l) {
+    if (l.leaf == 0x0) l.regs[0] = 0xA;
+    return l.leaf < 0xB || l.leaf >= 0x80000000;
+  });
+  const Topology topo(all);
+  CHECK_EQ(topo.source(), TopoSource::Legacy);
+  CHECK_EQ(topo.shift(TopoLevel::SMT), 1U);
+  CHECK_EQ(topo.shift(TopoLevel::Core), 7U);
+  CHECK_EQ(topo.shift(TopoLevel::Package), 7U);
+  CHECK_EQ(topo.count(TopoLevel::Core), size_t(16));
+  // Nothing between core and package: those levels are the package
+  CHECK_EQ(topo.count(TopoLevel::Module), size_t(1));
+  CHECK_EQ(topo.count(TopoLevel::Die), size_t(1));
+  CHECK_EQ(topo.count(TopoLevel::Package), size_t(1));
+  // CPU 3 is the second thread of the P-core at APIC ID 8, CPU 17 the
+  // E-core at 66
+  const LogicalCpu *p = topo.forCpu(3);
+  CHECK(p && p->ids[size_t(TopoLevel::SMT)] == 1);
+  CHECK(p && p->ids[size_t(TopoLevel::Core)] == 4);
+  CHECK(p && p->ids[size_t(TopoLevel::Package)] == 0);
+  const LogicalCpu *e = topo.forCpu(17);
+  CHECK(e && e->ids[size_t(TopoLevel::Core)] == 33);
+  CHECK(e && e->ids[size_t(TopoLevel::Package)] == 0);
+}
+
+// Leaf 0x1F with a DieGrp level (type 6) above the cores: the E-cores are
+// moved to the second die group, which is still the same package
+static void test_diegrp_topology() {
+  std::optional<PerCpuSnapshot> adl = load("intel_alderlake_12900k.txt");
+  if (!adl) return;
+  const PerCpuSnapshot all = rewrite(*adl, [](int cpu, CpuidLeaf &l) {
+    const uint32_t high = cpu >= 16 ? 0x80 : 0;
+    if (l.leaf == 0x1) l.regs[1] |= high << 24;
+    if (l.leaf == 0xB) l.regs[3] |= high;
+    if (l.leaf == 0x1F) {
+      l.regs[3] |= high;
+      if (l.subleaf == 2) {
+        l.regs[0] = 8;
+        l.regs[1] = 24;
+        l.regs[2] = 6 << 8 | 2;
+      }
+    }
+    return true;
+  });
+  const Topology topo(all);
+  CHECK_EQ(topo.source(), TopoSource::Leaf1F);
+  CHECK_EQ(topo.shift(TopoLevel::Die), 7U);
+  CHECK_EQ(topo.shift(TopoLevel::Package), 8U);
+  CHECK_EQ(topo.count(TopoLevel::Package), size_t(1));
+  for (size_t i = 0; i < topo.size(); ++i) {
+    CHECK_EQ(topo[i].ids[size_t(TopoLevel::Package)], 0U);
+  }
+}
+
+static void test_zen3() {
+  std::optional<PerCpuSnapshot> all = load("amd_zen3_5950x.txt");
+  if (!all) return;
+  const CpuidSnapshot &c0 = (*all)[0];
+  CHECK_EQ(all->size(), size_t(32));
+  CHECK_EQ(c0.vendor(), CpuVendor::AMD);
+  const CpuSignature sig = cpu_signature(c0.vendor(), c0.get(0x1));
+  CHECK_EQ(sig.family, 0x19);
+  CHECK_EQ(sig.model, 0x21);
+  const Uarch *u = find_uarch(c0);
+  CHECK(u && u->core == "Zen 3");
+
+  const FeatureSet features(c0);
+  CHECK(features.has(Feature::AVX2));
+  CHECK(features.has(Feature::TOPOEXT));
+  CHECK(!features.has(Feature::AVX512F));
+  CHECK(!features.has(Feature::HYBRID));
+
+  const CacheHierarchy caches = decode_caches(c0);
+  CHECK_EQ(caches.source, CacheSource::AmdLeaf8000001D);
+  CHECK_EQ(cache_bytes(caches, 1), 32U << 10);
+  CHECK_EQ(cache_bytes(caches, 2), 512U << 10);
+  CHECK_EQ(cache_bytes(caches, 3), 32U << 20);
+  CHECK_EQ(caches.data(3)->ways, 16);
+  CHECK_EQ(caches.data(3)->sharedBy, 16);
+
+  const Topology topo(*all);
+  CHECK_EQ(topo.source(), TopoSource::LeafB);
+  CHECK_EQ(topo.count(TopoLevel::Package), size_t(1));
+  CHECK_EQ(topo.count(TopoLevel::Core), size_t(16));
+  // CPUs 0 and 16 are the two threads of core 0
+  CHECK(topo.siblings(0, TopoLevel::Core).contains(16));
+  // One L3 per CCD
+  CHECK_EQ(topo.cacheDomains(3).size(), size_t(2));
+  CHECK_EQ(topo.cacheSiblings(0, 3).count(), 16);
+  CHECK(!topo.cacheSiblings(0, 3).contains(8));
+
+  CHECK(!CoreTypeMap(*all).isHybrid());
+
+  // Without TOPOEXT the legacy leaves are used; 0x80000006 reports the L3
+  // associativity as code 9 ("see Fn8000_001D"), which must stay unknown
+  auto leaves = std::make_shared<std::vector<CpuidLeaf>>(
+      c0.leaves().begin(), c0.leaves().end());
+  for (CpuidLeaf &l : *leaves) {
+    if (l.leaf == 0x80000001) l.regs[2] &= ~(1U << 22);
+  }
+  const CpuidSnapshot legacy(*leaves, leaves);
+  const CacheHierarchy old = decode_caches(legacy);
+  CHECK_EQ(old.source, CacheSource::AmdLegacy);
+  CHECK_EQ(cache_bytes(old, 2), 512U << 10);
+  CHECK_EQ(old.data(2)->ways, 8);
+  CHECK_EQ(cache_bytes(old, 3), 32U << 20);
+  CHECK_EQ(old.data(3)->ways, 0);
+  CHECK(!old.data(3)->fullyAssociative);
+}
+
+// CPUs listed out of order, one of them twice: entries come out ascending
+// and the first record of a CPU wins
+static void test_unordered() {
+  std::optional<PerCpuSnapshot> all = load("amd_zen3_unordered.txt");
+  if (!all) return;
+  CHECK(all->cpus() == std::vector<int>({0, 2, 10, 16, 31}));
+  const CpuidSnapshot *cpu2 = all->forCpu(2);
+  CHECK(cpu2 && cpu2->get(0x1).EBX() >> 24 == 4);
+
+  const Topology topo(*all);
+  CHECK_EQ(topo.size(), size_t(5));
+  const LogicalCpu *last = topo.forCpu(31);
+  CHECK(last && last->x2apicId == 31);
+  CHECK(topo.siblings(0, TopoLevel::Core).contains(16));
+  CHECK_EQ(topo.count(TopoLevel::Core), size_t(4));
+  CHECK_EQ(CoreTypeMap(*all).classOf(31), CoreClass::Performance);
+
+  PerCpuSnapshot copy = *all;
+  CHECK(copy.erase(10));
+  CHECK(!copy.erase(10));
+  copy.set(5, *cpu2);
+  CHECK(copy.cpus() == std::vector<int>({0, 2, 5, 16, 31}));
+  CHECK(copy.forCpu(31) != nullptr);
+}
+
+static void test_kvm_guest() {
+  std::optional<PerCpuSnapshot> all = load("kvm_xeon_1cpu.txt");
+  if (!all) return;
+  const CpuidSnapshot &c0 = (*all)[0];
+  CHECK_EQ(all->size(), size_t(1));
+  CHECK_EQ(c0.vendor(), CpuVendor::Intel);
+  const Uarch *u = find_uarch(c0);
+  CHECK(u && u->name == "Emerald Rapids");
+
+  const FeatureSet features(c0);
+  CHECK(features.has(Feature::HYPERVISOR));
+  CHECK(features.has(Feature::AVX512F));
+
+  const HypervisorInfo hv = decode_hypervisor(c0);
+  CHECK_EQ(hv.vendor, Hypervisor::KVM);
+  CHECK_EQ(hv.maxLeaf, 0x40000001U);
+
+  const CacheHierarchy caches = decode_caches(c0);
+  CHECK_EQ(caches.source, CacheSource::Leaf4);
+  CHECK_EQ(cache_bytes(caches, 1), 48U << 10);
+  CHECK_EQ(cache_bytes(caches, 2), 2U << 20);
+  CHECK_EQ(cache_bytes(caches, 3), 300U << 20);
+  CHECK_EQ(caches.data(3)->ways, 20);
+
+  const Topology topo(*all);
+  CHECK_EQ(topo.count(TopoLevel::Package), size_t(1));
+  CHECK_EQ(topo.count(TopoLevel::Core), size_t(1));
+  CHECK(!CoreTypeMap(*all).isHybrid());
+}
+
+int main() {
+  test_alderlake();
+  test_legacy_topology();
+  test_diegrp_topology();
+  test_zen3();
+  test_unordered();
+  test_kvm_guest();
+  return check_exit();
+}
@@ -0,0 +1,172 @@
+// Resctrl against stand-in trees in a temporary directory: open(),
+// reserve(), mask(), usage() and friends on a two-domain L3 with MBA, a
+// CDP mount, and group names that would leave the root.
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "resctrl.hpp"
+
+#include "check.hpp"
+
+namespace fs = std::filesystem;
+
+static void write(const fs::path &path, const std::string &text) {
+  fs::create_directories(path.parent_path());
+  std::ofstream(path) << text;
+}
+
+static std::string read(const fs::path &path) {
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+// 11 ways of 1 MiB per domain, the top two shared with I/O
+static CacheHierarchy l3_of(unsigned ways) {
+  CacheHierarchy caches;
+  CacheLevel &l3 = caches.caches[0];
+  l3.level = 3;
+  l3.type = CacheType::Unified;
+  l3.ways = uint16_t(ways);
+  l3.lineSize = 64;
+  l3.sets = 16384;
+  l3.sizeBytes = ways * 64 * 16384;
+  caches.count = 1;
+  return caches;
+}
+
+static void test_groups(const fs::path &root) {
+  write(root / "schemata", "    L3:0=7ff;1=7ff\n    MB:0=100;1=100\n");
+  write(root / "tasks", "");
+  write(root / "info/L3/cbm_mask", "7ff\n");
+  write(root / "info/L3/min_cbm_bits", "2\n");
+  write(root / "info/L3/shareable_bits", "600\n");
+  write(root / "info/L3/num_closids", "16\n");
+
+  CHECK(!Resctrl::open((root / "missing").string()).has_value());
+  std::optional<Resctrl> r = Resctrl::open(root.string());
+  CHECK(r.has_value());
+  if (!r) return;
+  CHECK_EQ(r->l3().cbmMask, 0x7ffU);
+  CHECK_EQ(r->l3().minCbmBits, 2U);
+  CHECK_EQ(r->l3().shareableBits, 0x600U);
+  CHECK_EQ(r->l3().numClosids, 16U);
+  CHECK(r->domains() == std::vector<uint32_t>({0, 1}));
+  CHECK(!r->cdp());
+  CHECK(r->bandwidth());
+
+  const CacheHierarchy caches = l3_of(11);
+  CHECK_EQ(r->waysFor(size_t(3) << 20, caches), 3U);
+  CHECK_EQ(r->waysFor(1, caches), 2U);  // min_cbm_bits
+  CHECK_EQ(r->waysFor(size_t(64) << 20, caches), 11U);
+  CHECK_EQ(r->lowMask(3), 0x7U);
+
+  // 10 MiB would leave the default group one way, below min_cbm_bits
+  CHECK(!r->reserve("big", size_t(10) << 20, caches).has_value());
+  std::optional<uint32_t> mine = r->reserve("g", size_t(4) << 20, caches);
+  CHECK(mine.has_value());
+  CHECK_EQ(mine.value_or(0), 0xfU);
+  CHECK_EQ(r->mask("g").value_or(0), 0xfU);
+  CHECK_EQ(r->mask("").value_or(0), 0x7f0U);
+  // The default group's MB line survives the L3 rewrite
+  const std::string schemata = read(root / "schemata");
+  CHECK(schemata.find("L3:0=7f0;1=7f0") != std::string::npos);
+  CHECK(schemata.find("MB:0=100;1=100") != std::string::npos);
+
+  CHECK(!r->createGroup("g", 0x1000));  // outside cbm_mask
+  CHECK(!r->createGroup("g", 0x1));     // fewer than min_cbm_bits
+  CHECK(r->createGroup("g", 0x3, 50));
+  CHECK_EQ(r->mask("g").value_or(0), 0x3U);
+  CHECK(read(root / "g/schemata").find("MB:0=50;1=50") != std::string::npos);
+
+  CHECK(r->assignTask("g"));
+  CHECK(r->tasks("g") == std::vector<pid_t>({gettid()}));
+  CHECK(r->groups() == std::vector<std::string>({"g"}));
+
+  CHECK(r->usage("g").empty());
+  for (int domain = 0; domain < 2; ++domain) {
+    fs::path dir = root / std::format("g/mon_data/mon_L3_{:02}", domain);
+    write(dir / "llc_occupancy", std::format("{}\n", (domain + 1) << 20));
+    write(dir / "mbm_total_bytes", std::format("{}\n", 1000 * domain));
+    write(dir / "mbm_local_bytes", "Unavailable\n");
+  }
+  std::vector<ResctrlUsage> usage = r->usage("g");
+  CHECK_EQ(usage.size(), size_t(2));
+  if (usage.size() == 2) {
+    CHECK_EQ(usage[1].domain, 1U);
+    CHECK_EQ(usage[1].llcOccupancyBytes, uint64_t(2) << 20);
+    CHECK_EQ(usage[1].mbmTotalBytes, uint64_t(1000));
+    CHECK_EQ(usage[1].mbmLocalBytes, uint64_t(0));
+  }
+
+  // Only rmdir: a stand-in group with files in it stays
+  CHECK(!r->removeGroup(""));
+  CHECK(!r->removeGroup("g"));
+  CHECK(fs::exists(root / "g/schemata"));
+  fs::create_directory(root / "empty");
+  CHECK(r->removeGroup("empty"));
+  CHECK(!fs::exists(root / "empty"));
+}
+
+// Names with a separator, "." or "..", or of the kernel's own entries:
+// nothing outside the root, nor the root's own files, is touched
+static void test_names(const fs::path &root, const fs::path &outside) {
+  fs::create_directories(outside / "inner");
+  fs::create_directories(root / "mon_groups");
+  fs::create_directories(root / "mon_data");
+  std::optional<Resctrl> r = Resctrl::open(root.string());
+  if (!r) return;
+  const std::string up = "../" + outside.filename().string();
+  CHECK(!r->removeGroup(up));
+  CHECK(!r->removeGroup(up + "/inner"));
+  CHECK(!r->removeGroup("g/.."));
+  CHECK(!r->removeGroup("a/b"));
+  CHECK(!r->createGroup(up + "/new", 0x3));
+  CHECK(fs::exists(outside / "inner"));
+  CHECK(!fs::exists(outside / "new"));
+  for (const char *reserved : {".", "info", "mon_groups", "mon_data"}) {
+    CHECK(!r->removeGroup(reserved));
+    CHECK(!r->createGroup(reserved, 0x3));
+  }
+  CHECK(fs::exists(root / "mon_groups"));
+  CHECK(fs::exists(root / "mon_data"));
+  CHECK(fs::exists(root / "info/L3/cbm_mask"));
+  CHECK(read(root / "schemata").find("L3:0=7f0;1=7f0") != std::string::npos);
+}
+
+static void test_cdp(const fs::path &root) {
+  write(root / "schemata", "L3CODE:0=fff\nL3DATA:0=fff\n");
+  write(root / "info/L3DATA/cbm_mask", "fff\n");
+  write(root / "info/L3DATA/num_closids", "8\n");
+  std::optional<Resctrl> r = Resctrl::open(root.string());
+  CHECK(r.has_value());
+  if (!r) return;
+  CHECK(r->cdp());
+  CHECK(!r->bandwidth());
+  CHECK_EQ(r->l3().numClosids, 8U);
+  CHECK(!r->createGroup("c", 0xf, 50));  // no MB resource
+  CHECK(r->createGroup("c", 0xf));
+  CHECK_EQ(read(root / "c/schemata"), "L3CODE:0=f\nL3DATA:0=f\n");
+  CHECK_EQ(r->mask("c").value_or(0), 0xfU);
+}
+
+int main() {
+  char tmpl[] = "/tmp/cpuid-resctrl-test-XXXXXX";
+  const char *made = mkdtemp(tmpl);
+  CHECK(made != nullptr);
+  if (!made) return check_exit();
+  const fs::path base = made;
+  test_groups(base / "resctrl");
+  test_names(base / "resctrl", base / "victim");
+  test_cdp(base / "cdp");
+  // The stand-in trees are this test's own, so it removes them
+  fs::remove_all(base);
+  return check_exit();
+}
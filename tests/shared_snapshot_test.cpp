@@ -0,0 +1,82 @@
+// The shared segment's failure paths: a second publisher is refused while
+// the first holds the segment, and a reader gives up, rather than spinning,
+// on a counter a dead publisher left odd.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <format>
+#include <optional>
+#include <string>
+
+#include "backend.hpp"
+#include "shared_snapshot.hpp"
+
+#include "check.hpp"
+
+// Marks a write in progress the way a publisher killed inside publish()
+// leaves it
+static void stick_seq(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  CHECK(fd >= 0);
+  if (fd < 0) return;
+  void *addr = mmap(nullptr, sizeof(SharedSnapshotHeader),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(addr != MAP_FAILED);
+  if (addr == MAP_FAILED) return;
+  static_cast<SharedSnapshotHeader *>(addr)->seq.fetch_add(1);
+  munmap(addr, sizeof(SharedSnapshotHeader));
+}
+
+static void test_segment(const std::string &name, const CpuidSnapshot &snap) {
+  const XsaveInfo xsave = decode_xsave(snap);
+  const uint32_t ebx7 = snap.get(0x7).EBX();
+  {
+    std::optional<SnapshotPublisher> publisher =
+        SnapshotPublisher::create(name);
+    CHECK(publisher.has_value());
+    if (!publisher) return;
+    CHECK(publisher->publish(snap, xsave, 0));
+    CHECK(!SnapshotPublisher::create(name).has_value());
+
+    std::optional<SnapshotReader> reader = SnapshotReader::open(name);
+    CHECK(reader.has_value());
+    if (!reader) return;
+    CHECK_EQ(reader->generation().value_or(0), uint64_t(1));
+    std::optional<CpuidLeaf> l7 = reader->get(0x7);
+    CHECK(l7 && l7->EBX() == ebx7);
+    std::optional<CpuidSnapshot> copy = reader->snapshot();
+    CHECK(copy.has_value());
+    if (copy) CHECK_EQ(copy->size(), snap.size());
+
+    stick_seq(name);
+    CHECK(!reader->generation().has_value());
+    CHECK(!reader->get(0x7).has_value());
+    CHECK(!reader->snapshot().has_value());
+  }
+
+  // The lock went with the publisher; the next one starts past the odd
+  // counter and readers recover
+  std::optional<SnapshotPublisher> next = SnapshotPublisher::create(name);
+  CHECK(next.has_value());
+  if (!next) return;
+  CHECK(next->publish(snap, xsave, 0));
+  std::optional<SnapshotReader> reader = SnapshotReader::open(name);
+  CHECK(reader.has_value());
+  if (!reader) return;
+  CHECK_EQ(reader->generation().value_or(0), uint64_t(2));
+  std::optional<CpuidLeaf> l7 = reader->get(0x7);
+  CHECK(l7 && l7->EBX() == ebx7);
+}
+
+int main() {
+  std::optional<CpuidDump> dump =
+      load_cpuid_dump(std::string(CPUID_CORPUS_DIR) + "/amd_zen3_5950x.txt");
+  CHECK(dump.has_value());
+  if (!dump) return check_exit();
+  const std::string name = std::format("/cpuid-shm-test-{}", getpid());
+  test_segment(name, CpuidSnapshot(dump->backends[0]));
+  SnapshotPublisher::unlink(name);
+  return check_exit();
+}
@@ -0,0 +1,83 @@
+// TaskGroup lifetime under stress: groups allocated on the heap by a thread
+// outside the pool and deleted as soon as wait() returns, while the worker
+// that ran the last task may still be inside done(). Best run under
+// AddressSanitizer, which reports any touch of a freed group.
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+#include "check.hpp"
+
+static void test_delete_after_wait(ThreadPool &pool, int groups, int tasks) {
+  std::atomic<size_t> ran{0};
+  for (int i = 0; i < groups; ++i) {
+    auto *group = new TaskGroup(pool);
+    for (int t = 0; t < tasks; ++t) {
+      group->run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+    }
+    group->wait();
+    delete group;
+    // Reuse the freed block at once, so a late done() sees garbage
+    auto *scribble = new char[sizeof(TaskGroup)];
+    std::memset(scribble, 0xA5, sizeof(TaskGroup));
+    delete[] scribble;
+  }
+  CHECK_EQ(ran.load(), size_t(groups) * size_t(tasks));
+}
+
+// Several outside threads at once, each with its own short-lived groups
+static void test_concurrent_waiters(ThreadPool &pool) {
+  constexpr int kThreads = 4;
+  constexpr int kGroups = 2000;
+  std::atomic<size_t> ran{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&] {
+      for (int g = 0; g < kGroups; ++g) {
+        auto group = std::make_unique<TaskGroup>(pool);
+        for (int t = 0; t < 3; ++t) {
+          group->run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+        }
+        group->wait();
+      }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+  CHECK_EQ(ran.load(), size_t(kThreads) * kGroups * 3);
+}
+
+// Groups forked and joined on workers, destroyed inside the task
+static void test_nested(ThreadPool &pool) {
+  std::atomic<size_t> ran{0};
+  TaskGroup outer(pool);
+  for (int i = 0; i < 200; ++i) {
+    outer.run([&pool, &ran] {
+      for (int g = 0; g < 10; ++g) {
+        TaskGroup inner(pool);
+        for (int t = 0; t < 4; ++t) {
+          inner.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+        }
+      }
+    });
+  }
+  outer.wait();
+  CHECK_EQ(ran.load(), size_t(200 * 10 * 4));
+}
+
+int main() {
+  // More workers than this machine may have CPUs; they share them
+  for (unsigned workers : {2U, 4U, 8U}) {
+    ThreadPool pool(ThreadPool::Options{.workers = workers, .pin = false});
+    CHECK_EQ(pool.size(), size_t(workers));
+    test_delete_after_wait(pool, 20000, 1);
+    test_delete_after_wait(pool, 2000, 16);
+    test_concurrent_waiters(pool);
+    test_nested(pool);
+  }
+  return check_exit();
+}
@@ -0,0 +1,113 @@
+// CpuWatcher::refresh() against a fake sysfs tree, with CPUs read from the
+// Zen 3 corpus dump instead of pinned threads: the CpuChange lists after a
+// CPU goes offline, comes back, and gets new microcode that flips a bit.
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "backend.hpp"
+#include "watch.hpp"
+
+#include "check.hpp"
+
+static void write_file(const std::string &path, const std::string &text) {
+  std::ofstream(path) << text << '\n';
+}
+
+static void write_microcode(const std::string &sys, int cpu, uint32_t rev) {
+  std::string dir = std::format("{}/cpu{}/microcode", sys, cpu);
+  std::filesystem::create_directories(dir);
+  write_file(dir + "/version", std::format("{:#x}", rev));
+}
+
+static void test_watch(const std::string &sys) {
+  std::optional<CpuidDump> dump =
+      load_cpuid_dump(std::string(CPUID_CORPUS_DIR) + "/amd_zen3_5950x.txt");
+  CHECK(dump.has_value());
+  if (!dump) return;
+  const PerCpuSnapshot recorded(*dump);
+  constexpr int kCpus = 8;
+
+  for (int cpu = 0; cpu < kCpus; ++cpu) write_microcode(sys, cpu, 0x100);
+  write_file(sys + "/online", "0-7");
+
+  // The "new microcode" flips CPUID.(7,0):EDX[4] on CPU 0
+  std::atomic<bool> patched{false};
+  auto read = [&](int cpu) -> std::optional<CpuidSnapshot> {
+    const CpuidSnapshot *snap = recorded.forCpu(cpu);
+    if (!snap) return std::nullopt;
+    if (cpu != 0 || !patched) return *snap;
+    std::vector<CpuidLeaf> leaves(snap->leaves().begin(), snap->leaves().end());
+    for (CpuidLeaf &l : leaves) {
+      if (l.leaf == 0x7 && l.subleaf == 0) l.regs[3] ^= 1U << 4;
+    }
+    return CpuidSnapshot(ReplayBackend(std::move(leaves)));
+  };
+  CpuWatcher watcher({.sysRoot = sys, .read = read, .netlink = false});
+  CHECK_EQ(watcher.cpus().size(), size_t(kCpus));
+  CHECK(watcher.refresh().empty());
+
+  write_file(sys + "/online", "0-6");
+  std::vector<CpuChange> changes = watcher.refresh();
+  CHECK_EQ(changes.size(), size_t(1));
+  if (changes.size() == 1) {
+    CHECK_EQ(changes[0].cpu, 7);
+    CHECK_EQ(changes[0].kind, CpuChange::Kind::Offline);
+    CHECK_EQ(changes[0].oldMicrocode, 0x100U);
+  }
+  CHECK(watcher.cpus().forCpu(7) == nullptr);
+  CHECK_EQ(watcher.topology().size(), size_t(kCpus - 1));
+
+  write_file(sys + "/online", "0-7");
+  changes = watcher.refresh();
+  CHECK_EQ(changes.size(), size_t(1));
+  if (changes.size() == 1) {
+    CHECK_EQ(changes[0].cpu, 7);
+    CHECK_EQ(changes[0].kind, CpuChange::Kind::Online);
+    CHECK_EQ(changes[0].newMicrocode, 0x100U);
+    CHECK(changes[0].leaves.empty());
+    CHECK_EQ(changes[0].topology.cpu, 7);
+    CHECK_EQ(changes[0].topology.x2apicId, 14U);
+  }
+  CHECK_EQ(watcher.cpus().size(), size_t(kCpus));
+
+  patched = true;
+  write_microcode(sys, 0, 0x101);
+  changes = watcher.refresh();
+  CHECK_EQ(changes.size(), size_t(1));
+  if (changes.size() == 1) {
+    const CpuChange &c = changes[0];
+    CHECK_EQ(c.cpu, 0);
+    CHECK_EQ(c.kind, CpuChange::Kind::Changed);
+    CHECK_EQ(c.oldMicrocode, 0x100U);
+    CHECK_EQ(c.newMicrocode, 0x101U);
+    CHECK_EQ(c.leaves.size(), size_t(1));
+    if (c.leaves.size() == 1) {
+      const uint32_t edx = recorded[0].get(0x7).EDX();
+      CHECK_EQ(c.leaves[0].leaf, 0x7U);
+      CHECK_EQ(c.leaves[0].subleaf, 0U);
+      CHECK_EQ(c.leaves[0].reg, CpuidReg::EDX);
+      CHECK_EQ(c.leaves[0].before, edx);
+      CHECK_EQ(c.leaves[0].after, edx ^ (1U << 4));
+    }
+  }
+  CHECK(watcher.refresh().empty());
+}
+
+int main() {
+  char tmpl[] = "/tmp/cpuid-watch-test-XXXXXX";
+  const char *made = mkdtemp(tmpl);
+  CHECK(made != nullptr);
+  if (!made) return check_exit();
+  const std::string sys = made;
+  test_watch(sys);
+  std::filesystem::remove_all(sys);
+  return check_exit();
+}